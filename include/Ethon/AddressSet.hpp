@@ -0,0 +1,319 @@
+/*
+AddressSet.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_ADDRESSSET_HPP__
+#define __ETHON_ADDRESSSET_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+namespace Ethon
+{
+  /**
+  * A sorted set of addresses, for example scan results, stored compactly.
+  * Addresses are grouped into blocks of at most BLOCK_CAPACITY addresses
+  * spanning less than 2 GiB, each storing its first address and 32 bit
+  * offsets to it. This takes about 4 bytes per address, a tenth of a
+  * std::set. Once the offsets exceed the spill threshold they move into an
+  * unlinked temporary file which is memory mapped, so the kernel can page
+  * them out instead of swapping.
+  * Set operations skip blocks which do not overlap. Intersection and
+  * difference compare the offsets of overlapping blocks four by four with
+  * SSE2, union copies non-overlapping blocks whole and merges the others
+  * address by address, near() walks the addresses one by one.
+  * Sets are movable but not copyable.
+  */
+  class AddressSet
+  {
+  public:
+    // Maximum amount of addresses per block.
+    static std::size_t const BLOCK_CAPACITY = 256;
+
+    // Maximum distance between the first and the last address of a block.
+    static std::uintptr_t const MAX_BLOCK_SPAN = 0x7FFFFFFF;
+
+    // Default size in bytes from which on offsets are spilled to a file.
+    static std::size_t const SPILL_THRESHOLD = 64 * 1024 * 1024;
+
+    /**
+    * A run of close addresses.
+    */
+    struct Block
+    {
+      std::uintptr_t base;  // First address.
+      std::uintptr_t last;  // Last address.
+      std::uint64_t first;  // Index of the block's first offset.
+      std::uint32_t count;  // Amount of addresses.
+    };
+
+    /**
+    * Iterates over the addresses in ascending order.
+    */
+    class const_iterator
+      : public boost::iterator_facade<  const_iterator,
+                                        std::uintptr_t const,
+                                        boost::forward_traversal_tag,
+                                        std::uintptr_t >
+    {
+    private:
+      friend class boost::iterator_core_access;
+      friend class AddressSet;
+
+      AddressSet const* m_set;
+      std::size_t m_block;
+      std::uint32_t m_index;
+
+      const_iterator(AddressSet const* set, std::size_t block);
+
+      void increment();
+      bool equal(const_iterator const& other) const;
+      std::uintptr_t dereference() const;
+
+    public:
+      /**
+      * Default constructor creating an invalid iterator.
+      */
+      const_iterator();
+    };
+
+  private:
+    std::vector<Block> m_blocks;
+    std::vector<std::uint32_t> m_offsets;   // Offsets while in memory.
+    std::uint32_t* m_map;                   // Offsets once spilled.
+    std::uint64_t m_mapCapacity;
+    int m_file;
+    std::uint64_t m_size;
+    std::size_t m_spillThreshold;
+    boost::filesystem::path m_spillDirectory;
+
+    /**
+    * Gets the offsets of all blocks.
+    * @return Pointer to the first offset.
+    */
+    std::uint32_t const* getOffsets() const;
+
+    /**
+    * Appends an offset to the last block.
+    * @param offset The offset.
+    */
+    void pushOffset(std::uint32_t offset);
+
+    /**
+    * Appends offsets to the last block.
+    * @param offsets The offsets.
+    * @param count Amount of offsets.
+    */
+    void pushOffsets(std::uint32_t const* offsets, std::size_t count);
+
+    /**
+    * Moves the offsets into a memory mapped file.
+    */
+    void spill();
+
+    /**
+    * Resizes the spill file and its mapping.
+    * @param capacity The new capacity in offsets.
+    */
+    void growMap(std::uint64_t capacity);
+
+    /**
+    * Unmaps and closes the spill file, if any.
+    */
+    void release();
+
+    /**
+    * Creates an empty set with the same spill settings.
+    * @return The set.
+    */
+    AddressSet makeResult() const;
+
+    /**
+    * Appends the addresses of this set which are or are not contained in
+    * another set.
+    * @param other The other set.
+    * @param contained True to keep the contained addresses, false to keep
+    * the others.
+    * @param result The set the addresses are appended to.
+    */
+    void filter(AddressSet const& other, bool contained,
+      AddressSet& result) const;
+
+  public:
+    /**
+    * Constructor creating an empty set.
+    */
+    AddressSet();
+
+    /**
+    * Constructor creating a set of addresses.
+    * @param addresses The addresses in any order, duplicates are dropped.
+    */
+    explicit AddressSet(std::vector<std::uintptr_t> addresses);
+
+    AddressSet(AddressSet&& other);
+    AddressSet& operator=(AddressSet&& other);
+    AddressSet(AddressSet const&) = delete;
+    AddressSet& operator=(AddressSet const&) = delete;
+
+    /**
+    * Destructor removing the spill file.
+    */
+    ~AddressSet();
+
+    /**
+    * Sets from which size on offsets are spilled to a file. Sets created
+    * by operations on this set inherit the setting.
+    * @param threshold The size in bytes.
+    * @param directory Directory of the spill file, empty for the system's
+    * temporary directory.
+    */
+    void setSpilling(std::size_t threshold,
+      boost::filesystem::path const& directory = boost::filesystem::path());
+
+    /**
+    * Appends an address greater than all addresses of the set.
+    * @param address The address.
+    */
+    void append(std::uintptr_t address);
+
+    /**
+    * Appends addresses greater than all addresses of the set.
+    * @param addresses The addresses in ascending order.
+    */
+    void append(std::vector<std::uintptr_t> const& addresses);
+
+    /**
+    * Appends an encoded block of addresses greater than all addresses of
+    * the set, for example one read from a file.
+    * @param base The block's first address.
+    * @param offsets Ascending offsets of the addresses to base, the first
+    * being 0 and the last at most MAX_BLOCK_SPAN.
+    * @param count Amount of offsets, at most BLOCK_CAPACITY.
+    */
+    void appendBlock(std::uintptr_t base, std::uint32_t const* offsets,
+      std::uint32_t count);
+
+    /**
+    * Removes all addresses.
+    */
+    void clear();
+
+    /**
+    * Gets the amount of addresses.
+    * @return The amount.
+    */
+    std::uint64_t size() const;
+
+    /**
+    * Tests if the set is empty.
+    * @return True if it is empty, false otherwise.
+    */
+    bool empty() const;
+
+    /**
+    * Tests if the offsets were spilled to a file.
+    * @return True if they were, false otherwise.
+    */
+    bool isSpilled() const;
+
+    /**
+    * Gets the size of the compressed representation.
+    * @return The size in bytes.
+    */
+    std::uint64_t getByteSize() const;
+
+    /**
+    * Gets the blocks the addresses are stored in.
+    * @return The blocks in ascending order.
+    */
+    std::vector<Block> const& getBlocks() const;
+
+    /**
+    * Gets the offsets of a block's addresses.
+    * @param block A block of this set.
+    * @return Pointer to block.count offsets.
+    */
+    std::uint32_t const* getOffsets(Block const& block) const;
+
+    /**
+    * Tests if the set contains an address.
+    * @param address The address.
+    * @return True if it does, false otherwise.
+    */
+    bool contains(std::uintptr_t address) const;
+
+    /**
+    * Gets an iterator to the smallest address.
+    * @return The iterator.
+    */
+    const_iterator begin() const;
+
+    /**
+    * Gets an iterator behind the greatest address.
+    * @return The iterator.
+    */
+    const_iterator end() const;
+
+    /**
+    * Copies the addresses into a vector.
+    * @return The addresses in ascending order.
+    */
+    std::vector<std::uintptr_t> toVector() const;
+
+    /**
+    * Computes the addresses contained in both sets.
+    * @param other The other set.
+    * @return The intersection.
+    */
+    AddressSet intersect(AddressSet const& other) const;
+
+    /**
+    * Computes the addresses contained in any of both sets.
+    * @param other The other set.
+    * @return The union.
+    */
+    AddressSet unite(AddressSet const& other) const;
+
+    /**
+    * Computes the addresses of this set not contained in another one.
+    * @param other The other set.
+    * @return The difference.
+    */
+    AddressSet subtract(AddressSet const& other) const;
+
+    /**
+    * Computes the addresses of this set which are close to an address of
+    * another set, for example values near a pointer found by another scan.
+    * @param other The other set.
+    * @param tolerance Maximum distance in bytes, in either direction.
+    * @return The addresses.
+    */
+    AddressSet near(AddressSet const& other, std::uintptr_t tolerance) const;
+  };
+}
+
+#endif // __ETHON_ADDRESSSET_HPP__
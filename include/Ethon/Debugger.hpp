@@ -118,6 +118,18 @@ namespace Ethon
     */
     void stepSyscall(int signalCode = 0) const;
 
+    /**
+    * Sets ptrace options (PTRACE_O_*) for the debugged process.
+    * @param options The options to set.
+    */
+    void setOptions(long options) const;
+
+    /**
+    * Waits until the debugged process stops, exits or is killed.
+    * @return The status as reported by waitpid(2).
+    */
+    int wait() const;
+
     /**
     * Sends the debugged process a SIGKILL to terminate it.
     */
@@ -66,6 +66,11 @@ namespace Ethon
     : public SystemApiError
   { };
 
+  // Will be thrown whenever a scan is cancelled or exceeds its deadline.
+  class ScanAbortedError
+    : public EthonError
+  { };
+
   // Records the current set system error code.
   std::error_code makeErrorCode();
 
@@ -0,0 +1,152 @@
+/*
+FleetScanner.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_FLEETSCANNER_HPP__
+#define __ETHON_FLEETSCANNER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <functional>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ScanContext.hpp>
+
+namespace Ethon
+{
+  class ValueQuery;
+  class StructQuery;
+
+  /**
+  * A match inside one process of a fleet.
+  */
+  struct FleetMatch
+  {
+    Pid pid;
+    std::uintptr_t address;
+  };
+
+  /**
+  * Scans many processes at once, for example every instance of a service.
+  * Read-only file-backed regions whose pages all come from the page cache
+  * have the same content in every process mapping the same device, inode
+  * and offset, so each of them is scanned once and its matches are
+  * reported for every process mapping it. All other regions are scanned
+  * per process, in parallel across the processes. Memory is read with
+  * process_vm_readv, the processes are neither debugged nor stopped.
+  */
+  class FleetScanner
+  {
+  private:
+    typedef std::function<std::vector<std::uintptr_t> (Scanner&,
+      MemoryRegion const&)> RegionSearch;
+
+    std::vector<Process> m_processes;
+    std::size_t m_threads;
+    ScanContext m_context;
+
+    /**
+    * Runs a search over the regions of all processes.
+    * @param search Functor searching a single region.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The matches, ordered by pid and address.
+    */
+    std::vector<FleetMatch> findAll(RegionSearch const& search,
+      RegionFilter const& filter);
+
+  public:
+    /**
+    * Constructor.
+    * @param processes The processes to scan.
+    * @param threads Number of regions scanned in parallel, 0 for one per
+    * core.
+    */
+    explicit FleetScanner(std::vector<Process> const& processes,
+      std::size_t threads = 0);
+
+    /**
+    * Constructor scanning all processes with a given name, see
+    * getProcessListByName().
+    * @param processName The processes' name.
+    * @param threads Number of regions scanned in parallel, 0 for one per
+    * core.
+    */
+    explicit FleetScanner(std::string const& processName,
+      std::size_t threads = 0);
+
+    /**
+    * Sets the context scans report their progress to and check for
+    * cancellation, see ScanContext.hpp. Shared regions count once.
+    * @param context The context.
+    */
+    void setContext(ScanContext const& context);
+
+    /**
+    * Gets the scanned processes.
+    * @return The processes.
+    */
+    std::vector<Process> const& getProcesses() const;
+
+    /**
+    * Finds all occurrences of a signature. References are not resolved,
+    * since their targets may differ between the processes.
+    * @param signature The signature.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The matches, ordered by pid and address.
+    */
+    std::vector<FleetMatch> findAll(Signature const& signature,
+      RegionFilter const& filter = "r***");
+
+    /**
+    * Finds all values matching a query.
+    * @param query The query, see ValueQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The matches, ordered by pid and address.
+    */
+    std::vector<FleetMatch> findAll(ValueQuery const& query,
+      RegionFilter const& filter = "r***");
+
+    /**
+    * Finds all structures matching a struct shape.
+    * @param query The query, see StructQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The base addresses, ordered by pid and address.
+    */
+    std::vector<FleetMatch> findAll(StructQuery const& query,
+      RegionFilter const& filter = "r***");
+
+    /**
+    * Finds all occurrences of a string in all of its encodings.
+    * @param query The query, see StringQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The matches, ordered by pid and address.
+    */
+    std::vector<FleetMatch> findAll(StringQuery const& query,
+      RegionFilter const& filter = "r***");
+  };
+}
+
+#endif // __ETHON_FLEETSCANNER_HPP__
@@ -0,0 +1,221 @@
+/*
+IncrementalScanner.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_INCREMENTALSCANNER_HPP__
+#define __ETHON_INCREMENTALSCANNER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+
+// Boost Library:
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ScanContext.hpp>
+
+namespace Ethon
+{
+  class MemoryEditor;
+  class ValueQuery;
+  class StructQuery;
+  class StringQuery;
+
+  /**
+  * Repeats the same search over a process, rereading only what changed.
+  * The matches of every region are kept between passes. After reading the
+  * dirty pages, each pass clears the process' soft-dirty bits through
+  * /proc/[pid]/clear_refs, so the next pass finds the pages written in
+  * the meantime in /proc/[pid]/pagemap, rescans only those and keeps the
+  * cached matches of all clean pages. The cost of a pass is thus
+  * proportional to the write rate instead of the size of the process.
+  * New and resized regions are rescanned completely. Without kernel
+  * support for soft-dirty bits every pass is a full scan.
+  * Clearing soft-dirty bits affects the whole process, so only one
+  * instance should track a process at a time. Pages written between
+  * reading pagemap and clearing the bits are missed unless the process is
+  * stopped during a pass, as it is while attached by the Debugger.
+  */
+  class IncrementalScanner
+    : boost::noncopyable
+  {
+  public:
+    /**
+    * Searches a buffer. Parameters are the buffer, its size, the amount of
+    * leading bytes matches may start in, its virtual address and the vector
+    * the matching addresses are appended to in ascending order.
+    */
+    typedef std::function<void (std::uint8_t const*, std::size_t,
+      std::size_t, std::uintptr_t, std::vector<std::uintptr_t>&)>
+      BufferSearch;
+
+    // Granularity of the soft-dirty bits.
+    static std::size_t const PAGE_BYTES = 4096;
+
+  private:
+    // The cached state of a region.
+    struct RegionState
+    {
+      MemoryRegion region;
+      std::vector<std::uintptr_t> results;  // Ascending.
+      std::vector<bool> present;            // Pages resident at last pass.
+    };
+
+    Process m_process;
+    std::shared_ptr<MemorySource> m_source;
+    Scanner m_scanner;
+    RegionFilter m_filter;
+    BufferSearch m_search;
+    std::size_t m_span;
+    bool m_incremental;
+    std::vector<RegionState> m_states;      // Ascending by start address.
+    std::uint64_t m_rescanned;
+
+    /**
+    * Reads the pagemap entries of a region.
+    * @param file Descriptor of the process' pagemap.
+    * @param region The region.
+    * @param dirty Receives one flag per page, set if it was written since
+    * the bits were cleared.
+    * @param present Receives one flag per page, set if it is resident or
+    * swapped.
+    * @return False if the entries could not be read, leaving dirty and
+    * present unchanged.
+    */
+    bool readPagemap(int file, MemoryRegion const& region,
+      std::vector<bool>& dirty, std::vector<bool>& present) const;
+
+    /**
+    * Clears the soft-dirty bits of all pages of the process.
+    * @return False if the kernel refused.
+    */
+    bool clearSoftDirty() const;
+
+    /**
+    * Searches the matches starting in a range of a region.
+    * @param region The region.
+    * @param start First address of the range.
+    * @param end Address behind the range.
+    * @param results Vector the matches are appended to.
+    */
+    void scanRange(MemoryRegion const& region, std::uintptr_t start,
+      std::uintptr_t end, std::vector<std::uintptr_t>& results);
+
+    /**
+    * Sets the search and forgets all cached matches.
+    * @param search The search.
+    * @param span Maximum size of a match, at least 1.
+    */
+    void setSearch(BufferSearch const& search, std::size_t span);
+
+  public:
+    /**
+    * Constructor reading the process through an editor.
+    * @param editor The editor, see MemoryEditor.
+    * @param filter Selects the regions to search, see RegionFilter.hpp.
+    */
+    explicit IncrementalScanner(MemoryEditor const& editor,
+      RegionFilter const& filter = "rw**");
+
+    /**
+    * Constructor reading the process with process_vm_readv, see
+    * RemoteMemorySource.
+    * @param process The process.
+    * @param filter Selects the regions to search, see RegionFilter.hpp.
+    */
+    explicit IncrementalScanner(Process const& process,
+      RegionFilter const& filter = "rw**");
+
+    /**
+    * Tests if the running kernel tracks soft-dirty bits.
+    * @return True if it does, false otherwise.
+    */
+    static bool isSoftDirtySupported();
+
+    /**
+    * Sets the context passes report their progress to and check for
+    * cancellation, see ScanContext.hpp. Only rescanned bytes count.
+    * @param context The context.
+    */
+    void setContext(ScanContext const& context);
+
+    /**
+    * Searches values matching a query.
+    * @param query The query, see ValueQuery.hpp.
+    */
+    void setQuery(ValueQuery const& query);
+
+    /**
+    * Searches occurrences of a signature. References are not resolved,
+    * since their targets may change without the match changing.
+    * @param signature The signature.
+    */
+    void setQuery(Signature const& signature);
+
+    /**
+    * Searches structures matching a struct shape.
+    * @param query The query, see StructQuery.hpp.
+    */
+    void setQuery(StructQuery const& query);
+
+    /**
+    * Searches occurrences of a string in any of its encodings.
+    * @param query The query, see StringQuery.hpp.
+    */
+    void setQuery(StringQuery const& query);
+
+    /**
+    * Forgets all cached matches, so the next pass is a full scan.
+    */
+    void reset();
+
+    /**
+    * Runs a pass, rescanning the pages written since the previous one.
+    * The first pass after setting a query scans everything.
+    * @return All current matches, ascending.
+    */
+    std::vector<std::uintptr_t> scan();
+
+    /**
+    * Tests if passes rescan only dirty pages.
+    * @return True if soft-dirty bits are used, false if every pass is a
+    * full scan.
+    */
+    bool isIncremental() const;
+
+    /**
+    * Gets the amount of bytes the last pass read from the process.
+    * @return The amount in bytes.
+    */
+    std::uint64_t getRescannedBytes() const;
+  };
+}
+
+#endif // __ETHON_INCREMENTALSCANNER_HPP__
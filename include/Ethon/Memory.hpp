@@ -37,6 +37,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 namespace Ethon
 {
+  class RegionMap;
+
   /**
   * Specifies access modes.
   */
@@ -111,6 +113,15 @@ namespace Ethon
     */
     bool isReadable(std::uintptr_t address) const;
 
+    /**
+    * Determines if it is possible to read from an address, looking it up in
+    * a snapshot of the regions instead of rereading them.
+    * @param address Address to check.
+    * @param regions The snapshot, see RegionMap.hpp.
+    * @return True if readable, false otherwise.
+    */
+    bool isReadable(std::uintptr_t address, RegionMap const& regions) const;
+
     /**
     * Determines if it is possible to write to an address.
     * @param address Address to check.
@@ -118,6 +129,15 @@ namespace Ethon
     */
     bool isWriteable(std::uintptr_t address) const;
 
+    /**
+    * Determines if it is possible to write to an address, looking it up in
+    * a snapshot of the regions instead of rereading them.
+    * @param address Address to check.
+    * @param regions The snapshot, see RegionMap.hpp.
+    * @return True if writeable, false otherwise.
+    */
+    bool isWriteable(std::uintptr_t address, RegionMap const& regions) const;
+
     /**
     * Reads a chunk of memory from the process.
     * @param address Address to read from.
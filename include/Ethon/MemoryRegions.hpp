@@ -29,16 +29,22 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <algorithm>
 #include <utility>
 #include <cstdio>
+#include <vector>
+#include <memory>
 
 // Boost Library:
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/optional.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
 
 // Ethon:
 #include <Ethon/Processes.hpp>
 
 namespace Ethon
 {
+  class RegionMap;
+
   /**
   * The currently mapped memory regions and their access permissions.
   */
@@ -46,19 +52,33 @@ namespace Ethon
   {
     friend class MemoryRegionIterator;
 
-  private:
+  public:
 
+    /**
+    * Permission bits as returned by getPermissionMask().
+    */
     enum Perms
     {
-      kPerm_Read,
-      kPerm_Write,
-      kPerm_Execute,
-      kPerm_Shared
+      kPerm_Read    = 1 << 0,
+      kPerm_Write   = 1 << 1,
+      kPerm_Execute = 1 << 2,
+      kPerm_Shared  = 1 << 3,
+      kPerm_Private = 1 << 4
     };
 
+    /**
+    * Converts permissions in the format returned by getPermissions() to
+    * kPerm_* bits.
+    * @param perms The permissions.
+    * @return The bits.
+    */
+    static std::uint8_t makePermissionMask(std::array<char, 4> const& perms);
+
+  private:
+
     std::uintptr_t   	  m_start;    // Begin of the address space.
     std::uintptr_t   	  m_end;      // End of the address space.
-    std::array<char, 4> m_perms;    // A set of permissions.
+    std::uint8_t        m_perms;    // A set of kPerm_* bits.
     std::uint32_t   	  m_offset;   // The offset into the file.
     std::uint16_t    	  m_devMajor; // The major device number.
     std::uint16_t    	  m_devMinor; // The minor device numer.
@@ -72,6 +92,23 @@ namespace Ethon
     */
     MemoryRegion();
 
+    /**
+    * Constructor creating a memory region from its fields, for example to
+    * describe memory which is not part of a live process.
+    * @param start The virtual start address.
+    * @param end The virtual end address.
+    * @param perms Permissions in the format returned by getPermissions().
+    * @param offset The offset into the mapped file.
+    * @param devMajor The major device number of the mapped file.
+    * @param devMinor The minor device number of the mapped file.
+    * @param inode The inode of the mapped file.
+    * @param path The path of the mapped file.
+    */
+    MemoryRegion(std::uintptr_t start, std::uintptr_t end,
+      std::array<char, 4> const& perms, std::uint32_t offset = 0,
+      std::uint16_t devMajor = 0, std::uint16_t devMinor = 0,
+      std::uint32_t inode = 0, std::string const& path = std::string());
+
     /**
     * Gets the memory region's virtual start address.
     * @return The memory region's virtual start address.
@@ -125,7 +162,13 @@ namespace Ethon
     * byte which is either 'p' or 's', indicating if the region is shared.
     * @return The memory regions permissions.
     */
-    const std::array<char, 4>& getPermissions() const;
+    std::array<char, 4> getPermissions() const;
+
+    /**
+    * Returns the memory region's permissions as kPerm_* bits.
+    * @return The memory regions permissions.
+    */
+    std::uint8_t getPermissionMask() const;
 
     /**
     * Gets the offset into the mapped file.
@@ -160,6 +203,69 @@ namespace Ethon
     const std::string& getPath() const;
   };
 
+  /**
+  * A line of /proc/[pid]/maps. The path points into the buffer of the
+  * MapsReader which parsed it and stays valid until the file is read again.
+  */
+  struct MapsEntry
+  {
+    std::uintptr_t start;
+    std::uintptr_t end;
+    std::array<char, 4> perms;
+    std::uint64_t offset;
+    std::uint16_t devMajor;
+    std::uint16_t devMinor;
+    std::uint64_t inode;
+    boost::string_ref path;   // Empty for anonymous regions.
+  };
+
+  /**
+  * Reads /proc/[pid]/maps in large blocks, with a single read if the buffer
+  * is large enough, and parses its lines in place. The buffer grows as
+  * needed and is kept for rereading, so parsing does not allocate. A
+  * destroyed reader hands its buffer to the next one created.
+  */
+  class MapsReader
+    : boost::noncopyable
+  {
+  private:
+    int m_file;
+    std::vector<char> m_buffer;
+    std::size_t m_size;       // Amount of read bytes.
+    std::size_t m_position;   // Start of the next line, behind m_size once
+                              // next() reached the end.
+
+  public:
+    /**
+    * Constructor reading the maps of a process.
+    * @param process The process.
+    */
+    explicit MapsReader(Process const& process);
+
+    /**
+    * Destructor closing the file.
+    */
+    ~MapsReader();
+
+    /**
+    * Reads the file again, entries parsed before become invalid.
+    */
+    void read();
+
+    /**
+    * Parses the next line.
+    * @param entry Receives the line's fields.
+    * @return False if there are no more lines.
+    */
+    bool next(MapsEntry& entry);
+
+    /**
+    * Checks if next() reached the end of the file.
+    * @return True if it did, false otherwise.
+    */
+    bool isExhausted() const;
+  };
+
   /**
   * Iterates over all memory regions of a process.
   * This iterator only creates flat copies when copied, so handle a copy like
@@ -175,13 +281,6 @@ namespace Ethon
 
     friend class boost::iterator_core_access;
 
-    /**
-     * Parses a line from /proc/[pid]/maps and stores it.
-     * @param line Line to parse.
-     * @return Number of read fields.
-     */
-    int parse(char const* line);
-
     /**
     * Increments the iterator to point to the next entry.
     */
@@ -201,7 +300,7 @@ namespace Ethon
     MemoryRegion& dereference() const;
 
     mutable MemoryRegion m_current;
-    std::shared_ptr<FILE> m_maps;
+    std::shared_ptr<MapsReader> m_maps;
 
   public:
 
@@ -253,13 +352,25 @@ namespace Ethon
   MemoryRegionSequence makeMemoryRegionSequence(Process const& process);
   
   /**
-  * Retrieves the memory region an address is inside.
+  * Retrieves the memory region an address is inside. Rereads the regions
+  * of the process on every call, see the RegionMap overload for repeated
+  * lookups.
   * @param process The process.
   * @param address Address to query for.
   * @return The memory-region, if found.
   */
   boost::optional<MemoryRegion> getMatchingRegion(Process const& process,
     std::uintptr_t address);
+
+  /**
+  * Retrieves the memory region an address is inside from a snapshot of the
+  * regions, using a binary search.
+  * @param regions The snapshot, see RegionMap.hpp.
+  * @param address Address to query for.
+  * @return The memory-region, if found.
+  */
+  boost::optional<MemoryRegion> getMatchingRegion(RegionMap const& regions,
+    std::uintptr_t address);
 }
 
 #endif //__ETHON_MEMORYREGIONS_HPP__
\ No newline at end of file
@@ -0,0 +1,315 @@
+/*
+MemorySource.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_MEMORYSOURCE_HPP__
+#define __ETHON_MEMORYSOURCE_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+#include <Ethon/Processes.hpp>
+
+namespace Ethon
+{
+  class Snapshot;
+
+  /**
+  * Memory a Scanner reads from: a live process or a capture of one.
+  * Implementations must allow concurrent reads.
+  */
+  class MemorySource
+    : boost::noncopyable
+  {
+  public:
+    /**
+    * Virtual destructor.
+    */
+    virtual ~MemorySource();
+
+    /**
+    * Gets all memory regions of the source.
+    * @return The regions, ordered by address.
+    */
+    virtual std::vector<MemoryRegion> getRegions() const = 0;
+
+    /**
+    * Reads memory. Reading stops at the first byte which is not available,
+    * for example because it was not captured.
+    * @param address Address to read from.
+    * @param dest Pointer to buffer.
+    * @param amount Amount of bytes to read.
+    * @return Amount of read bytes.
+    */
+    virtual std::size_t read(std::uintptr_t address, std::uint8_t* dest,
+      std::size_t amount) = 0;
+
+    /**
+    * Gets direct access to memory, if the source can provide it without
+    * copying.
+    * @param address The address.
+    * @param available Receives the amount of bytes accessible from the
+    * returned pointer.
+    * @return A pointer to the memory at address, or NULL if the source
+    * cannot provide direct access.
+    */
+    virtual std::uint8_t const* map(std::uintptr_t address,
+      std::size_t& available);
+
+    /**
+    * Gets the path of the executable whose memory the source holds, if
+    * known.
+    * @return The path or an empty string.
+    */
+    virtual std::string getExecutable() const;
+  };
+
+  /**
+  * Reads the memory of a live process.
+  */
+  class ProcessMemorySource
+    : public MemorySource
+  {
+  private:
+    MemoryEditor m_editor;
+
+  public:
+    /**
+    * Constructor.
+    * @param editor MemoryEditor used for reading memory.
+    */
+    explicit ProcessMemorySource(MemoryEditor const& editor);
+
+    /**
+    * Gets all memory regions of the process.
+    * @return The regions, ordered by address.
+    */
+    std::vector<MemoryRegion> getRegions() const;
+
+    /**
+    * Reads memory, treating I/O errors as an empty read.
+    * @param address Address to read from.
+    * @param dest Pointer to buffer.
+    * @param amount Amount of bytes to read.
+    * @return Amount of read bytes.
+    */
+    std::size_t read(std::uintptr_t address, std::uint8_t* dest,
+      std::size_t amount);
+
+    /**
+    * Gets the path of the process' executable.
+    * @return The path or an empty string if it can't be read.
+    */
+    std::string getExecutable() const;
+
+    /**
+    * Gets the MemoryEditor used for reading memory.
+    * @return The MemoryEditor.
+    */
+    MemoryEditor const& getEditor() const;
+  };
+
+  /**
+  * Reads the memory of a running process with process_vm_readv. Unlike
+  * ProcessMemorySource, the process neither has to be debugged nor stopped,
+  * so any number of processes can be read at once, but reads race with the
+  * process' own writes. Memory of an exited process reads as unavailable.
+  */
+  class RemoteMemorySource
+    : public MemorySource
+  {
+  private:
+    Process m_process;
+
+  public:
+    /**
+    * Constructor.
+    * @param process The process.
+    */
+    explicit RemoteMemorySource(Process const& process);
+
+    /**
+    * Gets all memory regions of the process.
+    * @return The regions, ordered by address.
+    */
+    std::vector<MemoryRegion> getRegions() const;
+
+    /**
+    * Reads memory, treating unmapped memory as an empty read.
+    * @param address Address to read from.
+    * @param dest Pointer to buffer.
+    * @param amount Amount of bytes to read.
+    * @return Amount of read bytes.
+    */
+    std::size_t read(std::uintptr_t address, std::uint8_t* dest,
+      std::size_t amount);
+
+    /**
+    * Gets the path of the process' executable.
+    * @return The path or an empty string if it can't be read.
+    */
+    std::string getExecutable() const;
+
+    /**
+    * Gets the process.
+    * @return The process.
+    */
+    Process const& getProcess() const;
+  };
+
+  /**
+  * Base of sources backed by a file mapped into memory. Reads and direct
+  * access are served from the mapping without any system call.
+  */
+  class MappedMemorySource
+    : public MemorySource
+  {
+  protected:
+    struct Segment
+    {
+      MemoryRegion region;
+      std::uint64_t offset;   // Offset of the region's data in the file.
+      std::uint64_t size;     // Amount of available bytes.
+    };
+
+    std::uint8_t const* m_data;
+    std::size_t m_size;
+    std::vector<Segment> m_segments;
+
+    /**
+    * Constructor mapping a file.
+    * @param path Path of the file.
+    */
+    explicit MappedMemorySource(boost::filesystem::path const& path);
+
+    /**
+    * Adds a region whose data lies inside the file. Data missing from the
+    * end of the file is treated as not available.
+    * @param region The region.
+    * @param offset Offset of the region's data in the file.
+    * @param size Amount of available bytes, at most the region's size.
+    */
+    void addSegment(MemoryRegion const& region, std::uint64_t offset,
+      std::uint64_t size);
+
+    /**
+    * Orders the segments by address, must be called after adding them.
+    */
+    void sortSegments();
+
+  public:
+    /**
+    * Destructor unmapping the file.
+    */
+    ~MappedMemorySource();
+
+    /**
+    * Gets all captured memory regions.
+    * @return The regions, ordered by address.
+    */
+    std::vector<MemoryRegion> getRegions() const;
+
+    /**
+    * Copies captured memory, possibly spanning several regions.
+    * @param address Address to read from.
+    * @param dest Pointer to buffer.
+    * @param amount Amount of bytes to read.
+    * @return Amount of read bytes.
+    */
+    std::size_t read(std::uintptr_t address, std::uint8_t* dest,
+      std::size_t amount);
+
+    /**
+    * Gets direct access to captured memory.
+    * @param address The address.
+    * @param available Receives the amount of bytes accessible from the
+    * returned pointer, up to the end of the address' region.
+    * @return A pointer into the mapping, or NULL if the address was not
+    * captured.
+    */
+    std::uint8_t const* map(std::uintptr_t address, std::size_t& available);
+  };
+
+  /**
+  * Reads the memory captured in an ELF core file of the same architecture.
+  * Loadable segments become the regions, file-backed ones get their path
+  * and offset from the NT_FILE note. Segments the kernel did not dump, like
+  * unmodified file mappings, have no available bytes.
+  */
+  class CoreMemorySource
+    : public MappedMemorySource
+  {
+  public:
+    /**
+    * Constructor mapping and parsing a core file.
+    * @param path Path of the core file.
+    */
+    explicit CoreMemorySource(boost::filesystem::path const& path);
+  };
+
+  /**
+  * Reads memory captured into a snapshot file, which stores the regions
+  * uncompressed and page aligned so it can be mapped as it is.
+  */
+  class SnapshotMemorySource
+    : public MappedMemorySource
+  {
+  public:
+    /**
+    * Constructor mapping a snapshot file.
+    * @param path Path of the snapshot file.
+    */
+    explicit SnapshotMemorySource(boost::filesystem::path const& path);
+
+    /**
+    * Captures the memory of a process into a snapshot file. The file is
+    * only valid once the capture finished.
+    * @param editor MemoryEditor used for reading memory.
+    * @param path Path of the snapshot file, overwritten if it exists.
+    * @param filter The region filter, see RegionFilter.hpp. Only readable regions are captured.
+    * @return The amount of captured bytes.
+    */
+    static std::uint64_t save(MemoryEditor const& editor,
+      boost::filesystem::path const& path,
+      RegionFilter const& filter = "r***");
+
+    /**
+    * Writes the pages of a snapshot into a snapshot file, consecutive pages
+    * of one captured region forming one region with its permissions.
+    * @param snapshot The snapshot.
+    * @param path Path of the snapshot file, overwritten if it exists.
+    * @return The amount of captured bytes.
+    */
+    static std::uint64_t save(Snapshot const& snapshot,
+      boost::filesystem::path const& path);
+  };
+}
+
+#endif // __ETHON_MEMORYSOURCE_HPP__
@@ -0,0 +1,165 @@
+/*
+ModuleMap.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_MODULEMAP_HPP__
+#define __ETHON_MODULEMAP_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+
+// Boost Library:
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+
+namespace Ethon
+{
+  /**
+  * A region of a module.
+  */
+  struct ModuleSegment
+  {
+    std::uintptr_t start;
+    std::uintptr_t end;
+    std::array<char, 4> perms;
+    std::uint32_t offset;       // Offset inside the file.
+  };
+
+  /**
+  * An image mapped into a process, like the executable or a shared library.
+  */
+  struct Module
+  {
+    std::string const* path;    // Interned, valid as long as the ModuleMap.
+    boost::string_ref name;     // Basename, points into path.
+    std::uintptr_t base;        // Start of the first segment.
+    std::uintptr_t end;         // End of the last segment.
+    std::uint16_t devMajor;
+    std::uint16_t devMinor;
+    std::uint32_t inode;
+    std::vector<ModuleSegment> segments;
+  };
+
+  /**
+  * Groups the regions of a process into modules. Consecutive regions with
+  * the same inode and path form a module, as do the regions of the [vdso].
+  * Modules can be looked up by full path or basename in constant time and
+  * by address with a binary search. The map is a snapshot, call refresh()
+  * after the process loaded or unloaded libraries. Not thread-safe.
+  */
+  class ModuleMap
+    : boost::noncopyable
+  {
+  private:
+    struct NameHash
+    {
+      std::size_t operator()(boost::string_ref value) const;
+    };
+
+    typedef std::unordered_map<boost::string_ref, std::size_t, NameHash>
+      NameIndex;
+
+    Process m_process;
+    std::unordered_set<std::string> m_paths;
+    std::vector<Module> m_modules;
+    std::vector<std::uintptr_t> m_bases;
+    NameIndex m_byPath;
+    NameIndex m_byName;
+    mutable std::size_t m_last;
+
+  public:
+    /**
+    * Constructor reading the modules of a process.
+    * @param process The process.
+    */
+    explicit ModuleMap(Process const& process);
+
+    /**
+    * Reads the modules again. Modules found before become invalid, their
+    * paths stay valid.
+    */
+    void refresh();
+
+    /**
+    * Gets the process.
+    * @return The process.
+    */
+    Process const& getProcess() const;
+
+    /**
+    * Gets all modules.
+    * @return The modules, ordered by address.
+    */
+    std::vector<Module> const& getModules() const;
+
+    /**
+    * Finds a module by its full path.
+    * @param path The path.
+    * @return The module mapped lowest if the file is mapped several times,
+    * NULL if there is none.
+    */
+    Module const* findByPath(boost::string_ref path) const;
+
+    /**
+    * Finds a module by its basename, like "libc.so.6".
+    * @param name The basename.
+    * @return The module mapped lowest if several match, NULL if there is
+    * none.
+    */
+    Module const* findByName(boost::string_ref name) const;
+
+    /**
+    * Finds a module by its full path if the argument contains a slash or by
+    * its basename otherwise.
+    * @param module Path or basename.
+    * @return The module or NULL.
+    */
+    Module const* find(boost::string_ref module) const;
+
+    /**
+    * Finds the module an address belongs to.
+    * @param address The address.
+    * @return The module or NULL if the address lies outside of all modules,
+    * including the gaps between a module's segments.
+    */
+    Module const* find(std::uintptr_t address) const;
+
+    /**
+    * Converts a module relative address to an absolute one.
+    * @param module Path or basename of the module.
+    * @param offset Offset from the module's base.
+    * @return The absolute address.
+    */
+    std::uintptr_t resolve(boost::string_ref module,
+      std::uintptr_t offset) const;
+  };
+}
+
+#endif // __ETHON_MODULEMAP_HPP__
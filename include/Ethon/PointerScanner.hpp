@@ -0,0 +1,244 @@
+/*
+PointerScanner.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_POINTERSCANNER_HPP__
+#define __ETHON_POINTERSCANNER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/ScanContext.hpp>
+
+namespace Ethon
+{
+  /**
+  * A path of pointers leading from a static module to an address. The
+  * address is resolved by starting at the module's base plus baseOffset,
+  * and for every offset dereferencing the current address and adding the
+  * offset.
+  */
+  struct PointerPath
+  {
+    std::string module;                 // Path of the module.
+    std::uintptr_t baseOffset;          // Offset relative to the module base.
+    std::vector<std::ptrdiff_t> offsets;// Offsets added after dereferencing.
+  };
+
+  /**
+  * Options for building reverse pointer maps and searching pointer paths.
+  */
+  struct PointerScanOptions
+  {
+    PointerScanOptions();
+
+    std::size_t maxDepth;         // Maximum number of dereferences.
+    std::size_t maxOffset;        // Maximum offset added after dereferencing.
+    std::size_t maxResults;       // Stop searching after this many paths.
+    std::size_t maxNodes;         // Stop searching after visiting this many
+                                  // pointers.
+    std::size_t threads;          // Number of threads, 0 for one per core.
+    std::size_t memoryLimit;      // Bytes of entries kept in memory before
+                                  // they spill to disk.
+    boost::filesystem::path spillDirectory; // Where spilled runs go, empty
+                                            // for the temporary directory.
+  };
+
+  /**
+  * A compact array of all pointers of a process, sorted by the address they
+  * point to. Large maps are merged on disk and memory mapped.
+  */
+  class PointerMap
+    : boost::noncopyable
+  {
+  public:
+    struct Entry
+    {
+      std::uint64_t value;    // The address pointed to.
+      std::uint64_t address;  // The address of the pointer.
+    };
+
+  private:
+    std::vector<Entry> m_entries;
+    Entry const* m_begin;
+    Entry const* m_end;
+    void* m_mapping;
+    std::size_t m_mappingSize;
+
+    /**
+    * Unmaps and clears the current entries.
+    */
+    void reset();
+
+  public:
+    /**
+    * Constructor creating an empty map.
+    */
+    PointerMap();
+
+    /**
+    * Destructor unmapping the entries.
+    */
+    ~PointerMap();
+
+    /**
+    * Builds the map from every aligned, pointer sized value inside the
+    * writeable memory of a process which points into a mapped region.
+    * @param editor MemoryEditor used for reading memory.
+    * @param options Options specifying threads and memory usage.
+    * @param context Context checked for cancellation and receiving the
+    * progress once per chunk, see ScanContext.hpp.
+    * @return The number of entries.
+    */
+    std::size_t build(MemoryEditor const& editor,
+      PointerScanOptions const& options = PointerScanOptions(),
+      ScanContext const& context = ScanContext());
+
+    /**
+    * Gets all entries pointing into a range.
+    * @param low The lowest address pointed to.
+    * @param high The highest address pointed to.
+    * @return A pair of pointers delimiting the entries.
+    */
+    std::pair<Entry const*, Entry const*> findRange(std::uint64_t low,
+      std::uint64_t high) const;
+
+    /**
+    * Gets the number of entries.
+    * @return The number of entries.
+    */
+    std::size_t getSize() const;
+
+    /**
+    * Gets the first entry.
+    * @return Pointer to the first entry.
+    */
+    Entry const* begin() const;
+
+    /**
+    * Gets the end of the entries.
+    * @return Pointer past the last entry.
+    */
+    Entry const* end() const;
+  };
+
+  /**
+  * Finds static pointer paths leading to dynamic addresses.
+  */
+  class PointerScanner
+    : boost::noncopyable
+  {
+  private:
+    struct Module
+    {
+      std::string path;
+      std::uintptr_t base;
+    };
+
+    struct StaticRange
+    {
+      std::uintptr_t start;
+      std::uintptr_t end;
+      std::size_t module;
+    };
+
+    MemoryEditor m_editor;
+    PointerScanOptions m_options;
+    ScanContext m_context;
+    PointerMap m_map;
+    std::vector<Module> m_modules;
+    std::vector<StaticRange> m_static;
+
+    /**
+    * Finds the static range containing an address.
+    * @param address The address.
+    * @return The range or NULL.
+    */
+    StaticRange const* findStatic(std::uintptr_t address) const;
+
+  public:
+    /**
+    * Constructor initializing the scanner.
+    * @param editor MemoryEditor the scanner may use for reading memory.
+    * @param options Options for building the map and searching.
+    */
+    PointerScanner(MemoryEditor const& editor,
+      PointerScanOptions const& options = PointerScanOptions());
+
+    /**
+    * Sets the context building the map reports its progress to and which
+    * it and searching paths check for cancellation, see ScanContext.hpp. Aborted scans throw a
+    * ScanAbortedError.
+    * @param context The context.
+    */
+    void setContext(ScanContext const& context);
+
+    /**
+    * Gets the context scans run in.
+    * @return The context.
+    */
+    ScanContext const& getContext() const;
+
+    /**
+    * Builds the reverse pointer map and identifies static regions, which
+    * are all writeable regions mapped from a file. Call again whenever the
+    * process' memory changed significantly.
+    * @return The number of pointers found.
+    */
+    std::size_t buildMap();
+
+    /**
+    * Searches backwards from an address for paths starting in a static
+    * region, using the map built before. The search proceeds level by
+    * level, expanding every address once per level, and stops early after
+    * maxResults paths or maxNodes visited pointers.
+    * @param target The address to find paths to.
+    * @return The paths found, shortest first.
+    */
+    std::vector<PointerPath> findPaths(std::uintptr_t target) const;
+
+    /**
+    * Follows a pointer path.
+    * @param path The path.
+    * @return The address the path currently leads to, 0 if the module is
+    * not loaded or a pointer is not readable.
+    */
+    std::uintptr_t resolve(PointerPath const& path);
+
+    /**
+    * Gets the reverse pointer map.
+    * @return The map.
+    */
+    PointerMap const& getMap() const;
+  };
+}
+
+#endif // __ETHON_POINTERSCANNER_HPP__
@@ -0,0 +1,166 @@
+/*
+RegionFilter.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_REGIONFILTER_HPP__
+#define __ETHON_REGIONFILTER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <limits>
+
+// Ethon:
+#include <Ethon/MemoryRegions.hpp>
+
+namespace Ethon
+{
+  /**
+  * A predicate selecting memory regions by permissions, path, size, inode
+  * and whether they are backed by a file. The criteria are compiled into
+  * bit masks and flags when the filter is built, so permission and size
+  * checks take a few instructions per region; path patterns are only
+  * matched for regions passing all other criteria. Every API taking a
+  * permission string accepts a filter, strings convert implicitly.
+  */
+  class RegionFilter
+  {
+  private:
+    enum Criteria
+    {
+      kFilter_Path        = 1 << 0,
+      kFilter_Inode       = 1 << 1,
+      kFilter_Anonymous   = 1 << 2,
+      kFilter_FileBacked  = 1 << 3
+    };
+
+    std::uint8_t m_permMask;    // kPerm_* bits which are compared.
+    std::uint8_t m_permValue;   // Required values of those bits.
+    std::uint8_t m_criteria;    // Active kFilter_* criteria.
+    std::size_t m_minSize;
+    std::size_t m_maxSize;
+    std::uint32_t m_inode;
+    std::string m_pattern;
+
+    /**
+    * Checks the criteria besides permissions and size.
+    * @param region The region.
+    * @return True if all criteria match, false otherwise.
+    */
+    bool matchesCriteria(MemoryRegion const& region) const;
+
+  public:
+    /**
+    * Constructor creating a filter which accepts all regions.
+    */
+    RegionFilter();
+
+    /**
+    * Constructor creating a filter from a permission string.
+    * @param perms A string consisting of 4 chars, [rwxs], where a '-' means
+    * that the operation must NOT be allowed and '*' means that it is
+    * ignored. For instance, "r-*-" accepts all readable, non-writeable,
+    * private regions.
+    */
+    RegionFilter(std::string const& perms);
+
+    /**
+    * Constructor creating a filter from a permission string.
+    * @param perms The permissions, see RegionFilter(std::string const&).
+    */
+    RegionFilter(char const* perms);
+
+    /**
+    * Sets the permissions from a string.
+    * @param perms The permissions, see RegionFilter(std::string const&).
+    * @return *this
+    */
+    RegionFilter& setPermissions(std::string const& perms);
+
+    /**
+    * Sets the permissions from bits.
+    * @param mask MemoryRegion::kPerm_* bits which are compared.
+    * @param value Required values of those bits.
+    * @return *this
+    */
+    RegionFilter& setPermissions(std::uint8_t mask, std::uint8_t value);
+
+    /**
+    * Only accepts regions whose path matches a pattern.
+    * @param pattern A shell wildcard pattern, see fnmatch(3), or an empty
+    * string to accept all paths.
+    * @return *this
+    */
+    RegionFilter& setPath(std::string const& pattern);
+
+    /**
+    * Only accepts regions of a size inside a range.
+    * @param minSize Minimum size.
+    * @param maxSize Maximum size.
+    * @return *this
+    */
+    RegionFilter& setSize(std::size_t minSize,
+      std::size_t maxSize = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Only accepts regions mapping a file with an inode.
+    * @param inode The inode.
+    * @return *this
+    */
+    RegionFilter& setInode(std::uint32_t inode);
+
+    /**
+    * Only accepts anonymous or file-backed regions.
+    * @param anonymous True to accept only regions without inode, false to
+    * accept only regions with one.
+    * @return *this
+    */
+    RegionFilter& setAnonymous(bool anonymous);
+
+    /**
+    * Checks if a region is accepted.
+    * @param region The region.
+    * @return True if accepted, false otherwise.
+    */
+    bool operator()(MemoryRegion const& region) const
+    {
+      std::size_t const size = region.getSize();
+      if((region.getPermissionMask() & m_permMask) != m_permValue ||
+        size < m_minSize || size > m_maxSize)
+      {
+        return false;
+      }
+
+      return !m_criteria || matchesCriteria(region);
+    }
+
+    /**
+    * Selects the accepted regions.
+    * @param regions The regions.
+    * @return The accepted regions, in their previous order.
+    */
+    std::vector<MemoryRegion> select(
+      std::vector<MemoryRegion> const& regions) const;
+  };
+}
+
+#endif // __ETHON_REGIONFILTER_HPP__
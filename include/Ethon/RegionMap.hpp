@@ -0,0 +1,136 @@
+/*
+RegionMap.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_REGIONMAP_HPP__
+#define __ETHON_REGIONMAP_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <chrono>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+
+namespace Ethon
+{
+  /**
+  * A snapshot of a process' memory regions for fast address lookups.
+  * The start and end addresses are kept in contiguous sorted arrays, so a
+  * lookup is a binary search instead of parsing /proc/[pid]/maps. The
+  * snapshot is refreshed explicitly or, if a maximum age is set, by the
+  * first lookup after it expired. Not thread-safe.
+  */
+  class RegionMap
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+  private:
+    Process m_process;
+    Clock::duration m_maxAge;
+    mutable Clock::time_point m_timestamp;
+    mutable std::vector<MemoryRegion> m_regions;
+    mutable std::vector<std::uintptr_t> m_starts;
+    mutable std::vector<std::uintptr_t> m_ends;
+
+    /**
+    * Refreshes the snapshot if it is older than the maximum age.
+    */
+    void update() const;
+
+    /**
+    * Reads the regions of the process.
+    */
+    void load() const;
+
+  public:
+    /**
+    * Constructor taking a snapshot of a process' regions.
+    * @param process The process.
+    * @param maxAge Age from which on lookups refresh the snapshot, zero to
+    * refresh only explicitly.
+    */
+    explicit RegionMap(Process const& process,
+      Clock::duration maxAge = Clock::duration::zero());
+
+    /**
+    * Takes a new snapshot.
+    */
+    void refresh();
+
+    /**
+    * Sets the age from which on lookups refresh the snapshot.
+    * @param maxAge The age, zero to refresh only explicitly.
+    */
+    void setMaxAge(Clock::duration maxAge);
+
+    /**
+    * Gets the age from which on lookups refresh the snapshot.
+    * @return The age, zero if it is only refreshed explicitly.
+    */
+    Clock::duration getMaxAge() const;
+
+    /**
+    * Gets the time the snapshot was taken.
+    * @return The time.
+    */
+    Clock::time_point getTimestamp() const;
+
+    /**
+    * Gets the process.
+    * @return The process.
+    */
+    Process const& getProcess() const;
+
+    /**
+    * Gets the regions of the snapshot.
+    * @return The regions, ordered by address.
+    */
+    std::vector<MemoryRegion> const& getRegions() const;
+
+    /**
+    * Finds the region containing an address.
+    * @param address The address.
+    * @return Pointer to the region, valid until the next refresh, or NULL
+    * if the address is not mapped.
+    */
+    MemoryRegion const* find(std::uintptr_t address) const;
+
+    /**
+    * Determines if it is possible to read from an address.
+    * @param address Address to check.
+    * @return True if readable, false otherwise.
+    */
+    bool isReadable(std::uintptr_t address) const;
+
+    /**
+    * Determines if it is possible to write to an address.
+    * @param address Address to check.
+    * @return True if writeable, false otherwise.
+    */
+    bool isWriteable(std::uintptr_t address) const;
+  };
+}
+
+#endif // __ETHON_REGIONMAP_HPP__
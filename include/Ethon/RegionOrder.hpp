@@ -0,0 +1,232 @@
+/*
+RegionOrder.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_REGIONORDER_HPP__
+#define __ETHON_REGIONORDER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/MemoryRegions.hpp>
+
+namespace Ethon
+{
+  /**
+  * Kinds of memory regions, as far as they can be told apart by their path.
+  */
+  enum class RegionKind
+  {
+    HEAP,       // [heap]
+    STACK,      // [stack]
+    ANONYMOUS,  // Anonymous mappings, including most allocator arenas.
+    FILE,       // File mappings.
+    SPECIAL,    // Other kernel provided regions, like [vdso].
+    COUNT
+  };
+
+  /**
+  * Classifies a region.
+  * @param region The region.
+  * @return The region's kind.
+  */
+  RegionKind classifyRegion(MemoryRegion const& region);
+
+  /**
+  * Learns in which regions of an executable's processes matches were found.
+  * Regions are identified independently of their addresses, by their kind,
+  * path, file offset, permissions and, for anonymous regions, their size
+  * class, so the history carries over to new processes. Older hits decay,
+  * so recent ones weigh more.
+  */
+  class RegionHistory
+    : boost::noncopyable
+  {
+  private:
+    typedef std::unordered_map<std::string, double> Weights;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Weights> m_executables;
+
+  public:
+    // Factor all weights of an executable decay by per hit.
+    static double const DECAY;
+
+    /**
+    * Computes the address independent key of a region.
+    * @param region The region.
+    * @return The key.
+    */
+    static std::string makeKey(MemoryRegion const& region);
+
+    /**
+    * Records a hit.
+    * @param executable Path of the process' executable.
+    * @param region The region the hit was found in.
+    */
+    void recordHit(std::string const& executable,
+      MemoryRegion const& region);
+
+    /**
+    * Gets the share of an executable's recent hits found in a region.
+    * @param executable Path of the process' executable.
+    * @param region The region.
+    * @return The share, between 0 and 1.
+    */
+    double getShare(std::string const& executable,
+      MemoryRegion const& region) const;
+
+    /**
+    * Writes the history to a file.
+    * @param path Path of the file, overwritten if it exists.
+    */
+    void save(boost::filesystem::path const& path) const;
+
+    /**
+    * Merges a history written by save() into this one.
+    * @param path Path of the file.
+    */
+    void load(boost::filesystem::path const& path);
+  };
+
+  /**
+  * Decides in which order first-match scans visit regions. Every region is
+  * scored by its kind, permissions, size, a user supplied priority and the
+  * share of previous hits found in it, highest scores first. Regions with
+  * equal scores keep their address order.
+  */
+  class RegionOrder
+  {
+  public:
+    /**
+    * Receives a region and returns a score added to its priority.
+    */
+    typedef std::function<double (MemoryRegion const&)> PriorityFunction;
+
+  private:
+    std::array<double, static_cast<std::size_t>(RegionKind::COUNT)>
+      m_kindWeights;
+    double m_writeableWeight;
+    double m_sizeWeight;
+    double m_historyWeight;
+    PriorityFunction m_priority;
+    std::shared_ptr<RegionHistory> m_history;
+
+  public:
+    /**
+    * Constructor creating the default policy: heap and small writeable
+    * anonymous regions first, file mappings and kernel provided regions
+    * last, adapting to previous hits through a new history.
+    */
+    RegionOrder();
+
+    /**
+    * Creates a policy keeping the address order.
+    * @return The policy.
+    */
+    static RegionOrder addressOrder();
+
+    /**
+    * Sets the score of a region kind.
+    * @param kind The kind.
+    * @param weight The score.
+    * @return *this
+    */
+    RegionOrder& setKindWeight(RegionKind kind, double weight);
+
+    /**
+    * Sets the score added to writeable regions.
+    * @param weight The score.
+    * @return *this
+    */
+    RegionOrder& setWriteableWeight(double weight);
+
+    /**
+    * Sets the score added per doubling of a region's size, negative values
+    * prefer small regions.
+    * @param weight The score.
+    * @return *this
+    */
+    RegionOrder& setSizeWeight(double weight);
+
+    /**
+    * Sets a user supplied priority.
+    * @param priority Functor scoring a region, may be empty.
+    * @return *this
+    */
+    RegionOrder& setPriority(PriorityFunction const& priority);
+
+    /**
+    * Sets the history hits are learned in. Histories may be shared by
+    * several policies.
+    * @param history The history, may be NULL.
+    * @param weight The score of a region holding all previous hits.
+    * @return *this
+    */
+    RegionOrder& setHistory(std::shared_ptr<RegionHistory> const& history,
+      double weight = 200.0);
+
+    /**
+    * Gets the history hits are learned in.
+    * @return The history, may be NULL.
+    */
+    std::shared_ptr<RegionHistory> const& getHistory() const;
+
+    /**
+    * Scores a region.
+    * @param region The region.
+    * @param executable Path of the process' executable, used to look up
+    * the history.
+    * @return The score, higher scores are visited first.
+    */
+    double getScore(MemoryRegion const& region,
+      std::string const& executable) const;
+
+    /**
+    * Orders regions by descending score.
+    * @param regions The regions.
+    * @param executable Path of the process' executable.
+    */
+    void order(std::vector<MemoryRegion>& regions,
+      std::string const& executable) const;
+
+    /**
+    * Records a hit in the history, if there is one.
+    * @param region The region the hit was found in.
+    * @param executable Path of the process' executable.
+    */
+    void recordHit(MemoryRegion const& region,
+      std::string const& executable) const;
+  };
+}
+
+#endif // __ETHON_REGIONORDER_HPP__
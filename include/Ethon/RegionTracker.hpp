@@ -0,0 +1,232 @@
+/*
+RegionTracker.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_REGIONTRACKER_HPP__
+#define __ETHON_REGIONTRACKER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <functional>
+#include <utility>
+
+// Boost Library:
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+
+namespace Ethon
+{
+  /**
+  * Kind of a change to a process' address space.
+  */
+  enum class RegionChangeType
+  {
+    MAPPED,       // Memory was mapped, possibly replacing older regions.
+    UNMAPPED,     // Memory was unmapped.
+    PROTECTED,    // The permissions of mapped memory changed.
+    RELOADED      // The range differs after rereading /proc/[pid]/maps.
+  };
+
+  /**
+  * A change to a range of a process' address space.
+  */
+  struct RegionChange
+  {
+    RegionChangeType type;
+    std::uintptr_t start;
+    std::uintptr_t end;
+  };
+
+  /**
+  * Keeps the memory regions of the debugged process up to date by tracing
+  * its system calls. mmap, munmap, mremap, brk and mprotect are applied to
+  * the region index from their arguments and return values; other calls
+  * that change the address space, like execve or shmat, and anything that
+  * can't be modelled cause a full reread of /proc/[pid]/maps.
+  * The tracker drives the Debugger, which must be attached to the process
+  * and have it stopped, and traces the attached thread only. Changes made
+  * by other threads are not seen, so while the process has more than one
+  * thread the tracker falls back to rereading /proc/[pid]/maps at every
+  * stop outside of a syscall, see isMultithreaded(). The index may then
+  * lag behind other threads until the next stop. Adjacent
+  * regions are merged like the kernel usually does, but region boundaries
+  * may still differ from /proc/[pid]/maps where the kernel didn't merge;
+  * the mapped ranges and their permissions are the same.
+  * Only x86 and x86-64 are supported.
+  */
+  class RegionTracker
+    : boost::noncopyable
+  {
+  public:
+    typedef std::function<void (RegionChange const&)> ChangeCallback;
+
+  private:
+    Process m_process;
+    std::map<std::uintptr_t, MemoryRegion> m_regions;
+    std::vector<std::pair<std::size_t, ChangeCallback>> m_listeners;
+    std::size_t m_nextListener;
+    bool m_inSyscall;
+    long m_syscall;
+    std::uintptr_t m_arguments[6];
+    std::uintptr_t m_brk;
+    int m_signal;
+    std::uint64_t m_reloads;
+    bool m_multithreaded;
+
+    /**
+    * Checks if the process has more than one thread.
+    * @return True if it has, false otherwise.
+    */
+    bool hasThreads() const;
+
+    /**
+    * Handles a syscall-stop.
+    */
+    void handleSyscall();
+
+    /**
+    * Applies the result of a finished syscall to the index.
+    * @param result The syscall's return value.
+    */
+    void apply(std::uintptr_t result);
+
+    /**
+    * Adds the region created by a successful mmap.
+    * @param address The address returned by mmap.
+    */
+    void map(std::uintptr_t address);
+
+    /**
+    * Notifies all listeners.
+    * @param type Kind of the change.
+    * @param start Start of the changed range.
+    * @param end End of the changed range.
+    */
+    void notify(RegionChangeType type, std::uintptr_t start,
+      std::uintptr_t end) const;
+
+    /**
+    * Splits the region containing an address at the address.
+    * @param address The address.
+    */
+    void split(std::uintptr_t address);
+
+    /**
+    * Merges the regions meeting at an address if they are compatible.
+    * @param address The address.
+    */
+    void merge(std::uintptr_t address);
+
+    /**
+    * Removes a range from the index.
+    * @param start Start of the range.
+    * @param end End of the range.
+    */
+    void remove(std::uintptr_t start, std::uintptr_t end);
+
+    /**
+    * Adds a region to the index, replacing what it overlaps.
+    * @param region The region.
+    */
+    void insert(MemoryRegion const& region);
+
+    /**
+    * Sets the permissions of a range.
+    * @param start Start of the range.
+    * @param end End of the range.
+    * @param protection PROT_* flags.
+    */
+    void protect(std::uintptr_t start, std::uintptr_t end, int protection);
+
+  public:
+    /**
+    * Constructor starting to track the debugged process.
+    * The Debugger must be attached and the process stopped. Syscalls are
+    * decoded on x86 and x86-64 only, elsewhere this throws an EthonError.
+    */
+    RegionTracker();
+
+    /**
+    * Continues the process until its next stop and processes the stop.
+    * Signals are passed on to the process.
+    * @return False if the process exited, true otherwise.
+    */
+    bool step();
+
+    /**
+    * Rereads /proc/[pid]/maps and notifies about all differing ranges.
+    */
+    void reload();
+
+    /**
+    * Adds a callback which is called for every change.
+    * @param callback The callback.
+    * @return An id for removeListener().
+    */
+    std::size_t addListener(ChangeCallback const& callback);
+
+    /**
+    * Removes a callback.
+    * @param id The id returned by addListener().
+    */
+    void removeListener(std::size_t id);
+
+    /**
+    * Gets the tracked process.
+    * @return The process.
+    */
+    Process const& getProcess() const;
+
+    /**
+    * Gets the current regions.
+    * @return The regions, ordered by address.
+    */
+    std::vector<MemoryRegion> getRegions() const;
+
+    /**
+    * Finds the region containing an address.
+    * @param address The address.
+    * @return Pointer to the region, valid until the next step or reload, or
+    * NULL if the address is not mapped.
+    */
+    MemoryRegion const* find(std::uintptr_t address) const;
+
+    /**
+    * Checks if the tracker rereads /proc/[pid]/maps at every stop because
+    * the process has more than one thread.
+    * @return True if it does, false if syscalls are traced.
+    */
+    bool isMultithreaded() const;
+
+    /**
+    * Gets how often /proc/[pid]/maps was read, including the first time.
+    * @return The number of reads.
+    */
+    std::uint64_t getReloadCount() const;
+  };
+}
+
+#endif // __ETHON_REGIONTRACKER_HPP__
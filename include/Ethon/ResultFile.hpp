@@ -0,0 +1,273 @@
+/*
+ResultFile.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_RESULTFILE_HPP__
+#define __ETHON_RESULTFILE_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <limits>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/AddressSet.hpp>
+
+namespace Ethon
+{
+  /**
+  * A region of a result file and the matches inside it.
+  */
+  struct ResultRegion
+  {
+    MemoryRegion region;
+    std::uint64_t first;  // Index of the first match.
+    std::uint64_t count;  // Amount of matches.
+  };
+
+  /**
+  * A result file written by a ResultWriter, memory mapped. Opening only
+  * checks the header, the columns are used in place, so reopening even
+  * huge results takes no time.
+  */
+  class ResultFile
+    : boost::noncopyable
+  {
+  private:
+    friend class ResultWriter;
+
+    // Layout of a result file: the header, the offset column at a page
+    // aligned offset, the value column, the block and region tables and the
+    // region paths.
+    struct FileHeader
+    {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t valueSize;
+      std::uint64_t count;          // Number of addresses.
+      std::uint64_t blockCount;
+      std::uint64_t regionCount;
+      std::uint64_t offsetsOffset;
+      std::uint64_t valuesOffset;
+      std::uint64_t blocksOffset;
+      std::uint64_t regionsOffset;
+      std::uint64_t stringsOffset;
+      std::uint64_t stringsSize;
+    };
+
+    struct BlockRecord
+    {
+      std::uint64_t base;           // First address.
+      std::uint64_t first;          // Index of the first address.
+    };
+
+    struct RegionRecord
+    {
+      std::uint64_t start;
+      std::uint64_t end;
+      std::uint64_t first;          // Index of the first match.
+      std::uint64_t count;
+      std::uint32_t fileOffset;
+      std::uint32_t inode;
+      std::uint16_t devMajor;
+      std::uint16_t devMinor;
+      char perms[4];
+      std::uint32_t pathOffset;
+      std::uint32_t pathLength;
+    };
+
+    std::uint8_t const* m_data;
+    std::size_t m_size;
+    std::size_t m_valueSize;
+    std::uint64_t m_count;
+    std::uint64_t m_blockCount;
+    std::uint64_t m_regionCount;
+    std::uint32_t const* m_offsets;
+    std::uint8_t const* m_values;
+    BlockRecord const* m_blocks;
+    RegionRecord const* m_regions;
+    char const* m_strings;
+    std::uint64_t m_stringsSize;
+
+    /**
+    * Finds the block containing a match.
+    * @param index Index of the match.
+    * @return The block.
+    */
+    BlockRecord const& getBlock(std::uint64_t index) const;
+
+  public:
+    // Returned by find() if an address is not contained.
+    static std::uint64_t const npos =
+      std::numeric_limits<std::uint64_t>::max();
+
+    /**
+    * Constructor opening a result file.
+    * @param path Path of the file.
+    */
+    explicit ResultFile(boost::filesystem::path const& path);
+
+    /**
+    * Destructor unmapping the file.
+    */
+    ~ResultFile();
+
+    /**
+    * Gets the amount of stored addresses.
+    * @return The amount.
+    */
+    std::uint64_t size() const;
+
+    /**
+    * Gets the size of the stored values.
+    * @return The size in bytes, 0 if there is no value column.
+    */
+    std::size_t getValueSize() const;
+
+    /**
+    * Gets a stored address.
+    * @param index Index of the address, less than size().
+    * @return The address.
+    */
+    std::uintptr_t getAddress(std::uint64_t index) const;
+
+    /**
+    * Gets the value stored with an address.
+    * @param index Index of the address, less than size().
+    * @return Pointer to getValueSize() bytes, NULL without value column.
+    */
+    std::uint8_t const* getValue(std::uint64_t index) const;
+
+    /**
+    * Finds an address.
+    * @param address The address.
+    * @return Its index or npos.
+    */
+    std::uint64_t find(std::uintptr_t address) const;
+
+    /**
+    * Gets the regions the results were found in.
+    * @return The regions.
+    */
+    std::vector<ResultRegion> getRegions() const;
+
+    /**
+    * Copies the addresses into an address set block by block.
+    * @return The set.
+    */
+    AddressSet toAddressSet() const;
+  };
+  /**
+  * Writes scan results into a result file, see ResultFile, while they are
+  * found. Addresses are encoded into blocks like those of an AddressSet:
+  * a table of block headers and a column of 32 bit offsets to the blocks'
+  * first addresses, streamed to the file. Values are collected in a
+  * temporary file and appended as a column of their own. The header is
+  * written last and the file is removed unless finish() is called.
+  */
+  class ResultWriter
+    : boost::noncopyable
+  {
+  private:
+    boost::filesystem::path m_path;
+    int m_file;
+    int m_values;                         // Temporary value column.
+    bool m_finished;
+    std::size_t m_valueSize;
+    std::vector<ResultFile::BlockRecord> m_blocks;
+    std::vector<ResultFile::RegionRecord> m_regions;
+    std::string m_strings;
+    std::vector<std::uint32_t> m_offsets; // Not yet written offsets.
+    std::vector<std::uint8_t> m_buffer;   // Not yet written values.
+    std::uint64_t m_count;
+    std::uintptr_t m_last;                // Last appended address.
+    std::uint64_t m_written;              // Amount of written offsets.
+    std::uint64_t m_valuesWritten;        // Amount of written value bytes.
+
+    /**
+    * Writes the buffered offsets and values.
+    */
+    void flush();
+
+  public:
+    /**
+    * Constructor creating a result file.
+    * @param path Path of the file, replaced if it exists.
+    * @param valueSize Size of the value stored with every address, 0 for
+    * none.
+    */
+    explicit ResultWriter(boost::filesystem::path const& path,
+      std::size_t valueSize = 0);
+
+    /**
+    * Destructor removing the file unless it was finished.
+    */
+    ~ResultWriter();
+
+    /**
+    * Starts a region, the following addresses are reported as its matches.
+    * @param region The region.
+    */
+    void beginRegion(MemoryRegion const& region);
+
+    /**
+    * Appends an address greater than all previous addresses.
+    * @param address The address.
+    * @param value Pointer to the value stored with it, ignored if the file
+    * has no value column.
+    */
+    void append(std::uintptr_t address, void const* value = 0);
+
+    /**
+    * Appends the blocks of an address set. Only possible without a value
+    * column.
+    * @param set The set, all of its addresses greater than all previous
+    * addresses.
+    */
+    void append(AddressSet const& set);
+
+    /**
+    * Gets the amount of appended addresses.
+    * @return The amount.
+    */
+    std::uint64_t size() const;
+
+    /**
+    * Gets the size of the stored values.
+    * @return The size in bytes, 0 if there is no value column.
+    */
+    std::size_t getValueSize() const;
+
+    /**
+    * Writes the tables and the header.
+    */
+    void finish();
+  };
+
+}
+
+#endif // __ETHON_RESULTFILE_HPP__
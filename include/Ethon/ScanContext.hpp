@@ -0,0 +1,202 @@
+/*
+ScanContext.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SCANCONTEXT_HPP__
+#define __ETHON_SCANCONTEXT_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Boost Library:
+#include <boost/noncopyable.hpp>
+
+namespace Ethon
+{
+  /**
+  * Cancels scans from any thread. Copies share their state, so a copy can
+  * be handed to a scan while the original stays with the caller.
+  */
+  class CancellationToken
+  {
+  private:
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+
+  public:
+    /**
+    * Constructor creating a token which is not cancelled.
+    */
+    CancellationToken();
+
+    /**
+    * Cancels all scans using this token or a copy of it.
+    */
+    void cancel() const;
+
+    /**
+    * Checks if the token was cancelled.
+    * @return True if cancelled, false otherwise.
+    */
+    bool isCancelled() const;
+  };
+
+  /**
+  * Controls a running scan: a cancellation token, an optional deadline and
+  * a progress callback. Scans check the context once per chunk and throw a
+  * ScanAbortedError when the token is cancelled or the deadline passed.
+  * Copies share their progress, so one context tracks one scan at a time.
+  */
+  class ScanContext
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+    * Receives the amount of scanned bytes and the total amount of bytes of
+    * the scanned regions. Parallel scans call it from their worker threads
+    * without holding a lock, so calls may overlap and the callback may
+    * query getScanned() and getTotal().
+    */
+    typedef std::function<void (std::uint64_t, std::uint64_t)>
+      ProgressCallback;
+
+  private:
+    struct Progress
+    {
+      std::mutex mutex;
+      std::uint64_t scanned;
+      std::uint64_t total;
+      std::size_t depth;      // Number of open scopes.
+    };
+
+    CancellationToken m_token;
+    bool m_hasDeadline;
+    Clock::time_point m_deadline;
+    ProgressCallback m_callback;
+    std::shared_ptr<Progress> m_progress;
+
+  public:
+    /**
+    * Tracks the progress of a scan for its lifetime. Only the outermost of
+    * nested scopes starts tracking, so scan entry points calling each other,
+    * or scans made of many smaller ones, count every byte once.
+    */
+    class Scope
+      : boost::noncopyable
+    {
+    private:
+      ScanContext const& m_context;
+
+    public:
+      /**
+      * Constructor opening the scope.
+      * @param context The context.
+      * @param total The total amount of bytes the scan will cover.
+      */
+      Scope(ScanContext const& context, std::uint64_t total);
+
+      /**
+      * Destructor closing the scope.
+      */
+      ~Scope();
+    };
+
+    /**
+    * Constructor creating a context without deadline and callback.
+    */
+    ScanContext();
+
+    /**
+    * Sets the cancellation token.
+    * @param token The token.
+    * @return *this
+    */
+    ScanContext& setToken(CancellationToken const& token);
+
+    /**
+    * Gets the cancellation token.
+    * @return The token.
+    */
+    CancellationToken const& getToken() const;
+
+    /**
+    * Sets the point in time after which scans are aborted.
+    * @param deadline The deadline.
+    * @return *this
+    */
+    ScanContext& setDeadline(Clock::time_point deadline);
+
+    /**
+    * Sets the deadline relative to now.
+    * @param timeout Time scans may take from now on.
+    * @return *this
+    */
+    ScanContext& setTimeout(Clock::duration timeout);
+
+    /**
+    * Checks if a deadline is set.
+    * @return True if a deadline is set, false otherwise.
+    */
+    bool hasDeadline() const;
+
+    /**
+    * Gets the deadline.
+    * @return The deadline, only meaningful if hasDeadline() returns true.
+    */
+    Clock::time_point getDeadline() const;
+
+    /**
+    * Sets the progress callback.
+    * @param callback The callback, may be empty.
+    * @return *this
+    */
+    ScanContext& setProgressCallback(ProgressCallback const& callback);
+
+    /**
+    * Throws a ScanAbortedError if the scan should not continue.
+    */
+    void check() const;
+
+    /**
+    * Adds scanned bytes and reports the progress.
+    * @param bytes The amount of bytes scanned since the last call.
+    */
+    void advance(std::uint64_t bytes) const;
+
+    /**
+    * Gets the amount of bytes scanned since the scan started.
+    * @return The amount of bytes.
+    */
+    std::uint64_t getScanned() const;
+
+    /**
+    * Gets the total amount of bytes of the scanned regions.
+    * @return The amount of bytes.
+    */
+    std::uint64_t getTotal() const;
+  };
+}
+
+#endif // __ETHON_SCANCONTEXT_HPP__
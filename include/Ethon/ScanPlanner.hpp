@@ -0,0 +1,182 @@
+/*
+ScanPlanner.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SCANPLANNER_HPP__
+#define __ETHON_SCANPLANNER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <limits>
+
+// Ethon:
+#include <Ethon/Signature.hpp>
+
+namespace Ethon
+{
+  /**
+  * The search kernels a signature can be matched with.
+  */
+  enum class SearchAlgorithm
+  {
+    MEMCHR,     // memchr for the rarest byte, then verify.
+    SIMD_PAIR,  // Test two anchor bytes for 16 positions at once.
+    HORSPOOL,   // Skip ahead by a bad character table.
+    BITAP       // Shift-and automaton, for signatures up to 64 bytes.
+  };
+
+  /**
+  * Byte frequencies of the memory a signature is searched in. Without
+  * samples, a prior modelled after code and data of typical processes is
+  * used, samples are blended into it.
+  */
+  class ByteStatistics
+  {
+  private:
+    std::array<std::uint64_t, 256> m_counts;
+    std::uint64_t m_total;
+
+  public:
+    /**
+    * Constructor creating statistics without samples.
+    */
+    ByteStatistics();
+
+    /**
+    * Samples bytes of a buffer.
+    * @param data The buffer.
+    * @param size The buffer's size.
+    * @param stride Distance between two sampled bytes.
+    */
+    void sample(std::uint8_t const* data, std::size_t size,
+      std::size_t stride = 61);
+
+    /**
+    * Gets the estimated probability of a byte.
+    * @param byte The byte.
+    * @return The probability, between 0 and 1.
+    */
+    double getFrequency(std::uint8_t byte) const;
+
+    /**
+    * Gets the amount of sampled bytes.
+    * @return The amount of sampled bytes.
+    */
+    std::uint64_t getSampleCount() const;
+  };
+
+  /**
+  * A signature bound to a search kernel and its precomputed tables.
+  * The signature has to outlive the plan.
+  */
+  class ScanPlan
+  {
+  private:
+    Signature const* m_signature;
+    SearchAlgorithm m_algorithm;
+    std::size_t m_anchor;
+    std::size_t m_second;
+    std::vector<std::size_t> m_shifts;    // HORSPOOL: shift per byte.
+    std::vector<std::uint64_t> m_masks;   // BITAP: positions per byte.
+
+    std::size_t searchMemchr(std::uint8_t const* data, std::size_t size,
+      std::size_t start) const;
+    std::size_t searchPair(std::uint8_t const* data, std::size_t size,
+      std::size_t start) const;
+    std::size_t searchHorspool(std::uint8_t const* data, std::size_t size,
+      std::size_t start) const;
+    std::size_t searchBitap(std::uint8_t const* data, std::size_t size,
+      std::size_t start) const;
+
+  public:
+    /**
+    * Constructor binding a signature to a kernel.
+    * @param signature The signature.
+    * @param algorithm The kernel, see isApplicable().
+    * @param statistics Byte frequencies used for picking anchor bytes.
+    */
+    ScanPlan(Signature const& signature, SearchAlgorithm algorithm,
+      ByteStatistics const& statistics = ByteStatistics());
+
+    /**
+    * Checks if a kernel can match a signature.
+    * @param signature The signature.
+    * @param algorithm The kernel.
+    * @return True if applicable.
+    */
+    static bool isApplicable(Signature const& signature,
+      SearchAlgorithm algorithm);
+
+    /**
+    * Estimates the cost of searching with a kernel, in roughly CPU cycles
+    * per searched byte.
+    * @param signature The signature.
+    * @param algorithm The kernel, which has to be applicable.
+    * @param statistics Byte frequencies of the searched memory.
+    * @return The estimated cost.
+    */
+    static double estimateCost(Signature const& signature,
+      SearchAlgorithm algorithm,
+      ByteStatistics const& statistics = ByteStatistics());
+
+    /**
+    * Gets the plan's kernel.
+    * @return The kernel.
+    */
+    SearchAlgorithm getAlgorithm() const;
+
+    /**
+    * Finds the first match inside a buffer.
+    * @param data The buffer.
+    * @param size The buffer's size.
+    * @param start Offset the search starts at.
+    * @return Offset of the match or Signature::npos.
+    */
+    std::size_t search(std::uint8_t const* data, std::size_t size,
+      std::size_t start = 0) const;
+
+    /**
+    * Appends the addresses of all matches inside a buffer.
+    * @param data The buffer.
+    * @param size The buffer's size.
+    * @param address Virtual address of the buffer.
+    * @param results Vector receiving the addresses, ordered ascending.
+    * @param limit Maximum amount of addresses to append.
+    */
+    void match(std::uint8_t const* data, std::size_t size,
+      std::uintptr_t address, std::vector<std::uintptr_t>& results,
+      std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+  };
+
+  /**
+  * Plans the search for a signature, picking the kernel with the lowest
+  * estimated cost.
+  * @param signature The signature, which has to outlive the plan.
+  * @param statistics Byte frequencies of the searched memory.
+  * @return The plan.
+  */
+  ScanPlan planSearch(Signature const& signature,
+    ByteStatistics const& statistics = ByteStatistics());
+}
+
+#endif // __ETHON_SCANPLANNER_HPP__
@@ -27,15 +27,82 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <vector>
 #include <string>
 #include <type_traits>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <memory>
 
 // Ethon:
 #include <Ethon/Memory.hpp>
 #include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+#include <Ethon/Error.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/StringQuery.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/RegionOrder.hpp>
+#include <Ethon/AddressSet.hpp>
 
 namespace Ethon
 {
   typedef std::vector<std::uint8_t> ByteContainer;
 
+  /**
+  * The primitive types value scans can interpret memory as.
+  */
+  enum class ValueType
+  {
+    INT8,
+    UINT8,
+    INT16,
+    UINT16,
+    INT32,
+    UINT32,
+    INT64,
+    UINT64,
+    FLOAT,
+    DOUBLE
+  };
+
+  /**
+  * Gets the size of a value type in bytes.
+  * @param type The value type.
+  * @return The size in bytes.
+  */
+  std::size_t getValueTypeSize(ValueType type);
+
+  /**
+  * Maps a C++ type to its ValueType, for example ValueTypeOf<float>::value
+  * is ValueType::FLOAT.
+  */
+  template<typename T>
+  struct ValueTypeOf;
+
+  template<> struct ValueTypeOf<std::int8_t>
+    : std::integral_constant<ValueType, ValueType::INT8> { };
+  template<> struct ValueTypeOf<std::uint8_t>
+    : std::integral_constant<ValueType, ValueType::UINT8> { };
+  template<> struct ValueTypeOf<std::int16_t>
+    : std::integral_constant<ValueType, ValueType::INT16> { };
+  template<> struct ValueTypeOf<std::uint16_t>
+    : std::integral_constant<ValueType, ValueType::UINT16> { };
+  template<> struct ValueTypeOf<std::int32_t>
+    : std::integral_constant<ValueType, ValueType::INT32> { };
+  template<> struct ValueTypeOf<std::uint32_t>
+    : std::integral_constant<ValueType, ValueType::UINT32> { };
+  template<> struct ValueTypeOf<std::int64_t>
+    : std::integral_constant<ValueType, ValueType::INT64> { };
+  template<> struct ValueTypeOf<std::uint64_t>
+    : std::integral_constant<ValueType, ValueType::UINT64> { };
+  template<> struct ValueTypeOf<float>
+    : std::integral_constant<ValueType, ValueType::FLOAT> { };
+  template<> struct ValueTypeOf<double>
+    : std::integral_constant<ValueType, ValueType::DOUBLE> { };
+
   /**
   * Converts a POD value into a byte-representation.
   * @param value Value to convert.
@@ -79,13 +146,425 @@ namespace Ethon
     return temp;
   }
 
+  /**
+  * Expression templates for scan predicates. An expression like
+  * value<std::int32_t>() > 100 && value<std::int32_t>() % 4 == 0 is a
+  * functor which Scanner::findAllIf() inlines into its scan loop. Besides
+  * the candidate's value, field<T>(offset) reads values at fixed offsets
+  * relative to the candidate, for example field<float>(+8) < 1.0f.
+  * Bring the operators into scope with 'using namespace Ethon::Predicates'.
+  */
+  namespace Predicates
+  {
+    /**
+    * Base of all expressions, used to detect them.
+    */
+    struct ExpressionBase
+    { };
+
+    template<typename T>
+    struct IsExpression
+      : std::is_base_of<ExpressionBase, T>
+    { };
+
+    /**
+    * Reads a value at a fixed offset relative to the candidate.
+    */
+    template<typename T>
+    class Field
+      : public ExpressionBase
+    {
+      static_assert(std::is_pod<T>::value,
+        "Predicates::Field Error : POD value required");
+
+    private:
+      std::ptrdiff_t m_offset;
+
+    public:
+      typedef T result_type;
+
+      explicit Field(std::ptrdiff_t offset)
+        : m_offset(offset)
+      { }
+
+      T operator()(std::uint8_t const* candidate) const
+      {
+        T temp;
+        std::memcpy(&temp, candidate + m_offset, sizeof(T));
+        return temp;
+      }
+
+      // The bytes relative to the candidate the expression reads.
+      std::ptrdiff_t getLow() const { return m_offset; }
+      std::ptrdiff_t getHigh() const { return m_offset + sizeof(T); }
+    };
+
+    /**
+    * A constant operand.
+    */
+    template<typename T>
+    class Constant
+      : public ExpressionBase
+    {
+    private:
+      T m_value;
+
+    public:
+      typedef T result_type;
+
+      explicit Constant(T value)
+        : m_value(value)
+      { }
+
+      T operator()(std::uint8_t const* /*candidate*/) const
+      {
+        return m_value;
+      }
+
+      std::ptrdiff_t getLow() const { return 0; }
+      std::ptrdiff_t getHigh() const { return 0; }
+    };
+
+    /**
+    * Applies a binary operation to two expressions.
+    */
+    template<typename L, typename R, typename OP>
+    class Binary
+      : public ExpressionBase
+    {
+    private:
+      L m_lhs;
+      R m_rhs;
+
+    public:
+      typedef decltype(OP::apply(std::declval<typename L::result_type>(),
+        std::declval<typename R::result_type>())) result_type;
+
+      Binary(L const& lhs, R const& rhs)
+        : m_lhs(lhs), m_rhs(rhs)
+      { }
+
+      result_type operator()(std::uint8_t const* candidate) const
+      {
+        return OP::apply(m_lhs(candidate), m_rhs(candidate));
+      }
+
+      std::ptrdiff_t getLow() const
+      { return std::min(m_lhs.getLow(), m_rhs.getLow()); }
+      std::ptrdiff_t getHigh() const
+      { return std::max(m_lhs.getHigh(), m_rhs.getHigh()); }
+    };
+
+    /**
+    * Short-circuiting logical and.
+    */
+    template<typename L, typename R>
+    class And
+      : public ExpressionBase
+    {
+    private:
+      L m_lhs;
+      R m_rhs;
+
+    public:
+      typedef bool result_type;
+
+      And(L const& lhs, R const& rhs)
+        : m_lhs(lhs), m_rhs(rhs)
+      { }
+
+      bool operator()(std::uint8_t const* candidate) const
+      {
+        return m_lhs(candidate) && m_rhs(candidate);
+      }
+
+      std::ptrdiff_t getLow() const
+      { return std::min(m_lhs.getLow(), m_rhs.getLow()); }
+      std::ptrdiff_t getHigh() const
+      { return std::max(m_lhs.getHigh(), m_rhs.getHigh()); }
+    };
+
+    /**
+    * Short-circuiting logical or.
+    */
+    template<typename L, typename R>
+    class Or
+      : public ExpressionBase
+    {
+    private:
+      L m_lhs;
+      R m_rhs;
+
+    public:
+      typedef bool result_type;
+
+      Or(L const& lhs, R const& rhs)
+        : m_lhs(lhs), m_rhs(rhs)
+      { }
+
+      bool operator()(std::uint8_t const* candidate) const
+      {
+        return m_lhs(candidate) || m_rhs(candidate);
+      }
+
+      std::ptrdiff_t getLow() const
+      { return std::min(m_lhs.getLow(), m_rhs.getLow()); }
+      std::ptrdiff_t getHigh() const
+      { return std::max(m_lhs.getHigh(), m_rhs.getHigh()); }
+    };
+
+    /**
+    * Logical negation.
+    */
+    template<typename E>
+    class Not
+      : public ExpressionBase
+    {
+    private:
+      E m_expression;
+
+    public:
+      typedef bool result_type;
+
+      explicit Not(E const& expression)
+        : m_expression(expression)
+      { }
+
+      bool operator()(std::uint8_t const* candidate) const
+      {
+        return !m_expression(candidate);
+      }
+
+      std::ptrdiff_t getLow() const { return m_expression.getLow(); }
+      std::ptrdiff_t getHigh() const { return m_expression.getHigh(); }
+    };
+
+    /**
+    * Wraps operands which are no expressions into constants.
+    */
+    template<typename T, bool = IsExpression<T>::value>
+    struct Wrap
+    {
+      typedef T type;
+      static T const& apply(T const& value) { return value; }
+    };
+
+    template<typename T>
+    struct Wrap<T, false>
+    {
+      typedef Constant<T> type;
+      static Constant<T> apply(T const& value) { return Constant<T>(value); }
+    };
+
+    // Enabled if at least one operand is an expression.
+    template<typename L, typename R, typename RESULT>
+    struct EnableIfExpression
+      : std::enable_if<IsExpression<L>::value || IsExpression<R>::value,
+        RESULT>
+    { };
+
+#define ETHON_PREDICATE_OPERATOR(NAME, OPERATOR) \
+    struct NAME \
+    { \
+      template<typename A, typename B> \
+      static auto apply(A a, B b) -> decltype(a OPERATOR b) \
+      { \
+        return a OPERATOR b; \
+      } \
+    }; \
+    \
+    template<typename L, typename R> \
+    typename EnableIfExpression<L, R, Binary<typename Wrap<L>::type, \
+      typename Wrap<R>::type, NAME>>::type \
+    operator OPERATOR(L const& lhs, R const& rhs) \
+    { \
+      return Binary<typename Wrap<L>::type, typename Wrap<R>::type, NAME>( \
+        Wrap<L>::apply(lhs), Wrap<R>::apply(rhs)); \
+    }
+
+    ETHON_PREDICATE_OPERATOR(Plus, +)
+    ETHON_PREDICATE_OPERATOR(Minus, -)
+    ETHON_PREDICATE_OPERATOR(Multiplies, *)
+    ETHON_PREDICATE_OPERATOR(Divides, /)
+    ETHON_PREDICATE_OPERATOR(Modulus, %)
+    ETHON_PREDICATE_OPERATOR(BitAnd, &)
+    ETHON_PREDICATE_OPERATOR(BitOr, |)
+    ETHON_PREDICATE_OPERATOR(BitXor, ^)
+    ETHON_PREDICATE_OPERATOR(ShiftLeft, <<)
+    ETHON_PREDICATE_OPERATOR(ShiftRight, >>)
+    ETHON_PREDICATE_OPERATOR(EqualTo, ==)
+    ETHON_PREDICATE_OPERATOR(NotEqualTo, !=)
+    ETHON_PREDICATE_OPERATOR(Less, <)
+    ETHON_PREDICATE_OPERATOR(LessEqual, <=)
+    ETHON_PREDICATE_OPERATOR(Greater, >)
+    ETHON_PREDICATE_OPERATOR(GreaterEqual, >=)
+
+#undef ETHON_PREDICATE_OPERATOR
+
+    template<typename L, typename R>
+    typename EnableIfExpression<L, R, And<typename Wrap<L>::type,
+      typename Wrap<R>::type>>::type
+    operator&&(L const& lhs, R const& rhs)
+    {
+      return And<typename Wrap<L>::type, typename Wrap<R>::type>(
+        Wrap<L>::apply(lhs), Wrap<R>::apply(rhs));
+    }
+
+    template<typename L, typename R>
+    typename EnableIfExpression<L, R, Or<typename Wrap<L>::type,
+      typename Wrap<R>::type>>::type
+    operator||(L const& lhs, R const& rhs)
+    {
+      return Or<typename Wrap<L>::type, typename Wrap<R>::type>(
+        Wrap<L>::apply(lhs), Wrap<R>::apply(rhs));
+    }
+
+    template<typename E>
+    typename std::enable_if<IsExpression<E>::value, Not<E>>::type
+    operator!(E const& expression)
+    {
+      return Not<E>(expression);
+    }
+
+    /**
+    * The candidate's value.
+    * @return An expression reading the candidate's value.
+    */
+    template<typename T>
+    Field<T> value()
+    {
+      return Field<T>(0);
+    }
+
+    /**
+    * A value at a fixed offset relative to the candidate.
+    * @param offset The offset in bytes, may be negative.
+    * @return An expression reading the value.
+    */
+    template<typename T>
+    Field<T> field(std::ptrdiff_t offset)
+    {
+      return Field<T>(offset);
+    }
+  }
+
+  class ValueQuery;
+  class StructQuery;
+  class ResultWriter;
+
+  /**
+  * The estimated amount of matches of a scan, see Scanner::estimate().
+  */
+  struct ScanEstimate
+  {
+    double matches;               // Estimated amount of matches.
+    double lower;                 // Bounds of the confidence interval.
+    double upper;
+    std::uint64_t sampledMatches; // Matches inside the sampled pages.
+    std::uint64_t sampledBytes;
+    std::uint64_t totalBytes;
+  };
+
   /**
   * Scans a process' memory for values.
   */
   class Scanner
   {
+  public:
+    /**
+    * Receives consecutive chunks of a region. Return false to stop walking.
+    * Parameters are the chunk's data, its size and its virtual address.
+    */
+    typedef std::function<bool (std::uint8_t const*, std::size_t,
+      std::uintptr_t)> ChunkVisitor;
+
+    // Amount of bytes read from the process at once.
+    static std::size_t const CHUNK_SIZE = 1024 * 1024;
+
+    // Size of the pages estimate() samples.
+    static std::size_t const SAMPLE_PAGE_SIZE = 4096;
+
+    // Regions from this size on sample byte frequencies for planning
+    // signature searches.
+    static std::size_t const SAMPLING_THRESHOLD = 64 * 1024;
+
   private:
-    MemoryEditor m_editor;
+    std::shared_ptr<MemorySource> m_source;
+    ScanContext m_context;
+    RegionOrder m_order;
+
+    /**
+    * Computes the amount of bytes a scan of regions covers.
+    * @param regions The regions.
+    * @return The size of all readable regions.
+    */
+    static std::uint64_t getScanSize(std::vector<MemoryRegion> const& regions);
+
+    /**
+    * Visits regions in the order of the region order policy until a search
+    * finds a match, which is recorded in the policy's history.
+    * @param regions The regions.
+    * @param search Functor searching a region, returning an address or 0.
+    * @return An address or 0 if no region contained a match.
+    */
+    template<typename F>
+    std::uintptr_t findFirst(std::vector<MemoryRegion> regions,
+      F const& search)
+    {
+      ScanContext::Scope scope(m_context, getScanSize(regions));
+
+      // Hits in a single region are learned under the same key as others.
+      std::string executable;
+      if(m_order.getHistory())
+        executable = m_source->getExecutable();
+      m_order.order(regions, executable);
+
+      for(std::size_t i = 0; i < regions.size(); ++i)
+      {
+        if(!regions[i].isReadable())
+          continue;
+
+        std::uintptr_t address = search(regions[i]);
+        if(address)
+        {
+          m_order.recordHit(regions[i], executable);
+          return address;
+        }
+      }
+
+      return 0;
+    }
+
+    /**
+    * Counts the matches starting in a sampled page. Parameters are the
+    * page's data including the overlap, its size, the amount of bytes
+    * matches may start in and its virtual address.
+    */
+    typedef std::function<std::size_t (std::uint8_t const*, std::size_t,
+      std::size_t, std::uintptr_t)> SampleCounter;
+
+    /**
+    * Estimates the amount of matches from a sample of pages, see
+    * estimate().
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param span Maximum size of a match.
+    * @param fraction Fraction of the pages to sample.
+    * @param confidence Confidence level of the interval.
+    * @param counter Functor counting the matches inside a page.
+    * @return The estimate.
+    */
+    ScanEstimate estimateMatches(RegionFilter const& filter, std::size_t span,
+      double fraction, double confidence, SampleCounter const& counter);
+
+    /**
+    * Reads a chunk of memory from the source.
+    * @param address Address to read from.
+    * @param dest Pointer to buffer.
+    * @param amount Amount of bytes to read.
+    * @return Amount of read bytes.
+    */
+    std::size_t readChunk(std::uintptr_t address, std::uint8_t* dest,
+      std::size_t amount);
 
   public:
     /**
@@ -94,6 +573,47 @@ namespace Ethon
     */
     Scanner(MemoryEditor const& editor);
 
+    /**
+    * Constructor initializing a scanner reading from a memory source, for
+    * example a core file or a snapshot file, see MemorySource.hpp.
+    * @param source The memory source.
+    */
+    explicit Scanner(std::shared_ptr<MemorySource> const& source);
+
+    /**
+    * Gets the memory source the scanner reads from.
+    * @return The memory source.
+    */
+    std::shared_ptr<MemorySource> const& getSource() const;
+
+    /**
+    * Sets the context all following scans report their progress to and
+    * check for cancellation, see ScanContext.hpp. Aborted scans throw a
+    * ScanAbortedError.
+    * @param context The context.
+    */
+    void setContext(ScanContext const& context);
+
+    /**
+    * Gets the context scans run in.
+    * @return The context.
+    */
+    ScanContext const& getContext() const;
+
+    /**
+    * Sets the order in which first-match scans, the find() family, visit
+    * regions, see RegionOrder.hpp. By default, regions are visited in
+    * address order. Scans returning all matches are not affected.
+    * @param order The region order policy.
+    */
+    void setRegionOrder(RegionOrder const& order);
+
+    /**
+    * Gets the order in which first-match scans visit regions.
+    * @return The region order policy.
+    */
+    RegionOrder const& getRegionOrder() const;
+
     /**
     * Finds a value inside a memory region.
     * @param value Value to find.
@@ -107,14 +627,15 @@ namespace Ethon
     /**
     * Finds a value inside memory matching a permission pattern.
     * @param value Value to find.
-    * @param perms A string consisting of 4 chars, [rwxs], where a '-' means
-    * that the operation should NOT be allowed and '*' means that you want to
-    * ignore that operation. For instance, "r-*-" searches all memory which is
-    * readable, non-writeable, executeable OR non-executeable and NOT shared.
+    * @param filter The region filter, see RegionFilter.hpp. A string of 4
+    * chars, [rwxs], converts implicitly; a '-' means that the operation
+    * should NOT be allowed and '*' means that you want to ignore that
+    * operation. For instance, "r-*-" searches all memory which is readable,
+    * non-writeable, executeable OR non-executeable and NOT shared.
     * @return An address or 0 if the value could not be found.
     */
     std::uintptr_t find(ByteContainer const& value,
-      std::string const& perms);
+      RegionFilter const& filter);
 
     /**
     * Finds a binary pattern inside a memory region.
@@ -135,14 +656,316 @@ namespace Ethon
     * "\xDE\xAD\xBE\xEF"
     * @param mask A mask to specify wildcards, where '*' is a wildcard and
     * everything else a match, for example "--*-" ignores the third byte.
-    * @param perms A string consisting of 4 chars, [rwxs], where a '-' means
-    * that the operation should NOT be allowed and '*' means that you want to
-    * ignore that operation. For instance, "r-*-" searches all memory which is
-    * readable, non-writeable, executeable OR non-executeable and NOT shared.
+    * @param filter The region filter, see RegionFilter.hpp.
     * @return An address or 0 if the value could not be found.
     */
     std::uintptr_t findPattern(std::string const& pattern,
-      std::string const& mask, std::string const& perms);
+      std::string const& mask, RegionFilter const& filter);
+
+    /**
+    * Finds all matches of a signature inside a memory region.
+    * @param signature The compiled signature, see Signature.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @param limit Maximum amount of addresses to return.
+    * @return The addresses the matches refer to, in the order of the
+    * matches. Unless the signature resolves a reference, that are the
+    * matches themselves.
+    */
+    std::vector<std::uintptr_t> findAll(Signature const& signature,
+      MemoryRegion const* region = 0,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds all matches of a signature inside memory matching a permission
+    * pattern.
+    * @param signature The compiled signature, see Signature.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param limit Maximum amount of addresses to return.
+    * @return The addresses the matches refer to, in the order of the
+    * matches.
+    */
+    std::vector<std::uintptr_t> findAll(Signature const& signature,
+      RegionFilter const& filter,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds a signature inside a memory region.
+    * @param signature The compiled signature, see Signature.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return The address the first match refers to or 0 if the signature
+    * could not be found.
+    */
+    std::uintptr_t findSignature(Signature const& signature,
+      MemoryRegion const* region = 0);
+
+    /**
+    * Finds a signature inside memory matching a permission pattern.
+    * @param signature The compiled signature, see Signature.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The address the first match refers to or 0 if the signature
+    * could not be found.
+    */
+    std::uintptr_t findSignature(Signature const& signature,
+      RegionFilter const& filter);
+
+    /**
+    * Finds an IDA-style signature inside a memory region, compiling it
+    * only on first use.
+    * @param signature The signature, for example "48 8B 05 ?? ?? ?? ??".
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return An address or 0 if the signature could not be found.
+    */
+    std::uintptr_t findSignature(std::string const& signature,
+      MemoryRegion const* region = 0);
+
+    /**
+    * Finds an IDA-style signature inside memory matching a permission
+    * pattern, compiling it only on first use.
+    * @param signature The signature, for example "48 8B 05 ?? ?? ?? ??".
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return An address or 0 if the signature could not be found.
+    */
+    std::uintptr_t findSignature(std::string const& signature,
+      RegionFilter const& filter);
+
+    /**
+    * Collects the regions a scan should cover.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return The regions.
+    */
+    std::vector<MemoryRegion> selectRegions(MemoryRegion const* region = 0)
+      const;
+
+    /**
+    * Collects the regions matching a permission pattern.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The regions.
+    */
+    std::vector<MemoryRegion> selectRegions(RegionFilter const& filter) const;
+
+    /**
+    * Reads a region in chunks of at most CHUNK_SIZE bytes plus overlap.
+    * Consecutive chunks start CHUNK_SIZE bytes apart, so with an overlap of
+    * the searched value's size minus one, every value starts in exactly one
+    * chunk in which it is complete. Unreadable parts end the walk. Chunks
+    * of sources providing direct access are not copied.
+    * @param region The region to walk.
+    * @param overlap Amount of bytes each chunk extends into the next one.
+    * @param visitor Functor receiving the chunks.
+    * @return False if the visitor stopped the walk, true otherwise.
+    */
+    bool walkRegion(MemoryRegion const& region, std::size_t overlap,
+      ChunkVisitor const& visitor);
+
+    /**
+    * Finds all values matching a query inside a memory region.
+    * @param query The query, see ValueQuery.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @param limit Maximum amount of addresses to return.
+    * @return The matching addresses, ordered ascending.
+    */
+    std::vector<std::uintptr_t> findAll(ValueQuery const& query,
+      MemoryRegion const* region = 0,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds all values matching a query inside memory matching a permission
+    * pattern.
+    * @param query The query, see ValueQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param limit Maximum amount of addresses to return.
+    * @return The matching addresses, ordered ascending.
+    */
+    std::vector<std::uintptr_t> findAll(ValueQuery const& query,
+      RegionFilter const& filter,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds all values matching a query inside memory matching a permission
+    * pattern and collects them compactly, for result counts too large for
+    * a vector.
+    * @param query The query, see ValueQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The matching addresses, see AddressSet.hpp.
+    */
+    AddressSet findAllSet(ValueQuery const& query, RegionFilter const& filter);
+
+    /**
+    * Finds all values matching a query inside memory matching a permission
+    * pattern and streams them into a result file, see ResultFile.hpp.
+    * Every searched region is recorded. The finished file is left to the
+    * caller.
+    * @param query The query, see ValueQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param writer The writer, storing either no values or values of the
+    * query's size.
+    * @return The amount of found addresses.
+    */
+    std::uint64_t findAll(ValueQuery const& query, RegionFilter const& filter,
+      ResultWriter& writer);
+
+    /**
+    * Estimates how many values a query matches inside memory matching a
+    * permission pattern without scanning all of it. Every region is a
+    * stratum sampled in proportion to its size, but at least one page, so
+    * the cost is about fraction times that of findAll(). The interval
+    * assumes normally distributed stratum means; if no sampled page
+    * matches, its upper bound is the Poisson bound of a zero count.
+    * Sampling is deterministic for the same regions.
+    * @param query The query, see ValueQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param fraction Fraction of the pages to sample, in (0, 1].
+    * @param confidence Confidence level of the interval, in (0, 1).
+    * @return The estimate.
+    */
+    ScanEstimate estimate(ValueQuery const& query, RegionFilter const& filter,
+      double fraction = 0.01, double confidence = 0.95);
+
+    /**
+    * Estimates how often a signature occurs, see estimate(ValueQuery).
+    * @param signature The signature.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param fraction Fraction of the pages to sample, in (0, 1].
+    * @param confidence Confidence level of the interval, in (0, 1).
+    * @return The estimate.
+    */
+    ScanEstimate estimate(Signature const& signature,
+      RegionFilter const& filter, double fraction = 0.01,
+      double confidence = 0.95);
+
+    /**
+    * Estimates how many structures match a struct shape, see
+    * estimate(ValueQuery).
+    * @param query The query, see StructQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param fraction Fraction of the pages to sample, in (0, 1].
+    * @param confidence Confidence level of the interval, in (0, 1).
+    * @return The estimate.
+    */
+    ScanEstimate estimate(StructQuery const& query, RegionFilter const& filter,
+      double fraction = 0.01, double confidence = 0.95);
+
+    /**
+    * Finds a value matching a query inside a memory region.
+    * @param query The query, see ValueQuery.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return An address or 0 if no value matched.
+    */
+    std::uintptr_t find(ValueQuery const& query,
+      MemoryRegion const* region = 0);
+
+    /**
+    * Finds a value matching a query inside memory matching a permission
+    * pattern.
+    * @param query The query, see ValueQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return An address or 0 if no value matched.
+    */
+    std::uintptr_t find(ValueQuery const& query, RegionFilter const& filter);
+
+    /**
+    * Finds all occurrences of a string in all of its encodings inside a
+    * memory region, reading every region once.
+    * @param query The query, see StringQuery.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @param limit Maximum amount of matches to return.
+    * @return The matches, ordered by address.
+    */
+    std::vector<StringMatch> findAll(StringQuery const& query,
+      MemoryRegion const* region = 0,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds all occurrences of a string in all of its encodings inside
+    * memory matching a permission pattern.
+    * @param query The query, see StringQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param limit Maximum amount of matches to return.
+    * @return The matches, ordered by address.
+    */
+    std::vector<StringMatch> findAll(StringQuery const& query,
+      RegionFilter const& filter,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds a string in any of its encodings inside a memory region.
+    * @param query The query, see StringQuery.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return An address or 0 if the string could not be found.
+    */
+    std::uintptr_t find(StringQuery const& query,
+      MemoryRegion const* region = 0);
+
+    /**
+    * Finds a string in any of its encodings inside memory matching a
+    * permission pattern.
+    * @param query The query, see StringQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return An address or 0 if the string could not be found.
+    */
+    std::uintptr_t find(StringQuery const& query, RegionFilter const& filter);
+
+    /**
+    * Finds all structures matching a struct shape inside a memory region.
+    * Only the shape's prefilter field is scanned, the remaining fields are
+    * verified on the same buffer.
+    * @param query The query, see StructQuery.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @param limit Maximum amount of base addresses to return.
+    * @return The base addresses, ordered ascending.
+    */
+    std::vector<std::uintptr_t> findAll(StructQuery const& query,
+      MemoryRegion const* region = 0,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds all structures matching a struct shape inside memory matching a
+    * permission pattern.
+    * @param query The query, see StructQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param limit Maximum amount of base addresses to return.
+    * @return The base addresses, ordered ascending.
+    */
+    std::vector<std::uintptr_t> findAll(StructQuery const& query,
+      RegionFilter const& filter,
+      std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+    /**
+    * Finds all structures matching a struct shape inside memory matching a
+    * permission pattern and collects them compactly.
+    * @param query The query, see StructQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return The base addresses, see AddressSet.hpp.
+    */
+    AddressSet findAllSet(StructQuery const& query, RegionFilter const& filter);
+
+    /**
+    * Finds a structure matching a struct shape inside a memory region.
+    * @param query The query, see StructQuery.hpp.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return A base address or 0 if no structure matched.
+    */
+    std::uintptr_t find(StructQuery const& query,
+      MemoryRegion const* region = 0);
+
+    /**
+    * Finds a structure matching a struct shape inside memory matching a
+    * permission pattern.
+    * @param query The query, see StructQuery.hpp.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return A base address or 0 if no structure matched.
+    */
+    std::uintptr_t find(StructQuery const& query, RegionFilter const& filter);
 
     /**
     * Finds a POD value inside a memory region.
@@ -161,17 +984,14 @@ namespace Ethon
     /**
     * Finds a POD value inside memory matching a permission pattern.
     * @param value Value to find.
-    * @param perms A string consisting of 3 chars, [rwx], where a '-' means
-    * that the operation should NOT be allowed and '*' means that you want to
-    * ignore that operation. For instance, "r-*" searches all memory which is
-    * readable, non-writeable, executeable OR non-executeable.
+    * @param filter The region filter, see RegionFilter.hpp.
     * @return An address or 0 if the value could not be found.
     */
     template<typename T>
-    std::uintptr_t find(T const& value, std::string const& perms,
+    std::uintptr_t find(T const& value, RegionFilter const& filter,
       typename std::enable_if<std::is_pod<T>::value,T>::type* /*dummy*/ = 0)
     {
-      return find(getBytes(value), perms);
+      return find(getBytes(value), filter);
     }
 
     /**
@@ -191,17 +1011,14 @@ namespace Ethon
     /**
     * Finds a string inside memory matching a permission pattern.
     * @param value String to find.
-    * @param perms A string consisting of 3 chars, [rwx], where a '-' means
-    * that the operation should NOT be allowed and '*' means that you want to
-    * ignore that operation. For instance, "r-*" searches all memory which is
-    * readable, non-writeable, executeable OR non-executeable.
+    * @param filter The region filter, see RegionFilter.hpp.
     * @return An address or 0 if the value could not be found.
     */
     template <typename T>
     std::uintptr_t find(std::basic_string<T> const& value,
-      std::string const& perms)
+      RegionFilter const& filter)
     {
-      return find(getBytes(value), perms);
+      return find(getBytes(value), filter);
     }
 
     /**
@@ -221,17 +1038,159 @@ namespace Ethon
     /**
     * Finds a vector of POD values inside memory matching a permission pattern.
     * @param value Vector to find.
-    * @param perms A string consisting of 3 chars, [rwx], where a '-' means
-    * that the operation should NOT be allowed and '*' means that you want to
-    * ignore that operation. For instance, "r-*" searches all memory which is
-    * readable, non-writeable, executeable OR non-executeable.
+    * @param filter The region filter, see RegionFilter.hpp.
     * @return An address or 0 if the value could not be found.
     */
     template <typename T>
     std::uintptr_t find(std::vector<T> const& value,
-      std::string const& perms)
+      RegionFilter const& filter)
     {
-      return find(getBytes(value), perms);
+      return find(getBytes(value), filter);
+    }
+
+    /**
+    * Finds all candidates satisfying a predicate inside a memory region.
+    * The predicate is inlined into the scan loop, see Predicates. All bytes
+    * a predicate reads have to lie inside the candidate's region.
+    * @param predicate The predicate.
+    * @param alignment Candidates are multiples of alignment, plus offset.
+    * @param offset Offset of the candidates from the alignment.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @param limit Maximum amount of addresses to return.
+    * @return The matching addresses, ordered ascending.
+    */
+    template<typename P>
+    std::vector<std::uintptr_t> findAllIf(P const& predicate,
+      std::size_t alignment, std::size_t offset = 0,
+      MemoryRegion const* region = 0,
+      std::size_t limit = std::numeric_limits<std::size_t>::max())
+    {
+      static_assert(Predicates::IsExpression<P>::value,
+        "Scanner::findAllIf() Error : Predicate expression required");
+
+      std::vector<MemoryRegion> regions = selectRegions(region);
+      return findAllIf(predicate, alignment, offset, regions, limit);
+    }
+
+    /**
+    * Finds all candidates satisfying a predicate inside memory matching a
+    * permission pattern.
+    * @param predicate The predicate.
+    * @param alignment Candidates are multiples of alignment, plus offset.
+    * @param offset Offset of the candidates from the alignment.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @param limit Maximum amount of addresses to return.
+    * @return The matching addresses, ordered ascending.
+    */
+    template<typename P>
+    std::vector<std::uintptr_t> findAllIf(P const& predicate,
+      std::size_t alignment, std::size_t offset, RegionFilter const& filter,
+      std::size_t limit = std::numeric_limits<std::size_t>::max())
+    {
+      static_assert(Predicates::IsExpression<P>::value,
+        "Scanner::findAllIf() Error : Predicate expression required");
+
+      std::vector<MemoryRegion> regions = selectRegions(filter);
+      return findAllIf(predicate, alignment, offset, regions, limit);
+    }
+
+    /**
+    * Finds a candidate satisfying a predicate inside a memory region.
+    * @param predicate The predicate.
+    * @param alignment Candidates are multiples of alignment.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return An address or 0 if no candidate matched.
+    */
+    template<typename P>
+    std::uintptr_t findIf(P const& predicate, std::size_t alignment,
+      MemoryRegion const* region = 0)
+    {
+      return findFirst(selectRegions(region),
+        [&](MemoryRegion const& cur) -> std::uintptr_t
+        {
+          std::vector<std::uintptr_t> results = findAllIf(predicate,
+            alignment, 0, &cur, 1);
+          return results.empty() ? 0 : results.front();
+        });
+    }
+
+    /**
+    * Finds a candidate satisfying a predicate inside memory matching a
+    * permission pattern.
+    * @param predicate The predicate.
+    * @param alignment Candidates are multiples of alignment.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return An address or 0 if no candidate matched.
+    */
+    template<typename P>
+    std::uintptr_t findIf(P const& predicate, std::size_t alignment,
+      RegionFilter const& filter)
+    {
+      return findFirst(selectRegions(filter),
+        [&](MemoryRegion const& cur) -> std::uintptr_t
+        {
+          std::vector<std::uintptr_t> results = findAllIf(predicate,
+            alignment, 0, &cur, 1);
+          return results.empty() ? 0 : results.front();
+        });
+    }
+
+  private:
+    template<typename P>
+    std::vector<std::uintptr_t> findAllIf(P const& predicate,
+      std::size_t alignment, std::size_t offset,
+      std::vector<MemoryRegion> const& regions, std::size_t limit)
+    {
+      if(!alignment || offset >= alignment)
+      {
+        BOOST_THROW_EXCEPTION(ArgumentError() <<
+          ErrorString("Invalid alignment or offset"));
+      }
+
+      ScanContext::Scope scope(m_context, getScanSize(regions));
+
+      // The bytes relative to a candidate the predicate reads.
+      std::ptrdiff_t const low = std::min<std::ptrdiff_t>(0,
+        predicate.getLow());
+      std::ptrdiff_t const high = std::max<std::ptrdiff_t>(1,
+        predicate.getHigh());
+
+      std::vector<std::uintptr_t> results;
+      for(std::size_t i = 0; i < regions.size() && results.size() < limit;
+        ++i)
+      {
+        if(!regions[i].isReadable())
+          continue;
+
+        // A candidate belongs to the chunk its lowest read byte lies in.
+        walkRegion(regions[i], high - low - 1, [&](std::uint8_t const* data,
+          std::size_t size, std::uintptr_t address) -> bool
+        {
+          std::uintptr_t const first = address - low;
+          std::uintptr_t const last = std::min<std::uintptr_t>(
+            address + size - high, first + CHUNK_SIZE - 1);
+          if(size < static_cast<std::size_t>(high - low) || last < first)
+            return true;
+
+          std::uintptr_t cur = first + (offset + alignment -
+            first % alignment) % alignment;
+          for(; cur <= last; cur += alignment)
+          {
+            if(predicate(data + (cur - address)))
+            {
+              results.push_back(cur);
+              if(results.size() >= limit)
+                return false;
+            }
+          }
+
+          return true;
+        });
+      }
+
+      return results;
     }
   };
 }
@@ -0,0 +1,270 @@
+/*
+Signature.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SIGNATURE_HPP__
+#define __ETHON_SIGNATURE_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <memory>
+#include <limits>
+
+namespace Ethon
+{
+  class ByteStatistics;
+  class ScanPlan;
+
+  /**
+  * How the address a signature refers to is derived from a match.
+  */
+  enum class SignatureReference
+  {
+    NONE,     // The match itself.
+    RELATIVE, // A RIP-relative disp32, relative to the instruction's end.
+    BRANCH    // The target of a call, jmp or jcc instruction.
+  };
+
+  /**
+  * A compiled byte signature with wildcards, written like
+  * "48 8B 05 ?? ?? ?? ?? 48 85 C0". Compiling precomputes the masked
+  * comparison blocks and picks the two most selective fixed bytes, which are
+  * tested for 16 positions at once before a candidate is verified. The
+  * Scanner plans a possibly faster kernel per region, see ScanPlanner.hpp.
+  */
+  class Signature
+  {
+  public:
+    // Returned by search() if no match exists.
+    static std::size_t const npos = std::numeric_limits<std::size_t>::max();
+
+  private:
+    std::vector<std::uint8_t> m_bytes;  // Pattern, wildcards zeroed.
+    std::vector<std::uint8_t> m_mask;   // 0xFF for fixed bytes, else 0x00.
+    std::size_t m_size;                 // Unpadded pattern size.
+    std::size_t m_anchor;               // Index of the most selective byte.
+    std::size_t m_second;               // Index of the second anchor.
+    bool m_wildcardOnly;
+
+    SignatureReference m_reference;
+    std::size_t m_referenceOffset;
+    std::size_t m_instructionEnd;
+
+    // Default kernel used by search() and match(), bound to this signature.
+    std::shared_ptr<ScanPlan const> m_plan;
+
+    void prepare();
+
+  public:
+    /**
+    * Constructor compiling an IDA-style signature.
+    * @param signature Hex bytes separated by whitespace, '?' or '??' being a
+    * wildcard.
+    */
+    explicit Signature(std::string const& signature);
+
+    /**
+    * Constructor compiling a raw pattern and mask, see
+    * Scanner::findPattern().
+    * @param pattern A byte pattern, wrapped in a string.
+    * @param mask A mask of equal size, where '*' is a wildcard.
+    */
+    Signature(std::string const& pattern, std::string const& mask);
+
+    /**
+    * Copy constructor, binding a new default kernel to the copy.
+    * @param other The signature to copy.
+    */
+    Signature(Signature const& other);
+
+    /**
+    * Copy assignment operator, see the copy constructor.
+    * @param other The signature to copy.
+    * @return Reference to this.
+    */
+    Signature& operator=(Signature const& other);
+
+    /**
+    * Returns a compiled signature from a process-wide cache, compiling it on
+    * first use. The cache keeps the 256 most recently used signatures.
+    * @param signature An IDA-style signature.
+    * @return The compiled signature.
+    */
+    static std::shared_ptr<Signature const> compile(
+      std::string const& signature);
+
+    /**
+    * Returns a compiled pattern and mask from a process-wide cache.
+    * @param pattern A byte pattern, wrapped in a string.
+    * @param mask A mask of equal size, where '*' is a wildcard.
+    * @return The compiled signature.
+    */
+    static std::shared_ptr<Signature const> compile(
+      std::string const& pattern, std::string const& mask);
+
+    /**
+    * Makes matches refer to a RIP-relative operand.
+    * @param offset Offset of the disp32 inside the match.
+    * @param instructionEnd Offset of the end of the instruction the
+    * displacement belongs to, which is what it is relative to.
+    * @return Reference to this.
+    */
+    Signature& setRelative(std::size_t offset, std::size_t instructionEnd);
+
+    /**
+    * Makes matches refer to the target of a branch instruction. Supported
+    * are call rel32, jmp rel32, jmp rel8, jcc rel8 and jcc rel32.
+    * @param offset Offset of the instruction's opcode inside the match.
+    * @return Reference to this.
+    */
+    Signature& setBranch(std::size_t offset);
+
+    /**
+    * Makes matches refer to themselves again.
+    * @return Reference to this.
+    */
+    Signature& clearReference();
+
+    /**
+    * Gets the signature's size.
+    * @return The size in bytes.
+    */
+    std::size_t getSize() const;
+
+    /**
+    * Gets the amount of bytes from the start of a match which are needed to
+    * resolve the reference.
+    * @return The size in bytes, at least getSize().
+    */
+    std::size_t getSpan() const;
+
+    /**
+    * Gets the kind of reference matches are resolved to.
+    * @return The reference kind.
+    */
+    SignatureReference getReference() const;
+
+    /**
+    * Gets the offset of the reference inside a match.
+    * @return The offset passed to setRelative() or setBranch().
+    */
+    std::size_t getReferenceOffset() const;
+
+    /**
+    * Gets the offset of the end of a RIP-relative instruction.
+    * @return The offset passed to setRelative(), 0 for other references.
+    */
+    std::size_t getInstructionEnd() const;
+
+    /**
+    * Renders the signature in IDA style.
+    * @return The signature string.
+    */
+    std::string toString() const;
+
+    /**
+    * Gets the pattern, padded with wildcards to a multiple of 16 bytes.
+    * @return The pattern's bytes, wildcards being zero.
+    */
+    std::vector<std::uint8_t> const& getBytes() const;
+
+    /**
+    * Gets the mask, padded with wildcards to a multiple of 16 bytes.
+    * @return 0xFF for every fixed byte, 0x00 for every wildcard.
+    */
+    std::vector<std::uint8_t> const& getMask() const;
+
+    /**
+    * Checks if the signature consists of wildcards only.
+    * @return True if no byte is fixed.
+    */
+    bool isWildcardOnly() const;
+
+    /**
+    * Gets the index of the rarest fixed byte.
+    * @return The index.
+    */
+    std::size_t getAnchor() const;
+
+    /**
+    * Gets the index of the second anchor, which equals the anchor if there
+    * is only one fixed byte.
+    * @return The index.
+    */
+    std::size_t getSecondAnchor() const;
+
+    /**
+    * Picks the two most selective fixed bytes for byte frequencies.
+    * @param statistics The byte frequencies.
+    * @param anchor Receives the index of the rarest fixed byte.
+    * @param second Receives the index of the second anchor.
+    */
+    void selectAnchors(ByteStatistics const& statistics, std::size_t& anchor,
+      std::size_t& second) const;
+
+    /**
+    * Tests if the signature matches at a position.
+    * @param data Pointer to at least getSize() bytes.
+    * @param available Amount of bytes readable at data. If it covers the
+    * padded pattern, whole blocks are compared at once.
+    * @return True on a match.
+    */
+    bool matches(std::uint8_t const* data, std::size_t available = 0) const;
+
+    /**
+    * Finds the first match inside a buffer.
+    * @param data The buffer.
+    * @param size The buffer's size.
+    * @param start Offset the search starts at.
+    * @return Offset of the match or npos.
+    */
+    std::size_t search(std::uint8_t const* data, std::size_t size,
+      std::size_t start = 0) const;
+
+    /**
+    * Appends the addresses of all matches inside a buffer.
+    * @param data The buffer.
+    * @param size The buffer's size.
+    * @param address Virtual address of the buffer.
+    * @param results Vector receiving the addresses, ordered ascending.
+    * @param limit Maximum amount of addresses to append.
+    */
+    void match(std::uint8_t const* data, std::size_t size,
+      std::uintptr_t address, std::vector<std::uintptr_t>& results,
+      std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    /**
+    * Resolves the reference of a match.
+    * @param data Pointer to the match's bytes.
+    * @param available Amount of bytes available at data.
+    * @param address Virtual address of the match.
+    * @param target Receives the referred address.
+    * @return False if more than available bytes are needed or the bytes at
+    * a branch reference are no supported branch instruction.
+    */
+    bool resolve(std::uint8_t const* data, std::size_t available,
+      std::uintptr_t address, std::uintptr_t& target) const;
+  };
+}
+
+#endif // __ETHON_SIGNATURE_HPP__
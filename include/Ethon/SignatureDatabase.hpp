@@ -0,0 +1,134 @@
+/*
+SignatureDatabase.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SIGNATUREDATABASE_HPP__
+#define __ETHON_SIGNATUREDATABASE_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mutex>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Signature.hpp>
+
+namespace Ethon
+{
+  /**
+  * A module mapped into a process, identified independently of where it is
+  * mapped.
+  */
+  struct SignatureModule
+  {
+    std::string path;                 // Path of the mapped file.
+    std::uintptr_t base;              // Start of the lowest mapping.
+    std::vector<MemoryRegion> regions; // All mappings of the file.
+    std::string identity;             // "build-id:<hex>" if the module has
+                                      // a GNU build-id, otherwise
+                                      // "file:<dev>:<inode>:<size>:<mtime>".
+  };
+
+  /**
+  * A persistent cache of signature matches. Matches are stored as offsets
+  * relative to the module they were found in, keyed by the module's
+  * identity and the signature, inside a memory-mapped hash table file which
+  * may be shared by several processes. Cached matches are validated with a
+  * single read before they are used, stale or missing ones are searched
+  * again and stored. A full table is rebuilt behind the end of the file and
+  * published by rewriting the header, so a crash never loses the cache.
+  */
+  class SignatureDatabase
+    : boost::noncopyable
+  {
+  private:
+    int m_file;
+    void* m_map;
+    std::size_t m_mapSize;
+    std::mutex m_mutex;
+
+    void remap();
+    void grow();
+    bool lookup(std::uint64_t module, std::uint64_t signature,
+      std::uint64_t& offset);
+    void store(std::uint64_t module, std::uint64_t signature,
+      std::uint64_t offset);
+
+  public:
+    /**
+    * Constructor opening a database, creating it if it does not exist.
+    * @param path Path to the database file.
+    */
+    explicit SignatureDatabase(boost::filesystem::path const& path);
+
+    /**
+    * Destructor closing the database.
+    */
+    ~SignatureDatabase();
+
+    /**
+    * Collects a module's mappings and identifies it, reading its build-id
+    * from the process' memory. 32 and 64 bit ELF images are supported.
+    * @param editor MemoryEditor of the process.
+    * @param module The module's full path or its file name.
+    * @return The module.
+    */
+    static SignatureModule loadModule(MemoryEditor const& editor,
+      std::string const& module);
+
+    /**
+    * Finds a signature inside a module, using the cache if possible.
+    * @param editor MemoryEditor of the process.
+    * @param module The module, see loadModule().
+    * @param signature The signature.
+    * @return The address the first match refers to or 0 if the signature
+    * could not be found.
+    */
+    std::uintptr_t find(MemoryEditor const& editor,
+      SignatureModule const& module, Signature const& signature);
+
+    /**
+    * Finds a signature inside a module, using the cache if possible.
+    * @param editor MemoryEditor of the process.
+    * @param module The module's full path or its file name.
+    * @param signature The signature.
+    * @return The address the first match refers to or 0 if the signature
+    * could not be found.
+    */
+    std::uintptr_t find(MemoryEditor const& editor, std::string const& module,
+      Signature const& signature);
+
+    /**
+    * Gets the amount of cached matches.
+    * @return The amount of cached matches.
+    */
+    std::size_t getSize();
+  };
+}
+
+#endif // __ETHON_SIGNATUREDATABASE_HPP__
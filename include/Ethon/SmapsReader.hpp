@@ -0,0 +1,147 @@
+/*
+SmapsReader.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SMAPSREADER_HPP__
+#define __ETHON_SMAPSREADER_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Boost Library:
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+
+namespace Ethon
+{
+  /**
+  * Memory usage of a region or process from /proc/[pid]/smaps, in bytes.
+  */
+  struct RegionUsage
+  {
+    std::uint64_t rss;            // Resident memory.
+    std::uint64_t pss;            // Resident memory divided among sharers.
+    std::uint64_t sharedClean;
+    std::uint64_t sharedDirty;
+    std::uint64_t privateClean;
+    std::uint64_t privateDirty;
+    std::uint64_t referenced;
+    std::uint64_t anonymous;      // Memory not backed by a file, including
+                                  // copy-on-write pages of file mappings.
+    std::uint64_t anonHugePages;
+    std::uint64_t swap;
+    std::uint64_t swapPss;
+  };
+
+  /**
+  * Reads extended region information from /proc/[pid]/smaps.
+  * The kernel computes smaps for all regions at once, so the file is read
+  * in a single pass on the first query after construction or refresh(),
+  * but only the fields of the regions asked about are parsed. Use this to
+  * skip non-resident regions before scanning or, through
+  * RegionOrder::setPriority(), to visit regions by resident size.
+  * Not thread-safe.
+  */
+  class SmapsReader
+    : boost::noncopyable
+  {
+  private:
+    // Position of a region's fields in the buffer.
+    struct Entry
+    {
+      std::uintptr_t start;
+      std::size_t begin;
+      std::size_t end;
+    };
+
+    Process m_process;
+    mutable bool m_loaded;
+    mutable bool m_available;
+    mutable std::vector<char> m_buffer;
+    mutable std::size_t m_size;
+    mutable std::vector<Entry> m_entries;
+    mutable std::vector<RegionUsage> m_usages;
+    mutable std::vector<bool> m_parsed;
+
+    /**
+    * Reads and indexes the file if it wasn't yet.
+    * @return True if the file could be read, false otherwise.
+    */
+    bool load() const;
+
+  public:
+    /**
+    * Constructor, the file is read on the first query.
+    * @param process The process.
+    */
+    explicit SmapsReader(Process const& process);
+
+    /**
+    * Discards the read information, the next query reads the file again.
+    */
+    void refresh();
+
+    /**
+    * Gets the tracked process.
+    * @return The process.
+    */
+    Process const& getProcess() const;
+
+    /**
+    * Gets the usage of a region.
+    * @param start Start address of the region.
+    * @param usage Receives the usage.
+    * @return False if smaps couldn't be read or lists no region starting at
+    * the address, true otherwise.
+    */
+    bool getUsage(std::uintptr_t start, RegionUsage& usage) const;
+
+    /**
+    * Gets the usage of a region.
+    * @param region The region.
+    * @param usage Receives the usage.
+    * @return False if smaps couldn't be read or doesn't list the region,
+    * true otherwise.
+    */
+    bool getUsage(MemoryRegion const& region, RegionUsage& usage) const;
+
+    /**
+    * Checks if any page of a region is resident or swapped out.
+    * @param region The region.
+    * @return False if the region is known to hold no pages, true otherwise.
+    */
+    bool isPopulated(MemoryRegion const& region) const;
+
+    /**
+    * Gets the total usage of a process from /proc/[pid]/smaps_rollup, or by
+    * summing up /proc/[pid]/smaps on kernels older than 4.14.
+    * @param process The process.
+    * @return The usage.
+    */
+    static RegionUsage getRollup(Process const& process);
+  };
+}
+
+#endif // __ETHON_SMAPSREADER_HPP__
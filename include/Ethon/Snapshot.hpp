@@ -0,0 +1,359 @@
+/*
+Snapshot.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SNAPSHOT_HPP__
+#define __ETHON_SNAPSHOT_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+// Ethon:
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ScanContext.hpp>
+
+namespace Ethon
+{
+  /**
+  * Specifies where compressed snapshot pages are kept.
+  */
+  enum class SnapshotStorage
+  {
+    MEMORY, // In memory, pages exceeding the memory limit spill to disk.
+    DISK    // Always on disk.
+  };
+
+  /**
+  * Stores compressed, reference counted pages either in memory or in a file.
+  */
+  class PageStore
+    : boost::noncopyable
+  {
+  private:
+    struct Slot
+    {
+      std::uint64_t offset;   // Offset into the file, if stored on disk.
+      std::uint32_t size;     // Size of the stored data.
+      std::uint32_t refs;     // Number of pages referencing this slot.
+      bool          onDisk;   // True if the data is stored in the file.
+      bool          raw;      // True if the data is stored uncompressed.
+    };
+
+    std::vector<Slot>           m_slots;
+    std::vector<ByteContainer>  m_blobs;
+    std::vector<std::uint32_t>  m_free;
+    SnapshotStorage             m_storage;
+    std::size_t                 m_memoryLimit;
+    std::size_t                 m_memoryUsage;
+    boost::filesystem::path     m_path;
+    int                         m_file;
+    std::uint64_t               m_fileSize;
+
+    /**
+    * Appends data to the backing file, creating it if neccessary.
+    * @param data The data to write.
+    * @param size Size of the data.
+    * @return The offset the data was written to.
+    */
+    std::uint64_t append(void const* data, std::size_t size);
+
+  public:
+    /**
+    * Constructor initializing an empty store.
+    * @param storage Where to keep the pages.
+    * @param memoryLimit Maximum amount of compressed bytes kept in memory.
+    * @param path The backing file. If empty, an unlinked temporary file is
+    * created once it is needed.
+    */
+    PageStore(SnapshotStorage storage, std::size_t memoryLimit,
+      boost::filesystem::path const& path);
+
+    /**
+    * Destructor closing the backing file.
+    */
+    ~PageStore();
+
+    /**
+    * Compresses and stores a page.
+    * @param data Pointer to the page.
+    * @param size Size of the page.
+    * @return A slot identifying the stored page, referenced once.
+    */
+    std::uint32_t put(void const* data, std::size_t size);
+
+    /**
+    * Decompresses a stored page.
+    * @param slot The slot to load.
+    * @param dest Buffer receiving the page.
+    * @param size Size of the page.
+    */
+    void get(std::uint32_t slot, void* dest, std::size_t size) const;
+
+    /**
+    * Adds a reference to a slot.
+    * @param slot The slot.
+    */
+    void retain(std::uint32_t slot);
+
+    /**
+    * Removes a reference from a slot, freeing it when unreferenced.
+    * @param slot The slot.
+    * @return True if the slot was freed, false otherwise.
+    */
+    bool release(std::uint32_t slot);
+
+    /**
+    * Gets the amount of compressed bytes kept in memory.
+    * @return The amount of bytes.
+    */
+    std::size_t getMemoryUsage() const;
+
+    /**
+    * Gets the size of the backing file.
+    * @return The size in bytes.
+    */
+    std::uint64_t getDiskUsage() const;
+  };
+
+  /**
+  * A compressed, page-deduplicated copy of a process' writeable memory.
+  * Pages consisting of zeroes only are not stored at all and identical pages
+  * are stored once.
+  */
+  class Snapshot
+    : boost::noncopyable
+  {
+  public:
+    static std::size_t const PAGE_BYTES = 4096;
+    static std::uint32_t const ZERO_SLOT =
+      std::numeric_limits<std::uint32_t>::max();
+
+    struct Page
+    {
+      std::uintptr_t address; // Virtual address of the page.
+      std::uint64_t hash;     // Hash of the page's content.
+      std::uint32_t slot;     // Slot inside the page store.
+    };
+
+  private:
+    PageStore m_store;
+    std::vector<Page> m_pages;
+    std::vector<MemoryRegion> m_regions;
+    std::unordered_map<std::uint64_t, std::uint32_t> m_dedup;
+
+    /**
+    * Stores a page, reusing an identical stored page if possible.
+    * @param data Pointer to the page.
+    * @param hash Hash of the page.
+    * @return The slot of the stored page.
+    */
+    std::uint32_t store(std::uint8_t const* data, std::uint64_t hash);
+
+    /**
+    * Drops the reference a page holds on its slot.
+    * @param page The page.
+    */
+    void drop(Page const& page);
+
+  public:
+    /**
+    * Constructor creating an empty snapshot.
+    * @param storage Where to keep the compressed pages.
+    * @param memoryLimit Maximum amount of compressed bytes kept in memory.
+    * @param path The backing file. If empty, an unlinked temporary file is
+    * created once it is needed.
+    */
+    Snapshot(SnapshotStorage storage = SnapshotStorage::MEMORY,
+      std::size_t memoryLimit = 256 * 1024 * 1024,
+      boost::filesystem::path const& path = boost::filesystem::path());
+
+    /**
+    * Captures all readable, writeable and private memory of a process,
+    * replacing the current content.
+    * @param editor MemoryEditor used for reading memory.
+    * @param context Context checked for cancellation and receiving the
+    * progress once per chunk, see ScanContext.hpp.
+    * @return The number of captured pages.
+    */
+    std::size_t capture(MemoryEditor& editor,
+      ScanContext const& context = ScanContext());
+
+    /**
+    * Hashes a page.
+    * @param data Pointer to the page.
+    * @return The page's hash.
+    */
+    static std::uint64_t hashPage(std::uint8_t const* data);
+
+    /**
+    * Gets all captured pages ordered by address.
+    * @return The captured pages.
+    */
+    std::vector<Page> const& getPages() const;
+
+    /**
+    * Gets the regions the pages were captured from, ordered by address.
+    * @return The captured regions.
+    */
+    std::vector<MemoryRegion> const& getRegions() const;
+
+    /**
+    * Decompresses a captured page.
+    * @param index Index of the page.
+    * @param dest Buffer of at least PAGE_BYTES bytes receiving the page.
+    */
+    void loadPage(std::size_t index, std::uint8_t* dest) const;
+
+    /**
+    * Replaces the content of a captured page.
+    * @param index Index of the page.
+    * @param data The new content.
+    * @param hash Hash of the new content.
+    */
+    void updatePage(std::size_t index, std::uint8_t const* data,
+      std::uint64_t hash);
+
+    /**
+    * Drops a page from the snapshot, leaving its index valid.
+    * @param index Index of the page.
+    */
+    void discardPage(std::size_t index);
+
+    /**
+    * Gets the store holding the compressed pages.
+    * @return The page store.
+    */
+    PageStore const& getStore() const;
+  };
+
+  /**
+  * Comparisons of an unknown value scan's passes.
+  */
+  enum class ChangeCompare
+  {
+    CHANGED,
+    UNCHANGED,
+    INCREASED,
+    DECREASED
+  };
+
+  /**
+  * Finds values whose initial value is unknown by comparing consecutive
+  * snapshots of the writeable address space. Values crossing a page
+  * boundary are not considered.
+  */
+  class UnknownValueScan
+    : boost::noncopyable
+  {
+  private:
+    struct Candidates
+    {
+      std::uint32_t count;              // Number of remaining candidates.
+      std::vector<std::uint64_t> bits;  // Empty if all slots are candidates.
+    };
+
+    MemoryEditor m_editor;
+    ValueType m_type;
+    std::size_t m_alignment;
+    std::size_t m_slotsPerPage;
+    Snapshot m_snapshot;
+    std::vector<Candidates> m_candidates;
+    ScanContext m_context;
+
+  public:
+    /**
+    * Constructor initializing the scan.
+    * @param editor MemoryEditor the scan may use for reading memory.
+    * @param type Type of the searched value.
+    * @param alignment Alignment of the searched value. If zero, the type's
+    * size is used.
+    * @param storage Where to keep the snapshot.
+    * @param memoryLimit Maximum amount of compressed bytes kept in memory.
+    * @param path The snapshot's backing file. If empty, an unlinked
+    * temporary file is created once it is needed.
+    */
+    UnknownValueScan(MemoryEditor const& editor, ValueType type,
+      std::size_t alignment = 0,
+      SnapshotStorage storage = SnapshotStorage::MEMORY,
+      std::size_t memoryLimit = 256 * 1024 * 1024,
+      boost::filesystem::path const& path = boost::filesystem::path());
+
+    /**
+    * Sets the context passes report their progress to and check for
+    * cancellation, see ScanContext.hpp. Aborted passes throw a
+    * ScanAbortedError.
+    * @param context The context.
+    */
+    void setContext(ScanContext const& context);
+
+    /**
+    * Gets the context passes run in.
+    * @return The context.
+    */
+    ScanContext const& getContext() const;
+
+    /**
+    * Performs the first pass, taking a snapshot. All aligned addresses of
+    * the writeable address space are candidates afterwards.
+    * @return The number of candidates.
+    */
+    std::uint64_t start();
+
+    /**
+    * Performs a comparison pass, keeping all candidates whose value compares
+    * to the previous pass' value as specified. Pages whose hash did not
+    * change are handled without decompressing them.
+    * @param compare The comparison to perform.
+    * @return The number of remaining candidates.
+    */
+    std::uint64_t next(ChangeCompare compare);
+
+    /**
+    * Gets the number of remaining candidates.
+    * @return The number of candidates.
+    */
+    std::uint64_t getResultCount() const;
+
+    /**
+    * Gets the addresses of the remaining candidates.
+    * @param limit Maximum number of addresses to return.
+    * @return The addresses, ordered ascending.
+    */
+    std::vector<std::uintptr_t> getResults(std::size_t limit =
+      std::numeric_limits<std::size_t>::max()) const;
+
+    /**
+    * Gets the underlying snapshot.
+    * @return The snapshot.
+    */
+    Snapshot const& getSnapshot() const;
+  };
+}
+
+#endif // __ETHON_SNAPSHOT_HPP__
@@ -0,0 +1,136 @@
+/*
+StringExtractor.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_STRINGEXTRACTOR_HPP__
+#define __ETHON_STRINGEXTRACTOR_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+
+// Ethon:
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+#include <Ethon/StringQuery.hpp>
+#include <Ethon/ScanContext.hpp>
+
+namespace Ethon
+{
+  /**
+  * A run of printable characters found in memory.
+  */
+  struct ExtractedString
+  {
+    std::uintptr_t address;       // Address of the first character.
+    StringEncoding encoding;      // UTF8 for ASCII runs, or UTF16LE/BE.
+    std::string text;             // The characters, narrowed to ASCII.
+    MemoryRegion const* region;   // The region the run was found in.
+  };
+
+  /**
+  * Extracts runs of printable ASCII characters (0x20 to 0x7E and tab) and
+  * their UTF-16 counterparts from memory, like strings(1). Bytes are
+  * classified 64 at a time with SSE2 into bitmasks, runs are then found with
+  * bit scans, so printable-free memory costs a few instructions per block.
+  * Runs spanning chunks are joined.
+  */
+  class StringExtractor
+  {
+  public:
+    /**
+    * Receives extracted strings, calls are serialized. Return false to stop
+    * the extraction.
+    */
+    typedef std::function<bool (ExtractedString const&)> Callback;
+
+  private:
+    std::shared_ptr<MemorySource> m_source;
+    std::size_t m_minLength;
+    StringEncoding m_encodings;
+    std::size_t m_threads;
+    ScanContext m_context;
+
+    bool extract(std::vector<MemoryRegion> const& regions,
+      Callback const& callback);
+
+  public:
+    /**
+    * Constructor initializing the extractor.
+    * @param editor MemoryEditor used for reading memory.
+    * @param minLength Minimum amount of characters of a run.
+    * @param encodings Encodings to extract, UTF8 meaning ASCII.
+    * @param threads Number of regions extracted in parallel, 0 for one per
+    * core.
+    */
+    StringExtractor(MemoryEditor const& editor, std::size_t minLength = 4,
+      StringEncoding encodings = StringEncoding::UTF8 |
+        StringEncoding::UTF16LE,
+      std::size_t threads = 0);
+
+    /**
+    * Constructor initializing an extractor reading from a memory source,
+    * for example a core file or a snapshot file, see MemorySource.hpp.
+    * @param source The memory source.
+    * @param minLength Minimum amount of characters of a run.
+    * @param encodings Encodings to extract, UTF8 meaning ASCII.
+    * @param threads Number of regions extracted in parallel, 0 for one per
+    * core.
+    */
+    explicit StringExtractor(std::shared_ptr<MemorySource> const& source,
+      std::size_t minLength = 4, StringEncoding encodings =
+        StringEncoding::UTF8 | StringEncoding::UTF16LE,
+      std::size_t threads = 0);
+
+    /**
+    * Sets the context extractions report their progress to and check for
+    * cancellation, see ScanContext.hpp. Aborted extractions throw a
+    * ScanAbortedError.
+    * @param context The context.
+    */
+    void setContext(ScanContext const& context);
+
+    /**
+    * Extracts the strings of a memory region. Strings are reported as soon
+    * as their run ends, so regions extracted in parallel interleave.
+    * @param callback Functor receiving the strings.
+    * @param region The memory region which should be searched.
+    * If NULL, all regions will be searched.
+    * @return False if the callback stopped the extraction.
+    */
+    bool extract(Callback const& callback, MemoryRegion const* region = 0);
+
+    /**
+    * Extracts the strings of all memory matching a permission pattern.
+    * @param callback Functor receiving the strings.
+    * @param filter The region filter, see RegionFilter.hpp.
+    * @return False if the callback stopped the extraction.
+    */
+    bool extract(Callback const& callback, RegionFilter const& filter);
+  };
+}
+
+#endif // __ETHON_STRINGEXTRACTOR_HPP__
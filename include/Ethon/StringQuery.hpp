@@ -0,0 +1,137 @@
+/*
+StringQuery.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_STRINGQUERY_HPP__
+#define __ETHON_STRINGQUERY_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <limits>
+
+namespace Ethon
+{
+  /**
+  * Encodings a string can be searched in, combinable with operator|.
+  */
+  enum class StringEncoding
+  {
+    UTF8    = 1,
+    UTF16LE = 2,
+    UTF16BE = 4
+  };
+
+  inline StringEncoding operator|(StringEncoding lhs, StringEncoding rhs)
+  {
+    return static_cast<StringEncoding>(static_cast<int>(lhs) |
+      static_cast<int>(rhs));
+  }
+
+  inline bool hasEncoding(StringEncoding set, StringEncoding encoding)
+  {
+    return (static_cast<int>(set) & static_cast<int>(encoding)) != 0;
+  }
+
+  /**
+  * An occurrence of a string.
+  */
+  struct StringMatch
+  {
+    std::uintptr_t address;
+    StringEncoding encoding;  // Exactly one encoding.
+  };
+
+  /**
+  * A string searched in several encodings at once, optionally ignoring the
+  * case of ASCII letters. Every encoding is compiled into a pattern and an
+  * OR-mask, so a candidate matches if (byte | mask) == pattern for all of
+  * its bytes, which folds letters without branches.
+  */
+  class StringQuery
+  {
+  public:
+    struct Needle
+    {
+      StringEncoding encoding;
+      std::size_t size;                   // Unpadded size.
+      std::size_t first;                  // Indices of the two bytes
+      std::size_t last;                   // tested before verifying.
+      std::vector<std::uint8_t> pattern;  // Padded to a multiple of 16.
+      std::vector<std::uint8_t> fold;     // 0x20 for letters if ignoring
+                                          // case, padding is 0xFF.
+    };
+
+  private:
+    std::vector<Needle> m_needles;
+    std::size_t m_minSize;
+    std::size_t m_maxSize;
+
+  public:
+    /**
+    * Constructor compiling a query.
+    * @param text The string, encoded as UTF-8.
+    * @param encodings The encodings to search, for example
+    * StringEncoding::UTF8 | StringEncoding::UTF16LE.
+    * @param ignoreCase If true, ASCII letters match in either case.
+    */
+    StringQuery(std::string const& text,
+      StringEncoding encodings = StringEncoding::UTF8,
+      bool ignoreCase = false);
+
+    /**
+    * Gets the compiled encodings.
+    * @return The needles, one per encoding.
+    */
+    std::vector<Needle> const& getNeedles() const;
+
+    /**
+    * Gets the size of the shortest encoding.
+    * @return The size in bytes.
+    */
+    std::size_t getMinSize() const;
+
+    /**
+    * Gets the size of the longest encoding.
+    * @return The size in bytes.
+    */
+    std::size_t getMaxSize() const;
+
+    /**
+    * Finds all encodings in a single pass over a buffer.
+    * @param data The buffer.
+    * @param size Size of the buffer.
+    * @param count Amount of starting positions to test, matches may extend
+    * past them up to size.
+    * @param address The virtual address the buffer was read from.
+    * @param results Vector the matches are appended to, ordered by address.
+    * @param limit Maximum number of matches to append.
+    * @return The number of appended matches.
+    */
+    std::size_t match(std::uint8_t const* data, std::size_t size,
+      std::size_t count, std::uintptr_t address,
+      std::vector<StringMatch>& results,
+      std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+  };
+}
+
+#endif // __ETHON_STRINGQUERY_HPP__
@@ -0,0 +1,152 @@
+/*
+StructQuery.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_STRUCTQUERY_HPP__
+#define __ETHON_STRUCTQUERY_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+// Ethon:
+#include <Ethon/ValueQuery.hpp>
+
+namespace Ethon
+{
+  /**
+  * A field of a struct shape: a value query evaluated at a fixed offset
+  * from the structure's base address.
+  */
+  struct StructField
+  {
+    std::size_t offset;
+    ValueQuery query;
+  };
+
+  /**
+  * Describes the shape of a structure as a set of value queries at fixed
+  * offsets. A scan runs only the most selective field over memory and
+  * verifies the remaining fields on the same buffer, so all fields are
+  * matched in a single pass without joining intermediate results.
+  */
+  class StructQuery
+  {
+  private:
+    std::vector<StructField> m_fields;
+    std::vector<std::size_t> m_order;  // Fields by ascending selectivity.
+    std::size_t m_alignment;           // Requested base alignment or 0.
+    std::size_t m_span;                // Bytes covered by the fields.
+    std::size_t m_prefilter;           // Forced prefilter field or npos.
+
+    // Orders the fields, the first one is used as prefilter.
+    void plan();
+
+    // Gets the prefilter field's query, aligned relative to the base.
+    ValueQuery getPrefilterQuery() const;
+
+  public:
+    static std::size_t const npos = static_cast<std::size_t>(-1);
+
+    /**
+    * Constructor.
+    * @param alignment Alignment of the structure's base address. If 0, the
+    * size of the largest field is used.
+    */
+    explicit StructQuery(std::size_t alignment = 0);
+
+    /**
+    * Adds a field. The field's own alignment is ignored, its address is
+    * always the base address plus offset.
+    * @param offset Offset of the field from the base address.
+    * @param query The query the field has to match.
+    * @return *this
+    */
+    StructQuery& add(std::size_t offset, ValueQuery const& query);
+
+    /**
+    * Forces a field to be used as prefilter, overriding the estimate.
+    * @param index Index of the field in order of addition, or npos to use
+    * the estimate again.
+    * @return *this
+    */
+    StructQuery& setPrefilter(std::size_t index);
+
+    /**
+    * Gets the fields in order of addition.
+    * @return The fields.
+    */
+    std::vector<StructField> const& getFields() const;
+
+    /**
+    * Gets the field scanned for candidates.
+    * @return Index of the field in order of addition.
+    */
+    std::size_t getPrefilter() const;
+
+    /**
+    * Gets the alignment of base addresses.
+    * @return The alignment.
+    */
+    std::size_t getAlignment() const;
+
+    /**
+    * Gets the amount of bytes covered by the fields, counted from the base
+    * address.
+    * @return The size in bytes.
+    */
+    std::size_t getSpan() const;
+
+    /**
+    * Finds all structures whose base address lies within the first count
+    * bytes of a buffer and whose fields lie completely inside it.
+    * @param data The buffer.
+    * @param size Size of the buffer.
+    * @param count Amount of leading bytes structures may start in.
+    * @param address The virtual address the buffer was read from.
+    * @param results Vector the base addresses are appended to, in
+    * ascending order.
+    * @param limit Maximum number of addresses to append.
+    * @return The number of appended addresses.
+    */
+    std::size_t match(std::uint8_t const* data, std::size_t size,
+      std::size_t count, std::uintptr_t address,
+      std::vector<std::uintptr_t>& results,
+      std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    /**
+    * Tests all fields of a single structure.
+    * @param data Pointer to the structure's base, at least getSpan() bytes.
+    * @return True if all fields match, false otherwise.
+    */
+    bool test(std::uint8_t const* data) const;
+  };
+
+  /**
+  * Estimates the fraction of candidates a value query matches in typical
+  * memory. Used to select the prefilter field of a struct query.
+  * @param query The query.
+  * @return The estimated fraction, between 0 and 1.
+  */
+  double estimateSelectivity(ValueQuery const& query);
+}
+
+#endif // __ETHON_STRUCTQUERY_HPP__
@@ -0,0 +1,256 @@
+/*
+SymbolResolver.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_SYMBOLRESOLVER_HPP__
+#define __ETHON_SYMBOLRESOLVER_HPP__
+
+// POSIX:
+#include <elf.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+
+// Boost Library:
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/ModuleMap.hpp>
+
+namespace Ethon
+{
+  /**
+  * A symbol of an ELF file.
+  */
+  struct ElfSymbol
+  {
+    boost::string_ref name;     // Points into the mapped file.
+    std::uint64_t value;        // Virtual address as linked.
+    std::uint64_t size;
+  };
+
+  /**
+  * The symbols of an ELF64 file, which is mapped into memory and read in
+  * place. Names are looked up with the GNU hash table of .dynsym, .symtab
+  * and files without GNU hash use a hash table built on first use. Address
+  * lookups use a sorted table of all function and object symbols, also
+  * built on first use. Not thread-safe.
+  */
+  class ElfSymbols
+    : boost::noncopyable
+  {
+  private:
+    struct NameHash
+    {
+      std::size_t operator()(boost::string_ref value) const;
+    };
+
+    // A symbol table and its string table.
+    struct Table
+    {
+      Elf64_Sym const* symbols;
+      std::size_t count;
+      char const* strings;
+      std::size_t stringSize;
+    };
+
+    void* m_map;
+    std::size_t m_size;
+    std::uint64_t m_loadAddress;
+    Table m_dynsym;
+    Table m_symtab;
+    std::uint32_t const* m_gnuHash;
+    std::size_t m_gnuHashSize;
+    mutable bool m_indexed;
+    mutable std::unordered_map<boost::string_ref, ElfSymbol, NameHash>
+      m_names;
+    mutable std::vector<ElfSymbol> m_sorted;
+
+    /**
+    * Gets a symbol's name.
+    * @param table The symbol's table.
+    * @param symbol The symbol.
+    * @return The name, empty if it is invalid.
+    */
+    static boost::string_ref getName(Table const& table,
+      Elf64_Sym const& symbol);
+
+    /**
+    * Looks up a name in the GNU hash table.
+    * @param name The name.
+    * @param result Receives the symbol.
+    * @return True if a defined symbol was found, false otherwise.
+    */
+    bool lookupGnuHash(boost::string_ref name, ElfSymbol& result) const;
+
+    /**
+    * Builds the name table and the sorted table.
+    */
+    void index() const;
+
+  public:
+    /**
+    * Constructor mapping a file.
+    * @param path Path of the file.
+    */
+    explicit ElfSymbols(boost::filesystem::path const& path);
+
+    /**
+    * Destructor unmapping the file.
+    */
+    ~ElfSymbols();
+
+    /**
+    * Gets the virtual address of the first loaded segment, rounded down to
+    * a page, which is the address the module's base corresponds to.
+    * @return The address.
+    */
+    std::uint64_t getLoadAddress() const;
+
+    /**
+    * Finds a defined symbol by name.
+    * @param name The name.
+    * @param result Receives the symbol.
+    * @return True if found, false otherwise.
+    */
+    bool lookup(boost::string_ref name, ElfSymbol& result) const;
+
+    /**
+    * Finds the symbol at or closest below a virtual address.
+    * @param value The virtual address as linked.
+    * @param result Receives the symbol.
+    * @return True if found, false if there is no symbol below the address.
+    */
+    bool lookup(std::uint64_t value, ElfSymbol& result) const;
+  };
+
+  /**
+  * A symbol resolved in a process.
+  */
+  struct Symbol
+  {
+    boost::string_ref name;     // Valid as long as the SymbolResolver.
+    std::uintptr_t address;     // Runtime address.
+    std::uint64_t size;
+    Module const* module;       // Valid until SymbolResolver::refresh().
+  };
+
+  /**
+  * Resolves symbols of the modules mapped into a process by reading their
+  * files. Files are mapped once per device and inode and kept across
+  * refreshes. GNU indirect functions, like memcpy in glibc, resolve to their
+  * resolver rather than the implementation the dynamic linker chose.
+  * Not thread-safe.
+  */
+  class SymbolResolver
+    : boost::noncopyable
+  {
+  private:
+    typedef std::tuple<std::uint16_t, std::uint16_t, std::uint32_t> FileKey;
+
+    ModuleMap m_modules;
+    mutable std::map<FileKey, std::shared_ptr<ElfSymbols>> m_files;
+    mutable std::vector<ElfSymbols const*> m_symbols;
+    mutable std::vector<bool> m_loaded;
+
+    /**
+    * Gets the symbols of a module, mapping its file if needed.
+    * @param module The module.
+    * @return The symbols or NULL if the file can't be read.
+    */
+    ElfSymbols const* getSymbols(Module const& module) const;
+
+    /**
+    * Looks up a symbol in a module.
+    * @param module The module.
+    * @param name The symbol's name.
+    * @param result Receives the symbol.
+    * @return True if found, false otherwise.
+    */
+    bool lookup(Module const& module, boost::string_ref name,
+      Symbol& result) const;
+
+  public:
+    /**
+    * Constructor reading the modules of a process.
+    * @param process The process.
+    */
+    explicit SymbolResolver(Process const& process);
+
+    /**
+    * Reads the modules again, files mapped before are reused.
+    */
+    void refresh();
+
+    /**
+    * Gets the modules.
+    * @return The modules.
+    */
+    ModuleMap const& getModuleMap() const;
+
+    /**
+    * Finds a symbol in a module.
+    * @param module Path or basename of the module.
+    * @param name The symbol's name.
+    * @param result Receives the symbol.
+    * @return True if found, false otherwise.
+    */
+    bool find(boost::string_ref module, boost::string_ref name,
+      Symbol& result) const;
+
+    /**
+    * Finds a symbol in any module, searching them in address order.
+    * @param name The symbol's name.
+    * @param result Receives the symbol.
+    * @return True if found, false otherwise.
+    */
+    bool find(boost::string_ref name, Symbol& result) const;
+
+    /**
+    * Gets the runtime address of a symbol.
+    * @param module Path or basename of the module.
+    * @param name The symbol's name.
+    * @return The address.
+    */
+    std::uintptr_t resolve(boost::string_ref module,
+      boost::string_ref name) const;
+
+    /**
+    * Finds the symbol at or closest below an address.
+    * @param address The address.
+    * @param result Receives the symbol.
+    * @return True if found, false if the address lies outside of all
+    * modules or below all symbols of its module.
+    */
+    bool symbolize(std::uintptr_t address, Symbol& result) const;
+  };
+}
+
+#endif // __ETHON_SYMBOLRESOLVER_HPP__
@@ -0,0 +1,238 @@
+/*
+ValueQuery.hpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __ETHON_VALUEQUERY_HPP__
+#define __ETHON_VALUEQUERY_HPP__
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <limits>
+#include <type_traits>
+
+// Ethon:
+#include <Ethon/Scanner.hpp>
+
+namespace Ethon
+{
+  /**
+  * Comparisons a value query can perform.
+  */
+  enum class Comparison
+  {
+    EQUAL,    // value == first
+    RANGE,    // first <= value <= second
+    EPSILON,  // |value - first| <= second
+    GREATER,  // value > first
+    LESS      // value < first
+  };
+
+  /**
+  * A typed comparison evaluated for every aligned element of a memory
+  * buffer. Comparisons follow the rules of the C++ operators, so NaNs in
+  * memory never match and a NaN operand matches nothing.
+  */
+  class ValueQuery
+  {
+  private:
+    ValueType m_type;
+    Comparison m_comparison;
+    std::uint64_t m_first;      // Representation of the first operand.
+    std::uint64_t m_second;     // Representation of the second operand.
+    std::size_t m_alignment;    // Candidates satisfy
+    std::size_t m_offset;       // address % alignment == offset.
+
+  public:
+    /**
+    * Constructor initializing a query from raw operands.
+    * @param type Type of the compared values.
+    * @param comparison The comparison to perform.
+    * @param first Pointer to the first operand, of the specified type.
+    * @param second Pointer to the second operand, of the specified type.
+    * Ignored unless comparison is RANGE or EPSILON.
+    */
+    ValueQuery(ValueType type, Comparison comparison, void const* first,
+      void const* second);
+
+    /**
+    * Creates a query for a C++ type.
+    * @param comparison The comparison to perform.
+    * @param first The first operand.
+    * @param second The second operand, only used by RANGE and EPSILON.
+    * @return The query.
+    */
+    template<typename T>
+    static ValueQuery make(Comparison comparison, T first, T second = T())
+    {
+      static_assert(std::is_arithmetic<T>::value,
+        "ValueQuery::make() Error : Arithmetic type required");
+
+      return ValueQuery(ValueTypeOf<T>::value, comparison, &first, &second);
+    }
+
+    /**
+    * Sets which addresses are candidates. By default, candidates are
+    * aligned to the size of the value type. A larger alignment together
+    * with an offset can be used to scan a member of an array of structures.
+    * @param alignment Candidates are multiples of alignment, plus offset.
+    * @param offset Offset of the candidates from the alignment.
+    * @return *this
+    */
+    ValueQuery& setAlignment(std::size_t alignment, std::size_t offset = 0);
+
+    /**
+    * Gets the value type.
+    * @return The value type.
+    */
+    ValueType getType() const;
+
+    /**
+    * Gets the comparison.
+    * @return The comparison.
+    */
+    Comparison getComparison() const;
+
+    /**
+    * Gets the candidates' alignment.
+    * @return The alignment.
+    */
+    std::size_t getAlignment() const;
+
+    /**
+    * Gets the candidates' offset from the alignment.
+    * @return The offset.
+    */
+    std::size_t getOffset() const;
+
+    /**
+    * Gets the size of the compared values.
+    * @return The size in bytes.
+    */
+    std::size_t getSize() const;
+
+    /**
+    * Gets an operand.
+    * @param second If true, the second operand is returned.
+    * @return The operand.
+    */
+    template<typename T>
+    T getOperand(bool second = false) const
+    {
+      T result;
+      std::memcpy(&result, second ? &m_second : &m_first, sizeof(T));
+      return result;
+    }
+
+    /**
+    * Evaluates the query for every candidate which lies completely inside a
+    * buffer.
+    * @param data The buffer.
+    * @param size Size of the buffer.
+    * @param address The virtual address the buffer was read from.
+    * @param results Vector the matching addresses are appended to, in
+    * ascending order.
+    * @param limit Maximum number of addresses to append.
+    * @return The number of appended addresses.
+    */
+    std::size_t match(std::uint8_t const* data, std::size_t size,
+      std::uintptr_t address, std::vector<std::uintptr_t>& results,
+      std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    /**
+    * Evaluates the query for a single value.
+    * @param data Pointer to the value.
+    * @return True if it matches, false otherwise.
+    */
+    bool test(std::uint8_t const* data) const;
+  };
+
+  /**
+  * Creates a query matching values equal to a value.
+  * @param value The value.
+  * @return The query.
+  */
+  template<typename T>
+  ValueQuery equalTo(T value)
+  {
+    return ValueQuery::make<T>(Comparison::EQUAL, value);
+  }
+
+  /**
+  * Creates a query matching values inside an inclusive range.
+  * @param low The lower bound.
+  * @param high The upper bound.
+  * @return The query.
+  */
+  template<typename T>
+  ValueQuery inRange(T low, T high)
+  {
+    return ValueQuery::make<T>(Comparison::RANGE, low, high);
+  }
+
+  /**
+  * Creates a query matching values which differ by at most epsilon from a
+  * value.
+  * @param value The value.
+  * @param epsilon The maximum difference.
+  * @return The query.
+  */
+  template<typename T>
+  ValueQuery withinEpsilon(T value, T epsilon)
+  {
+    return ValueQuery::make<T>(Comparison::EPSILON, value, epsilon);
+  }
+
+  /**
+  * Creates a query matching values greater than a value.
+  * @param value The value.
+  * @return The query.
+  */
+  template<typename T>
+  ValueQuery greaterThan(T value)
+  {
+    return ValueQuery::make<T>(Comparison::GREATER, value);
+  }
+
+  /**
+  * Creates a query matching values less than a value.
+  * @param value The value.
+  * @return The query.
+  */
+  template<typename T>
+  ValueQuery lessThan(T value)
+  {
+    return ValueQuery::make<T>(Comparison::LESS, value);
+  }
+
+  /**
+  * Creates a query matching pointers into a memory region.
+  * @param region The memory region.
+  * @return The query.
+  */
+  inline ValueQuery pointsInto(MemoryRegion const& region)
+  {
+    return inRange<std::uintptr_t>(region.getStartAddress(),
+      region.getEndAddress() - 1);
+  }
+}
+
+#endif // __ETHON_VALUEQUERY_HPP__
@@ -25,9 +25,31 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <Ethon/Processes.hpp>
 #include <Ethon/Threads.hpp>
 #include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+#include <Ethon/RegionMap.hpp>
+#include <Ethon/RegionTracker.hpp>
+#include <Ethon/SmapsReader.hpp>
+#include <Ethon/ModuleMap.hpp>
+#include <Ethon/SymbolResolver.hpp>
+#include <Ethon/MemorySource.hpp>
 
 #include <Ethon/Debugger.hpp>
+#include <Ethon/AddressSet.hpp>
 #include <Ethon/Scanner.hpp>
+#include <Ethon/FleetScanner.hpp>
+#include <Ethon/IncrementalScanner.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/SignatureDatabase.hpp>
+#include <Ethon/ScanPlanner.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/RegionOrder.hpp>
+#include <Ethon/StringQuery.hpp>
+#include <Ethon/StringExtractor.hpp>
+#include <Ethon/StructQuery.hpp>
+#include <Ethon/PointerScanner.hpp>
+#include <Ethon/Snapshot.hpp>
+#include <Ethon/ResultFile.hpp>
+#include <Ethon/ValueQuery.hpp>
 #include <Ethon/Memory.hpp>
 
 #include <Ethon/Error.hpp>
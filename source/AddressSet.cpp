@@ -0,0 +1,600 @@
+/*
+AddressSet.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <sys/mman.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+// SSE2:
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/AddressSet.hpp>
+
+using Ethon::AddressSet;
+using Ethon::ArgumentError;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  // Converts the offsets of a block into offsets to a smaller base.
+  void rebase(std::uint32_t const* offsets, std::size_t count,
+    std::uintptr_t shift, std::uint32_t* dest)
+  {
+    std::uint32_t const delta = static_cast<std::uint32_t>(shift);
+    for(std::size_t i = 0; i < count; ++i)
+      dest[i] = offsets[i] + delta;
+  }
+
+  // Flags the elements of a which are contained in b, both ascending.
+  void markMembers(std::uint32_t const* a, std::size_t countA,
+    std::uint32_t const* b, std::size_t countB, bool* found)
+  {
+    std::size_t i = 0;
+    std::size_t j = 0;
+
+#ifdef __SSE2__
+    // Compares four elements of a with all rotations of four elements of b
+    // and advances the group whose last element is smaller.
+    while(i + 4 <= countA && j + 4 <= countB)
+    {
+      __m128i const left = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(a + i));
+      __m128i const right = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(b + j));
+      __m128i const equal = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(left, right),
+          _mm_cmpeq_epi32(left,
+            _mm_shuffle_epi32(right, _MM_SHUFFLE(0, 3, 2, 1)))),
+        _mm_or_si128(
+          _mm_cmpeq_epi32(left,
+            _mm_shuffle_epi32(right, _MM_SHUFFLE(1, 0, 3, 2))),
+          _mm_cmpeq_epi32(left,
+            _mm_shuffle_epi32(right, _MM_SHUFFLE(2, 1, 0, 3)))));
+
+      unsigned bits = _mm_movemask_ps(_mm_castsi128_ps(equal));
+      while(bits)
+      {
+        found[i + __builtin_ctz(bits)] = true;
+        bits &= bits - 1;
+      }
+
+      std::uint32_t const lastA = a[i + 3];
+      std::uint32_t const lastB = b[j + 3];
+      if(lastA <= lastB)
+        i += 4;
+      if(lastB <= lastA)
+        j += 4;
+    }
+#endif
+
+    while(i < countA && j < countB)
+    {
+      if(a[i] < b[j])
+      {
+        ++i;
+      }
+      else if(b[j] < a[i])
+      {
+        ++j;
+      }
+      else
+      {
+        found[i] = true;
+        ++i;
+        ++j;
+      }
+    }
+  }
+}
+
+/* AddressSet::const_iterator class */
+
+AddressSet::const_iterator::const_iterator()
+  : m_set(0), m_block(0), m_index(0)
+{ }
+
+AddressSet::const_iterator::const_iterator(AddressSet const* set,
+  std::size_t block)
+  : m_set(set), m_block(block), m_index(0)
+{ }
+
+void AddressSet::const_iterator::increment()
+{
+  if(++m_index == m_set->m_blocks[m_block].count)
+  {
+    ++m_block;
+    m_index = 0;
+  }
+}
+
+bool AddressSet::const_iterator::equal(const_iterator const& other) const
+{
+  return m_set == other.m_set && m_block == other.m_block &&
+    m_index == other.m_index;
+}
+
+std::uintptr_t AddressSet::const_iterator::dereference() const
+{
+  Block const& block = m_set->m_blocks[m_block];
+  return block.base + m_set->getOffsets()[block.first + m_index];
+}
+
+/* AddressSet class */
+
+AddressSet::AddressSet()
+  : m_blocks(), m_offsets(), m_map(0), m_mapCapacity(0), m_file(-1),
+    m_size(0), m_spillThreshold(SPILL_THRESHOLD), m_spillDirectory()
+{ }
+
+AddressSet::AddressSet(std::vector<std::uintptr_t> addresses)
+  : m_blocks(), m_offsets(), m_map(0), m_mapCapacity(0), m_file(-1),
+    m_size(0), m_spillThreshold(SPILL_THRESHOLD), m_spillDirectory()
+{
+  std::sort(addresses.begin(), addresses.end());
+  addresses.erase(std::unique(addresses.begin(), addresses.end()),
+    addresses.end());
+  append(addresses);
+}
+
+AddressSet::AddressSet(AddressSet&& other)
+  : m_blocks(std::move(other.m_blocks)),
+    m_offsets(std::move(other.m_offsets)), m_map(other.m_map),
+    m_mapCapacity(other.m_mapCapacity), m_file(other.m_file),
+    m_size(other.m_size), m_spillThreshold(other.m_spillThreshold),
+    m_spillDirectory(std::move(other.m_spillDirectory))
+{
+  other.m_blocks.clear();
+  other.m_offsets.clear();
+  other.m_map = 0;
+  other.m_mapCapacity = 0;
+  other.m_file = -1;
+  other.m_size = 0;
+}
+
+AddressSet& AddressSet::operator=(AddressSet&& other)
+{
+  if(this != &other)
+  {
+    release();
+    m_blocks = std::move(other.m_blocks);
+    m_offsets = std::move(other.m_offsets);
+    m_map = other.m_map;
+    m_mapCapacity = other.m_mapCapacity;
+    m_file = other.m_file;
+    m_size = other.m_size;
+    m_spillThreshold = other.m_spillThreshold;
+    m_spillDirectory = std::move(other.m_spillDirectory);
+
+    other.m_blocks.clear();
+    other.m_offsets.clear();
+    other.m_map = 0;
+    other.m_mapCapacity = 0;
+    other.m_file = -1;
+    other.m_size = 0;
+  }
+
+  return *this;
+}
+
+AddressSet::~AddressSet()
+{
+  release();
+}
+
+std::uint32_t const* AddressSet::getOffsets() const
+{
+  return m_map ? m_map : m_offsets.data();
+}
+
+void AddressSet::pushOffset(std::uint32_t offset)
+{
+  if(m_map)
+  {
+    if(m_size == m_mapCapacity)
+      growMap(m_mapCapacity * 2);
+    m_map[m_size++] = offset;
+    return;
+  }
+
+  m_offsets.push_back(offset);
+  ++m_size;
+  if(m_offsets.size() * sizeof(std::uint32_t) > m_spillThreshold)
+    spill();
+}
+
+void AddressSet::pushOffsets(std::uint32_t const* offsets,
+  std::size_t count)
+{
+  if(m_map)
+  {
+    while(m_size + count > m_mapCapacity)
+      growMap(m_mapCapacity * 2);
+    std::memcpy(m_map + m_size, offsets, count * sizeof(std::uint32_t));
+    m_size += count;
+    return;
+  }
+
+  m_offsets.insert(m_offsets.end(), offsets, offsets + count);
+  m_size += count;
+  if(m_offsets.size() * sizeof(std::uint32_t) > m_spillThreshold)
+    spill();
+}
+
+void AddressSet::spill()
+{
+  boost::filesystem::path directory = m_spillDirectory.empty() ?
+    boost::filesystem::temp_directory_path() : m_spillDirectory;
+  std::string path = (directory / "ethonmem-addresses-XXXXXX").string();
+
+  m_file = ::mkstemp(&path[0]);
+  if(m_file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't create spill file") <<
+      ErrorCode(error));
+  }
+
+  // The file vanishes with its descriptor.
+  ::unlink(path.c_str());
+
+  growMap(std::max<std::uint64_t>(m_size * 2, BLOCK_CAPACITY));
+  if(m_size)
+    std::memcpy(m_map, m_offsets.data(), m_size * sizeof(std::uint32_t));
+  std::vector<std::uint32_t>().swap(m_offsets);
+}
+
+void AddressSet::growMap(std::uint64_t capacity)
+{
+  std::size_t const bytes = capacity * sizeof(std::uint32_t);
+  if(::ftruncate(m_file, bytes) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't resize spill file") <<
+      ErrorCode(error));
+  }
+
+  void* map = m_map ?
+    ::mremap(m_map, m_mapCapacity * sizeof(std::uint32_t), bytes,
+      MREMAP_MAYMOVE) :
+    ::mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+  if(map == MAP_FAILED)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't map spill file") <<
+      ErrorCode(error));
+  }
+
+  m_map = static_cast<std::uint32_t*>(map);
+  m_mapCapacity = capacity;
+}
+
+void AddressSet::release()
+{
+  if(m_map)
+    ::munmap(m_map, m_mapCapacity * sizeof(std::uint32_t));
+  if(m_file != -1)
+    ::close(m_file);
+
+  m_map = 0;
+  m_mapCapacity = 0;
+  m_file = -1;
+}
+
+void AddressSet::setSpilling(std::size_t threshold,
+  boost::filesystem::path const& directory)
+{
+  m_spillThreshold = threshold;
+  m_spillDirectory = directory;
+  if(!m_map && m_size * sizeof(std::uint32_t) > m_spillThreshold)
+    spill();
+}
+
+void AddressSet::append(std::uintptr_t address)
+{
+  if(!m_blocks.empty())
+  {
+    Block& block = m_blocks.back();
+    if(address <= block.last)
+    {
+      BOOST_THROW_EXCEPTION(ArgumentError() <<
+        ErrorString("Addresses have to be appended in ascending order"));
+    }
+
+    if(block.count < BLOCK_CAPACITY && address - block.base <= MAX_BLOCK_SPAN)
+    {
+      pushOffset(static_cast<std::uint32_t>(address - block.base));
+      block.last = address;
+      ++block.count;
+      return;
+    }
+  }
+
+  Block block = { address, address, m_size, 1 };
+  m_blocks.push_back(block);
+  pushOffset(0);
+}
+
+void AddressSet::append(std::vector<std::uintptr_t> const& addresses)
+{
+  BOOST_FOREACH(std::uintptr_t cur, addresses)
+    append(cur);
+}
+
+void AddressSet::appendBlock(std::uintptr_t base,
+  std::uint32_t const* offsets, std::uint32_t count)
+{
+  if(!count)
+    return;
+
+  if(count > BLOCK_CAPACITY || offsets[0] != 0 ||
+    offsets[count - 1] > MAX_BLOCK_SPAN ||
+    (!m_blocks.empty() && base <= m_blocks.back().last))
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Invalid address block"));
+  }
+
+  Block block = { base, base + offsets[count - 1], m_size, count };
+  m_blocks.push_back(block);
+  pushOffsets(offsets, count);
+}
+
+void AddressSet::clear()
+{
+  release();
+  m_blocks.clear();
+  m_offsets.clear();
+  m_size = 0;
+}
+
+std::uint64_t AddressSet::size() const
+{
+  return m_size;
+}
+
+bool AddressSet::empty() const
+{
+  return !m_size;
+}
+
+bool AddressSet::isSpilled() const
+{
+  return m_map != 0;
+}
+
+std::uint64_t AddressSet::getByteSize() const
+{
+  return m_blocks.size() * sizeof(Block) + m_size * sizeof(std::uint32_t);
+}
+
+std::vector<AddressSet::Block> const& AddressSet::getBlocks() const
+{
+  return m_blocks;
+}
+
+std::uint32_t const* AddressSet::getOffsets(Block const& block) const
+{
+  return getOffsets() + block.first;
+}
+
+bool AddressSet::contains(std::uintptr_t address) const
+{
+  std::vector<Block>::const_iterator block = std::upper_bound(
+    m_blocks.begin(), m_blocks.end(), address,
+    [](std::uintptr_t value, Block const& cur) { return value < cur.base; });
+  if(block == m_blocks.begin())
+    return false;
+
+  --block;
+  if(address > block->last)
+    return false;
+
+  std::uint32_t const* first = getOffsets() + block->first;
+  return std::binary_search(first, first + block->count,
+    static_cast<std::uint32_t>(address - block->base));
+}
+
+AddressSet::const_iterator AddressSet::begin() const
+{
+  return const_iterator(this, 0);
+}
+
+AddressSet::const_iterator AddressSet::end() const
+{
+  return const_iterator(this, m_blocks.size());
+}
+
+std::vector<std::uintptr_t> AddressSet::toVector() const
+{
+  return std::vector<std::uintptr_t>(begin(), end());
+}
+
+AddressSet AddressSet::makeResult() const
+{
+  AddressSet result;
+  result.setSpilling(m_spillThreshold, m_spillDirectory);
+  return result;
+}
+
+void AddressSet::filter(AddressSet const& other, bool contained,
+  AddressSet& result) const
+{
+  std::uint32_t const* offsets = getOffsets();
+  std::uint32_t const* otherOffsets = other.getOffsets();
+  std::uint32_t left[BLOCK_CAPACITY];
+  std::uint32_t right[BLOCK_CAPACITY];
+  bool found[BLOCK_CAPACITY];
+
+  std::size_t j = 0;
+  BOOST_FOREACH(Block const& block, m_blocks)
+  {
+    std::fill(found, found + block.count, false);
+    while(j < other.m_blocks.size() && other.m_blocks[j].last < block.base)
+      ++j;
+
+    // Overlapping blocks start less than MAX_BLOCK_SPAN apart, so their
+    // offsets to the smaller base still fit into 32 bits.
+    for(std::size_t k = j; k < other.m_blocks.size() &&
+      other.m_blocks[k].base <= block.last; ++k)
+    {
+      Block const& cur = other.m_blocks[k];
+      std::uintptr_t const base = std::min(block.base, cur.base);
+      rebase(offsets + block.first, block.count, block.base - base, left);
+      rebase(otherOffsets + cur.first, cur.count, cur.base - base, right);
+      markMembers(left, block.count, right, cur.count, found);
+    }
+
+    for(std::uint32_t i = 0; i < block.count; ++i)
+    {
+      if(found[i] == contained)
+        result.append(block.base + offsets[block.first + i]);
+    }
+  }
+}
+
+AddressSet AddressSet::intersect(AddressSet const& other) const
+{
+  AddressSet result = makeResult();
+  filter(other, true, result);
+  return result;
+}
+
+AddressSet AddressSet::subtract(AddressSet const& other) const
+{
+  AddressSet result = makeResult();
+  filter(other, false, result);
+  return result;
+}
+
+AddressSet AddressSet::unite(AddressSet const& other) const
+{
+  AddressSet result = makeResult();
+  std::uint32_t const* offsets = getOffsets();
+  std::uint32_t const* otherOffsets = other.getOffsets();
+
+  // Blocks ending before the next address of the other set are copied as a
+  // whole, only the addresses of overlapping blocks are merged one by one.
+  std::uintptr_t const max = std::numeric_limits<std::uintptr_t>::max();
+  std::size_t i = 0, j = 0;
+  std::uint32_t k = 0, l = 0;
+  while(i < m_blocks.size() || j < other.m_blocks.size())
+  {
+    Block const* left = i < m_blocks.size() ? &m_blocks[i] : 0;
+    Block const* right = j < other.m_blocks.size() ? &other.m_blocks[j] : 0;
+    std::uintptr_t const a = left ? left->base + offsets[left->first + k] :
+      max;
+    std::uintptr_t const b = right ?
+      right->base + otherOffsets[right->first + l] : max;
+
+    if(left && !k && (!right || left->last < b))
+    {
+      result.appendBlock(left->base, offsets + left->first, left->count);
+      ++i;
+      continue;
+    }
+
+    if(right && !l && (!left || right->last < a))
+    {
+      result.appendBlock(right->base, otherOffsets + right->first,
+        right->count);
+      ++j;
+      continue;
+    }
+
+    result.append(std::min(a, b));
+    if(a <= b && ++k == left->count)
+    {
+      ++i;
+      k = 0;
+    }
+    if(b <= a && ++l == right->count)
+    {
+      ++j;
+      l = 0;
+    }
+  }
+
+  return result;
+}
+
+AddressSet AddressSet::near(AddressSet const& other,
+  std::uintptr_t tolerance) const
+{
+  std::uintptr_t const max = std::numeric_limits<std::uintptr_t>::max();
+  std::uint32_t const* offsets = getOffsets();
+  std::uint32_t const* otherOffsets = other.getOffsets();
+  AddressSet result = makeResult();
+
+  // The first address of the other set not below the current lower bound.
+  std::size_t j = 0;
+  std::uint32_t k = 0;
+  BOOST_FOREACH(Block const& block, m_blocks)
+  {
+    for(std::uint32_t i = 0; i < block.count; ++i)
+    {
+      std::uintptr_t const address = block.base + offsets[block.first + i];
+      std::uintptr_t const low = address < tolerance ? 0 : address - tolerance;
+      std::uintptr_t const high = max - address < tolerance ? max :
+        address + tolerance;
+
+      // Blocks entirely below the bound are skipped without decoding.
+      while(j < other.m_blocks.size() && other.m_blocks[j].last < low)
+      {
+        ++j;
+        k = 0;
+      }
+
+      if(j == other.m_blocks.size())
+        return result;
+
+      Block const& cur = other.m_blocks[j];
+      while(cur.base + otherOffsets[cur.first + k] < low)
+        ++k;
+
+      if(cur.base + otherOffsets[cur.first + k] <= high)
+        result.append(address);
+    }
+  }
+
+  return result;
+}
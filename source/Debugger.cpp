@@ -138,6 +138,38 @@ void Debugger::stepSyscall(int signalCode) const
   }
 }
 
+void Debugger::setOptions(long options) const
+{
+  long ec = ::ptrace(PTRACE_SETOPTIONS, m_process.getPid(), 0, options);
+  if(ec == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(EthonError() <<
+      ErrorString("ptrace with PTRACE_SETOPTIONS failed") <<
+      ErrorCode(error));
+  }
+}
+
+int Debugger::wait() const
+{
+  int status;
+  pid_t ec;
+  do
+  {
+    ec = ::waitpid(m_process.getPid(), &status, __WALL);
+  } while(ec == -1 && errno == EINTR);
+
+  if(ec == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(EthonError() <<
+      ErrorString("wait failed") <<
+      ErrorCode(error));
+  }
+
+  return status;
+}
+
 void Debugger::kill() const
 {
   long ec = ::ptrace(PTRACE_KILL, m_process.getPid(), 0, 0);
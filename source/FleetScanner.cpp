@@ -0,0 +1,301 @@
+/*
+FleetScanner.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <memory>
+#include <unordered_map>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/StringQuery.hpp>
+#include <Ethon/ValueQuery.hpp>
+#include <Ethon/StructQuery.hpp>
+#include <Ethon/SmapsReader.hpp>
+#include <Ethon/FleetScanner.hpp>
+
+using Ethon::FleetScanner;
+using Ethon::FleetMatch;
+using Ethon::Process;
+using Ethon::Pid;
+using Ethon::MemoryRegion;
+using Ethon::RemoteMemorySource;
+using Ethon::Scanner;
+using Ethon::ScanContext;
+using Ethon::Signature;
+using Ethon::StringQuery;
+using Ethon::StringMatch;
+using Ethon::ValueQuery;
+using Ethon::StructQuery;
+using Ethon::SmapsReader;
+using Ethon::RegionUsage;
+using Ethon::EthonError;
+
+namespace
+{
+  // Identifies the content of a file-backed mapping.
+  struct MappingKey
+  {
+    std::uint16_t devMajor;
+    std::uint16_t devMinor;
+    std::uint32_t inode;
+    std::uint32_t offset;
+    std::size_t size;
+
+    bool operator==(MappingKey const& rhs) const
+    {
+      return devMajor == rhs.devMajor && devMinor == rhs.devMinor &&
+        inode == rhs.inode && offset == rhs.offset && size == rhs.size;
+    }
+  };
+
+  struct MappingKeyHash
+  {
+    std::size_t operator()(MappingKey const& key) const
+    {
+      std::uint64_t hash = (static_cast<std::uint64_t>(key.devMajor) << 48) ^
+        (static_cast<std::uint64_t>(key.devMinor) << 32) ^ key.inode;
+      hash = hash * 0x9E3779B97F4A7C15ULL ^ key.offset;
+      hash = hash * 0x9E3779B97F4A7C15ULL ^ key.size;
+      return static_cast<std::size_t>(hash ^ (hash >> 29));
+    }
+  };
+
+  // A process mapping a region at an address.
+  struct Target
+  {
+    Pid pid;
+    std::uintptr_t start;
+  };
+
+  // A region scanned once, its matches are reported for all targets.
+  struct WorkItem
+  {
+    std::size_t source;
+    MemoryRegion region;
+    std::vector<Target> targets;
+  };
+}
+
+/* FleetScanner class */
+
+FleetScanner::FleetScanner(std::vector<Process> const& processes,
+  std::size_t threads)
+  : m_processes(processes), m_threads(threads), m_context()
+{ }
+
+FleetScanner::FleetScanner(std::string const& processName,
+  std::size_t threads)
+  : m_processes(Ethon::getProcessListByName(processName)),
+    m_threads(threads), m_context()
+{ }
+
+void FleetScanner::setContext(ScanContext const& context)
+{
+  m_context = context;
+}
+
+std::vector<Process> const& FleetScanner::getProcesses() const
+{
+  return m_processes;
+}
+
+std::vector<FleetMatch> FleetScanner::findAll(RegionSearch const& search,
+  RegionFilter const& filter)
+{
+  std::vector<std::shared_ptr<RemoteMemorySource>> sources;
+  std::vector<WorkItem> items;
+  std::unordered_map<MappingKey, std::size_t, MappingKeyHash> shared;
+  std::uint64_t total = 0;
+
+  BOOST_FOREACH(Process const& process, m_processes)
+  {
+    std::shared_ptr<RemoteMemorySource> source =
+      std::make_shared<RemoteMemorySource>(process);
+
+    // Processes which exited meanwhile are skipped.
+    std::vector<MemoryRegion> regions;
+    try
+    {
+      regions = Scanner(source).selectRegions(filter);
+    }
+    catch(EthonError const&)
+    {
+      continue;
+    }
+
+    // Regions with anonymous pages hold private copies of the file's pages.
+    // Without smaps, no region of the process is known to be unmodified.
+    SmapsReader smaps(process);
+
+    sources.push_back(source);
+    BOOST_FOREACH(MemoryRegion const& cur, regions)
+    {
+      if(!cur.isReadable())
+        continue;
+
+      Target target = { process.getPid(), cur.getStartAddress() };
+      RegionUsage usage;
+      if(cur.getInode() && !cur.isWriteable() &&
+        smaps.getUsage(cur, usage) && !usage.anonymous)
+      {
+        MappingKey key = { cur.getDeviceMajor(), cur.getDeviceMinor(),
+          cur.getInode(), cur.getOffset(), cur.getSize() };
+        auto found = shared.find(key);
+        if(found != shared.end())
+        {
+          items[found->second].targets.push_back(target);
+          continue;
+        }
+
+        shared[key] = items.size();
+      }
+
+      WorkItem item = { sources.size() - 1, cur,
+        std::vector<Target>(1, target) };
+      items.push_back(item);
+      total += cur.getSize();
+    }
+  }
+
+  ScanContext::Scope scope(m_context, total);
+
+  std::size_t threadCount = m_threads ? m_threads :
+    std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+  threadCount = std::min(threadCount,
+    std::max<std::size_t>(items.size(), 1));
+
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stopped(false);
+  std::vector<std::vector<std::uintptr_t>> found(items.size());
+  std::vector<std::exception_ptr> errors(threadCount);
+
+  auto worker = [&](std::size_t index)
+  {
+    try
+    {
+      for(std::size_t i = next++; i < items.size() && !stopped; i = next++)
+      {
+        Scanner scanner(sources[items[i].source]);
+        scanner.setContext(m_context);
+        found[i] = search(scanner, items[i].region);
+      }
+    }
+    catch(...)
+    {
+      errors[index] = std::current_exception();
+      stopped = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < threadCount; ++i)
+    threads.push_back(std::thread(worker, i));
+  BOOST_FOREACH(std::thread& cur, threads)
+    cur.join();
+
+  BOOST_FOREACH(std::exception_ptr const& cur, errors)
+  {
+    if(cur)
+      std::rethrow_exception(cur);
+  }
+
+  // Fan the matches out to every process mapping the region.
+  std::vector<FleetMatch> results;
+  for(std::size_t i = 0; i < items.size(); ++i)
+  {
+    std::uintptr_t const start = items[i].region.getStartAddress();
+    BOOST_FOREACH(Target const& target, items[i].targets)
+    {
+      BOOST_FOREACH(std::uintptr_t address, found[i])
+      {
+        FleetMatch match = { target.pid, target.start + (address - start) };
+        results.push_back(match);
+      }
+    }
+  }
+
+  std::sort(results.begin(), results.end(),
+    [](FleetMatch const& lhs, FleetMatch const& rhs)
+    {
+      return lhs.pid != rhs.pid ? lhs.pid < rhs.pid :
+        lhs.address < rhs.address;
+    });
+  return results;
+}
+
+std::vector<FleetMatch> FleetScanner::findAll(Signature const& signature,
+  RegionFilter const& filter)
+{
+  Signature plain(signature);
+  plain.clearReference();
+
+  return findAll([&](Scanner& scanner, MemoryRegion const& region)
+    {
+      return scanner.findAll(plain, &region);
+    }, filter);
+}
+
+std::vector<FleetMatch> FleetScanner::findAll(ValueQuery const& query,
+  RegionFilter const& filter)
+{
+  return findAll([&](Scanner& scanner, MemoryRegion const& region)
+    {
+      return scanner.findAll(query, &region);
+    }, filter);
+}
+
+std::vector<FleetMatch> FleetScanner::findAll(StructQuery const& query,
+  RegionFilter const& filter)
+{
+  return findAll([&](Scanner& scanner, MemoryRegion const& region)
+    {
+      return scanner.findAll(query, &region);
+    }, filter);
+}
+
+std::vector<FleetMatch> FleetScanner::findAll(StringQuery const& query,
+  RegionFilter const& filter)
+{
+  return findAll([&](Scanner& scanner, MemoryRegion const& region)
+    {
+      std::vector<std::uintptr_t> addresses;
+      BOOST_FOREACH(StringMatch const& cur, scanner.findAll(query, &region))
+        addresses.push_back(cur.address);
+      return addresses;
+    }, filter);
+}
@@ -0,0 +1,479 @@
+/*
+IncrementalScanner.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/ValueQuery.hpp>
+#include <Ethon/StructQuery.hpp>
+#include <Ethon/StringQuery.hpp>
+#include <Ethon/IncrementalScanner.hpp>
+
+using Ethon::IncrementalScanner;
+using Ethon::MemoryEditor;
+using Ethon::MemoryRegion;
+using Ethon::ProcessMemorySource;
+using Ethon::RemoteMemorySource;
+using Ethon::Process;
+using Ethon::Scanner;
+using Ethon::ScanContext;
+using Ethon::Signature;
+using Ethon::ValueQuery;
+using Ethon::StructQuery;
+using Ethon::StringQuery;
+using Ethon::StringMatch;
+using Ethon::ArgumentError;
+using Ethon::ErrorString;
+
+namespace
+{
+  // Bits of a pagemap entry, see Documentation/admin-guide/mm/pagemap.rst.
+  std::uint64_t const SOFT_DIRTY_BIT = 1ULL << 55;
+  std::uint64_t const SWAPPED_BIT = 1ULL << 62;
+  std::uint64_t const PRESENT_BIT = 1ULL << 63;
+
+  // Amount of pagemap entries read at once.
+  std::size_t const PAGEMAP_BATCH = 8192;
+
+  // Value written to clear_refs to clear the soft-dirty bits.
+  char const CLEAR_SOFT_DIRTY[] = "4";
+
+  // A range of a region whose matches are searched again.
+  struct DirtyRun
+  {
+    std::size_t state;
+    std::uintptr_t start;
+    std::uintptr_t end;
+  };
+
+  bool writeClearRefs(std::string const& path)
+  {
+    int file = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if(file == -1)
+      return false;
+
+    bool const result = ::write(file, CLEAR_SOFT_DIRTY,
+      sizeof(CLEAR_SOFT_DIRTY) - 1) == sizeof(CLEAR_SOFT_DIRTY) - 1;
+    ::close(file);
+    return result;
+  }
+
+  bool readOwnPagemapEntry(void const* page, std::uint64_t& entry)
+  {
+    int file = ::open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if(file == -1)
+      return false;
+
+    ::off_t const offset = static_cast<::off_t>(
+      reinterpret_cast<std::uintptr_t>(page) /
+      IncrementalScanner::PAGE_BYTES * sizeof(entry));
+    bool const result = ::pread(file, &entry, sizeof(entry), offset) ==
+      static_cast<::ssize_t>(sizeof(entry));
+    ::close(file);
+    return result;
+  }
+
+  // Kernels built without soft-dirty tracking still accept clear_refs, so
+  // the bits are tested on a page of the own process.
+  bool testSoftDirty()
+  {
+    void* map = ::mmap(0, IncrementalScanner::PAGE_BYTES,
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(map == MAP_FAILED)
+      return false;
+
+    volatile std::uint8_t* page = static_cast<std::uint8_t*>(map);
+    page[0] = 1;
+
+    std::uint64_t clean = 0;
+    std::uint64_t dirty = 0;
+    bool result = writeClearRefs("/proc/self/clear_refs") &&
+      readOwnPagemapEntry(map, clean);
+    page[0] = 2;
+    result = result && readOwnPagemapEntry(map, dirty) &&
+      !(clean & SOFT_DIRTY_BIT) && (dirty & SOFT_DIRTY_BIT);
+
+    ::munmap(map, IncrementalScanner::PAGE_BYTES);
+    return result;
+  }
+
+  // Tests if two regions are the same mapping, apart from their size.
+  bool isSameMapping(MemoryRegion const& lhs, MemoryRegion const& rhs)
+  {
+    return lhs.getStartAddress() == rhs.getStartAddress() &&
+      lhs.getPermissionMask() == rhs.getPermissionMask() &&
+      lhs.getOffset() == rhs.getOffset() &&
+      lhs.getDeviceMajor() == rhs.getDeviceMajor() &&
+      lhs.getDeviceMinor() == rhs.getDeviceMinor() &&
+      lhs.getInode() == rhs.getInode();
+  }
+}
+
+/* IncrementalScanner class */
+
+IncrementalScanner::IncrementalScanner(MemoryEditor const& editor,
+  RegionFilter const& filter)
+  : m_process(editor.getProcess()),
+    m_source(std::make_shared<ProcessMemorySource>(editor)),
+    m_scanner(m_source), m_filter(filter), m_search(), m_span(1),
+    m_incremental(isSoftDirtySupported()), m_states(), m_rescanned(0)
+{ }
+
+IncrementalScanner::IncrementalScanner(Process const& process,
+  RegionFilter const& filter)
+  : m_process(process),
+    m_source(std::make_shared<RemoteMemorySource>(process)),
+    m_scanner(m_source), m_filter(filter), m_search(), m_span(1),
+    m_incremental(isSoftDirtySupported()), m_states(), m_rescanned(0)
+{ }
+
+bool IncrementalScanner::isSoftDirtySupported()
+{
+  static bool const supported = testSoftDirty();
+  return supported;
+}
+
+void IncrementalScanner::setContext(ScanContext const& context)
+{
+  m_scanner.setContext(context);
+}
+
+void IncrementalScanner::setSearch(BufferSearch const& search,
+  std::size_t span)
+{
+  m_search = search;
+  m_span = std::max<std::size_t>(span, 1);
+  reset();
+}
+
+void IncrementalScanner::setQuery(ValueQuery const& query)
+{
+  std::size_t const size = query.getSize();
+  setSearch([query, size](std::uint8_t const* data, std::size_t available,
+    std::size_t count, std::uintptr_t address,
+    std::vector<std::uintptr_t>& results)
+  {
+    query.match(data, std::min(available, count + size - 1), address,
+      results);
+  }, size);
+}
+
+void IncrementalScanner::setQuery(Signature const& signature)
+{
+  std::size_t const size = signature.getSize();
+  setSearch([signature, size](std::uint8_t const* data,
+    std::size_t available, std::size_t count, std::uintptr_t address,
+    std::vector<std::uintptr_t>& results)
+  {
+    signature.match(data, std::min(available, count + size - 1), address,
+      results);
+  }, size);
+}
+
+void IncrementalScanner::setQuery(StructQuery const& query)
+{
+  if(query.getFields().empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Struct query without fields"));
+  }
+
+  setSearch([query](std::uint8_t const* data, std::size_t available,
+    std::size_t count, std::uintptr_t address,
+    std::vector<std::uintptr_t>& results)
+  {
+    query.match(data, available, count, address, results);
+  }, query.getSpan());
+}
+
+void IncrementalScanner::setQuery(StringQuery const& query)
+{
+  setSearch([query](std::uint8_t const* data, std::size_t available,
+    std::size_t count, std::uintptr_t address,
+    std::vector<std::uintptr_t>& results)
+  {
+    // Several encodings may match at the same address.
+    std::vector<StringMatch> matches;
+    query.match(data, available, count, address, matches);
+    BOOST_FOREACH(StringMatch const& cur, matches)
+    {
+      if(results.empty() || results.back() != cur.address)
+        results.push_back(cur.address);
+    }
+  }, query.getMaxSize());
+}
+
+void IncrementalScanner::reset()
+{
+  m_states.clear();
+}
+
+bool IncrementalScanner::readPagemap(int file, MemoryRegion const& region,
+  std::vector<bool>& dirty, std::vector<bool>& present) const
+{
+  std::size_t const first = region.getStartAddress() / PAGE_BYTES;
+  std::size_t const pages = (region.getSize() + PAGE_BYTES - 1) / PAGE_BYTES;
+
+  // Filled separately, so a failing read leaves both outputs untouched.
+  std::vector<bool> readDirty(pages, false);
+  std::vector<bool> readPresent(pages, false);
+
+  std::vector<std::uint64_t> entries(std::min(pages, PAGEMAP_BATCH));
+  for(std::size_t done = 0; done < pages; )
+  {
+    std::size_t const amount = std::min(pages - done, PAGEMAP_BATCH);
+    std::size_t const bytes = amount * sizeof(std::uint64_t);
+    ::ssize_t const count = ::pread(file, &entries[0], bytes,
+      static_cast<::off_t>((first + done) * sizeof(std::uint64_t)));
+    if(count != static_cast<::ssize_t>(bytes))
+      return false;
+
+    for(std::size_t i = 0; i < amount; ++i)
+    {
+      readDirty[done + i] = (entries[i] & SOFT_DIRTY_BIT) != 0;
+      readPresent[done + i] =
+        (entries[i] & (PRESENT_BIT | SWAPPED_BIT)) != 0;
+    }
+
+    done += amount;
+  }
+
+  dirty.swap(readDirty);
+  present.swap(readPresent);
+  return true;
+}
+
+bool IncrementalScanner::clearSoftDirty() const
+{
+  return writeClearRefs(
+    (m_process.getProcfsDirectory() / "clear_refs").string());
+}
+
+void IncrementalScanner::scanRange(MemoryRegion const& region,
+  std::uintptr_t start, std::uintptr_t end,
+  std::vector<std::uintptr_t>& results)
+{
+  // Matches starting in the range may extend behind it.
+  std::uintptr_t const limit = std::min<std::uintptr_t>(end + m_span - 1,
+    region.getEndAddress());
+  MemoryRegion const range(start, limit, region.getPermissions());
+  m_rescanned += limit - start;
+
+  m_scanner.walkRegion(range, m_span - 1,
+    [&](std::uint8_t const* data, std::size_t size, std::uintptr_t address)
+    {
+      if(address >= end)
+        return false;
+
+      std::size_t const count = std::min<std::uintptr_t>(Scanner::CHUNK_SIZE,
+        end - address);
+      m_search(data, size, count, address, results);
+      return true;
+    });
+}
+
+std::vector<std::uintptr_t> IncrementalScanner::scan()
+{
+  if(!m_search)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("No query set for incremental scan"));
+  }
+
+  std::vector<MemoryRegion> regions = m_scanner.selectRegions(m_filter);
+  regions.erase(std::remove_if(regions.begin(), regions.end(),
+    [](MemoryRegion const& cur) { return !cur.isReadable(); }),
+    regions.end());
+
+  // Matches starting this many pages before a written page may reach
+  // into it.
+  std::size_t const reach = (m_span - 1 + PAGE_BYTES - 1) / PAGE_BYTES;
+
+  int pagemap = -1;
+  if(m_incremental)
+  {
+    pagemap = ::open((m_process.getProcfsDirectory() / "pagemap").c_str(),
+      O_RDONLY | O_CLOEXEC);
+  }
+
+  // The pagemap has to be read before the bits are cleared, the pages
+  // afterwards, so that no write goes unnoticed.
+  std::vector<RegionState> states(regions.size());
+  std::vector<DirtyRun> runs;
+  std::uint64_t total = 0;
+  for(std::size_t i = 0; i < regions.size(); ++i)
+  {
+    RegionState& state = states[i];
+    state.region = regions[i];
+
+    std::size_t const pages =
+      (state.region.getSize() + PAGE_BYTES - 1) / PAGE_BYTES;
+    std::vector<bool> dirty(pages, true);
+    std::vector<bool> softDirty;
+    // A region whose entries could not be read keeps no residency, which
+    // makes the next pass treat all of its pages as unknown.
+    if(pagemap != -1 &&
+      readPagemap(pagemap, state.region, softDirty, state.present))
+    {
+      std::vector<RegionState>::iterator previous = std::lower_bound(
+        m_states.begin(), m_states.end(), state.region.getStartAddress(),
+        [](RegionState const& cur, std::uintptr_t address)
+        {
+          return cur.region.getStartAddress() < address;
+        });
+
+      // Pages which were dropped since the last pass read as zero now
+      // without having been written.
+      if(previous != m_states.end() &&
+        isSameMapping(previous->region, state.region))
+      {
+        for(std::size_t page = 0; page < pages; ++page)
+        {
+          dirty[page] = softDirty[page] ||
+            page >= previous->present.size() ||
+            (previous->present[page] && !state.present[page]);
+        }
+
+        if(previous->region.getEndAddress() != state.region.getEndAddress())
+          dirty[pages - 1] = true;
+
+        state.results.swap(previous->results);
+      }
+    }
+
+    // Extend every dirty page to the pages whose matches may reach into it.
+    for(std::size_t page = pages, pending = 0; page-- > 0; )
+    {
+      if(dirty[page])
+        pending = reach + 1;
+
+      if(pending)
+      {
+        dirty[page] = true;
+        --pending;
+      }
+    }
+
+    for(std::size_t page = 0; page < pages; )
+    {
+      if(!dirty[page])
+      {
+        ++page;
+        continue;
+      }
+
+      std::size_t last = page;
+      while(last < pages && dirty[last])
+        ++last;
+
+      DirtyRun run;
+      run.state = i;
+      run.start = state.region.getStartAddress() + page * PAGE_BYTES;
+      run.end = std::min<std::uintptr_t>(
+        state.region.getStartAddress() + last * PAGE_BYTES,
+        state.region.getEndAddress());
+      runs.push_back(run);
+      total += std::min<std::uintptr_t>(run.end + m_span - 1,
+        state.region.getEndAddress()) - run.start;
+
+      page = last;
+    }
+  }
+
+  if(pagemap != -1)
+    ::close(pagemap);
+
+  // Without cleared bits the next pass has to scan everything.
+  if(!m_incremental || !clearSoftDirty())
+  {
+    BOOST_FOREACH(RegionState& cur, states)
+      cur.present.clear();
+  }
+
+  m_states.clear();
+  m_rescanned = 0;
+
+  // Replace the cached matches of every dirty run.
+  ScanContext::Scope scope(m_scanner.getContext(), total);
+  std::vector<DirtyRun>::const_iterator run = runs.begin();
+  for(std::size_t i = 0; i < states.size(); ++i)
+  {
+    RegionState& state = states[i];
+    std::vector<std::uintptr_t> const& cached = state.results;
+    std::vector<std::uintptr_t> results;
+    results.reserve(cached.size());
+
+    std::vector<std::uintptr_t>::const_iterator cur = cached.begin();
+    for(; run != runs.end() && run->state == i; ++run)
+    {
+      std::vector<std::uintptr_t>::const_iterator first =
+        std::lower_bound(cur, cached.end(), run->start);
+      results.insert(results.end(), cur, first);
+      scanRange(state.region, run->start, run->end, results);
+      cur = std::lower_bound(first, cached.end(), run->end);
+    }
+
+    // Matches of a shrunk region's dropped pages.
+    results.insert(results.end(), cur,
+      std::lower_bound(cur, cached.end(), state.region.getEndAddress()));
+    state.results.swap(results);
+  }
+
+  m_states.swap(states);
+
+  std::vector<std::uintptr_t> results;
+  BOOST_FOREACH(RegionState const& cur, m_states)
+    results.insert(results.end(), cur.results.begin(), cur.results.end());
+
+  return results;
+}
+
+bool IncrementalScanner::isIncremental() const
+{
+  return m_incremental;
+}
+
+std::uint64_t IncrementalScanner::getRescannedBytes() const
+{
+  return m_rescanned;
+}
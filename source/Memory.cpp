@@ -37,6 +37,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <Ethon/Debugger.hpp>
 #include <Ethon/Error.hpp>
 #include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionMap.hpp>
 #include <Ethon/Processes.hpp>
 
 using Ethon::MemoryEditor;
@@ -45,6 +46,7 @@ using Ethon::Process;
 using Ethon::EthonError;
 using Ethon::MemoryRegion;
 using Ethon::MemoryRegionSequence;
+using Ethon::RegionMap;
 using Ethon::AccessMode;
 
 /* MemoryEditor class */
@@ -141,6 +143,12 @@ bool MemoryEditor::isReadable(uintptr_t address) const
   return true;
 }
 
+bool MemoryEditor::isReadable(uintptr_t address, RegionMap const& regions)
+  const
+{
+  return regions.isReadable(address);
+}
+
 bool MemoryEditor::isWriteable(uintptr_t address) const
 {
   boost::optional<MemoryRegion> region =
@@ -152,27 +160,26 @@ bool MemoryEditor::isWriteable(uintptr_t address) const
   return true;
 }
 
+bool MemoryEditor::isWriteable(uintptr_t address, RegionMap const& regions)
+  const
+{
+  return regions.isWriteable(address);
+}
+
 std::size_t MemoryEditor::read(std::uintptr_t address, void* dest,
   std::size_t amount)
 {
   REQUIRES_PROCESS_STOPPED(Debugger::get());
 
-  typedef ::off_t Offset;
-  Offset ec = ::lseek(m_file, address, SEEK_SET);
-  if(ec == static_cast<Offset>(-1))
-  {
-    std::error_code const error = Ethon::makeErrorCode();
-    BOOST_THROW_EXCEPTION(EthonError() <<
-      ErrorString("lseek failed, probably invalid address.") <<
-      ErrorCode(error));
-  }
-
-  ::ssize_t count = ::read(m_file, dest, amount);
+  // pread does not touch the file offset, which is shared with copies of
+  // this editor, so several threads can read concurrently.
+  ::ssize_t count = ::pread(m_file, dest, amount,
+    static_cast< ::off_t>(address));
   if(count == -1)
   {
     std::error_code const error = Ethon::makeErrorCode();
     BOOST_THROW_EXCEPTION(EthonError() <<
-      ErrorString("read failed reading from address.") <<
+      ErrorString("pread failed reading from address.") <<
       ErrorCode(error));
   }
 
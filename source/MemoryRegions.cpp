@@ -27,6 +27,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <cstdio>
 #include <utility>
 #include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <system_error>
+#include <mutex>
+
+// POSIX:
+#include <fcntl.h>
+#include <unistd.h>
 
 // Boost Library:
 #include <boost/iterator/iterator_facade.hpp>
@@ -37,20 +45,113 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 // Ethonmem:
 #include <Ethon/Error.hpp>
 #include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionMap.hpp>
 #include <Ethon/Processes.hpp>
 
 using Ethon::MemoryRegion;
 using Ethon::MemoryRegionIterator;
+using Ethon::MapsEntry;
+using Ethon::MapsReader;
 using Ethon::UnexpectedError;
 using Ethon::FilesystemError;
 using Ethon::MemoryRegionSequence;
+using Ethon::RegionMap;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  // Initial size of a MapsReader's buffer, about 600 typical lines.
+  std::size_t const MAPS_BUFFER_SIZE = 64 * 1024;
+
+  // The largest buffer of the destroyed MapsReaders, handed to the next one
+  // so that enumerating the regions again reads the file with one call.
+  std::mutex g_spareMutex;
+  std::vector<char> g_spareBuffer;
+
+  /**
+  * Parses a hexadecimal number.
+  * @param cur Start of the number.
+  * @param end End of the line.
+  * @param value Receives the number.
+  * @return Pointer behind the number or NULL if there are no digits.
+  */
+  char const* parseHex(char const* cur, char const* end, std::uint64_t& value)
+  {
+    char const* const begin = cur;
+    value = 0;
+    for(; cur != end; ++cur)
+    {
+      unsigned int digit;
+      char const c = *cur;
+      if(c >= '0' && c <= '9')
+        digit = c - '0';
+      else if(c >= 'a' && c <= 'f')
+        digit = c - 'a' + 10;
+      else if(c >= 'A' && c <= 'F')
+        digit = c - 'A' + 10;
+      else
+        break;
+
+      value = (value << 4) | digit;
+    }
+
+    return cur != begin ? cur : nullptr;
+  }
+
+  /**
+  * Parses a decimal number.
+  * @param cur Start of the number.
+  * @param end End of the line.
+  * @param value Receives the number.
+  * @return Pointer behind the number or NULL if there are no digits.
+  */
+  char const* parseDec(char const* cur, char const* end, std::uint64_t& value)
+  {
+    char const* const begin = cur;
+    value = 0;
+    for(; cur != end && *cur >= '0' && *cur <= '9'; ++cur)
+      value = value * 10 + (*cur - '0');
+
+    return cur != begin ? cur : nullptr;
+  }
+
+  /**
+  * Skips a single expected character.
+  * @param cur Current position, may be NULL after a failed field.
+  * @param end End of the line.
+  * @param c The expected character.
+  * @return Pointer behind the character or NULL if it doesn't match.
+  */
+  char const* expect(char const* cur, char const* end, char c)
+  {
+    return (cur && cur != end && *cur == c) ? cur + 1 : nullptr;
+  }
+}
 
 /* MemoryRegion class */
 MemoryRegion::MemoryRegion()
-  : m_start(0), m_end(0), m_perms(), m_offset(0), m_devMajor(0),
+  : m_start(0), m_end(0), m_perms(0), m_offset(0), m_devMajor(0),
     m_devMinor(0), m_inode(0), m_path()
+{ }
+
+MemoryRegion::MemoryRegion(std::uintptr_t start, std::uintptr_t end,
+  std::array<char, 4> const& perms, std::uint32_t offset,
+  std::uint16_t devMajor, std::uint16_t devMinor, std::uint32_t inode,
+  std::string const& path)
+  : m_start(start), m_end(end), m_perms(makePermissionMask(perms)),
+    m_offset(offset), m_devMajor(devMajor), m_devMinor(devMinor),
+    m_inode(inode), m_path(path)
+{ }
+
+std::uint8_t MemoryRegion::makePermissionMask(
+  std::array<char, 4> const& perms)
 {
-  std::fill(m_perms.begin(), m_perms.end(), '-');
+  return (perms[0] == 'r' ? kPerm_Read : 0) |
+    (perms[1] == 'w' ? kPerm_Write : 0) |
+    (perms[2] == 'x' ? kPerm_Execute : 0) |
+    (perms[3] == 's' ? kPerm_Shared : 0) |
+    (perms[3] == 'p' ? kPerm_Private : 0);
 }
 
 std::uintptr_t MemoryRegion::getStartAddress() const
@@ -70,30 +171,41 @@ std::size_t MemoryRegion::getSize() const
 
 bool MemoryRegion::isReadable() const
 {
-  return m_perms[kPerm_Read] == 'r';
+  return (m_perms & kPerm_Read) != 0;
 }
 
 bool MemoryRegion::isWriteable() const
 {
-  return m_perms[kPerm_Write] == 'w';
+  return (m_perms & kPerm_Write) != 0;
 }
 
 bool MemoryRegion::isExecuteable() const
 {
-  return m_perms[kPerm_Execute] == 'x';
+  return (m_perms & kPerm_Execute) != 0;
 }
 
 bool MemoryRegion::isShared() const
 {
-  return m_perms[kPerm_Shared] == 's';
+  return (m_perms & kPerm_Shared) != 0;
 }
 
 bool MemoryRegion::isPrivate() const
 {
-  return m_perms[kPerm_Shared] == 'p';
+  return (m_perms & kPerm_Private) != 0;
+}
+
+std::array<char, 4> MemoryRegion::getPermissions() const
+{
+  std::array<char, 4> result = {{
+    (m_perms & kPerm_Read) ? 'r' : '-',
+    (m_perms & kPerm_Write) ? 'w' : '-',
+    (m_perms & kPerm_Execute) ? 'x' : '-',
+    (m_perms & kPerm_Shared) ? 's' : ((m_perms & kPerm_Private) ? 'p' : '-')
+  }};
+  return result;
 }
 
-const std::array<char, 4>& MemoryRegion::getPermissions() const
+std::uint8_t MemoryRegion::getPermissionMask() const
 {
   return m_perms;
 }
@@ -123,6 +235,153 @@ const std::string& MemoryRegion::getPath() const
   return m_path;
 }
 
+/* MapsReader class */
+MapsReader::MapsReader(Process const& process)
+  : m_file(-1), m_buffer(), m_size(0), m_position(0)
+{
+  std::string const path = (process.getProcfsDirectory()/"maps").string();
+  m_file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(m_file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't open maps-file") <<
+      ErrorCode(error));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(g_spareMutex);
+    m_buffer.swap(g_spareBuffer);
+  }
+  if(m_buffer.size() < MAPS_BUFFER_SIZE)
+    m_buffer.resize(MAPS_BUFFER_SIZE);
+
+  try
+  {
+    read();
+  }
+  catch(...)
+  {
+    ::close(m_file);
+    throw;
+  }
+}
+
+MapsReader::~MapsReader()
+{
+  ::close(m_file);
+
+  std::lock_guard<std::mutex> lock(g_spareMutex);
+  if(m_buffer.size() > g_spareBuffer.size())
+    m_buffer.swap(g_spareBuffer);
+}
+
+void MapsReader::read()
+{
+  m_size = 0;
+  m_position = 0;
+  if(::lseek(m_file, 0, SEEK_SET) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't rewind maps-file") <<
+      ErrorCode(error));
+  }
+
+  // The kernel fills as much of the buffer as it can per call, so this is a
+  // single read unless the buffer has to grow.
+  for(;;)
+  {
+    if(m_size == m_buffer.size())
+      m_buffer.resize(m_buffer.size() * 2);
+
+    ssize_t const count = ::read(m_file, &m_buffer[m_size],
+      m_buffer.size() - m_size);
+    if(count == 0)
+      break;
+
+    if(count == -1)
+    {
+      if(errno == EINTR)
+        continue;
+
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("Can't read maps-file") <<
+        ErrorCode(error));
+    }
+
+    m_size += count;
+  }
+}
+
+bool MapsReader::next(MapsEntry& entry)
+{
+  if(m_position >= m_size)
+  {
+    m_position = m_size + 1;
+    return false;
+  }
+
+  char const* const data = &m_buffer[0];
+  char const* const end = data + m_size;
+  char const* cur = data + m_position;
+  char const* eol = static_cast<char const*>(
+    std::memchr(cur, '\n', end - cur));
+  if(!eol)
+    eol = end;
+
+  // Format: start-end perms offset major:minor inode [path]
+  std::uint64_t value;
+  cur = parseHex(cur, eol, value);
+  entry.start = value;
+  cur = expect(cur, eol, '-');
+  if(cur)
+    cur = parseHex(cur, eol, value);
+  entry.end = value;
+  cur = expect(cur, eol, ' ');
+  if(cur && eol - cur >= 4)
+  {
+    std::copy(cur, cur + 4, entry.perms.begin());
+    cur += 4;
+  }
+  else
+    cur = nullptr;
+  cur = expect(cur, eol, ' ');
+  if(cur)
+    cur = parseHex(cur, eol, entry.offset);
+  cur = expect(cur, eol, ' ');
+  if(cur)
+    cur = parseHex(cur, eol, value);
+  entry.devMajor = static_cast<std::uint16_t>(value);
+  cur = expect(cur, eol, ':');
+  if(cur)
+    cur = parseHex(cur, eol, value);
+  entry.devMinor = static_cast<std::uint16_t>(value);
+  cur = expect(cur, eol, ' ');
+  if(cur)
+    cur = parseDec(cur, eol, entry.inode);
+
+  if(!cur)
+  {
+    BOOST_THROW_EXCEPTION(UnexpectedError() <<
+      ErrorString("Malformed line in maps-file"));
+  }
+
+  // The path is the rest of the line and may contain spaces.
+  while(cur != eol && *cur == ' ')
+    ++cur;
+  entry.path = boost::string_ref(cur, eol - cur);
+
+  m_position = (eol - data) + 1;
+  return true;
+}
+
+bool MapsReader::isExhausted() const
+{
+  return m_position > m_size;
+}
+
 /* MemoryRegionIterator class */
 
 MemoryRegionIterator::MemoryRegionIterator()
@@ -131,44 +390,34 @@ MemoryRegionIterator::MemoryRegionIterator()
 
 MemoryRegionIterator::MemoryRegionIterator(Process const& process)
   : m_current(),
-    m_maps(fopen((process.getProcfsDirectory()/"maps").string().c_str(), "r"),
-      std::ptr_fun(&fclose))
+    m_maps(std::make_shared<MapsReader>(process))
 {
-  if(!m_maps)
-  {
-    BOOST_THROW_EXCEPTION(FilesystemError() <<
-      ErrorString("Can't open maps-file"));
-  }
-
   // Set to first entry.
   increment();
 }
 
 bool MemoryRegionIterator::isValid() const
 {
-  return m_maps && !feof(m_maps.get()) && !ferror(m_maps.get());
-}
-
-int MemoryRegionIterator::parse(char const* line)
-{
-  std::array<char, 1024> pathBuffer;
-  pathBuffer[0] = '\0';
-  int result = sscanf(line, "%lx-%lx %4s %x %hx:%hx %u %1024s",
-    &m_current.m_start, &m_current.m_end, &m_current.m_perms[0],
-    &m_current.m_offset, &m_current.m_devMajor, &m_current.m_devMinor,
-    &m_current.m_inode, &pathBuffer[0]);
-
-  m_current.m_path.assign(&pathBuffer[0]);
-  return result;
+  return m_maps && !m_maps->isExhausted();
 }
 
 void MemoryRegionIterator::increment()
 {
   assert(isValid());
 
-  std::array<char, 1152> lineBuffer;
-  if(fgets(&lineBuffer[0], 1152, m_maps.get()))
-    parse(&lineBuffer[0]);
+  MapsEntry entry;
+  if(!m_maps->next(entry))
+    return;
+
+  m_current.m_start = entry.start;
+  m_current.m_end = entry.end;
+  m_current.m_perms = MemoryRegion::makePermissionMask(entry.perms);
+  m_current.m_offset = static_cast<std::uint32_t>(entry.offset);
+  m_current.m_devMajor = entry.devMajor;
+  m_current.m_devMinor = entry.devMinor;
+  m_current.m_inode = static_cast<std::uint32_t>(entry.inode);
+  // Reuses the string's storage for paths up to its capacity.
+  m_current.m_path.assign(entry.path.data(), entry.path.size());
 }
 
 bool MemoryRegionIterator::equal(MemoryRegionIterator const& other) const
@@ -197,9 +446,20 @@ boost::optional<MemoryRegion> Ethon::getMatchingRegion(
     if(cur.getStartAddress() > address)
       break;
       
-    if(address >= cur.getStartAddress() && address <= cur.getEndAddress())
+    // The end address is exclusive.
+    if(address >= cur.getStartAddress() && address < cur.getEndAddress())
       return boost::optional<MemoryRegion>(cur);
   }
   
   return boost::optional<MemoryRegion>();
 }
+
+boost::optional<MemoryRegion> Ethon::getMatchingRegion(
+  RegionMap const& regions, std::uintptr_t address)
+{
+  MemoryRegion const* region = regions.find(address);
+  if(!region)
+    return boost::optional<MemoryRegion>();
+
+  return boost::optional<MemoryRegion>(*region);
+}
@@ -0,0 +1,769 @@
+/*
+MemorySource.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <array>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/Snapshot.hpp>
+#include <Ethon/MemorySource.hpp>
+
+using Ethon::MemorySource;
+using Ethon::ProcessMemorySource;
+using Ethon::RemoteMemorySource;
+using Ethon::MappedMemorySource;
+using Ethon::CoreMemorySource;
+using Ethon::SnapshotMemorySource;
+using Ethon::MemoryEditor;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::Process;
+using Ethon::SystemApiError;
+using Ethon::Scanner;
+using Ethon::Snapshot;
+using Ethon::EthonError;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  std::size_t const PAGE_BYTES = 4096;
+
+  // Layout of a snapshot file: the header, the region records and the
+  // region paths, followed by every region's data at a page aligned offset.
+  char const MAGIC[8] = { 'E', 'T', 'H', 'S', 'N', 'A', 'P', 'F' };
+  std::uint32_t const VERSION = 1;
+
+  struct FileHeader
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t count;          // Number of region records.
+    std::uint64_t stringsOffset;  // Offset of the concatenated paths.
+    std::uint64_t stringsSize;
+  };
+
+  struct RegionRecord
+  {
+    std::uint64_t start;
+    std::uint64_t end;
+    std::uint64_t dataOffset;
+    std::uint64_t dataSize;       // Amount of captured bytes.
+    std::uint32_t fileOffset;
+    std::uint32_t inode;
+    std::uint16_t devMajor;
+    std::uint16_t devMinor;
+    char perms[4];
+    std::uint32_t pathOffset;
+    std::uint32_t pathLength;
+  };
+
+  std::uint64_t alignPage(std::uint64_t value)
+  {
+    return (value + PAGE_BYTES - 1) & ~static_cast<std::uint64_t>(
+      PAGE_BYTES - 1);
+  }
+
+  // Writes a snapshot file for a known set of regions. The file is removed
+  // again unless it is finished.
+  class SnapshotWriter
+  {
+  private:
+    boost::filesystem::path m_path;
+    int m_file;
+    bool m_finished;
+    std::vector<RegionRecord> m_records;
+    std::string m_strings;
+
+    void writeAll(void const* data, std::size_t size, std::uint64_t offset)
+    {
+      std::uint8_t const* bytes = static_cast<std::uint8_t const*>(data);
+      while(size)
+      {
+        ::ssize_t written = ::pwrite(m_file, bytes, size,
+          static_cast< ::off_t>(offset));
+        if(written == -1)
+        {
+          if(errno == EINTR)
+            continue;
+
+          std::error_code const error = Ethon::makeErrorCode();
+          BOOST_THROW_EXCEPTION(FilesystemError() <<
+            ErrorString("Can't write snapshot file") <<
+            ErrorCode(error));
+        }
+
+        bytes += written;
+        size -= written;
+        offset += written;
+      }
+    }
+
+  public:
+    SnapshotWriter(boost::filesystem::path const& path,
+      std::vector<MemoryRegion> const& regions)
+      : m_path(path), m_file(-1), m_finished(false), m_records(),
+        m_strings()
+    {
+      BOOST_FOREACH(MemoryRegion const& cur, regions)
+      {
+        RegionRecord record = RegionRecord();
+        record.start = cur.getStartAddress();
+        record.end = cur.getEndAddress();
+        record.fileOffset = cur.getOffset();
+        record.inode = cur.getInode();
+        record.devMajor = cur.getDeviceMajor();
+        record.devMinor = cur.getDeviceMinor();
+        std::array<char, 4> const perms = cur.getPermissions();
+        std::copy(perms.begin(), perms.end(), record.perms);
+        record.pathOffset = static_cast<std::uint32_t>(m_strings.size());
+        record.pathLength = static_cast<std::uint32_t>(cur.getPath().size());
+        m_strings += cur.getPath();
+        m_records.push_back(record);
+      }
+
+      std::uint64_t offset = alignPage(sizeof(FileHeader) +
+        m_records.size() * sizeof(RegionRecord) + m_strings.size());
+      BOOST_FOREACH(RegionRecord& record, m_records)
+      {
+        record.dataOffset = offset;
+        offset += alignPage(record.end - record.start);
+      }
+
+      m_file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        0644);
+      if(m_file == -1)
+      {
+        std::error_code const error = Ethon::makeErrorCode();
+        BOOST_THROW_EXCEPTION(FilesystemError() <<
+          ErrorString("Can't create snapshot file") <<
+          ErrorCode(error));
+      }
+    }
+
+    ~SnapshotWriter()
+    {
+      ::close(m_file);
+      if(!m_finished)
+        ::unlink(m_path.c_str());
+    }
+
+    // Appends captured data to a region.
+    void append(std::size_t index, std::uint8_t const* data,
+      std::size_t size)
+    {
+      RegionRecord& record = m_records[index];
+      writeAll(data, size, record.dataOffset + record.dataSize);
+      record.dataSize += size;
+    }
+
+    // Writes the tables, the header last.
+    std::uint64_t finish()
+    {
+      std::uint64_t captured = 0;
+      std::uint64_t end = alignPage(sizeof(FileHeader) +
+        m_records.size() * sizeof(RegionRecord) + m_strings.size());
+      BOOST_FOREACH(RegionRecord const& record, m_records)
+      {
+        captured += record.dataSize;
+        end = std::max(end, record.dataOffset + record.dataSize);
+      }
+
+      if(!m_records.empty())
+      {
+        writeAll(&m_records[0], m_records.size() * sizeof(RegionRecord),
+          sizeof(FileHeader));
+      }
+      writeAll(m_strings.data(), m_strings.size(),
+        sizeof(FileHeader) + m_records.size() * sizeof(RegionRecord));
+
+      if(::ftruncate(m_file, static_cast< ::off_t>(end)) == -1)
+      {
+        std::error_code const error = Ethon::makeErrorCode();
+        BOOST_THROW_EXCEPTION(FilesystemError() <<
+          ErrorString("Can't resize snapshot file") <<
+          ErrorCode(error));
+      }
+
+      FileHeader header = FileHeader();
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.count = static_cast<std::uint32_t>(m_records.size());
+      header.stringsOffset = sizeof(FileHeader) +
+        m_records.size() * sizeof(RegionRecord);
+      header.stringsSize = m_strings.size();
+      writeAll(&header, sizeof(header), 0);
+
+      m_finished = true;
+      return captured;
+    }
+  };
+
+  // File mappings of a core, taken from its NT_FILE note.
+  struct FileMapping
+  {
+    std::uint64_t offset;
+    std::string path;
+  };
+
+  void parseFileNote(std::uint8_t const* desc, std::size_t size,
+    std::unordered_map<std::uint64_t, FileMapping>& mappings)
+  {
+    // count, page size, count * (start, end, page offset), count * path
+    if(size < 2 * sizeof(std::uint64_t))
+      return;
+
+    std::uint64_t count, pageSize;
+    std::memcpy(&count, desc, sizeof(count));
+    std::memcpy(&pageSize, desc + sizeof(count), sizeof(pageSize));
+
+    std::size_t const tableSize = 3 * sizeof(std::uint64_t);
+    std::size_t const stringsOffset = 2 * sizeof(std::uint64_t);
+    if(count > (size - stringsOffset) / tableSize)
+      return;
+
+    char const* path = reinterpret_cast<char const*>(desc + stringsOffset +
+      count * tableSize);
+    char const* end = reinterpret_cast<char const*>(desc + size);
+    for(std::uint64_t i = 0; i < count && path < end; ++i)
+    {
+      std::uint64_t entry[3];
+      std::memcpy(entry, desc + stringsOffset + i * tableSize, tableSize);
+
+      char const* terminator = std::find(path, end, '\0');
+      FileMapping mapping;
+      mapping.offset = entry[2] * pageSize;
+      mapping.path.assign(path, terminator);
+      mappings[entry[0]] = mapping;
+
+      path = terminator + 1;
+    }
+  }
+
+  void throwMalformedCore()
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Not a core file of this architecture"));
+  }
+}
+
+/* MemorySource class */
+
+MemorySource::~MemorySource()
+{ }
+
+std::uint8_t const* MemorySource::map(std::uintptr_t /* address */,
+  std::size_t& available)
+{
+  available = 0;
+  return 0;
+}
+
+std::string MemorySource::getExecutable() const
+{
+  return std::string();
+}
+
+/* ProcessMemorySource class */
+
+ProcessMemorySource::ProcessMemorySource(MemoryEditor const& editor)
+  : m_editor(editor)
+{ }
+
+std::vector<MemoryRegion> ProcessMemorySource::getRegions() const
+{
+  // The iterators share their state, so they can't be handed to a range
+  // constructor, which would walk them twice.
+  std::vector<MemoryRegion> regions;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(m_editor.getProcess());
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+    regions.push_back(cur);
+
+  return regions;
+}
+
+std::size_t ProcessMemorySource::read(std::uintptr_t address,
+  std::uint8_t* dest, std::size_t amount)
+{
+  // Trying to read from device memory always results in I/O errors, so I
+  // guess it's best practise to catch them here.
+  try
+  {
+    return m_editor.read(address, dest, amount);
+  }
+  catch(EthonError const& e)
+  {
+    std::error_code const* errorCode =
+      boost::get_error_info<Ethon::ErrorCode>(e);
+    if(errorCode && errorCode->value() == EIO)
+      return 0;
+
+    // Another error occurred, rethrow.
+    throw;
+  }
+}
+
+std::string ProcessMemorySource::getExecutable() const
+{
+  try
+  {
+    return m_editor.getProcess().getExecutablePath().string();
+  }
+  catch(EthonError const&)
+  {
+    return std::string();
+  }
+}
+
+MemoryEditor const& ProcessMemorySource::getEditor() const
+{
+  return m_editor;
+}
+
+/* RemoteMemorySource class */
+
+RemoteMemorySource::RemoteMemorySource(Process const& process)
+  : m_process(process)
+{ }
+
+std::vector<MemoryRegion> RemoteMemorySource::getRegions() const
+{
+  std::vector<MemoryRegion> regions;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(m_process);
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+    regions.push_back(cur);
+
+  return regions;
+}
+
+std::size_t RemoteMemorySource::read(std::uintptr_t address,
+  std::uint8_t* dest, std::size_t amount)
+{
+  ::iovec local = { dest, amount };
+  ::iovec remote = { reinterpret_cast<void*>(address), amount };
+  ::ssize_t count = ::process_vm_readv(m_process.getPid(), &local, 1,
+    &remote, 1, 0);
+  if(count == -1)
+  {
+    // Unmapped or device memory and processes which exited meanwhile.
+    if(errno == EFAULT || errno == EIO || errno == ESRCH)
+      return 0;
+
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(SystemApiError() <<
+      ErrorString("process_vm_readv failed reading from address.") <<
+      ErrorCode(error));
+  }
+
+  return count;
+}
+
+std::string RemoteMemorySource::getExecutable() const
+{
+  try
+  {
+    return m_process.getExecutablePath().string();
+  }
+  catch(EthonError const&)
+  {
+    return std::string();
+  }
+}
+
+Process const& RemoteMemorySource::getProcess() const
+{
+  return m_process;
+}
+
+/* MappedMemorySource class */
+
+MappedMemorySource::MappedMemorySource(boost::filesystem::path const& path)
+  : m_data(0), m_size(0), m_segments()
+{
+  int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't open memory capture") <<
+      ErrorCode(error));
+  }
+
+  struct stat info;
+  if(::fstat(file, &info) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    ::close(file);
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't stat memory capture") <<
+      ErrorCode(error));
+  }
+
+  std::size_t size = static_cast<std::size_t>(info.st_size);
+  if(!size)
+  {
+    ::close(file);
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Memory capture is empty"));
+  }
+
+  // The mapping outlives the descriptor.
+  void* map = ::mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0);
+  std::error_code const error = Ethon::makeErrorCode();
+  ::close(file);
+  if(map == MAP_FAILED)
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't map memory capture") <<
+      ErrorCode(error));
+  }
+
+  // Scans walk the capture front to back.
+  ::madvise(map, size, MADV_SEQUENTIAL);
+
+  m_data = static_cast<std::uint8_t const*>(map);
+  m_size = size;
+}
+
+MappedMemorySource::~MappedMemorySource()
+{
+  ::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+}
+
+void MappedMemorySource::addSegment(MemoryRegion const& region,
+  std::uint64_t offset, std::uint64_t size)
+{
+  Segment segment = { region, offset, 0 };
+  if(offset <= m_size)
+  {
+    segment.size = std::min<std::uint64_t>(std::min<std::uint64_t>(size,
+      region.getSize()), m_size - offset);
+  }
+
+  m_segments.push_back(segment);
+}
+
+void MappedMemorySource::sortSegments()
+{
+  std::sort(m_segments.begin(), m_segments.end(),
+    [](Segment const& lhs, Segment const& rhs)
+    {
+      return lhs.region.getStartAddress() < rhs.region.getStartAddress();
+    });
+}
+
+std::vector<MemoryRegion> MappedMemorySource::getRegions() const
+{
+  std::vector<MemoryRegion> regions;
+  regions.reserve(m_segments.size());
+  BOOST_FOREACH(Segment const& cur, m_segments)
+    regions.push_back(cur.region);
+
+  return regions;
+}
+
+std::size_t MappedMemorySource::read(std::uintptr_t address,
+  std::uint8_t* dest, std::size_t amount)
+{
+  std::size_t done = 0;
+  while(done < amount)
+  {
+    std::size_t available;
+    std::uint8_t const* data = map(address + done, available);
+    if(!data)
+      break;
+
+    std::size_t count = std::min(available, amount - done);
+    std::memcpy(dest + done, data, count);
+    done += count;
+  }
+
+  return done;
+}
+
+std::uint8_t const* MappedMemorySource::map(std::uintptr_t address,
+  std::size_t& available)
+{
+  available = 0;
+
+  auto next = std::upper_bound(m_segments.begin(), m_segments.end(),
+    address, [](std::uintptr_t lhs, Segment const& rhs)
+    {
+      return lhs < rhs.region.getStartAddress();
+    });
+  if(next == m_segments.begin())
+    return 0;
+
+  Segment const& segment = *(next - 1);
+  std::uint64_t offset = address - segment.region.getStartAddress();
+  if(offset >= segment.size)
+    return 0;
+
+  available = static_cast<std::size_t>(segment.size - offset);
+  return m_data + segment.offset + offset;
+}
+
+/* CoreMemorySource class */
+
+CoreMemorySource::CoreMemorySource(boost::filesystem::path const& path)
+  : MappedMemorySource(path)
+{
+  Elf64_Ehdr header;
+  if(m_size < sizeof(header))
+    throwMalformedCore();
+  std::memcpy(&header, m_data, sizeof(header));
+
+  if(std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+    header.e_ident[EI_CLASS] != ELFCLASS64 ||
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    header.e_ident[EI_DATA] != ELFDATA2LSB ||
+#else
+    header.e_ident[EI_DATA] != ELFDATA2MSB ||
+#endif
+    header.e_type != ET_CORE || header.e_phentsize != sizeof(Elf64_Phdr))
+  {
+    throwMalformedCore();
+  }
+
+  // Cores with too many segments keep the real count in section 0.
+  std::uint64_t count = header.e_phnum;
+  if(count == PN_XNUM)
+  {
+    Elf64_Shdr section;
+    if(header.e_shoff > m_size || m_size - header.e_shoff < sizeof(section))
+      throwMalformedCore();
+    std::memcpy(&section, m_data + header.e_shoff, sizeof(section));
+    count = section.sh_info;
+  }
+
+  if(header.e_phoff > m_size ||
+    (m_size - header.e_phoff) / sizeof(Elf64_Phdr) < count)
+  {
+    throwMalformedCore();
+  }
+
+  std::vector<Elf64_Phdr> programHeaders(count);
+  if(count)
+  {
+    std::memcpy(&programHeaders[0], m_data + header.e_phoff,
+      count * sizeof(Elf64_Phdr));
+  }
+
+  std::unordered_map<std::uint64_t, FileMapping> mappings;
+  BOOST_FOREACH(Elf64_Phdr const& cur, programHeaders)
+  {
+    if(cur.p_type != PT_NOTE || cur.p_offset > m_size ||
+      cur.p_filesz > m_size - cur.p_offset)
+    {
+      continue;
+    }
+
+    std::uint8_t const* notes = m_data + cur.p_offset;
+    for(std::size_t pos = 0; pos + sizeof(Elf64_Nhdr) <= cur.p_filesz; )
+    {
+      Elf64_Nhdr note;
+      std::memcpy(&note, notes + pos, sizeof(note));
+      std::size_t desc = pos + sizeof(note) + ((note.n_namesz + 3) & ~3u);
+      std::size_t next = desc + ((note.n_descsz + 3) & ~3u);
+      if(next > cur.p_filesz || next <= pos)
+        break;
+
+      if(note.n_type == NT_FILE)
+        parseFileNote(notes + desc, note.n_descsz, mappings);
+      pos = next;
+    }
+  }
+
+  BOOST_FOREACH(Elf64_Phdr const& cur, programHeaders)
+  {
+    if(cur.p_type != PT_LOAD || !cur.p_memsz)
+      continue;
+
+    std::array<char, 4> perms = { {
+      (cur.p_flags & PF_R) ? 'r' : '-',
+      (cur.p_flags & PF_W) ? 'w' : '-',
+      (cur.p_flags & PF_X) ? 'x' : '-',
+      'p' } };
+
+    auto mapping = mappings.find(cur.p_vaddr);
+    MemoryRegion region = mapping == mappings.end() ?
+      MemoryRegion(cur.p_vaddr, cur.p_vaddr + cur.p_memsz, perms) :
+      MemoryRegion(cur.p_vaddr, cur.p_vaddr + cur.p_memsz, perms,
+        static_cast<std::uint32_t>(mapping->second.offset), 0, 0, 0,
+        mapping->second.path);
+
+    addSegment(region, cur.p_offset, cur.p_filesz);
+  }
+
+  sortSegments();
+}
+
+/* SnapshotMemorySource class */
+
+SnapshotMemorySource::SnapshotMemorySource(
+  boost::filesystem::path const& path)
+  : MappedMemorySource(path)
+{
+  FileHeader header;
+  if(m_size < sizeof(header))
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Not a snapshot file"));
+  }
+  std::memcpy(&header, m_data, sizeof(header));
+
+  if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+    header.version != VERSION ||
+    (m_size - sizeof(header)) / sizeof(RegionRecord) < header.count ||
+    header.stringsOffset > m_size ||
+    header.stringsSize > m_size - header.stringsOffset)
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Not a snapshot file"));
+  }
+
+  char const* strings = reinterpret_cast<char const*>(m_data +
+    header.stringsOffset);
+  for(std::uint32_t i = 0; i < header.count; ++i)
+  {
+    RegionRecord record;
+    std::memcpy(&record, m_data + sizeof(header) + i * sizeof(record),
+      sizeof(record));
+    if(record.end < record.start ||
+      record.pathOffset > header.stringsSize ||
+      record.pathLength > header.stringsSize - record.pathOffset)
+    {
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("Corrupted snapshot file"));
+    }
+
+    std::array<char, 4> perms;
+    std::copy(record.perms, record.perms + 4, perms.begin());
+    addSegment(MemoryRegion(record.start, record.end, perms,
+      record.fileOffset, record.devMajor, record.devMinor, record.inode,
+      std::string(strings + record.pathOffset, record.pathLength)),
+      record.dataOffset, record.dataSize);
+  }
+
+  sortSegments();
+}
+
+std::uint64_t SnapshotMemorySource::save(MemoryEditor const& editor,
+  boost::filesystem::path const& path, RegionFilter const& filter)
+{
+  std::vector<MemoryRegion> regions;
+  BOOST_FOREACH(MemoryRegion const& cur, Scanner(editor).selectRegions(filter))
+  {
+    if(cur.isReadable())
+      regions.push_back(cur);
+  }
+
+  SnapshotWriter writer(path, regions);
+  ProcessMemorySource source(editor);
+  std::vector<std::uint8_t> buffer(Scanner::CHUNK_SIZE);
+  for(std::size_t i = 0; i < regions.size(); ++i)
+  {
+    for(std::uintptr_t address = regions[i].getStartAddress();
+      address < regions[i].getEndAddress(); )
+    {
+      std::size_t amount = std::min<std::size_t>(buffer.size(),
+        regions[i].getEndAddress() - address);
+      std::size_t read = source.read(address, &buffer[0], amount);
+      writer.append(i, &buffer[0], read);
+
+      // The rest of a region which could not be read is not captured.
+      if(read != amount)
+        break;
+      address += read;
+    }
+  }
+
+  return writer.finish();
+}
+
+std::uint64_t SnapshotMemorySource::save(Snapshot const& snapshot,
+  boost::filesystem::path const& path)
+{
+  std::vector<Snapshot::Page> const& pages = snapshot.getPages();
+  std::vector<MemoryRegion> const& captured = snapshot.getRegions();
+
+  // Consecutive pages of the same captured region form a region, keeping
+  // the permissions it had.
+  std::vector<MemoryRegion> regions;
+  std::size_t source = 0;
+  for(std::size_t i = 0; i < pages.size(); )
+  {
+    while(captured[source].getEndAddress() <= pages[i].address)
+      ++source;
+
+    std::size_t j = i + 1;
+    while(j < pages.size() &&
+      pages[j].address == pages[j - 1].address + Snapshot::PAGE_BYTES &&
+      pages[j].address < captured[source].getEndAddress())
+    {
+      ++j;
+    }
+
+    regions.push_back(MemoryRegion(pages[i].address,
+      pages[j - 1].address + Snapshot::PAGE_BYTES,
+      captured[source].getPermissions()));
+    i = j;
+  }
+
+  SnapshotWriter writer(path, regions);
+  std::vector<std::uint8_t> buffer(Snapshot::PAGE_BYTES);
+  for(std::size_t i = 0, page = 0; i < regions.size(); ++i)
+  {
+    for(; page < pages.size() &&
+      pages[page].address < regions[i].getEndAddress(); ++page)
+    {
+      snapshot.loadPage(page, &buffer[0]);
+      writer.append(i, &buffer[0], buffer.size());
+    }
+  }
+
+  return writer.finish();
+}
@@ -0,0 +1,210 @@
+/*
+ModuleMap.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+#include <boost/utility/string_ref.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/ModuleMap.hpp>
+
+using Ethon::ModuleMap;
+using Ethon::Module;
+using Ethon::ModuleSegment;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::Process;
+using Ethon::ArgumentError;
+
+namespace
+{
+  // Checks if a region belongs to a loaded image.
+  bool isImage(MemoryRegion const& region)
+  {
+    return (region.getInode() && !region.getPath().empty()) ||
+      region.getPath() == "[vdso]";
+  }
+}
+
+/* ModuleMap class */
+
+std::size_t ModuleMap::NameHash::operator()(boost::string_ref value) const
+{
+  // FNV-1a
+  std::uint64_t hash = 0xCBF29CE484222325ULL;
+  BOOST_FOREACH(char cur, value)
+  {
+    hash ^= static_cast<unsigned char>(cur);
+    hash *= 0x100000001B3ULL;
+  }
+  return static_cast<std::size_t>(hash);
+}
+
+ModuleMap::ModuleMap(Process const& process)
+  : m_process(process), m_paths(), m_modules(), m_bases(), m_byPath(),
+    m_byName(), m_last(0)
+{
+  refresh();
+}
+
+void ModuleMap::refresh()
+{
+  m_modules.clear();
+  m_bases.clear();
+  m_byPath.clear();
+  m_byName.clear();
+  m_last = 0;
+
+  bool consecutive = false;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(m_process);
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+  {
+    if(!isImage(cur))
+    {
+      consecutive = false;
+      continue;
+    }
+
+    ModuleSegment const segment = { cur.getStartAddress(),
+      cur.getEndAddress(), cur.getPermissions(), cur.getOffset() };
+
+    if(consecutive)
+    {
+      Module& last = m_modules.back();
+      if(last.inode == cur.getInode() && last.devMajor == cur.getDeviceMajor()
+        && last.devMinor == cur.getDeviceMinor() &&
+        *last.path == cur.getPath())
+      {
+        last.segments.push_back(segment);
+        last.end = segment.end;
+        continue;
+      }
+    }
+
+    // Paths are interned once and kept across refreshes.
+    std::string const& path = *m_paths.insert(cur.getPath()).first;
+    std::size_t const slash = path.rfind('/');
+    boost::string_ref name(path);
+    if(slash != std::string::npos)
+      name = name.substr(slash + 1);
+
+    Module module = { &path, name, segment.start, segment.end,
+      cur.getDeviceMajor(), cur.getDeviceMinor(), cur.getInode(),
+      std::vector<ModuleSegment>(1, segment) };
+    m_modules.push_back(module);
+    consecutive = true;
+  }
+
+  // The kernel lists regions in order, so the modules already are sorted
+  // and the first module inserted for a name is the lowest one.
+  m_bases.reserve(m_modules.size());
+  for(std::size_t i = 0; i < m_modules.size(); ++i)
+  {
+    Module const& cur = m_modules[i];
+    m_bases.push_back(cur.base);
+    m_byPath.insert(std::make_pair(boost::string_ref(*cur.path), i));
+    m_byName.insert(std::make_pair(cur.name, i));
+  }
+}
+
+Process const& ModuleMap::getProcess() const
+{
+  return m_process;
+}
+
+std::vector<Module> const& ModuleMap::getModules() const
+{
+  return m_modules;
+}
+
+Module const* ModuleMap::findByPath(boost::string_ref path) const
+{
+  NameIndex::const_iterator it = m_byPath.find(path);
+  return it != m_byPath.end() ? &m_modules[it->second] : 0;
+}
+
+Module const* ModuleMap::findByName(boost::string_ref name) const
+{
+  NameIndex::const_iterator it = m_byName.find(name);
+  return it != m_byName.end() ? &m_modules[it->second] : 0;
+}
+
+Module const* ModuleMap::find(boost::string_ref module) const
+{
+  if(module.find('/') != boost::string_ref::npos)
+    return findByPath(module);
+  return findByName(module);
+}
+
+Module const* ModuleMap::find(std::uintptr_t address) const
+{
+  if(m_modules.empty())
+    return 0;
+
+  // Lookups tend to hit the same module repeatedly.
+  std::size_t index = m_last;
+  Module const* module = &m_modules[index];
+  if(address < module->base || address >= module->end)
+  {
+    std::vector<std::uintptr_t>::const_iterator it = std::upper_bound(
+      m_bases.begin(), m_bases.end(), address);
+    if(it == m_bases.begin())
+      return 0;
+
+    index = it - m_bases.begin() - 1;
+    module = &m_modules[index];
+    if(address >= module->end)
+      return 0;
+  }
+
+  BOOST_FOREACH(ModuleSegment const& cur, module->segments)
+  {
+    if(address >= cur.start && address < cur.end)
+    {
+      m_last = index;
+      return module;
+    }
+  }
+
+  return 0;
+}
+
+std::uintptr_t ModuleMap::resolve(boost::string_ref module,
+  std::uintptr_t offset) const
+{
+  Module const* found = find(module);
+  if(!found)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Module '" + module.to_string() + "' is not mapped"));
+  }
+
+  return found->base + offset;
+}
@@ -0,0 +1,871 @@
+/*
+PointerScanner.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/PointerScanner.hpp>
+
+using Ethon::PointerPath;
+using Ethon::PointerScanOptions;
+using Ethon::PointerMap;
+using Ethon::PointerScanner;
+using Ethon::MemoryEditor;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::ScanContext;
+using Ethon::EthonError;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+// Amount of bytes read from the process at once.
+static std::size_t const READ_SIZE = 1024 * 1024;
+
+// Amount of entries buffered per run while merging.
+static std::size_t const MERGE_BUFFER = 64 * 1024;
+
+typedef PointerMap::Entry Entry;
+
+// Orders entries by the address pointed to, then by their own address.
+struct EntryLess
+{
+  bool operator()(Entry const& lhs, Entry const& rhs) const
+  {
+    return lhs.value < rhs.value ||
+      (lhs.value == rhs.value && lhs.address < rhs.address);
+  }
+};
+
+static std::size_t getThreadCount(PointerScanOptions const& options)
+{
+  if(options.threads)
+    return options.threads;
+
+  std::size_t cores = std::thread::hardware_concurrency();
+  return cores ? cores : 1;
+}
+
+static std::vector<MemoryRegion> getRegions(Ethon::Process const& process)
+{
+  std::vector<MemoryRegion> regions;
+  MemoryRegionSequence seq = Ethon::makeMemoryRegionSequence(process);
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+    regions.push_back(cur);
+
+  return regions;
+}
+
+static void writeAll(int file, void const* data, std::size_t size)
+{
+  char const* source = static_cast<char const*>(data);
+  while(size)
+  {
+    ::ssize_t count = ::write(file, source, size);
+    if(count == -1)
+    {
+      if(errno == EINTR)
+        continue;
+
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("write failed spilling pointer map") <<
+        ErrorCode(error));
+    }
+
+    source += count;
+    size -= count;
+  }
+}
+
+// Creates an unlinked file inside a directory, closed once unreferenced.
+static std::shared_ptr<int> createSpillFile(
+  boost::filesystem::path const& directory)
+{
+  boost::filesystem::path dir = directory.empty() ?
+    boost::filesystem::temp_directory_path() : directory;
+  std::string tmpl = (dir / "ethonmem-pointers-XXXXXX").string();
+
+  int file = ::mkstemp(&tmpl[0]);
+  if(file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't create spill file") <<
+      ErrorCode(error));
+  }
+
+  ::unlink(tmpl.c_str());
+  return std::shared_ptr<int>(new int(file),
+    [](int* cur) { ::close(*cur); delete cur; });
+}
+
+namespace
+{
+  // A sorted run of entries, either in memory or spilled to a file.
+  struct Run
+  {
+    std::shared_ptr<int> file;
+    std::uint64_t size;
+    std::vector<Entry> entries;
+  };
+
+  // Reads a spilled run sequentially.
+  class RunReader
+  {
+  private:
+    Run const* m_run;
+    std::vector<Entry> m_buffer;
+    std::uint64_t m_consumed;
+    std::size_t m_position;
+
+  public:
+    explicit RunReader(Run const& run)
+      : m_run(&run), m_buffer(), m_consumed(0), m_position(0)
+    {
+      fill();
+    }
+
+    void fill()
+    {
+      std::uint64_t remaining = m_run->size - m_consumed;
+      m_buffer.resize(std::min<std::uint64_t>(remaining, MERGE_BUFFER));
+      m_position = 0;
+      if(m_buffer.empty())
+        return;
+
+      std::size_t bytes = m_buffer.size() * sizeof(Entry);
+      char* dest = reinterpret_cast<char*>(&m_buffer[0]);
+      for(std::size_t done = 0; done < bytes; )
+      {
+        ::ssize_t count = ::pread(*m_run->file, dest + done, bytes - done,
+          m_consumed * sizeof(Entry) + done);
+        if(count <= 0)
+        {
+          std::error_code const error = Ethon::makeErrorCode();
+          BOOST_THROW_EXCEPTION(FilesystemError() <<
+            ErrorString("pread failed reading spilled pointers") <<
+            ErrorCode(error));
+        }
+        done += count;
+      }
+
+      m_consumed += m_buffer.size();
+    }
+
+    bool empty() const
+    {
+      return m_position == m_buffer.size();
+    }
+
+    Entry const& top() const
+    {
+      return m_buffer[m_position];
+    }
+
+    void pop()
+    {
+      if(++m_position == m_buffer.size())
+        fill();
+    }
+  };
+
+  // Collects entries of one thread and spills sorted runs when full.
+  class RunWriter
+  {
+  private:
+    std::vector<Entry> m_entries;
+    std::size_t m_limit;
+    boost::filesystem::path m_directory;
+    std::vector<Run>& m_runs;
+    std::mutex& m_mutex;
+
+  public:
+    RunWriter(std::size_t limit, boost::filesystem::path const& directory,
+      std::vector<Run>& runs, std::mutex& mutex)
+      : m_entries(), m_limit(std::max<std::size_t>(limit, 1024)),
+        m_directory(directory), m_runs(runs), m_mutex(mutex)
+    { }
+
+    void add(std::uint64_t value, std::uint64_t address)
+    {
+      Entry entry = { value, address };
+      m_entries.push_back(entry);
+      if(m_entries.size() >= m_limit)
+        spill();
+    }
+
+    void spill()
+    {
+      if(m_entries.empty())
+        return;
+
+      std::sort(m_entries.begin(), m_entries.end(), EntryLess());
+      Run run;
+      run.file = createSpillFile(m_directory);
+      writeAll(*run.file, &m_entries[0], m_entries.size() * sizeof(Entry));
+      run.size = m_entries.size();
+      m_entries.clear();
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_runs.push_back(run);
+    }
+
+    // Hands the remaining entries over as an in-memory run.
+    void finish()
+    {
+      std::sort(m_entries.begin(), m_entries.end(), EntryLess());
+      Run run;
+      run.size = m_entries.size();
+      run.entries.swap(m_entries);
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_runs.push_back(run);
+    }
+  };
+
+  // A pointer at from leading to to after adding offset.
+  struct PathEdge
+  {
+    std::uintptr_t from;
+    std::uintptr_t to;
+    std::ptrdiff_t offset;
+  };
+
+  // Checks whether values point into mapped memory.
+  class TargetRanges
+  {
+  private:
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> m_ranges;
+    std::uint64_t m_low;
+    std::uint64_t m_high;
+
+  public:
+    explicit TargetRanges(std::vector<MemoryRegion> const& regions)
+      : m_ranges(), m_low(~std::uint64_t(0)), m_high(0)
+    {
+      BOOST_FOREACH(MemoryRegion const& cur, regions)
+      {
+        if(!cur.isReadable())
+          continue;
+
+        // Merge adjacent regions.
+        if(!m_ranges.empty() && m_ranges.back().second ==
+          cur.getStartAddress())
+        {
+          m_ranges.back().second = cur.getEndAddress();
+        }
+        else
+        {
+          m_ranges.push_back(std::make_pair(cur.getStartAddress(),
+            cur.getEndAddress()));
+        }
+      }
+
+      if(!m_ranges.empty())
+      {
+        m_low = m_ranges.front().first;
+        m_high = m_ranges.back().second;
+      }
+    }
+
+    bool contains(std::uint64_t value) const
+    {
+      if(value < m_low || value >= m_high)
+        return false;
+
+      auto itr = std::upper_bound(m_ranges.begin(), m_ranges.end(),
+        std::make_pair(value, ~std::uint64_t(0)));
+      return itr != m_ranges.begin() && value < (itr - 1)->second;
+    }
+  };
+
+  template<typename POINTER>
+  void collectPointers(std::uint8_t const* data, std::size_t size,
+    std::uintptr_t address, TargetRanges const& targets, RunWriter& writer)
+  {
+    for(std::size_t i = 0; i + sizeof(POINTER) <= size;
+      i += sizeof(POINTER))
+    {
+      POINTER value;
+      std::memcpy(&value, data + i, sizeof(value));
+      if(targets.contains(value))
+        writer.add(value, address + i);
+    }
+  }
+}
+
+/* PointerScanOptions struct */
+
+PointerScanOptions::PointerScanOptions()
+  : maxDepth(5), maxOffset(0x1000), maxResults(10000), maxNodes(1 << 24),
+    threads(0), memoryLimit(512 * 1024 * 1024), spillDirectory()
+{ }
+
+/* PointerMap class */
+
+PointerMap::PointerMap()
+  : m_entries(), m_begin(0), m_end(0), m_mapping(0), m_mappingSize(0)
+{ }
+
+PointerMap::~PointerMap()
+{
+  reset();
+}
+
+void PointerMap::reset()
+{
+  if(m_mapping)
+    ::munmap(m_mapping, m_mappingSize);
+
+  m_mapping = 0;
+  m_mappingSize = 0;
+  std::vector<Entry>().swap(m_entries);
+  m_begin = m_end = 0;
+}
+
+std::size_t PointerMap::build(MemoryEditor const& editor,
+  PointerScanOptions const& options, ScanContext const& context)
+{
+  reset();
+
+  std::vector<MemoryRegion> const regions = getRegions(editor.getProcess());
+  TargetRanges const targets(regions);
+  bool const wide = Ethon::getProcessImageBits(editor.getProcess()) == 64;
+
+  // Pointers are stored in writeable memory only.
+  std::vector<MemoryRegion> sources;
+  std::uint64_t scanSize = 0;
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(cur.isReadable() && cur.isWriteable())
+    {
+      sources.push_back(cur);
+      scanSize += cur.getSize();
+    }
+  }
+
+  ScanContext::Scope scope(context, scanSize);
+
+  std::size_t const threadCount = getThreadCount(options);
+  std::size_t const perThread = options.memoryLimit / sizeof(Entry) /
+    threadCount;
+
+  std::vector<Run> runs;
+  std::mutex mutex;
+  std::atomic<std::size_t> next(0);
+  std::vector<std::exception_ptr> errors(threadCount);
+
+  auto worker = [&](std::size_t index)
+  {
+    try
+    {
+      MemoryEditor reader(editor);
+      RunWriter writer(perThread, options.spillDirectory, runs, mutex);
+      std::vector<std::uint8_t> buffer(READ_SIZE);
+
+      for(std::size_t i = next++; i < sources.size(); i = next++)
+      {
+        MemoryRegion const& region = sources[i];
+        for(std::uintptr_t address = region.getStartAddress();
+          address < region.getEndAddress(); address += READ_SIZE)
+        {
+          context.check();
+
+          std::size_t amount = std::min<std::size_t>(READ_SIZE,
+            region.getEndAddress() - address);
+
+          std::size_t read = 0;
+          try
+          {
+            read = reader.read(address, &buffer[0], amount);
+          }
+          catch(EthonError const&)
+          {
+            // The region is not readable (anymore), skip it.
+          }
+
+          if(wide)
+          {
+            collectPointers<std::uint64_t>(&buffer[0], read, address,
+              targets, writer);
+          }
+          else
+          {
+            collectPointers<std::uint32_t>(&buffer[0], read, address,
+              targets, writer);
+          }
+
+          if(read != amount)
+          {
+            context.advance(region.getEndAddress() - address);
+            break;
+          }
+
+          context.advance(amount);
+        }
+      }
+
+      writer.finish();
+    }
+    catch(...)
+    {
+      errors[index] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < threadCount; ++i)
+    threads.push_back(std::thread(worker, i));
+  BOOST_FOREACH(std::thread& cur, threads)
+    cur.join();
+
+  BOOST_FOREACH(std::exception_ptr const& cur, errors)
+  {
+    if(cur)
+      std::rethrow_exception(cur);
+  }
+
+  bool spilled = false;
+  std::uint64_t total = 0;
+  BOOST_FOREACH(Run const& cur, runs)
+  {
+    spilled = spilled || cur.file;
+    total += cur.size;
+  }
+
+  if(!spilled)
+  {
+    // Everything fits into memory, merge the runs in place.
+    m_entries.reserve(total);
+    BOOST_FOREACH(Run const& cur, runs)
+    {
+      std::size_t middle = m_entries.size();
+      m_entries.insert(m_entries.end(), cur.entries.begin(),
+        cur.entries.end());
+      std::inplace_merge(m_entries.begin(), m_entries.begin() + middle,
+        m_entries.end(), EntryLess());
+    }
+
+    m_begin = m_entries.empty() ? 0 : &m_entries[0];
+    m_end = m_begin + m_entries.size();
+    return getSize();
+  }
+
+  // Spill runs which were finished in memory by threads which did not spill
+  // themselves, then merge all runs into one file.
+  BOOST_FOREACH(Run& cur, runs)
+  {
+    if(cur.file)
+      continue;
+
+    cur.file = createSpillFile(options.spillDirectory);
+    if(!cur.entries.empty())
+    {
+      writeAll(*cur.file, &cur.entries[0],
+        cur.entries.size() * sizeof(Entry));
+    }
+    std::vector<Entry>().swap(cur.entries);
+  }
+
+  std::shared_ptr<int> merged = createSpillFile(options.spillDirectory);
+
+  std::vector<RunReader> readers;
+  BOOST_FOREACH(Run const& cur, runs)
+    readers.push_back(RunReader(cur));
+
+  std::vector<Entry> output;
+  output.reserve(MERGE_BUFFER);
+  auto greater = [&](std::size_t lhs, std::size_t rhs)
+  {
+    return EntryLess()(readers[rhs].top(), readers[lhs].top());
+  };
+
+  std::vector<std::size_t> heap;
+  for(std::size_t i = 0; i < readers.size(); ++i)
+  {
+    if(!readers[i].empty())
+      heap.push_back(i);
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+
+  while(!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    RunReader& reader = readers[heap.back()];
+    output.push_back(reader.top());
+    reader.pop();
+
+    if(reader.empty())
+      heap.pop_back();
+    else
+      std::push_heap(heap.begin(), heap.end(), greater);
+
+    if(output.size() == MERGE_BUFFER)
+    {
+      writeAll(*merged, &output[0], output.size() * sizeof(Entry));
+      output.clear();
+    }
+  }
+
+  if(!output.empty())
+    writeAll(*merged, &output[0], output.size() * sizeof(Entry));
+  runs.clear();
+
+  if(total)
+  {
+    m_mappingSize = total * sizeof(Entry);
+    m_mapping = ::mmap(0, m_mappingSize, PROT_READ, MAP_SHARED, *merged, 0);
+    if(m_mapping == MAP_FAILED)
+    {
+      m_mapping = 0;
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("mmap failed mapping pointer map") <<
+        ErrorCode(error));
+    }
+
+    m_begin = static_cast<Entry const*>(m_mapping);
+    m_end = m_begin + total;
+  }
+
+  return getSize();
+}
+
+std::pair<Entry const*, Entry const*> PointerMap::findRange(
+  std::uint64_t low, std::uint64_t high) const
+{
+  Entry const lowest = { low, 0 };
+  Entry const highest = { high, ~std::uint64_t(0) };
+  return std::make_pair(std::lower_bound(m_begin, m_end, lowest, EntryLess()),
+    std::upper_bound(m_begin, m_end, highest, EntryLess()));
+}
+
+std::size_t PointerMap::getSize() const
+{
+  return m_end - m_begin;
+}
+
+Entry const* PointerMap::begin() const
+{
+  return m_begin;
+}
+
+Entry const* PointerMap::end() const
+{
+  return m_end;
+}
+
+/* PointerScanner class */
+
+PointerScanner::PointerScanner(MemoryEditor const& editor,
+  PointerScanOptions const& options)
+  : m_editor(editor), m_options(options), m_context(), m_map(),
+    m_modules(), m_static()
+{ }
+
+void PointerScanner::setContext(ScanContext const& context)
+{
+  m_context = context;
+}
+
+ScanContext const& PointerScanner::getContext() const
+{
+  return m_context;
+}
+
+std::size_t PointerScanner::buildMap()
+{
+  m_modules.clear();
+  m_static.clear();
+
+  // The base of a module is the start of its first mapping.
+  std::vector<MemoryRegion> regions = getRegions(m_editor.getProcess());
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    std::string const& path = cur.getPath();
+    if(path.empty() || path[0] != '/')
+      continue;
+
+    std::size_t module = 0;
+    while(module < m_modules.size() && m_modules[module].path != path)
+      ++module;
+
+    if(module == m_modules.size())
+    {
+      Module entry = { path, cur.getStartAddress() };
+      m_modules.push_back(entry);
+    }
+
+    // Static pointers live in the module's writeable mappings. The
+    // anonymous mapping directly following them holds .bss.
+    if(cur.isWriteable())
+    {
+      StaticRange range = { cur.getStartAddress(), cur.getEndAddress(),
+        module };
+      m_static.push_back(range);
+    }
+  }
+
+  for(std::size_t i = 0; i + 1 < regions.size(); ++i)
+  {
+    MemoryRegion const& cur = regions[i + 1];
+    if(!cur.getPath().empty() || !cur.isWriteable() || m_static.empty())
+      continue;
+
+    StaticRange const* previous = findStatic(cur.getStartAddress() - 1);
+    if(previous && previous->end == cur.getStartAddress())
+    {
+      StaticRange range = { cur.getStartAddress(), cur.getEndAddress(),
+        previous->module };
+      m_static.push_back(range);
+      std::sort(m_static.begin(), m_static.end(),
+        [](StaticRange const& lhs, StaticRange const& rhs)
+        { return lhs.start < rhs.start; });
+    }
+  }
+
+  return m_map.build(m_editor, m_options, m_context);
+}
+
+PointerScanner::StaticRange const* PointerScanner::findStatic(
+  std::uintptr_t address) const
+{
+  auto itr = std::upper_bound(m_static.begin(), m_static.end(), address,
+    [](std::uintptr_t lhs, StaticRange const& rhs)
+    { return lhs < rhs.start; });
+  if(itr == m_static.begin() || address >= (itr - 1)->end)
+    return 0;
+
+  return &*(itr - 1);
+}
+
+std::vector<PointerPath> PointerScanner::findPaths(std::uintptr_t target)
+  const
+{
+  std::vector<PointerPath> results;
+  if(!m_options.maxDepth)
+    return results;
+
+  // Breadth first search from the target backwards. Level n holds the edges
+  // from the pointers found in step n to the addresses they lead to, every
+  // address is expanded once per level.
+  std::vector<std::vector<PathEdge>> levels;
+  std::vector<std::uintptr_t> frontier(1, target);
+  std::atomic<std::size_t> visited(0);
+
+  // Collects the paths from an address of a level to the target, appending
+  // offsets while descending.
+  PointerPath path;
+  std::function<void (std::size_t, std::uintptr_t)> collect;
+  collect = [&](std::size_t level, std::uintptr_t address)
+  {
+    if(!level)
+    {
+      results.push_back(path);
+      return;
+    }
+
+    std::vector<PathEdge> const& edges = levels[level - 1];
+    auto itr = std::lower_bound(edges.begin(), edges.end(), address,
+      [](PathEdge const& lhs, std::uintptr_t rhs) { return lhs.from < rhs; });
+    for(; itr != edges.end() && itr->from == address &&
+      results.size() < m_options.maxResults; ++itr)
+    {
+      path.offsets.push_back(itr->offset);
+      collect(level - 1, itr->to);
+      path.offsets.pop_back();
+    }
+  };
+
+  for(std::size_t depth = 0; depth < m_options.maxDepth &&
+    !frontier.empty() && visited < m_options.maxNodes; ++depth)
+  {
+    std::vector<PathEdge> edges;
+    std::mutex mutex;
+    std::atomic<std::size_t> next(0);
+    std::size_t const threadCount = std::min(getThreadCount(m_options),
+      frontier.size());
+    std::vector<std::exception_ptr> errors(threadCount);
+
+    auto worker = [&](std::size_t index)
+    {
+      try
+      {
+        std::vector<PathEdge> found;
+        for(std::size_t i = next++; i < frontier.size() &&
+          visited < m_options.maxNodes; i = next++)
+        {
+          m_context.check();
+
+          std::uintptr_t const address = frontier[i];
+          std::uint64_t const low = address > m_options.maxOffset ?
+            address - m_options.maxOffset : 0;
+          std::pair<PointerMap::Entry const*, PointerMap::Entry const*> range =
+            m_map.findRange(low, address);
+
+          visited += range.second - range.first;
+          for(PointerMap::Entry const* cur = range.first; cur != range.second;
+            ++cur)
+          {
+            PathEdge edge = { static_cast<std::uintptr_t>(cur->address),
+              address, static_cast<std::ptrdiff_t>(address - cur->value) };
+            found.push_back(edge);
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        edges.insert(edges.end(), found.begin(), found.end());
+      }
+      catch(...)
+      {
+        errors[index] = std::current_exception();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i < threadCount; ++i)
+      threads.push_back(std::thread(worker, i));
+    BOOST_FOREACH(std::thread& cur, threads)
+      cur.join();
+
+    BOOST_FOREACH(std::exception_ptr const& cur, errors)
+    {
+      if(cur)
+        std::rethrow_exception(cur);
+    }
+
+    std::sort(edges.begin(), edges.end(),
+      [](PathEdge const& lhs, PathEdge const& rhs)
+      { return lhs.from < rhs.from || (lhs.from == rhs.from &&
+        lhs.to < rhs.to); });
+    levels.push_back(std::vector<PathEdge>());
+    levels.back().swap(edges);
+
+    // Paths end at static pointers, all other pointers are expanded by the
+    // next level.
+    frontier.clear();
+    std::vector<PathEdge> const& level = levels.back();
+    for(std::size_t i = 0; i < level.size(); )
+    {
+      std::uintptr_t const from = level[i].from;
+      StaticRange const* found = findStatic(from);
+      if(found && results.size() < m_options.maxResults)
+      {
+        path.module = m_modules[found->module].path;
+        path.baseOffset = from - m_modules[found->module].base;
+        collect(levels.size(), from);
+      }
+      else if(!found)
+      {
+        frontier.push_back(from);
+      }
+
+      while(i < level.size() && level[i].from == from)
+        ++i;
+    }
+
+    if(results.size() >= m_options.maxResults)
+      break;
+  }
+
+  std::sort(results.begin(), results.end(),
+    [](PointerPath const& lhs, PointerPath const& rhs)
+    {
+      if(lhs.offsets.size() != rhs.offsets.size())
+        return lhs.offsets.size() < rhs.offsets.size();
+      if(lhs.module != rhs.module)
+        return lhs.module < rhs.module;
+      if(lhs.baseOffset != rhs.baseOffset)
+        return lhs.baseOffset < rhs.baseOffset;
+      return lhs.offsets < rhs.offsets;
+    });
+
+  return results;
+}
+
+std::uintptr_t PointerScanner::resolve(PointerPath const& path)
+{
+  std::uintptr_t address = 0;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(m_editor.getProcess());
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+  {
+    if(cur.getPath() == path.module)
+    {
+      address = cur.getStartAddress() + path.baseOffset;
+      break;
+    }
+  }
+
+  if(!address)
+    return 0;
+
+  bool const wide = Ethon::getProcessImageBits(m_editor.getProcess()) == 64;
+  try
+  {
+    BOOST_FOREACH(std::ptrdiff_t offset, path.offsets)
+    {
+      std::uintptr_t pointer = wide ? m_editor.read<std::uint64_t>(address) :
+        m_editor.read<std::uint32_t>(address);
+      if(!pointer)
+        return 0;
+
+      address = pointer + offset;
+    }
+  }
+  catch(EthonError const&)
+  {
+    return 0;
+  }
+
+  return address;
+}
+
+PointerMap const& PointerScanner::getMap() const
+{
+  return m_map;
+}
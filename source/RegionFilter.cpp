@@ -0,0 +1,165 @@
+/*
+RegionFilter.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <fnmatch.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <limits>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionFilter.hpp>
+
+using Ethon::RegionFilter;
+using Ethon::MemoryRegion;
+using Ethon::EthonError;
+
+/* RegionFilter class */
+
+RegionFilter::RegionFilter()
+  : m_permMask(0), m_permValue(0), m_criteria(0), m_minSize(0),
+    m_maxSize(std::numeric_limits<std::size_t>::max()), m_inode(0),
+    m_pattern()
+{ }
+
+RegionFilter::RegionFilter(std::string const& perms)
+  : m_permMask(0), m_permValue(0), m_criteria(0), m_minSize(0),
+    m_maxSize(std::numeric_limits<std::size_t>::max()), m_inode(0),
+    m_pattern()
+{
+  setPermissions(perms);
+}
+
+RegionFilter::RegionFilter(char const* perms)
+  : m_permMask(0), m_permValue(0), m_criteria(0), m_minSize(0),
+    m_maxSize(std::numeric_limits<std::size_t>::max()), m_inode(0),
+    m_pattern()
+{
+  setPermissions(perms);
+}
+
+RegionFilter& RegionFilter::setPermissions(std::string const& perms)
+{
+  if(perms.length() != 4)
+  {
+    BOOST_THROW_EXCEPTION(EthonError() <<
+      ErrorString("No valid 'rwxs' permission string"));
+  }
+
+  // Any character but the letter itself requires the permission to be
+  // missing, like the string comparison did before.
+  static char const letters[] = { 'r', 'w', 'x', 's' };
+  static std::uint8_t const bits[] = {
+    MemoryRegion::kPerm_Read, MemoryRegion::kPerm_Write,
+    MemoryRegion::kPerm_Execute, MemoryRegion::kPerm_Shared
+  };
+
+  m_permMask = 0;
+  m_permValue = 0;
+  for(std::size_t i = 0; i < 4; ++i)
+  {
+    if(perms[i] == '*')
+      continue;
+
+    m_permMask |= bits[i];
+    if(perms[i] == letters[i])
+      m_permValue |= bits[i];
+  }
+
+  return *this;
+}
+
+RegionFilter& RegionFilter::setPermissions(std::uint8_t mask,
+  std::uint8_t value)
+{
+  m_permMask = mask;
+  m_permValue = value & mask;
+  return *this;
+}
+
+RegionFilter& RegionFilter::setPath(std::string const& pattern)
+{
+  m_pattern = pattern;
+  if(pattern.empty())
+    m_criteria &= ~kFilter_Path;
+  else
+    m_criteria |= kFilter_Path;
+  return *this;
+}
+
+RegionFilter& RegionFilter::setSize(std::size_t minSize,
+  std::size_t maxSize)
+{
+  m_minSize = minSize;
+  m_maxSize = maxSize;
+  return *this;
+}
+
+RegionFilter& RegionFilter::setInode(std::uint32_t inode)
+{
+  m_inode = inode;
+  m_criteria |= kFilter_Inode;
+  return *this;
+}
+
+RegionFilter& RegionFilter::setAnonymous(bool anonymous)
+{
+  m_criteria &= ~(kFilter_Anonymous | kFilter_FileBacked);
+  m_criteria |= anonymous ? kFilter_Anonymous : kFilter_FileBacked;
+  return *this;
+}
+
+bool RegionFilter::matchesCriteria(MemoryRegion const& region) const
+{
+  if((m_criteria & kFilter_Inode) && region.getInode() != m_inode)
+    return false;
+
+  if((m_criteria & kFilter_Anonymous) && region.getInode())
+    return false;
+
+  if((m_criteria & kFilter_FileBacked) && !region.getInode())
+    return false;
+
+  // The most expensive check comes last.
+  return !(m_criteria & kFilter_Path) ||
+    ::fnmatch(m_pattern.c_str(), region.getPath().c_str(), 0) == 0;
+}
+
+std::vector<MemoryRegion> RegionFilter::select(
+  std::vector<MemoryRegion> const& regions) const
+{
+  std::vector<MemoryRegion> result;
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if((*this)(cur))
+      result.push_back(cur);
+  }
+
+  return result;
+}
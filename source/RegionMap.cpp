@@ -0,0 +1,138 @@
+/*
+RegionMap.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionMap.hpp>
+
+using Ethon::RegionMap;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::Process;
+
+/* RegionMap class */
+
+RegionMap::RegionMap(Process const& process, Clock::duration maxAge)
+  : m_process(process), m_maxAge(maxAge), m_timestamp(), m_regions(),
+    m_starts(), m_ends()
+{
+  load();
+}
+
+void RegionMap::load() const
+{
+  // The kernel lists regions ordered by address, as find() requires.
+  std::vector<MemoryRegion> regions;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(m_process);
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+    regions.push_back(cur);
+
+  m_starts.clear();
+  m_ends.clear();
+  m_starts.reserve(regions.size());
+  m_ends.reserve(regions.size());
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    m_starts.push_back(cur.getStartAddress());
+    m_ends.push_back(cur.getEndAddress());
+  }
+
+  m_regions.swap(regions);
+  m_timestamp = Clock::now();
+}
+
+void RegionMap::update() const
+{
+  if(m_maxAge != Clock::duration::zero() &&
+    Clock::now() - m_timestamp >= m_maxAge)
+  {
+    load();
+  }
+}
+
+void RegionMap::refresh()
+{
+  load();
+}
+
+void RegionMap::setMaxAge(Clock::duration maxAge)
+{
+  m_maxAge = maxAge;
+}
+
+RegionMap::Clock::duration RegionMap::getMaxAge() const
+{
+  return m_maxAge;
+}
+
+RegionMap::Clock::time_point RegionMap::getTimestamp() const
+{
+  return m_timestamp;
+}
+
+Process const& RegionMap::getProcess() const
+{
+  return m_process;
+}
+
+std::vector<MemoryRegion> const& RegionMap::getRegions() const
+{
+  update();
+  return m_regions;
+}
+
+MemoryRegion const* RegionMap::find(std::uintptr_t address) const
+{
+  update();
+
+  // The last region starting at or before the address.
+  std::vector<std::uintptr_t>::const_iterator start = std::upper_bound(
+    m_starts.begin(), m_starts.end(), address);
+  if(start == m_starts.begin())
+    return 0;
+
+  std::size_t const index = start - m_starts.begin() - 1;
+  if(address >= m_ends[index])
+    return 0;
+
+  return &m_regions[index];
+}
+
+bool RegionMap::isReadable(std::uintptr_t address) const
+{
+  MemoryRegion const* region = find(address);
+  return region && region->isReadable();
+}
+
+bool RegionMap::isWriteable(std::uintptr_t address) const
+{
+  MemoryRegion const* region = find(address);
+  return region && region->isWriteable();
+}
@@ -0,0 +1,290 @@
+/*
+RegionOrder.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionOrder.hpp>
+
+using Ethon::RegionKind;
+using Ethon::RegionHistory;
+using Ethon::RegionOrder;
+using Ethon::MemoryRegion;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+
+RegionKind Ethon::classifyRegion(MemoryRegion const& region)
+{
+  std::string const& path = region.getPath();
+  if(path.empty())
+    return RegionKind::ANONYMOUS;
+  if(path == "[heap]")
+    return RegionKind::HEAP;
+  if(path.compare(0, 6, "[stack") == 0)
+    return RegionKind::STACK;
+  if(path[0] == '[')
+    return RegionKind::SPECIAL;
+  return RegionKind::FILE;
+}
+
+/* RegionHistory class */
+
+double const RegionHistory::DECAY = 0.9;
+
+std::string RegionHistory::makeKey(MemoryRegion const& region)
+{
+  std::array<char, 4> const permissions = region.getPermissions();
+  std::string const perms(permissions.begin(), permissions.end());
+
+  std::ostringstream key;
+  switch(classifyRegion(region))
+  {
+  case RegionKind::ANONYMOUS:
+    {
+      // Anonymous regions only differ by their size class.
+      unsigned int sizeClass = 0;
+      for(std::size_t size = region.getSize(); size > 1; size >>= 1)
+        ++sizeClass;
+      key << "anon:" << perms << ':' << sizeClass;
+    }
+    break;
+  case RegionKind::FILE:
+    key << "file:" << perms << ':' << std::hex << region.getOffset() << ':' <<
+      region.getPath();
+    break;
+  default:
+    key << region.getPath() << ':' << perms;
+    break;
+  }
+
+  return key.str();
+}
+
+void RegionHistory::recordHit(std::string const& executable,
+  MemoryRegion const& region)
+{
+  std::string const key = makeKey(region);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Weights& weights = m_executables[executable];
+  for(auto it = weights.begin(); it != weights.end(); ++it)
+    it->second *= DECAY;
+  weights[key] += 1.0;
+}
+
+double RegionHistory::getShare(std::string const& executable,
+  MemoryRegion const& region) const
+{
+  std::string const key = makeKey(region);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto weights = m_executables.find(executable);
+  if(weights == m_executables.end())
+    return 0.0;
+
+  double total = 0.0;
+  for(auto it = weights->second.begin(); it != weights->second.end(); ++it)
+    total += it->second;
+
+  auto weight = weights->second.find(key);
+  if(weight == weights->second.end() || total <= 0.0)
+    return 0.0;
+  return weight->second / total;
+}
+
+void RegionHistory::save(boost::filesystem::path const& path) const
+{
+  std::ofstream file(path.c_str(), std::ios::trunc);
+  if(!file)
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't create region history"));
+  }
+
+  // One tab separated line per executable and region.
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(auto exe = m_executables.begin(); exe != m_executables.end(); ++exe)
+  {
+    if(exe->first.find_first_of("\t\n") != std::string::npos)
+      continue;
+
+    for(auto it = exe->second.begin(); it != exe->second.end(); ++it)
+    {
+      if(it->first.find_first_of("\t\n") == std::string::npos)
+        file << exe->first << '\t' << it->first << '\t' << it->second << '\n';
+    }
+  }
+
+  if(!file.flush())
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't write region history"));
+  }
+}
+
+void RegionHistory::load(boost::filesystem::path const& path)
+{
+  std::ifstream file(path.c_str());
+  if(!file)
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't open region history"));
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::string line;
+  while(std::getline(file, line))
+  {
+    std::size_t first = line.find('\t');
+    std::size_t second = line.find('\t', first + 1);
+    if(first == std::string::npos || second == std::string::npos)
+      continue;
+
+    double weight = std::strtod(line.c_str() + second + 1, 0);
+    if(weight > 0.0)
+    {
+      m_executables[line.substr(0, first)][line.substr(first + 1,
+        second - first - 1)] += weight;
+    }
+  }
+}
+
+/* RegionOrder class */
+
+RegionOrder::RegionOrder()
+  : m_kindWeights(), m_writeableWeight(30.0), m_sizeWeight(-2.0),
+    m_historyWeight(200.0), m_priority(),
+    m_history(std::make_shared<RegionHistory>())
+{
+  setKindWeight(RegionKind::HEAP, 40.0);
+  setKindWeight(RegionKind::ANONYMOUS, 30.0);
+  setKindWeight(RegionKind::STACK, 10.0);
+  setKindWeight(RegionKind::FILE, 0.0);
+  setKindWeight(RegionKind::SPECIAL, -100.0);
+}
+
+RegionOrder RegionOrder::addressOrder()
+{
+  RegionOrder order;
+  order.m_kindWeights.fill(0.0);
+  order.m_writeableWeight = 0.0;
+  order.m_sizeWeight = 0.0;
+  order.m_history.reset();
+  return order;
+}
+
+RegionOrder& RegionOrder::setKindWeight(RegionKind kind, double weight)
+{
+  m_kindWeights.at(static_cast<std::size_t>(kind)) = weight;
+  return *this;
+}
+
+RegionOrder& RegionOrder::setWriteableWeight(double weight)
+{
+  m_writeableWeight = weight;
+  return *this;
+}
+
+RegionOrder& RegionOrder::setSizeWeight(double weight)
+{
+  m_sizeWeight = weight;
+  return *this;
+}
+
+RegionOrder& RegionOrder::setPriority(PriorityFunction const& priority)
+{
+  m_priority = priority;
+  return *this;
+}
+
+RegionOrder& RegionOrder::setHistory(
+  std::shared_ptr<RegionHistory> const& history, double weight)
+{
+  m_history = history;
+  m_historyWeight = weight;
+  return *this;
+}
+
+std::shared_ptr<RegionHistory> const& RegionOrder::getHistory() const
+{
+  return m_history;
+}
+
+double RegionOrder::getScore(MemoryRegion const& region,
+  std::string const& executable) const
+{
+  double score = m_kindWeights[static_cast<std::size_t>(
+    Ethon::classifyRegion(region))];
+
+  if(region.isWriteable())
+    score += m_writeableWeight;
+
+  // Measured in doublings beyond a page.
+  if(m_sizeWeight != 0.0 && region.getSize() > 4096)
+    score += m_sizeWeight * std::log2(region.getSize() / 4096.0);
+
+  if(m_priority)
+    score += m_priority(region);
+
+  if(m_history)
+    score += m_historyWeight * m_history->getShare(executable, region);
+
+  return score;
+}
+
+void RegionOrder::order(std::vector<MemoryRegion>& regions,
+  std::string const& executable) const
+{
+  std::vector<std::pair<double, std::size_t>> scores;
+  scores.reserve(regions.size());
+  for(std::size_t i = 0; i < regions.size(); ++i)
+    scores.push_back(std::make_pair(-getScore(regions[i], executable), i));
+
+  // The index breaks ties, keeping the address order.
+  std::sort(scores.begin(), scores.end());
+
+  std::vector<MemoryRegion> ordered;
+  ordered.reserve(regions.size());
+  for(std::size_t i = 0; i < scores.size(); ++i)
+    ordered.push_back(regions[scores[i].second]);
+  regions.swap(ordered);
+}
+
+void RegionOrder::recordHit(MemoryRegion const& region,
+  std::string const& executable) const
+{
+  if(m_history)
+    m_history->recordHit(executable, region);
+}
@@ -0,0 +1,715 @@
+/*
+RegionTracker.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <limits.h>
+#include <signal.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cerrno>
+#include <vector>
+#include <map>
+#include <array>
+#include <string>
+#include <iterator>
+#include <utility>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Debugger.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/RegionTracker.hpp>
+
+using Ethon::RegionTracker;
+using Ethon::RegionChange;
+using Ethon::RegionChangeType;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::Debugger;
+using Ethon::Registers;
+using Ethon::SignalInfo;
+using Ethon::Process;
+using Ethon::EthonError;
+using Ethon::ErrorString;
+
+// Syscalls are decoded from x86 registers, other architectures get a stub.
+#if defined(__i386__) || defined(__x86_64__)
+
+namespace
+{
+  std::uintptr_t const PAGE_BYTES = 4096;
+
+  // mremap flag keeping the old mapping, which is not modelled.
+  std::uintptr_t const REMAP_DONTUNMAP = 4;
+
+#if defined(__i386__)
+  // mmap2 takes its offset in pages.
+  std::uint64_t const MMAP_OFFSET_UNIT = 4096;
+#else
+  std::uint64_t const MMAP_OFFSET_UNIT = 1;
+#endif
+
+  /**
+  * Reads the syscall number, arguments and return value from registers.
+  * @param registers The registers at a syscall-stop.
+  * @param number Receives the syscall number.
+  * @param arguments Receives the arguments.
+  * @param result Receives the return value, -ENOSYS on syscall-entry.
+  */
+  void readSyscall(Registers const& registers, long& number,
+    std::uintptr_t (&arguments)[6], std::uintptr_t& result)
+  {
+#if defined(__x86_64__)
+    number = registers.orig_rax;
+    arguments[0] = registers.rdi;
+    arguments[1] = registers.rsi;
+    arguments[2] = registers.rdx;
+    arguments[3] = registers.r10;
+    arguments[4] = registers.r8;
+    arguments[5] = registers.r9;
+    result = registers.rax;
+#else
+    number = registers.orig_eax;
+    arguments[0] = registers.ebx;
+    arguments[1] = registers.ecx;
+    arguments[2] = registers.edx;
+    arguments[3] = registers.esi;
+    arguments[4] = registers.edi;
+    arguments[5] = registers.ebp;
+    result = registers.eax;
+#endif
+  }
+
+  std::uintptr_t pageAlign(std::uintptr_t value)
+  {
+    return (value + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+  }
+
+  // Syscalls return -4095 to -1 on failure.
+  bool isError(std::uintptr_t result)
+  {
+    return result >= static_cast<std::uintptr_t>(-4095);
+  }
+
+  std::array<char, 4> makePermissions(int protection, bool shared)
+  {
+    std::array<char, 4> result = {{
+      (protection & PROT_READ) ? 'r' : '-',
+      (protection & PROT_WRITE) ? 'w' : '-',
+      (protection & PROT_EXEC) ? 'x' : '-',
+      shared ? 's' : 'p'
+    }};
+    return result;
+  }
+
+  /**
+  * Creates a region with the attributes of another one.
+  * @param region The original region.
+  * @param from Address in the original region the new one starts at.
+  * @param start Start of the new region.
+  * @param end End of the new region.
+  * @param permissions Permissions of the new region.
+  * @return The new region.
+  */
+  MemoryRegion relocate(MemoryRegion const& region, std::uintptr_t from,
+    std::uintptr_t start, std::uintptr_t end,
+    std::array<char, 4> const& permissions)
+  {
+    // The kernel shows offsets of file-backed regions only.
+    std::uint32_t offset = region.getOffset();
+    if(region.getInode())
+      offset += static_cast<std::uint32_t>(from - region.getStartAddress());
+
+    return MemoryRegion(start, end, permissions, offset,
+      region.getDeviceMajor(), region.getDeviceMinor(), region.getInode(),
+      region.getPath());
+  }
+
+  MemoryRegion resize(MemoryRegion const& region, std::uintptr_t start,
+    std::uintptr_t end)
+  {
+    return relocate(region, start, start, end, region.getPermissions());
+  }
+
+  bool isSameRegion(MemoryRegion const& lhs, MemoryRegion const& rhs)
+  {
+    return lhs.getStartAddress() == rhs.getStartAddress() &&
+      lhs.getEndAddress() == rhs.getEndAddress() &&
+      lhs.getPermissionMask() == rhs.getPermissionMask() &&
+      lhs.getOffset() == rhs.getOffset() &&
+      lhs.getInode() == rhs.getInode() && lhs.getPath() == rhs.getPath();
+  }
+
+  // Checks if the kernel would merge two adjacent regions.
+  bool isCompatible(MemoryRegion const& lower, MemoryRegion const& upper)
+  {
+    return lower.getPermissionMask() == upper.getPermissionMask() &&
+      lower.getDeviceMajor() == upper.getDeviceMajor() &&
+      lower.getDeviceMinor() == upper.getDeviceMinor() &&
+      lower.getInode() == upper.getInode() &&
+      lower.getPath() == upper.getPath() &&
+      (!lower.getInode() ||
+        upper.getOffset() == lower.getOffset() + lower.getSize());
+  }
+}
+
+/* RegionTracker class */
+
+RegionTracker::RegionTracker()
+  : m_process(Debugger::get().getProcess()), m_regions(), m_listeners(),
+    m_nextListener(0), m_inSyscall(false), m_syscall(-1), m_arguments(),
+    m_brk(0), m_signal(0), m_reloads(0), m_multithreaded(false)
+{
+  if(!m_process.getPid())
+  {
+    BOOST_THROW_EXCEPTION(EthonError() <<
+      ErrorString("Debugger is not attached"));
+  }
+
+  // Syscall-stops are reported as SIGTRAP | 0x80 to tell them from signals.
+  Debugger::get().setOptions(PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC);
+  m_multithreaded = hasThreads();
+  reload();
+}
+
+bool RegionTracker::hasThreads() const
+{
+  return Ethon::ProcessStatus(m_process).getNumThreads() > 1;
+}
+
+bool RegionTracker::step()
+{
+  Debugger& debugger = Debugger::get();
+  debugger.stepSyscall(m_signal);
+  m_signal = 0;
+
+  int const status = debugger.wait();
+  if(WIFEXITED(status) || WIFSIGNALED(status))
+  {
+    std::map<std::uintptr_t, MemoryRegion> regions;
+    regions.swap(m_regions);
+    BOOST_FOREACH(auto const& cur, regions)
+    {
+      notify(RegionChangeType::UNMAPPED, cur.second.getStartAddress(),
+        cur.second.getEndAddress());
+    }
+    return false;
+  }
+
+  if(!WIFSTOPPED(status))
+    return true;
+
+  int const signal = WSTOPSIG(status);
+  if(signal == (SIGTRAP | 0x80))
+    handleSyscall();
+  else if(status >> 8 == (SIGTRAP | (PTRACE_EVENT_EXEC << 8)))
+  {
+    m_multithreaded = hasThreads();
+    reload();
+  }
+  else if(status >> 16 == 0)
+  {
+    // A group-stop has no siginfo and the signal must not be sent again.
+    try
+    {
+      SignalInfo info;
+      debugger.getSignalInfo(info);
+      m_signal = signal;
+    }
+    catch(EthonError const&)
+    { }
+  }
+
+  // Other threads are not traced, their changes are only caught by
+  // rereading. A syscall-entry is always followed by its exit, which
+  // rereads for both.
+  if(m_multithreaded && !m_inSyscall)
+  {
+    m_multithreaded = hasThreads();
+    reload();
+  }
+
+  return true;
+}
+
+void RegionTracker::handleSyscall()
+{
+  Registers registers;
+  Debugger::get().getRegisters(registers);
+
+  long number;
+  std::uintptr_t arguments[6];
+  std::uintptr_t result;
+  readSyscall(registers, number, arguments, result);
+
+  // The kernel sets the return value to -ENOSYS on syscall-entry.
+  if(!m_inSyscall && result == static_cast<std::uintptr_t>(-ENOSYS))
+  {
+    m_inSyscall = true;
+    m_syscall = number;
+    std::copy(arguments, arguments + 6, m_arguments);
+    return;
+  }
+
+  // The first stop may be the exit of a syscall entered before tracking.
+  bool const entered = m_inSyscall;
+  m_inSyscall = false;
+  if(entered)
+    apply(result);
+}
+
+void RegionTracker::apply(std::uintptr_t result)
+{
+  std::uintptr_t const* args = m_arguments;
+  switch(m_syscall)
+  {
+#if defined(__i386__)
+  case SYS_mmap2:
+#else
+  case SYS_mmap:
+#endif
+    if(!isError(result))
+      map(result);
+    break;
+
+  case SYS_munmap:
+    if(!isError(result))
+    {
+      std::uintptr_t const end = args[0] + pageAlign(args[1]);
+      remove(args[0], end);
+      notify(RegionChangeType::UNMAPPED, args[0], end);
+    }
+    break;
+
+  case SYS_mprotect:
+#ifdef SYS_pkey_mprotect
+  case SYS_pkey_mprotect:
+#endif
+    if(!isError(result))
+    {
+      int const protection = static_cast<int>(args[2]);
+      if(protection & (PROT_GROWSDOWN | PROT_GROWSUP))
+      {
+        reload();
+        break;
+      }
+
+      std::uintptr_t const end = args[0] + pageAlign(args[1]);
+      protect(args[0], end, protection);
+      notify(RegionChangeType::PROTECTED, args[0], end);
+    }
+    break;
+
+  case SYS_mremap:
+    if(!isError(result))
+    {
+      std::uintptr_t const oldStart = args[0];
+      std::uintptr_t const oldEnd = oldStart + pageAlign(args[1]);
+      std::uintptr_t const newEnd = result + pageAlign(args[2]);
+      MemoryRegion const* source = find(oldStart);
+
+      // A zero old size duplicates a shared mapping.
+      if(oldStart == oldEnd || (args[3] & REMAP_DONTUNMAP) || !source)
+      {
+        reload();
+        break;
+      }
+
+      MemoryRegion const moved = relocate(*source, oldStart, result, newEnd,
+        source->getPermissions());
+      remove(oldStart, oldEnd);
+      insert(moved);
+      merge(result);
+      merge(newEnd);
+
+      if(result != oldStart)
+      {
+        notify(RegionChangeType::UNMAPPED, oldStart, oldEnd);
+        notify(RegionChangeType::MAPPED, result, newEnd);
+      }
+      else if(newEnd > oldEnd)
+        notify(RegionChangeType::MAPPED, oldEnd, newEnd);
+      else if(newEnd < oldEnd)
+        notify(RegionChangeType::UNMAPPED, newEnd, oldEnd);
+    }
+    break;
+
+  case SYS_brk:
+  {
+    // brk returns the current break on failure, so there is no error check.
+    std::uintptr_t const brk = pageAlign(result);
+    if(brk == m_brk)
+      break;
+    m_brk = brk;
+
+    MemoryRegion const* heap = 0;
+    BOOST_FOREACH(auto const& cur, m_regions)
+    {
+      if(cur.second.getPath() == "[heap]")
+        heap = &cur.second;
+    }
+
+    if(!heap)
+    {
+      reload();
+      break;
+    }
+
+    MemoryRegion const current = *heap;
+    std::uintptr_t const start = current.getStartAddress();
+    std::uintptr_t const end = current.getEndAddress();
+    if(brk <= start)
+    {
+      remove(start, end);
+      notify(RegionChangeType::UNMAPPED, start, end);
+    }
+    else if(brk < end)
+    {
+      remove(brk, end);
+      notify(RegionChangeType::UNMAPPED, brk, end);
+    }
+    else if(brk > end)
+    {
+      insert(resize(current, start, brk));
+      notify(RegionChangeType::MAPPED, end, brk);
+    }
+    break;
+  }
+
+  // Threads created by the traced thread switch to rereading.
+  case SYS_clone:
+#ifdef SYS_clone3
+  case SYS_clone3:
+#endif
+    if(!isError(result) && !m_multithreaded)
+      m_multithreaded = hasThreads();
+    break;
+
+  // Address space changes which are not modelled.
+#if defined(__i386__)
+  case SYS_mmap:
+#endif
+  case SYS_execve:
+#ifdef SYS_execveat
+  case SYS_execveat:
+#endif
+#ifdef SYS_shmat
+  case SYS_shmat:
+  case SYS_shmdt:
+#endif
+  case SYS_io_setup:
+  case SYS_io_destroy:
+  case SYS_remap_file_pages:
+    if(!isError(result))
+      reload();
+    break;
+
+  default:
+    break;
+  }
+}
+
+void RegionTracker::map(std::uintptr_t address)
+{
+  std::uintptr_t const* args = m_arguments;
+  std::uintptr_t const end = address + pageAlign(args[1]);
+  int const protection = static_cast<int>(args[2]);
+  int const flags = static_cast<int>(args[3]);
+  int const file = static_cast<int>(args[4]);
+  bool const shared = (flags & (MAP_SHARED | MAP_PRIVATE)) != MAP_PRIVATE;
+  std::array<char, 4> const permissions = makePermissions(protection, shared);
+
+  if(flags & MAP_ANONYMOUS)
+  {
+    // Shared anonymous memory is backed by a hidden file.
+    if(shared)
+    {
+      reload();
+      return;
+    }
+
+    insert(MemoryRegion(address, end, permissions, 0, 0, 0, 0,
+      std::string()));
+  }
+  else
+  {
+    std::string const link = (m_process.getProcfsDirectory() / "fd" /
+      std::to_string(file)).string();
+
+    struct stat info;
+    std::array<char, PATH_MAX> path;
+    ssize_t const length = ::readlink(link.c_str(), &path[0], path.size());
+    if(length == -1 || ::stat(link.c_str(), &info) == -1)
+    {
+      reload();
+      return;
+    }
+
+    std::uint64_t const offset = args[5] * MMAP_OFFSET_UNIT;
+    insert(MemoryRegion(address, end, permissions,
+      static_cast<std::uint32_t>(offset), major(info.st_dev),
+      minor(info.st_dev), static_cast<std::uint32_t>(info.st_ino),
+      std::string(&path[0], length)));
+  }
+
+  merge(address);
+  merge(end);
+  notify(RegionChangeType::MAPPED, address, end);
+}
+
+void RegionTracker::notify(RegionChangeType type, std::uintptr_t start,
+  std::uintptr_t end) const
+{
+  RegionChange const change = {type, start, end};
+
+  // Listeners may remove themselves.
+  std::vector<std::pair<std::size_t, ChangeCallback>> const listeners =
+    m_listeners;
+  BOOST_FOREACH(auto const& cur, listeners)
+    cur.second(change);
+}
+
+void RegionTracker::split(std::uintptr_t address)
+{
+  std::map<std::uintptr_t, MemoryRegion>::iterator it =
+    m_regions.upper_bound(address);
+  if(it == m_regions.begin())
+    return;
+  --it;
+
+  MemoryRegion const region = it->second;
+  if(address <= region.getStartAddress() || address >= region.getEndAddress())
+    return;
+
+  it->second = resize(region, region.getStartAddress(), address);
+  m_regions.insert(std::make_pair(address,
+    resize(region, address, region.getEndAddress())));
+}
+
+void RegionTracker::merge(std::uintptr_t address)
+{
+  std::map<std::uintptr_t, MemoryRegion>::iterator upper =
+    m_regions.find(address);
+  if(upper == m_regions.end() || upper == m_regions.begin())
+    return;
+
+  std::map<std::uintptr_t, MemoryRegion>::iterator lower = std::prev(upper);
+  if(lower->second.getEndAddress() != address ||
+    !isCompatible(lower->second, upper->second))
+    return;
+
+  lower->second = resize(lower->second, lower->first,
+    upper->second.getEndAddress());
+  m_regions.erase(upper);
+}
+
+void RegionTracker::remove(std::uintptr_t start, std::uintptr_t end)
+{
+  split(start);
+  split(end);
+  m_regions.erase(m_regions.lower_bound(start), m_regions.lower_bound(end));
+}
+
+void RegionTracker::insert(MemoryRegion const& region)
+{
+  remove(region.getStartAddress(), region.getEndAddress());
+  m_regions.insert(std::make_pair(region.getStartAddress(), region));
+}
+
+void RegionTracker::protect(std::uintptr_t start, std::uintptr_t end,
+  int protection)
+{
+  split(start);
+  split(end);
+
+  std::vector<std::uintptr_t> bounds;
+  std::map<std::uintptr_t, MemoryRegion>::iterator it =
+    m_regions.lower_bound(start);
+  for(; it != m_regions.end() && it->first < end; ++it)
+  {
+    MemoryRegion const& cur = it->second;
+    it->second = relocate(cur, cur.getStartAddress(), cur.getStartAddress(),
+      cur.getEndAddress(), makePermissions(protection, cur.isShared()));
+    bounds.push_back(it->first);
+  }
+
+  bounds.push_back(end);
+  BOOST_FOREACH(std::uintptr_t cur, bounds)
+    merge(cur);
+}
+
+void RegionTracker::reload()
+{
+  std::map<std::uintptr_t, MemoryRegion> regions;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(m_process);
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+    regions.insert(std::make_pair(cur.getStartAddress(), cur));
+
+  ++m_reloads;
+  m_regions.swap(regions);
+
+  // Report every region which is not in both versions.
+  BOOST_FOREACH(auto const& cur, regions)
+  {
+    std::map<std::uintptr_t, MemoryRegion>::const_iterator match =
+      m_regions.find(cur.first);
+    if(match == m_regions.end() || !isSameRegion(cur.second, match->second))
+    {
+      notify(RegionChangeType::RELOADED, cur.second.getStartAddress(),
+        cur.second.getEndAddress());
+    }
+  }
+
+  BOOST_FOREACH(auto const& cur, m_regions)
+  {
+    std::map<std::uintptr_t, MemoryRegion>::const_iterator match =
+      regions.find(cur.first);
+    if(match == regions.end() || !isSameRegion(cur.second, match->second))
+    {
+      notify(RegionChangeType::RELOADED, cur.second.getStartAddress(),
+        cur.second.getEndAddress());
+    }
+  }
+}
+
+std::size_t RegionTracker::addListener(ChangeCallback const& callback)
+{
+  m_listeners.push_back(std::make_pair(m_nextListener, callback));
+  return m_nextListener++;
+}
+
+void RegionTracker::removeListener(std::size_t id)
+{
+  for(std::size_t i = 0; i < m_listeners.size(); ++i)
+  {
+    if(m_listeners[i].first == id)
+    {
+      m_listeners.erase(m_listeners.begin() + i);
+      return;
+    }
+  }
+}
+
+Process const& RegionTracker::getProcess() const
+{
+  return m_process;
+}
+
+std::vector<MemoryRegion> RegionTracker::getRegions() const
+{
+  std::vector<MemoryRegion> result;
+  result.reserve(m_regions.size());
+  BOOST_FOREACH(auto const& cur, m_regions)
+    result.push_back(cur.second);
+  return result;
+}
+
+MemoryRegion const* RegionTracker::find(std::uintptr_t address) const
+{
+  std::map<std::uintptr_t, MemoryRegion>::const_iterator it =
+    m_regions.upper_bound(address);
+  if(it == m_regions.begin())
+    return 0;
+  --it;
+
+  if(address >= it->second.getEndAddress())
+    return 0;
+  return &it->second;
+}
+
+bool RegionTracker::isMultithreaded() const
+{
+  return m_multithreaded;
+}
+
+std::uint64_t RegionTracker::getReloadCount() const
+{
+  return m_reloads;
+}
+
+#else
+
+/* RegionTracker class */
+
+RegionTracker::RegionTracker()
+  : m_process(), m_regions(), m_listeners(), m_nextListener(0),
+    m_inSyscall(false), m_syscall(-1), m_arguments(), m_brk(0), m_signal(0),
+    m_reloads(0), m_multithreaded(false)
+{
+  BOOST_THROW_EXCEPTION(EthonError() <<
+    ErrorString("RegionTracker is not supported on this architecture"));
+}
+
+bool RegionTracker::step()
+{
+  return false;
+}
+
+void RegionTracker::reload()
+{ }
+
+std::size_t RegionTracker::addListener(ChangeCallback const& /*callback*/)
+{
+  return m_nextListener++;
+}
+
+void RegionTracker::removeListener(std::size_t /*id*/)
+{ }
+
+Process const& RegionTracker::getProcess() const
+{
+  return m_process;
+}
+
+std::vector<MemoryRegion> RegionTracker::getRegions() const
+{
+  return std::vector<MemoryRegion>();
+}
+
+MemoryRegion const* RegionTracker::find(std::uintptr_t /*address*/) const
+{
+  return 0;
+}
+
+bool RegionTracker::isMultithreaded() const
+{
+  return m_multithreaded;
+}
+
+std::uint64_t RegionTracker::getReloadCount() const
+{
+  return m_reloads;
+}
+
+#endif
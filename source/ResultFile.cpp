@@ -0,0 +1,528 @@
+/*
+ResultFile.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/AddressSet.hpp>
+#include <Ethon/ResultFile.hpp>
+
+using Ethon::ResultFile;
+using Ethon::ResultWriter;
+using Ethon::ResultRegion;
+using Ethon::AddressSet;
+using Ethon::MemoryRegion;
+using Ethon::ArgumentError;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  std::size_t const PAGE_BYTES = 4096;
+
+  // Amount of buffered offsets written at once.
+  std::size_t const FLUSH_OFFSETS = 64 * 1024;
+
+  char const MAGIC[8] = { 'E', 'T', 'H', 'R', 'S', 'L', 'T', 'F' };
+  std::uint32_t const VERSION = 1;
+
+  std::uint64_t alignPage(std::uint64_t value)
+  {
+    return (value + PAGE_BYTES - 1) & ~static_cast<std::uint64_t>(
+      PAGE_BYTES - 1);
+  }
+
+  void writeAll(int file, void const* data, std::size_t size,
+    std::uint64_t offset)
+  {
+    std::uint8_t const* bytes = static_cast<std::uint8_t const*>(data);
+    while(size)
+    {
+      ::ssize_t written = ::pwrite(file, bytes, size,
+        static_cast< ::off_t>(offset));
+      if(written == -1)
+      {
+        if(errno == EINTR)
+          continue;
+
+        std::error_code const error = Ethon::makeErrorCode();
+        BOOST_THROW_EXCEPTION(FilesystemError() <<
+          ErrorString("Can't write result file") <<
+          ErrorCode(error));
+      }
+
+      bytes += written;
+      size -= written;
+      offset += written;
+    }
+  }
+
+  void throwMalformedResults()
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Not a result file"));
+  }
+
+  // Tests if a table of count entries of a size fits into a file.
+  bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t size,
+    std::uint64_t fileSize)
+  {
+    return offset <= fileSize && (!size || count <= (fileSize - offset) / size);
+  }
+}
+
+/* ResultFile class */
+
+std::uint64_t const ResultFile::npos;
+
+ResultFile::ResultFile(boost::filesystem::path const& path)
+  : m_data(0), m_size(0), m_valueSize(0), m_count(0), m_blockCount(0),
+    m_regionCount(0), m_offsets(0), m_values(0), m_blocks(0), m_regions(0),
+    m_strings(0), m_stringsSize(0)
+{
+  int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't open result file") <<
+      ErrorCode(error));
+  }
+
+  struct stat info;
+  if(::fstat(file, &info) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    ::close(file);
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't stat result file") <<
+      ErrorCode(error));
+  }
+
+  m_size = static_cast<std::size_t>(info.st_size);
+  if(m_size < sizeof(FileHeader))
+  {
+    ::close(file);
+    throwMalformedResults();
+  }
+
+  void* map = ::mmap(0, m_size, PROT_READ, MAP_SHARED, file, 0);
+  std::error_code const error = Ethon::makeErrorCode();
+  ::close(file);
+  if(map == MAP_FAILED)
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't map result file") <<
+      ErrorCode(error));
+  }
+  m_data = static_cast<std::uint8_t const*>(map);
+
+  FileHeader header;
+  std::memcpy(&header, m_data, sizeof(header));
+  if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+    header.version != VERSION ||
+    !fits(header.offsetsOffset, header.count, sizeof(std::uint32_t),
+      m_size) ||
+    !fits(header.valuesOffset, header.count, header.valueSize, m_size) ||
+    !fits(header.blocksOffset, header.blockCount, sizeof(BlockRecord),
+      m_size) ||
+    !fits(header.regionsOffset, header.regionCount, sizeof(RegionRecord),
+      m_size) ||
+    !fits(header.stringsOffset, header.stringsSize, 1, m_size) ||
+    header.offsetsOffset % sizeof(std::uint32_t) ||
+    header.blocksOffset % sizeof(std::uint64_t) ||
+    header.regionsOffset % sizeof(std::uint64_t) ||
+    (header.count && !header.blockCount))
+  {
+    ::munmap(map, m_size);
+    throwMalformedResults();
+  }
+
+  m_valueSize = header.valueSize;
+  m_count = header.count;
+  m_blockCount = header.blockCount;
+  m_regionCount = header.regionCount;
+  m_offsets = reinterpret_cast<std::uint32_t const*>(m_data +
+    header.offsetsOffset);
+  m_values = m_valueSize ? m_data + header.valuesOffset : 0;
+  m_blocks = reinterpret_cast<BlockRecord const*>(m_data +
+    header.blocksOffset);
+  m_regions = reinterpret_cast<RegionRecord const*>(m_data +
+    header.regionsOffset);
+  m_strings = reinterpret_cast<char const*>(m_data + header.stringsOffset);
+  m_stringsSize = header.stringsSize;
+}
+
+ResultFile::~ResultFile()
+{
+  ::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+}
+
+ResultFile::BlockRecord const& ResultFile::getBlock(
+  std::uint64_t index) const
+{
+  BlockRecord const* block = std::upper_bound(m_blocks,
+    m_blocks + m_blockCount, index,
+    [](std::uint64_t value, BlockRecord const& cur)
+    {
+      return value < cur.first;
+    });
+
+  return block == m_blocks ? *block : *(block - 1);
+}
+
+std::uint64_t ResultFile::size() const
+{
+  return m_count;
+}
+
+std::size_t ResultFile::getValueSize() const
+{
+  return m_valueSize;
+}
+
+std::uintptr_t ResultFile::getAddress(std::uint64_t index) const
+{
+  return getBlock(index).base + m_offsets[index];
+}
+
+std::uint8_t const* ResultFile::getValue(std::uint64_t index) const
+{
+  return m_values ? m_values + index * m_valueSize : 0;
+}
+
+std::uint64_t ResultFile::find(std::uintptr_t address) const
+{
+  BlockRecord const* block = std::upper_bound(m_blocks,
+    m_blocks + m_blockCount, address,
+    [](std::uintptr_t value, BlockRecord const& cur)
+    {
+      return value < cur.base;
+    });
+  if(block == m_blocks)
+    return npos;
+
+  --block;
+  std::uint64_t const end = block + 1 == m_blocks + m_blockCount ? m_count :
+    (block + 1)->first;
+  if(block->first >= end || end > m_count ||
+    address - block->base > AddressSet::MAX_BLOCK_SPAN)
+  {
+    return npos;
+  }
+
+  std::uint32_t const offset = static_cast<std::uint32_t>(
+    address - block->base);
+  std::uint32_t const* found = std::lower_bound(m_offsets + block->first,
+    m_offsets + end, offset);
+  return found != m_offsets + end && *found == offset ?
+    found - m_offsets : npos;
+}
+
+std::vector<ResultRegion> ResultFile::getRegions() const
+{
+  std::vector<ResultRegion> regions;
+  regions.reserve(m_regionCount);
+  for(std::uint64_t i = 0; i < m_regionCount; ++i)
+  {
+    RegionRecord const& record = m_regions[i];
+    if(static_cast<std::uint64_t>(record.pathOffset) + record.pathLength >
+      m_stringsSize)
+    {
+      throwMalformedResults();
+    }
+
+    std::array<char, 4> perms;
+    std::copy(record.perms, record.perms + 4, perms.begin());
+    ResultRegion region = {
+      MemoryRegion(record.start, record.end, perms, record.fileOffset,
+        record.devMajor, record.devMinor, record.inode,
+        std::string(m_strings + record.pathOffset, record.pathLength)),
+      record.first, record.count };
+    regions.push_back(region);
+  }
+
+  return regions;
+}
+
+AddressSet ResultFile::toAddressSet() const
+{
+  AddressSet set;
+  for(std::uint64_t i = 0; i < m_blockCount; ++i)
+  {
+    std::uint64_t const end = i + 1 == m_blockCount ? m_count :
+      m_blocks[i + 1].first;
+    if(m_blocks[i].first >= end || end > m_count)
+      throwMalformedResults();
+
+    set.appendBlock(m_blocks[i].base, m_offsets + m_blocks[i].first,
+      static_cast<std::uint32_t>(end - m_blocks[i].first));
+  }
+
+  return set;
+}
+
+/* ResultWriter class */
+
+ResultWriter::ResultWriter(boost::filesystem::path const& path,
+  std::size_t valueSize)
+  : m_path(path), m_file(-1), m_values(-1), m_finished(false),
+    m_valueSize(valueSize), m_blocks(), m_regions(), m_strings(),
+    m_offsets(), m_buffer(), m_count(0), m_last(0), m_written(0),
+    m_valuesWritten(0)
+{
+  m_file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+    0644);
+  if(m_file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't create result file") <<
+      ErrorCode(error));
+  }
+
+  if(m_valueSize)
+  {
+    // Next to the result file, so that copying the values stays local.
+    std::string temp = path.string() + ".values-XXXXXX";
+    m_values = ::mkstemp(&temp[0]);
+    if(m_values == -1)
+    {
+      std::error_code const error = Ethon::makeErrorCode();
+      ::close(m_file);
+      ::unlink(m_path.c_str());
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("Can't create value column file") <<
+        ErrorCode(error));
+    }
+
+    ::unlink(temp.c_str());
+  }
+}
+
+ResultWriter::~ResultWriter()
+{
+  if(m_values != -1)
+    ::close(m_values);
+  ::close(m_file);
+  if(!m_finished)
+    ::unlink(m_path.c_str());
+}
+
+void ResultWriter::flush()
+{
+  std::uint64_t const offsetsOffset = alignPage(
+    sizeof(ResultFile::FileHeader));
+  if(!m_offsets.empty())
+  {
+    writeAll(m_file, &m_offsets[0], m_offsets.size() * sizeof(std::uint32_t),
+      offsetsOffset + m_written * sizeof(std::uint32_t));
+    m_written += m_offsets.size();
+    m_offsets.clear();
+  }
+
+  if(!m_buffer.empty())
+  {
+    writeAll(m_values, &m_buffer[0], m_buffer.size(), m_valuesWritten);
+    m_valuesWritten += m_buffer.size();
+    m_buffer.clear();
+  }
+}
+
+void ResultWriter::beginRegion(MemoryRegion const& region)
+{
+  if(!m_regions.empty())
+    m_regions.back().count = m_count - m_regions.back().first;
+
+  ResultFile::RegionRecord record = ResultFile::RegionRecord();
+  record.start = region.getStartAddress();
+  record.end = region.getEndAddress();
+  record.first = m_count;
+  record.fileOffset = region.getOffset();
+  record.inode = region.getInode();
+  record.devMajor = region.getDeviceMajor();
+  record.devMinor = region.getDeviceMinor();
+  std::array<char, 4> const perms = region.getPermissions();
+  std::copy(perms.begin(), perms.end(), record.perms);
+  record.pathOffset = static_cast<std::uint32_t>(m_strings.size());
+  record.pathLength = static_cast<std::uint32_t>(region.getPath().size());
+  m_strings += region.getPath();
+  m_regions.push_back(record);
+}
+
+void ResultWriter::append(std::uintptr_t address, void const* value)
+{
+  if(m_count && address <= m_last)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Addresses have to be appended in ascending order"));
+  }
+
+  // Blocks follow the rules of AddressSet, so they can be adopted as is.
+  if(m_blocks.empty() ||
+    m_count - m_blocks.back().first == AddressSet::BLOCK_CAPACITY ||
+    address - m_blocks.back().base > AddressSet::MAX_BLOCK_SPAN)
+  {
+    ResultFile::BlockRecord block = { address, m_count };
+    m_blocks.push_back(block);
+  }
+
+  m_offsets.push_back(static_cast<std::uint32_t>(
+    address - m_blocks.back().base));
+  if(m_valueSize)
+  {
+    std::uint8_t const* bytes = static_cast<std::uint8_t const*>(value);
+    m_buffer.insert(m_buffer.end(), bytes, bytes + m_valueSize);
+  }
+
+  m_last = address;
+  ++m_count;
+  if(m_offsets.size() == FLUSH_OFFSETS)
+    flush();
+}
+
+void ResultWriter::append(AddressSet const& set)
+{
+  if(m_valueSize)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Address sets carry no values"));
+  }
+
+  BOOST_FOREACH(AddressSet::Block const& cur, set.getBlocks())
+  {
+    if(m_count && cur.base <= m_last)
+    {
+      BOOST_THROW_EXCEPTION(ArgumentError() <<
+        ErrorString("Addresses have to be appended in ascending order"));
+    }
+
+    ResultFile::BlockRecord block = { cur.base, m_count };
+    m_blocks.push_back(block);
+
+    std::uint32_t const* offsets = set.getOffsets(cur);
+    m_offsets.insert(m_offsets.end(), offsets, offsets + cur.count);
+    m_last = cur.last;
+    m_count += cur.count;
+    if(m_offsets.size() >= FLUSH_OFFSETS)
+      flush();
+  }
+}
+
+std::uint64_t ResultWriter::size() const
+{
+  return m_count;
+}
+
+std::size_t ResultWriter::getValueSize() const
+{
+  return m_valueSize;
+}
+
+void ResultWriter::finish()
+{
+  flush();
+  if(!m_regions.empty())
+    m_regions.back().count = m_count - m_regions.back().first;
+
+  ResultFile::FileHeader header = ResultFile::FileHeader();
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.valueSize = static_cast<std::uint32_t>(m_valueSize);
+  header.count = m_count;
+  header.blockCount = m_blocks.size();
+  header.regionCount = m_regions.size();
+  header.offsetsOffset = alignPage(sizeof(header));
+  header.valuesOffset = alignPage(header.offsetsOffset +
+    m_count * sizeof(std::uint32_t));
+  header.blocksOffset = alignPage(header.valuesOffset +
+    m_count * m_valueSize);
+  header.regionsOffset = header.blocksOffset +
+    m_blocks.size() * sizeof(ResultFile::BlockRecord);
+  header.stringsOffset = header.regionsOffset +
+    m_regions.size() * sizeof(ResultFile::RegionRecord);
+  header.stringsSize = m_strings.size();
+
+  // Copy the value column behind the offsets.
+  std::vector<std::uint8_t> buffer(std::min<std::uint64_t>(m_valuesWritten,
+    1024 * 1024));
+  for(std::uint64_t done = 0; done < m_valuesWritten; )
+  {
+    ::ssize_t count = ::pread(m_values, &buffer[0], buffer.size(),
+      static_cast< ::off_t>(done));
+    if(count <= 0)
+    {
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("Can't read value column file") <<
+        ErrorCode(error));
+    }
+
+    writeAll(m_file, &buffer[0], count, header.valuesOffset + done);
+    done += count;
+  }
+
+  if(!m_blocks.empty())
+  {
+    writeAll(m_file, &m_blocks[0],
+      m_blocks.size() * sizeof(ResultFile::BlockRecord), header.blocksOffset);
+  }
+  if(!m_regions.empty())
+  {
+    writeAll(m_file, &m_regions[0],
+      m_regions.size() * sizeof(ResultFile::RegionRecord),
+      header.regionsOffset);
+  }
+  writeAll(m_file, m_strings.data(), m_strings.size(), header.stringsOffset);
+
+  if(::ftruncate(m_file, static_cast< ::off_t>(header.stringsOffset +
+    header.stringsSize)) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't resize result file") <<
+      ErrorCode(error));
+  }
+
+  writeAll(m_file, &header, sizeof(header), 0);
+  m_finished = true;
+}
@@ -0,0 +1,170 @@
+/*
+ScanContext.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/ScanContext.hpp>
+
+using Ethon::CancellationToken;
+using Ethon::ScanContext;
+using Ethon::ScanAbortedError;
+using Ethon::ErrorString;
+
+/* CancellationToken class */
+
+CancellationToken::CancellationToken()
+  : m_cancelled(std::make_shared<std::atomic<bool>>(false))
+{ }
+
+void CancellationToken::cancel() const
+{
+  m_cancelled->store(true);
+}
+
+bool CancellationToken::isCancelled() const
+{
+  return m_cancelled->load();
+}
+
+/* ScanContext::Scope class */
+
+ScanContext::Scope::Scope(ScanContext const& context, std::uint64_t total)
+  : m_context(context)
+{
+  Progress& progress = *m_context.m_progress;
+  {
+    std::lock_guard<std::mutex> lock(progress.mutex);
+    if(progress.depth++)
+      return;
+
+    progress.scanned = 0;
+    progress.total = total;
+  }
+
+  // Called without the lock, callbacks may query the progress.
+  if(m_context.m_callback)
+    m_context.m_callback(0, total);
+}
+
+ScanContext::Scope::~Scope()
+{
+  std::lock_guard<std::mutex> lock(m_context.m_progress->mutex);
+  --m_context.m_progress->depth;
+}
+
+/* ScanContext class */
+
+ScanContext::ScanContext()
+  : m_token(), m_hasDeadline(false), m_deadline(), m_callback(),
+    m_progress(std::make_shared<Progress>())
+{
+  m_progress->scanned = 0;
+  m_progress->total = 0;
+  m_progress->depth = 0;
+}
+
+ScanContext& ScanContext::setToken(CancellationToken const& token)
+{
+  m_token = token;
+  return *this;
+}
+
+CancellationToken const& ScanContext::getToken() const
+{
+  return m_token;
+}
+
+ScanContext& ScanContext::setDeadline(Clock::time_point deadline)
+{
+  m_hasDeadline = true;
+  m_deadline = deadline;
+  return *this;
+}
+
+ScanContext& ScanContext::setTimeout(Clock::duration timeout)
+{
+  return setDeadline(Clock::now() + timeout);
+}
+
+bool ScanContext::hasDeadline() const
+{
+  return m_hasDeadline;
+}
+
+ScanContext::Clock::time_point ScanContext::getDeadline() const
+{
+  return m_deadline;
+}
+
+ScanContext& ScanContext::setProgressCallback(
+  ProgressCallback const& callback)
+{
+  m_callback = callback;
+  return *this;
+}
+
+void ScanContext::check() const
+{
+  if(m_token.isCancelled())
+  {
+    BOOST_THROW_EXCEPTION(ScanAbortedError() <<
+      ErrorString("Scan cancelled"));
+  }
+
+  if(m_hasDeadline && Clock::now() >= m_deadline)
+  {
+    BOOST_THROW_EXCEPTION(ScanAbortedError() <<
+      ErrorString("Scan exceeded its deadline"));
+  }
+}
+
+void ScanContext::advance(std::uint64_t bytes) const
+{
+  std::uint64_t scanned, total;
+  {
+    std::lock_guard<std::mutex> lock(m_progress->mutex);
+    m_progress->scanned += bytes;
+    scanned = m_progress->scanned;
+    total = m_progress->total;
+  }
+
+  if(m_callback)
+    m_callback(scanned, total);
+}
+
+std::uint64_t ScanContext::getScanned() const
+{
+  std::lock_guard<std::mutex> lock(m_progress->mutex);
+  return m_progress->scanned;
+}
+
+std::uint64_t ScanContext::getTotal() const
+{
+  std::lock_guard<std::mutex> lock(m_progress->mutex);
+  return m_progress->total;
+}
@@ -0,0 +1,411 @@
+/*
+ScanPlanner.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// SSE2:
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/ScanPlanner.hpp>
+
+using Ethon::ByteStatistics;
+using Ethon::ScanPlan;
+using Ethon::SearchAlgorithm;
+using Ethon::Signature;
+using Ethon::ArgumentError;
+using Ethon::ErrorString;
+
+namespace
+{
+  // Weight of a sampled byte relative to the whole prior.
+  double const PRIOR_WEIGHT = 256.0;
+
+  // Relative weights of bytes in code and data of typical processes.
+  double priorWeight(std::uint8_t byte)
+  {
+    switch(byte)
+    {
+    case 0x00:
+      return 300.0;
+    case 0xFF: case 0xCC: case 0x90:
+      return 40.0;
+    case 0x48: case 0x8B: case 0x89: case 0x0F: case 0x24: case 0x44:
+    case 0x4C: case 0x85: case 0xE8: case 0x83: case 0x01: case 0xC3:
+      return 16.0;
+    }
+
+    return std::isprint(byte) ? 2.0 : 1.0;
+  }
+
+  std::array<double, 256> const& getPrior()
+  {
+    static std::array<double, 256> const prior = []
+    {
+      std::array<double, 256> result;
+      double total = 0.0;
+      for(std::size_t i = 0; i < 256; ++i)
+        total += result[i] = priorWeight(static_cast<std::uint8_t>(i));
+      for(std::size_t i = 0; i < 256; ++i)
+        result[i] /= total;
+      return result;
+    }();
+
+    return prior;
+  }
+
+  // Bad character shifts of a pattern with wildcards: a wildcard matches
+  // every byte, so no shift may skip past the last one.
+  void computeShifts(Signature const& signature,
+    std::vector<std::size_t>& shifts)
+  {
+    std::vector<std::uint8_t> const& bytes = signature.getBytes();
+    std::vector<std::uint8_t> const& mask = signature.getMask();
+    std::size_t const size = signature.getSize();
+
+    std::size_t first = 0;
+    for(std::size_t i = 0; i + 1 < size; ++i)
+    {
+      if(!mask[i])
+        first = i + 1;
+    }
+
+    shifts.assign(256, size - first);
+    for(std::size_t i = first; i + 1 < size; ++i)
+      shifts[bytes[i]] = size - 1 - i;
+  }
+
+  // Cost of verifying a candidate.
+  double verifyCost(Signature const& signature)
+  {
+    return 4.0 + 2.0 * (signature.getSize() / 16);
+  }
+}
+
+/* ByteStatistics class */
+
+ByteStatistics::ByteStatistics()
+  : m_total(0)
+{
+  m_counts.fill(0);
+}
+
+void ByteStatistics::sample(std::uint8_t const* data, std::size_t size,
+  std::size_t stride)
+{
+  stride = std::max<std::size_t>(stride, 1);
+  for(std::size_t i = 0; i < size; i += stride)
+    ++m_counts[data[i]];
+  m_total += (size + stride - 1) / stride;
+}
+
+double ByteStatistics::getFrequency(std::uint8_t byte) const
+{
+  return (m_counts[byte] + PRIOR_WEIGHT * getPrior()[byte]) /
+    (m_total + PRIOR_WEIGHT);
+}
+
+std::uint64_t ByteStatistics::getSampleCount() const
+{
+  return m_total;
+}
+
+/* ScanPlan class */
+
+ScanPlan::ScanPlan(Signature const& signature, SearchAlgorithm algorithm,
+  ByteStatistics const& statistics)
+  : m_signature(&signature), m_algorithm(algorithm),
+    m_anchor(signature.getAnchor()), m_second(signature.getSecondAnchor())
+{
+  if(!isApplicable(signature, algorithm))
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Search algorithm not applicable to signature"));
+  }
+
+  // Anchors of the signature were picked using the prior.
+  if(statistics.getSampleCount())
+    signature.selectAnchors(statistics, m_anchor, m_second);
+
+  if(algorithm == SearchAlgorithm::HORSPOOL)
+    computeShifts(signature, m_shifts);
+
+  if(algorithm == SearchAlgorithm::BITAP)
+  {
+    std::vector<std::uint8_t> const& bytes = signature.getBytes();
+    std::vector<std::uint8_t> const& mask = signature.getMask();
+
+    m_masks.assign(256, 0);
+    for(std::size_t i = 0; i < signature.getSize(); ++i)
+    {
+      std::uint64_t bit = static_cast<std::uint64_t>(1) << i;
+      if(!mask[i])
+      {
+        for(std::size_t j = 0; j < 256; ++j)
+          m_masks[j] |= bit;
+      }
+      else
+        m_masks[bytes[i]] |= bit;
+    }
+  }
+}
+
+bool ScanPlan::isApplicable(Signature const& signature,
+  SearchAlgorithm algorithm)
+{
+  return algorithm != SearchAlgorithm::BITAP || signature.getSize() <= 64;
+}
+
+double ScanPlan::estimateCost(Signature const& signature,
+  SearchAlgorithm algorithm, ByteStatistics const& statistics)
+{
+  std::size_t anchor, second;
+  signature.selectAnchors(statistics, anchor, second);
+
+  std::vector<std::uint8_t> const& bytes = signature.getBytes();
+  std::vector<std::uint8_t> const& mask = signature.getMask();
+  double const anchorFrequency = statistics.getFrequency(bytes[anchor]);
+  double const pairFrequency = second == anchor ? anchorFrequency :
+    anchorFrequency * statistics.getFrequency(bytes[second]);
+
+  switch(algorithm)
+  {
+  case SearchAlgorithm::MEMCHR:
+    // Vectorized scanning is nearly free, but restarting it after every
+    // hit is not.
+    return 0.19 + anchorFrequency * (110.0 + verifyCost(signature));
+
+  case SearchAlgorithm::SIMD_PAIR:
+    return 0.5 + pairFrequency * (4.0 + verifyCost(signature));
+
+  case SearchAlgorithm::HORSPOOL:
+    {
+      std::vector<std::size_t> shifts;
+      computeShifts(signature, shifts);
+
+      double shift = 0.0;
+      for(std::size_t i = 0; i < 256; ++i)
+        shift += statistics.getFrequency(static_cast<std::uint8_t>(i)) *
+          shifts[i];
+
+      std::size_t const last = signature.getSize() - 1;
+      double lastFrequency = mask[last] ?
+        statistics.getFrequency(bytes[last]) : 1.0;
+      // Steps depend on each other, so each costs a whole load latency.
+      return (32.0 + lastFrequency * verifyCost(signature)) / shift;
+    }
+
+  case SearchAlgorithm::BITAP:
+    return 2.7;
+  }
+
+  return 0.0;
+}
+
+SearchAlgorithm ScanPlan::getAlgorithm() const
+{
+  return m_algorithm;
+}
+
+std::size_t ScanPlan::searchMemchr(std::uint8_t const* data, std::size_t size,
+  std::size_t start) const
+{
+  std::size_t const last = size - m_signature->getSize();
+  std::uint8_t const anchor = m_signature->getBytes()[m_anchor];
+
+  for(std::size_t i = start; i <= last; ++i)
+  {
+    void const* found = std::memchr(data + i + m_anchor, anchor,
+      last - i + 1);
+    if(!found)
+      break;
+
+    i = static_cast<std::uint8_t const*>(found) - data - m_anchor;
+    if(m_signature->matches(data + i, size - i))
+      return i;
+  }
+
+  return Signature::npos;
+}
+
+std::size_t ScanPlan::searchPair(std::uint8_t const* data, std::size_t size,
+  std::size_t start) const
+{
+  std::size_t const last = size - m_signature->getSize();
+  std::uint8_t const anchor = m_signature->getBytes()[m_anchor];
+  std::uint8_t const second = m_signature->getBytes()[m_second];
+  std::size_t i = start;
+
+#ifdef __SSE2__
+  // Tests both anchors for 16 candidates at once.
+  __m128i const anchors = _mm_set1_epi8(static_cast<char>(anchor));
+  __m128i const seconds = _mm_set1_epi8(static_cast<char>(second));
+  for(; i <= last && last - i >= 15; i += 16)
+  {
+    __m128i first = _mm_loadu_si128(
+      reinterpret_cast<__m128i const*>(data + i + m_anchor));
+    __m128i other = _mm_loadu_si128(
+      reinterpret_cast<__m128i const*>(data + i + m_second));
+    unsigned bits = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(first, anchors), _mm_cmpeq_epi8(other, seconds)));
+
+    while(bits)
+    {
+      std::size_t candidate = i + __builtin_ctz(bits);
+      if(m_signature->matches(data + candidate, size - candidate))
+        return candidate;
+      bits &= bits - 1;
+    }
+  }
+#endif
+
+  while(i <= last)
+  {
+    void const* found = std::memchr(data + i + m_anchor, anchor,
+      last - i + 1);
+    if(!found)
+      break;
+
+    i = static_cast<std::uint8_t const*>(found) - data - m_anchor;
+    if(data[i + m_second] == second &&
+      m_signature->matches(data + i, size - i))
+    {
+      return i;
+    }
+    ++i;
+  }
+
+  return Signature::npos;
+}
+
+std::size_t ScanPlan::searchHorspool(std::uint8_t const* data,
+  std::size_t size, std::size_t start) const
+{
+  std::size_t const length = m_signature->getSize();
+  std::size_t const last = size - length;
+  bool const lastFixed = m_signature->getMask()[length - 1] != 0;
+  std::uint8_t const lastByte = m_signature->getBytes()[length - 1];
+
+  for(std::size_t i = start; i <= last; )
+  {
+    std::uint8_t cur = data[i + length - 1];
+    if((!lastFixed || cur == lastByte) &&
+      m_signature->matches(data + i, size - i))
+    {
+      return i;
+    }
+
+    i += m_shifts[cur];
+  }
+
+  return Signature::npos;
+}
+
+std::size_t ScanPlan::searchBitap(std::uint8_t const* data, std::size_t size,
+  std::size_t start) const
+{
+  std::size_t const length = m_signature->getSize();
+  std::uint64_t const hit = static_cast<std::uint64_t>(1) << (length - 1);
+
+  std::uint64_t state = 0;
+  for(std::size_t i = start; i < size; ++i)
+  {
+    state = ((state << 1) | 1) & m_masks[data[i]];
+    if(state & hit)
+      return i + 1 - length;
+  }
+
+  return Signature::npos;
+}
+
+std::size_t ScanPlan::search(std::uint8_t const* data, std::size_t size,
+  std::size_t start) const
+{
+  std::size_t const length = m_signature->getSize();
+  if(size < length || start > size - length)
+    return Signature::npos;
+  if(m_signature->isWildcardOnly())
+    return start;
+
+  switch(m_algorithm)
+  {
+  case SearchAlgorithm::MEMCHR:
+    return searchMemchr(data, size, start);
+  case SearchAlgorithm::SIMD_PAIR:
+    return searchPair(data, size, start);
+  case SearchAlgorithm::HORSPOOL:
+    return searchHorspool(data, size, start);
+  case SearchAlgorithm::BITAP:
+    return searchBitap(data, size, start);
+  }
+
+  return Signature::npos;
+}
+
+void ScanPlan::match(std::uint8_t const* data, std::size_t size,
+  std::uintptr_t address, std::vector<std::uintptr_t>& results,
+  std::size_t limit) const
+{
+  for(std::size_t found = search(data, size); found != Signature::npos &&
+    limit; found = search(data, size, found + 1), --limit)
+  {
+    results.push_back(address + found);
+  }
+}
+
+ScanPlan Ethon::planSearch(Signature const& signature,
+  ByteStatistics const& statistics)
+{
+  static SearchAlgorithm const algorithms[] = {
+    SearchAlgorithm::MEMCHR, SearchAlgorithm::SIMD_PAIR,
+    SearchAlgorithm::HORSPOOL, SearchAlgorithm::BITAP
+  };
+
+  SearchAlgorithm best = SearchAlgorithm::SIMD_PAIR;
+  double bestCost = ScanPlan::estimateCost(signature, best, statistics);
+  BOOST_FOREACH(SearchAlgorithm cur, algorithms)
+  {
+    if(!ScanPlan::isApplicable(signature, cur))
+      continue;
+
+    double cost = ScanPlan::estimateCost(signature, cur, statistics);
+    if(cost < bestCost)
+    {
+      best = cur;
+      bestCost = cost;
+    }
+  }
+
+  return ScanPlan(signature, best, statistics);
+}
@@ -24,6 +24,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <memory>
+#include <cmath>
+#include <random>
+#include <unordered_set>
 
 // Boost Library:
 #include <boost/foreach.hpp>
@@ -33,224 +37,860 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <Ethon/MemoryRegions.hpp>
 #include <Ethon/Error.hpp>
 #include <Ethon/Scanner.hpp>
+#include <Ethon/ValueQuery.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/ScanPlanner.hpp>
+#include <Ethon/StringQuery.hpp>
+#include <Ethon/StructQuery.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/RegionOrder.hpp>
+#include <Ethon/AddressSet.hpp>
+#include <Ethon/ResultFile.hpp>
 
 using Ethon::MemoryEditor;
 using Ethon::Scanner;
 using Ethon::EthonError;
+using Ethon::ArgumentError;
 using Ethon::MemoryRegion;
-using Ethon::MemoryRegionSequence;
+using Ethon::MemorySource;
+using Ethon::ProcessMemorySource;
+using Ethon::ScanContext;
+using Ethon::RegionOrder;
 using Ethon::ByteContainer;
-
-struct WrappedByte
+using Ethon::ValueType;
+using Ethon::ValueQuery;
+using Ethon::Signature;
+using Ethon::ScanPlan;
+using Ethon::ByteStatistics;
+using Ethon::StringQuery;
+using Ethon::StringMatch;
+using Ethon::StructQuery;
+using Ethon::AddressSet;
+using Ethon::ResultWriter;
+using Ethon::ScanEstimate;
+
+namespace
 {
-  WrappedByte() = default;
-  WrappedByte(std::uint8_t value_, bool wildcard_)
-    : value(value_), wildcard(wildcard_)
-  { }
+  // Seed of the page sampling, fixed so estimates are reproducible.
+  std::uint64_t const SAMPLING_SEED = 0x5EED5EED5EED5EEDULL;
+
+  // Finds z with P(Z <= z) = probability for a standard normal Z.
+  double getNormalQuantile(double probability)
+  {
+    double low = -10.0;
+    double high = 10.0;
+    for(int i = 0; i < 100; ++i)
+    {
+      double const middle = (low + high) / 2;
+      if(0.5 * std::erfc(-middle / std::sqrt(2.0)) < probability)
+        low = middle;
+      else
+        high = middle;
+    }
+
+    return (low + high) / 2;
+  }
+
+  // Draws count distinct numbers below total in ascending order, using
+  // Floyd's algorithm.
+  std::vector<std::uint64_t> drawSample(std::uint64_t total,
+    std::uint64_t count, std::mt19937_64& random)
+  {
+    std::unordered_set<std::uint64_t> chosen;
+    for(std::uint64_t i = total - count; i < total; ++i)
+    {
+      std::uint64_t const candidate =
+        std::uniform_int_distribution<std::uint64_t>(0, i)(random);
+      if(!chosen.insert(candidate).second)
+        chosen.insert(i);
+    }
+
+    std::vector<std::uint64_t> sample(chosen.begin(), chosen.end());
+    std::sort(sample.begin(), sample.end());
+    return sample;
+  }
 
-  std::uint8_t value;
-  bool wildcard;
-};
+  // Address sets are built in ascending order.
+  void sortByAddress(std::vector<MemoryRegion>& regions)
+  {
+    std::sort(regions.begin(), regions.end(),
+      [](MemoryRegion const& lhs, MemoryRegion const& rhs)
+      {
+        return lhs.getStartAddress() < rhs.getStartAddress();
+      });
+  }
 
-static std::vector<WrappedByte> compilePattern(std::string const& pattern,
-  std::string const& mask)
+  // An empty value is found at the start of the first readable region, like
+  // std::search finds it at the start of a buffer.
+  std::uintptr_t findEmpty(std::vector<MemoryRegion> const& regions)
+  {
+    BOOST_FOREACH(MemoryRegion const& cur, regions)
+    {
+      if(cur.isReadable())
+        return cur.getStartAddress();
+    }
+    return 0;
+  }
+}
+
+std::size_t Ethon::getValueTypeSize(ValueType type)
 {
-  if(pattern.length() != mask.length())
+  switch(type)
   {
-    BOOST_THROW_EXCEPTION(EthonError() <<
-      Ethon::ErrorString("Pattern and mask have not equal size"));
+  case ValueType::INT8:
+  case ValueType::UINT8:
+    return 1;
+  case ValueType::INT16:
+  case ValueType::UINT16:
+    return 2;
+  case ValueType::INT32:
+  case ValueType::UINT32:
+  case ValueType::FLOAT:
+    return 4;
+  case ValueType::INT64:
+  case ValueType::UINT64:
+  case ValueType::DOUBLE:
+    return 8;
   }
 
-  std::vector<WrappedByte> values(pattern.length());
-  for(std::size_t i = 0, len = pattern.length(); i < len; ++i)
-    values[i] = WrappedByte(pattern[i], mask[i] == '*');
+  BOOST_THROW_EXCEPTION(Ethon::ArgumentError() <<
+    Ethon::ErrorString("Unknown value type"));
+}
+
+/* Scanner class */
+
+std::size_t const Scanner::CHUNK_SIZE;
+std::size_t const Scanner::SAMPLING_THRESHOLD;
+std::size_t const Scanner::SAMPLE_PAGE_SIZE;
+
+Scanner::Scanner(MemoryEditor const& editor)
+  : m_source(std::make_shared<ProcessMemorySource>(editor)), m_context(),
+    m_order(RegionOrder::addressOrder())
+{ }
+
+Scanner::Scanner(std::shared_ptr<MemorySource> const& source)
+  : m_source(source), m_context(),
+    m_order(RegionOrder::addressOrder())
+{ }
 
-  return std::move(values);
+std::shared_ptr<MemorySource> const& Scanner::getSource() const
+{
+  return m_source;
 }
 
-static bool operator==(std::uint8_t lhs, WrappedByte rhs)
+void Scanner::setContext(ScanContext const& context)
 {
-  return rhs.wildcard ? true : lhs == rhs.value;
+  m_context = context;
 }
 
-static std::uintptr_t impl_findPattern(
-    std::vector<WrappedByte> const& compiled,
-    MemoryRegion const* region, MemoryEditor& edit)
+ScanContext const& Scanner::getContext() const
 {
-  // If region is zero, scan all regions
-  if(!region)
-  {
-    MemoryRegionSequence seq =
-      makeMemoryRegionSequence(edit.getProcess());
+  return m_context;
+}
 
-    BOOST_FOREACH(MemoryRegion const& cur, seq)
-    {
-      std::uintptr_t result = impl_findPattern(compiled, &cur, edit);
-      if(result)
-        return result;
-    }
+void Scanner::setRegionOrder(RegionOrder const& order)
+{
+  m_order = order;
+}
+
+RegionOrder const& Scanner::getRegionOrder() const
+{
+  return m_order;
+}
+
+std::uintptr_t Scanner::find(ByteContainer const& value,
+  MemoryRegion const* region)
+{
+  if(value.empty())
+    return findEmpty(selectRegions(region));
+
+  std::string bytes(value.begin(), value.end());
+  return findSignature(Signature(bytes, std::string(bytes.size(), '-')),
+    region);
+}
+
+std::uintptr_t Scanner::find(ByteContainer const& value,
+  RegionFilter const& filter)
+{
+  if(value.empty())
+    return findEmpty(selectRegions(filter));
+
+  std::string bytes(value.begin(), value.end());
+  return findSignature(Signature(bytes, std::string(bytes.size(), '-')),
+    filter);
+}
+
+std::uintptr_t Scanner::findPattern(std::string const& pattern,
+  std::string const& mask, MemoryRegion const* region)
+{
+  return findSignature(*Signature::compile(pattern, mask), region);
+}
+
+std::uintptr_t Scanner::findPattern(std::string const& pattern,
+  std::string const& mask, RegionFilter const& filter)
+{
+  return findSignature(*Signature::compile(pattern, mask), filter);
+}
+
+std::size_t Scanner::readChunk(std::uintptr_t address, std::uint8_t* dest,
+  std::size_t amount)
+{
+  return m_source->read(address, dest, amount);
+}
+
+std::vector<MemoryRegion> Scanner::selectRegions(MemoryRegion const* region)
+  const
+{
+  if(region)
+    return std::vector<MemoryRegion>(1, *region);
+
+  return m_source->getRegions();
+}
+
+std::vector<MemoryRegion> Scanner::selectRegions(RegionFilter const& filter)
+  const
+{
+  return filter.select(m_source->getRegions());
+}
+
+std::uint64_t Scanner::getScanSize(std::vector<MemoryRegion> const& regions)
+{
+  std::uint64_t size = 0;
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(cur.isReadable())
+      size += cur.getSize();
   }
 
-  // Else just scan the specified region
-  else
+  return size;
+}
+
+bool Scanner::walkRegion(MemoryRegion const& region, std::size_t overlap,
+  ChunkVisitor const& visitor)
+{
+  std::size_t const size = std::min<std::size_t>(CHUNK_SIZE + overlap,
+    region.getSize());
+  if(!size)
+    return true;
+
+  // Only allocated once a chunk has to be copied.
+  ByteContainer buffer;
+  for(std::uintptr_t address = region.getStartAddress();
+    address < region.getEndAddress(); address += CHUNK_SIZE)
   {
-    ByteContainer buffer;
-    // Trying to read from device memory always results in I/O errors, so I
-    // guess it's best practise to catch them here.
-    try
+    m_context.check();
+
+    std::size_t amount = std::min<std::size_t>(size,
+      region.getEndAddress() - address);
+
+    std::size_t read;
+    std::uint8_t const* data = m_source->map(address, read);
+    if(data)
     {
-      buffer = edit.read<ByteContainer>(
-        region->getStartAddress(), region->getSize());
+      read = std::min(read, amount);
     }
-    catch(EthonError const& e)
+    else
     {
-      std::error_code const* errorCode =
-        boost::get_error_info<Ethon::ErrorCode>(e);
-      if(errorCode && errorCode->value() == EIO)
-        return 0;
-
-      // Another error occurred, rethrow.
-      throw;
+      buffer.resize(size);
+      read = readChunk(address, &buffer[0], amount);
+      data = &buffer[0];
     }
 
-    auto itr = std::search(buffer.begin(), buffer.end(),
-      compiled.begin(), compiled.end());
-    if(itr != buffer.end())
+    if(read && !visitor(data, read, address))
+      return false;
+
+    // Skip the rest of the region if it could not be read entirely.
+    std::size_t const remaining = region.getEndAddress() - address;
+    if(read != amount)
     {
-      std::uintptr_t offset = itr - buffer.begin();
-      return region->getStartAddress() + offset;
+      m_context.advance(remaining);
+      break;
     }
+
+    m_context.advance(std::min(remaining, CHUNK_SIZE));
   }
 
-  return 0;
+  return true;
 }
 
+std::vector<std::uintptr_t> Scanner::findAll(ValueQuery const& query,
+  MemoryRegion const* region, std::size_t limit)
+{
+  std::vector<std::uintptr_t> results;
+  std::vector<MemoryRegion> regions = selectRegions(region);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(!cur.isReadable())
+      continue;
+
+    bool more = walkRegion(cur, query.getSize() - 1,
+      [&](std::uint8_t const* data, std::size_t size, std::uintptr_t address)
+      {
+        query.match(data, size, address, results, limit - results.size());
+        return results.size() < limit;
+      });
+
+    if(!more)
+      break;
+  }
 
-/* Scanner class */
+  return results;
+}
 
-Scanner::Scanner(MemoryEditor const& editor)
-  : m_editor(editor)
-{ }
+std::vector<std::uintptr_t> Scanner::findAll(ValueQuery const& query,
+  RegionFilter const& filter, std::size_t limit)
+{
+  std::vector<std::uintptr_t> results;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    std::vector<std::uintptr_t> found = findAll(query, &cur,
+      limit - results.size());
+    results.insert(results.end(), found.begin(), found.end());
+    if(results.size() >= limit)
+      break;
+  }
 
-std::uintptr_t Scanner::find(ByteContainer const& value,
-  MemoryRegion const* region)
+  return results;
+}
+
+AddressSet Scanner::findAllSet(ValueQuery const& query,
+  RegionFilter const& filter)
 {
-  // If region is zero, scan all regions
-  if(!region)
+  AddressSet results;
+  std::vector<std::uintptr_t> found;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  sortByAddress(regions);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
   {
-    MemoryRegionSequence seq =
-      makeMemoryRegionSequence(m_editor.getProcess());
+    if(!cur.isReadable())
+      continue;
+
+    walkRegion(cur, query.getSize() - 1,
+      [&](std::uint8_t const* data, std::size_t size, std::uintptr_t address)
+      {
+        found.clear();
+        query.match(data, size, address, found);
+        results.append(found);
+        return true;
+      });
+  }
+
+  return results;
+}
 
-    BOOST_FOREACH(MemoryRegion const& cur, seq)
+std::uint64_t Scanner::findAll(ValueQuery const& query,
+  RegionFilter const& filter, ResultWriter& writer)
+{
+  std::size_t const valueSize = writer.getValueSize();
+  if(valueSize && valueSize != query.getSize())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Value column does not match the query's size"));
+  }
+
+  std::uint64_t const first = writer.size();
+  std::vector<std::uintptr_t> found;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  sortByAddress(regions);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(!cur.isReadable())
+      continue;
+
+    writer.beginRegion(cur);
+    walkRegion(cur, query.getSize() - 1,
+      [&](std::uint8_t const* data, std::size_t size, std::uintptr_t address)
+      {
+        found.clear();
+        query.match(data, size, address, found);
+        BOOST_FOREACH(std::uintptr_t match, found)
+          writer.append(match, data + (match - address));
+        return true;
+      });
+  }
+
+  return writer.size() - first;
+}
+
+ScanEstimate Scanner::estimateMatches(RegionFilter const& filter,
+  std::size_t span, double fraction, double confidence,
+  SampleCounter const& counter)
+{
+  if(!(fraction > 0.0 && fraction <= 1.0) ||
+    !(confidence > 0.0 && confidence < 1.0))
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Invalid sampling fraction or confidence level"));
+  }
+
+  // Every region is a stratum, sampled in proportion to its page count.
+  std::mt19937_64 random(SAMPLING_SEED);
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  std::vector<std::vector<std::uint64_t>> samples(regions.size());
+  ScanEstimate result = ScanEstimate();
+  std::uint64_t totalPages = 0;
+  std::uint64_t sampledPages = 0;
+  for(std::size_t i = 0; i < regions.size(); ++i)
+  {
+    if(!regions[i].isReadable())
+      continue;
+
+    std::uint64_t const pages = (regions[i].getSize() + SAMPLE_PAGE_SIZE - 1) /
+      SAMPLE_PAGE_SIZE;
+    if(!pages)
+      continue;
+
+    std::uint64_t const count = std::min(pages, std::max<std::uint64_t>(1,
+      static_cast<std::uint64_t>(std::ceil(fraction * pages))));
+    samples[i] = drawSample(pages, count, random);
+    totalPages += pages;
+    sampledPages += count;
+    result.totalBytes += regions[i].getSize();
+  }
+
+  ScanContext::Scope scope(m_context, sampledPages * SAMPLE_PAGE_SIZE);
+  ByteContainer buffer(SAMPLE_PAGE_SIZE + span - 1);
+  double variance = 0.0;
+  for(std::size_t i = 0; i < regions.size(); ++i)
+  {
+    std::vector<std::uint64_t> const& sample = samples[i];
+    if(sample.empty())
+      continue;
+
+    MemoryRegion const& region = regions[i];
+    double sum = 0.0;
+    double squares = 0.0;
+    BOOST_FOREACH(std::uint64_t page, sample)
     {
-      std::uintptr_t result = find(value, &cur);
-      if(result)
-        return result;
+      m_context.check();
+
+      std::uintptr_t const address = region.getStartAddress() +
+        page * SAMPLE_PAGE_SIZE;
+      std::size_t const remaining = region.getEndAddress() - address;
+      std::size_t const bytes = std::min(remaining, SAMPLE_PAGE_SIZE);
+      std::size_t const read = readChunk(address, &buffer[0],
+        std::min(remaining, buffer.size()));
+
+      std::size_t const matches = read ?
+        counter(&buffer[0], read, std::min(bytes, read), address) : 0;
+      sum += matches;
+      squares += static_cast<double>(matches) * matches;
+      result.sampledMatches += matches;
+      result.sampledBytes += bytes;
+      m_context.advance(SAMPLE_PAGE_SIZE);
     }
+
+    // Without a second page, the count is assumed Poisson distributed.
+    double const pages = static_cast<double>(
+      (region.getSize() + SAMPLE_PAGE_SIZE - 1) / SAMPLE_PAGE_SIZE);
+    double const count = static_cast<double>(sample.size());
+    double const mean = sum / count;
+    double const spread = count > 1 ?
+      std::max(0.0, (squares - count * mean * mean) / (count - 1)) : mean;
+    result.matches += pages * mean;
+    variance += pages * pages * (1.0 - count / pages) * spread / count;
   }
 
-  // Else just scan the specified region
-  else
+  double const z = getNormalQuantile((1.0 + confidence) / 2);
+  double const margin = z * std::sqrt(variance);
+  result.lower = std::max<double>(result.sampledMatches,
+    result.matches - margin);
+  result.upper = result.matches + margin;
+
+  // No match at all only bounds the rate of matches per page.
+  if(!result.sampledMatches && sampledPages < totalPages)
   {
-    ByteContainer buffer;
-    // Trying to read from device memory always results in I/O errors, so I
-    // guess it's best practise to catch them here.
-    try
+    result.upper = -std::log(1.0 - confidence) *
+      static_cast<double>(totalPages) / sampledPages;
+  }
+
+  return result;
+}
+
+ScanEstimate Scanner::estimate(ValueQuery const& query,
+  RegionFilter const& filter, double fraction, double confidence)
+{
+  std::size_t const size = query.getSize();
+  std::vector<std::uintptr_t> found;
+  return estimateMatches(filter, size, fraction, confidence,
+    [&](std::uint8_t const* data, std::size_t available, std::size_t count,
+      std::uintptr_t address) -> std::size_t
     {
-      buffer = m_editor.read<ByteContainer>(
-        region->getStartAddress(), region->getSize());
-    }
-    catch(EthonError const& e)
+      found.clear();
+      return query.match(data, std::min(available, count + size - 1),
+        address, found);
+    });
+}
+
+ScanEstimate Scanner::estimate(Signature const& signature,
+  RegionFilter const& filter, double fraction, double confidence)
+{
+  std::size_t const size = signature.getSize();
+  std::vector<std::uintptr_t> found;
+  return estimateMatches(filter, size, fraction, confidence,
+    [&](std::uint8_t const* data, std::size_t available, std::size_t count,
+      std::uintptr_t address) -> std::size_t
     {
-      std::error_code const* errorCode =
-        boost::get_error_info<Ethon::ErrorCode>(e);
-      if(errorCode && errorCode->value() == EIO)
-        return 0;
+      found.clear();
+      signature.match(data, std::min(available, count + size - 1), address,
+        found);
+      return found.size();
+    });
+}
 
-      // Another error occurred, rethrow.
-      throw;
-    }
+ScanEstimate Scanner::estimate(StructQuery const& query,
+  RegionFilter const& filter, double fraction, double confidence)
+{
+  if(query.getFields().empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Struct query without fields"));
+  }
 
-    auto itr = std::search(buffer.begin(), buffer.end(),
-      value.begin(), value.end());
-    if(itr != buffer.end())
+  std::vector<std::uintptr_t> found;
+  return estimateMatches(filter, query.getSpan(), fraction, confidence,
+    [&](std::uint8_t const* data, std::size_t available, std::size_t count,
+      std::uintptr_t address) -> std::size_t
     {
-      std::uintptr_t offset = itr - buffer.begin();
-      return region->getStartAddress() + offset;
-    }
-  }
+      found.clear();
+      return query.match(data, available, count, address, found);
+    });
+}
 
-  return 0;
+std::uintptr_t Scanner::find(ValueQuery const& query,
+  MemoryRegion const* region)
+{
+  return findFirst(selectRegions(region),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<std::uintptr_t> results = findAll(query, &cur, 1);
+      return results.empty() ? 0 : results.front();
+    });
 }
 
-std::uintptr_t Scanner::find(ByteContainer const& value,
-  std::string const& perms)
+std::uintptr_t Scanner::find(ValueQuery const& query,
+  RegionFilter const& filter)
+{
+  return findFirst(selectRegions(filter),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<std::uintptr_t> results = findAll(query, &cur, 1);
+      return results.empty() ? 0 : results.front();
+    });
+}
+
+std::vector<std::uintptr_t> Scanner::findAll(Signature const& signature,
+  MemoryRegion const* region, std::size_t limit)
 {
-  if(perms.length() != 4)
+  std::size_t const size = signature.getSize();
+  std::size_t const span = signature.getSpan();
+
+  std::vector<std::uintptr_t> results;
+  std::vector<MemoryRegion> regions = selectRegions(region);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
   {
-    BOOST_THROW_EXCEPTION(EthonError() <<
-      ErrorString("No valid 'rwxs' permission string"));
+    if(!cur.isReadable())
+      continue;
+
+    // The kernel is planned on the region's first chunk, large regions
+    // sample their byte frequencies from it.
+    std::unique_ptr<ScanPlan> plan;
+
+    // The overlap covers the bytes a reference needs, matches starting in
+    // it belong to the next chunk though.
+    bool more = walkRegion(cur, span - 1,
+      [&](std::uint8_t const* data, std::size_t amount,
+        std::uintptr_t address) -> bool
+      {
+        if(!plan)
+        {
+          ByteStatistics statistics;
+          if(cur.getSize() >= SAMPLING_THRESHOLD)
+            statistics.sample(data, amount);
+          plan.reset(new ScanPlan(planSearch(signature, statistics)));
+        }
+
+        // Matches whose reference can't be resolved are skipped, searching
+        // goes on behind them until the limit is reached.
+        std::size_t const end = std::min(amount, CHUNK_SIZE + size - 1);
+        for(std::size_t start = 0; start < end && results.size() < limit; )
+        {
+          std::size_t const first = results.size();
+          plan->match(data + start, end - start, address + start, results,
+            limit - results.size());
+          if(results.size() == first)
+            break;
+
+          start = results.back() - address + 1;
+          std::size_t kept = first;
+          for(std::size_t i = first; i < results.size(); ++i)
+          {
+            std::size_t const offset = results[i] - address;
+            std::uintptr_t target;
+            if(signature.resolve(data + offset, amount - offset, results[i],
+              target))
+            {
+              results[kept++] = target;
+              continue;
+            }
+
+            // The reference may lie behind the end of the chunk.
+            if(amount - offset < span)
+            {
+              ByteContainer tail(span);
+              std::size_t got = readChunk(results[i], &tail[0], span);
+              if(signature.resolve(&tail[0], got, results[i], target))
+                results[kept++] = target;
+            }
+          }
+
+          bool const complete = kept == results.size();
+          results.resize(kept);
+          if(complete)
+            break;
+        }
+
+        return results.size() < limit;
+      });
+
+    if(!more)
+      break;
   }
 
-  bool mayRead    = perms[0] == 'r';
-  bool mayWrite   = perms[1] == 'w';
-  bool mayExecute = perms[2] == 'x';
-  bool mayShared  = perms[3] == 's';
+  return results;
+}
 
-  MemoryRegionSequence seq =
-    makeMemoryRegionSequence(m_editor.getProcess());
-  BOOST_FOREACH(MemoryRegion const& cur, seq)
+std::vector<std::uintptr_t> Scanner::findAll(Signature const& signature,
+  RegionFilter const& filter, std::size_t limit)
+{
+  std::vector<std::uintptr_t> results;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
   {
-    if( (cur.isReadable() == mayRead || perms[0] == '*') &&
-        (cur.isWriteable() == mayWrite || perms[1] == '*') &&
-        (cur.isExecuteable() == mayExecute || perms[2] == '*') &&
-        (cur.isShared() == mayShared || perms[3] == '*') )
-    {
-      std::uintptr_t result = find(value, &cur);
-      if(result)
-        return result;
-    }
+    std::vector<std::uintptr_t> found = findAll(signature, &cur,
+      limit - results.size());
+    results.insert(results.end(), found.begin(), found.end());
+    if(results.size() >= limit)
+      break;
   }
 
-  return 0;
+  return results;
 }
 
-std::uintptr_t Scanner::findPattern(std::string const& pattern,
-  std::string const& mask, MemoryRegion const* region)
+std::uintptr_t Scanner::findSignature(Signature const& signature,
+  MemoryRegion const* region)
 {
-  return impl_findPattern(compilePattern(pattern, mask), region, m_editor);
+  return findFirst(selectRegions(region),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<std::uintptr_t> results = findAll(signature, &cur, 1);
+      return results.empty() ? 0 : results.front();
+    });
 }
 
-#include <iostream>
-std::uintptr_t Scanner::findPattern(std::string const& pattern,
-  std::string const& mask, std::string const& perms)
+std::uintptr_t Scanner::findSignature(Signature const& signature,
+  RegionFilter const& filter)
 {
-  if(perms.length() != 4)
+  return findFirst(selectRegions(filter),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<std::uintptr_t> results = findAll(signature, &cur, 1);
+      return results.empty() ? 0 : results.front();
+    });
+}
+
+std::uintptr_t Scanner::findSignature(std::string const& signature,
+  MemoryRegion const* region)
+{
+  return findSignature(*Signature::compile(signature), region);
+}
+
+std::uintptr_t Scanner::findSignature(std::string const& signature,
+  RegionFilter const& filter)
+{
+  return findSignature(*Signature::compile(signature), filter);
+}
+
+std::vector<StringMatch> Scanner::findAll(StringQuery const& query,
+  MemoryRegion const* region, std::size_t limit)
+{
+  std::vector<StringMatch> results;
+  std::vector<MemoryRegion> regions = selectRegions(region);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
   {
-    BOOST_THROW_EXCEPTION(EthonError() <<
-      ErrorString("No valid 'rwxs' permission string"));
+    if(!cur.isReadable())
+      continue;
+
+    // Matches starting in the overlap belong to the next chunk.
+    bool more = walkRegion(cur, query.getMaxSize() - 1,
+      [&](std::uint8_t const* data, std::size_t amount,
+        std::uintptr_t address) -> bool
+      {
+        query.match(data, amount, std::min(amount, CHUNK_SIZE), address,
+          results, limit - results.size());
+        return results.size() < limit;
+      });
+
+    if(!more)
+      break;
   }
 
-  bool mayRead    = perms[0] == 'r';
-  bool mayWrite   = perms[1] == 'w';
-  bool mayExecute = perms[2] == 'x';
-  bool mayShared  = perms[3] == 's';
+  return results;
+}
 
-  MemoryRegionSequence seq =
-    makeMemoryRegionSequence(m_editor.getProcess());
-  auto compiled = compilePattern(pattern, mask);
-  BOOST_FOREACH(MemoryRegion const& cur, seq)
+std::vector<StringMatch> Scanner::findAll(StringQuery const& query,
+  RegionFilter const& filter, std::size_t limit)
+{
+  std::vector<StringMatch> results;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
   {
-    if( (cur.isReadable() == mayRead || perms[0] == '*') &&
-        (cur.isWriteable() == mayWrite || perms[1] == '*') &&
-        (cur.isExecuteable() == mayExecute || perms[2] == '*') &&
-        (cur.isShared() == mayShared || perms[3] == '*') )
+    std::vector<StringMatch> found = findAll(query, &cur,
+      limit - results.size());
+    results.insert(results.end(), found.begin(), found.end());
+    if(results.size() >= limit)
+      break;
+  }
+
+  return results;
+}
+
+std::uintptr_t Scanner::find(StringQuery const& query,
+  MemoryRegion const* region)
+{
+  return findFirst(selectRegions(region),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
     {
-      std::uintptr_t result = impl_findPattern(compiled, &cur, m_editor);
-      if(result)
-        return result;
-    }
+      std::vector<StringMatch> results = findAll(query, &cur, 1);
+      return results.empty() ? 0 : results.front().address;
+    });
+}
+
+std::uintptr_t Scanner::find(StringQuery const& query,
+  RegionFilter const& filter)
+{
+  return findFirst(selectRegions(filter),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<StringMatch> results = findAll(query, &cur, 1);
+      return results.empty() ? 0 : results.front().address;
+    });
+}
+
+std::vector<std::uintptr_t> Scanner::findAll(StructQuery const& query,
+  MemoryRegion const* region, std::size_t limit)
+{
+  if(query.getFields().empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Struct query without fields"));
   }
 
-  return 0;
+  std::vector<std::uintptr_t> results;
+  std::vector<MemoryRegion> regions = selectRegions(region);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(!cur.isReadable())
+      continue;
+
+    // Structures starting in the overlap belong to the next chunk.
+    bool more = walkRegion(cur, query.getSpan() - 1,
+      [&](std::uint8_t const* data, std::size_t amount,
+        std::uintptr_t address) -> bool
+      {
+        query.match(data, amount, std::min(amount, CHUNK_SIZE), address,
+          results, limit - results.size());
+        return results.size() < limit;
+      });
+
+    if(!more)
+      break;
+  }
+
+  return results;
+}
+
+std::vector<std::uintptr_t> Scanner::findAll(StructQuery const& query,
+  RegionFilter const& filter, std::size_t limit)
+{
+  std::vector<std::uintptr_t> results;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    std::vector<std::uintptr_t> found = findAll(query, &cur,
+      limit - results.size());
+    results.insert(results.end(), found.begin(), found.end());
+    if(results.size() >= limit)
+      break;
+  }
+
+  return results;
+}
+
+AddressSet Scanner::findAllSet(StructQuery const& query,
+  RegionFilter const& filter)
+{
+  if(query.getFields().empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Struct query without fields"));
+  }
+
+  AddressSet results;
+  std::vector<std::uintptr_t> found;
+  std::vector<MemoryRegion> regions = selectRegions(filter);
+  sortByAddress(regions);
+  ScanContext::Scope scope(m_context, getScanSize(regions));
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(!cur.isReadable())
+      continue;
+
+    walkRegion(cur, query.getSpan() - 1,
+      [&](std::uint8_t const* data, std::size_t amount,
+        std::uintptr_t address)
+      {
+        found.clear();
+        query.match(data, amount, std::min(amount, CHUNK_SIZE), address,
+          found);
+        results.append(found);
+        return true;
+      });
+  }
+
+  return results;
+}
+
+std::uintptr_t Scanner::find(StructQuery const& query,
+  MemoryRegion const* region)
+{
+  return findFirst(selectRegions(region),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<std::uintptr_t> results = findAll(query, &cur, 1);
+      return results.empty() ? 0 : results.front();
+    });
+}
+
+std::uintptr_t Scanner::find(StructQuery const& query,
+  RegionFilter const& filter)
+{
+  return findFirst(selectRegions(filter),
+    [&](MemoryRegion const& cur) -> std::uintptr_t
+    {
+      std::vector<std::uintptr_t> results = findAll(query, &cur, 1);
+      return results.empty() ? 0 : results.front();
+    });
 }
@@ -0,0 +1,475 @@
+/*
+Signature.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+
+// SSE2:
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/ScanPlanner.hpp>
+
+using Ethon::Signature;
+using Ethon::SignatureReference;
+using Ethon::ByteStatistics;
+using Ethon::ScanPlan;
+using Ethon::SearchAlgorithm;
+using Ethon::ArgumentError;
+using Ethon::ErrorString;
+
+namespace
+{
+  // Maximum amount of compiled signatures kept by compile().
+  std::size_t const CACHE_SIZE = 256;
+
+  // Compiled signatures shared by all callers, the least recently used are
+  // evicted first.
+  typedef std::pair<std::string, std::shared_ptr<Signature const>> CacheEntry;
+  std::mutex g_cacheMutex;
+  std::list<CacheEntry> g_cacheOrder;
+  std::unordered_map<std::string, std::list<CacheEntry>::iterator> g_cache;
+
+  template<typename F>
+  std::shared_ptr<Signature const> lookup(std::string const& key,
+    F const& factory)
+  {
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    auto itr = g_cache.find(key);
+    if(itr != g_cache.end())
+    {
+      g_cacheOrder.splice(g_cacheOrder.begin(), g_cacheOrder, itr->second);
+      return itr->second->second;
+    }
+
+    std::shared_ptr<Signature const> compiled = factory();
+    g_cacheOrder.push_front(CacheEntry(key, compiled));
+    g_cache.emplace(key, g_cacheOrder.begin());
+    if(g_cache.size() > CACHE_SIZE)
+    {
+      g_cache.erase(g_cacheOrder.back().first);
+      g_cacheOrder.pop_back();
+    }
+
+    return compiled;
+  }
+
+  std::int32_t readDisplacement(std::uint8_t const* data)
+  {
+    std::int32_t displacement;
+    std::memcpy(&displacement, data, sizeof(displacement));
+    return displacement;
+  }
+}
+
+/* Signature class */
+
+std::size_t const Signature::npos;
+
+Signature::Signature(std::string const& signature)
+  : m_reference(SignatureReference::NONE), m_referenceOffset(0),
+    m_instructionEnd(0)
+{
+  std::istringstream stream(signature);
+  std::string token;
+  while(stream >> token)
+  {
+    if(token == "?" || token == "??")
+    {
+      m_bytes.push_back(0x00);
+      m_mask.push_back(0x00);
+      continue;
+    }
+
+    if(token.length() != 2 || !std::isxdigit(token[0]) ||
+      !std::isxdigit(token[1]))
+    {
+      BOOST_THROW_EXCEPTION(ArgumentError() <<
+        ErrorString("Invalid signature token '" + token + "'"));
+    }
+
+    m_bytes.push_back(static_cast<std::uint8_t>(
+      std::strtoul(token.c_str(), 0, 16)));
+    m_mask.push_back(0xFF);
+  }
+
+  prepare();
+}
+
+Signature::Signature(std::string const& pattern, std::string const& mask)
+  : m_reference(SignatureReference::NONE), m_referenceOffset(0),
+    m_instructionEnd(0)
+{
+  if(pattern.length() != mask.length())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Pattern and mask have not equal size"));
+  }
+
+  for(std::size_t i = 0; i < pattern.length(); ++i)
+  {
+    bool wildcard = mask[i] == '*';
+    m_bytes.push_back(wildcard ? 0x00 : static_cast<std::uint8_t>(pattern[i]));
+    m_mask.push_back(wildcard ? 0x00 : 0xFF);
+  }
+
+  prepare();
+}
+
+Signature::Signature(Signature const& other)
+  : m_bytes(other.m_bytes), m_mask(other.m_mask), m_size(other.m_size),
+    m_anchor(other.m_anchor), m_second(other.m_second),
+    m_wildcardOnly(other.m_wildcardOnly), m_reference(other.m_reference),
+    m_referenceOffset(other.m_referenceOffset),
+    m_instructionEnd(other.m_instructionEnd),
+    m_plan(std::make_shared<ScanPlan const>(*this,
+      SearchAlgorithm::SIMD_PAIR))
+{ }
+
+Signature& Signature::operator=(Signature const& other)
+{
+  if(this != &other)
+  {
+    m_bytes = other.m_bytes;
+    m_mask = other.m_mask;
+    m_size = other.m_size;
+    m_anchor = other.m_anchor;
+    m_second = other.m_second;
+    m_wildcardOnly = other.m_wildcardOnly;
+    m_reference = other.m_reference;
+    m_referenceOffset = other.m_referenceOffset;
+    m_instructionEnd = other.m_instructionEnd;
+    m_plan = std::make_shared<ScanPlan const>(*this,
+      SearchAlgorithm::SIMD_PAIR);
+  }
+  return *this;
+}
+
+void Signature::prepare()
+{
+  m_size = m_bytes.size();
+  if(!m_size)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Empty signature"));
+  }
+
+  m_wildcardOnly = std::find(m_mask.begin(), m_mask.end(), 0xFF) ==
+    m_mask.end();
+  selectAnchors(ByteStatistics(), m_anchor, m_second);
+
+  // Pad to whole blocks, padding never takes part in a comparison.
+  std::size_t padded = (m_size + 15) / 16 * 16;
+  m_bytes.resize(padded, 0x00);
+  m_mask.resize(padded, 0x00);
+
+  m_plan = std::make_shared<ScanPlan const>(*this,
+    SearchAlgorithm::SIMD_PAIR);
+}
+
+void Signature::selectAnchors(ByteStatistics const& statistics,
+  std::size_t& anchor, std::size_t& second) const
+{
+  // The anchor is the rarest fixed byte, the second anchor the rarest of the
+  // others, preferring bytes far away from the anchor.
+  anchor = 0;
+  double frequency = 2.0;
+  for(std::size_t i = 0; i < m_size; ++i)
+  {
+    if(m_mask[i] && statistics.getFrequency(m_bytes[i]) < frequency)
+    {
+      anchor = i;
+      frequency = statistics.getFrequency(m_bytes[i]);
+    }
+  }
+
+  second = anchor;
+  frequency = 2.0;
+  std::size_t distance = 0;
+  for(std::size_t i = 0; i < m_size; ++i)
+  {
+    if(!m_mask[i] || i == anchor)
+      continue;
+
+    double curFrequency = statistics.getFrequency(m_bytes[i]);
+    std::size_t curDistance = i > anchor ? i - anchor : anchor - i;
+    if(curFrequency < frequency ||
+      (curFrequency == frequency && curDistance > distance))
+    {
+      second = i;
+      frequency = curFrequency;
+      distance = curDistance;
+    }
+  }
+}
+
+std::shared_ptr<Signature const> Signature::compile(
+  std::string const& signature)
+{
+  return lookup("S" + signature, [&]
+  {
+    return std::make_shared<Signature const>(signature);
+  });
+}
+
+std::shared_ptr<Signature const> Signature::compile(
+  std::string const& pattern, std::string const& mask)
+{
+  // Checked here, as keys of unequally sized pairs could collide.
+  if(pattern.length() != mask.length())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Pattern and mask have not equal size"));
+  }
+
+  return lookup("P" + pattern + mask, [&]
+  {
+    return std::make_shared<Signature const>(pattern, mask);
+  });
+}
+
+Signature& Signature::setRelative(std::size_t offset,
+  std::size_t instructionEnd)
+{
+  if(instructionEnd < offset + 4)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Displacement exceeds the instruction"));
+  }
+
+  m_reference = SignatureReference::RELATIVE;
+  m_referenceOffset = offset;
+  m_instructionEnd = instructionEnd;
+  return *this;
+}
+
+Signature& Signature::setBranch(std::size_t offset)
+{
+  m_reference = SignatureReference::BRANCH;
+  m_referenceOffset = offset;
+  m_instructionEnd = 0;
+  return *this;
+}
+
+Signature& Signature::clearReference()
+{
+  m_reference = SignatureReference::NONE;
+  m_referenceOffset = 0;
+  m_instructionEnd = 0;
+  return *this;
+}
+
+std::size_t Signature::getSize() const
+{
+  return m_size;
+}
+
+std::size_t Signature::getSpan() const
+{
+  switch(m_reference)
+  {
+  case SignatureReference::RELATIVE:
+    return std::max(m_size, m_referenceOffset + 4);
+  case SignatureReference::BRANCH:
+    // The longest supported form is jcc rel32, 0F 8x + disp32.
+    return std::max(m_size, m_referenceOffset + 6);
+  default:
+    return m_size;
+  }
+}
+
+SignatureReference Signature::getReference() const
+{
+  return m_reference;
+}
+
+std::vector<std::uint8_t> const& Signature::getBytes() const
+{
+  return m_bytes;
+}
+
+std::vector<std::uint8_t> const& Signature::getMask() const
+{
+  return m_mask;
+}
+
+bool Signature::isWildcardOnly() const
+{
+  return m_wildcardOnly;
+}
+
+std::size_t Signature::getAnchor() const
+{
+  return m_anchor;
+}
+
+std::size_t Signature::getSecondAnchor() const
+{
+  return m_second;
+}
+
+std::size_t Signature::getReferenceOffset() const
+{
+  return m_referenceOffset;
+}
+
+std::size_t Signature::getInstructionEnd() const
+{
+  return m_instructionEnd;
+}
+
+std::string Signature::toString() const
+{
+  static char const digits[] = "0123456789ABCDEF";
+
+  std::string result;
+  for(std::size_t i = 0; i < m_size; ++i)
+  {
+    if(i)
+      result += ' ';
+
+    if(m_mask[i])
+    {
+      result += digits[m_bytes[i] >> 4];
+      result += digits[m_bytes[i] & 0x0F];
+    }
+    else
+      result += "??";
+  }
+
+  return result;
+}
+
+bool Signature::matches(std::uint8_t const* data, std::size_t available)
+  const
+{
+#ifdef __SSE2__
+  if(available >= m_bytes.size())
+  {
+    for(std::size_t i = 0; i < m_bytes.size(); i += 16)
+    {
+      __m128i value = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(data + i));
+      __m128i mask = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(&m_mask[i]));
+      __m128i bytes = _mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(&m_bytes[i]));
+      __m128i equal = _mm_cmpeq_epi8(_mm_and_si128(value, mask), bytes);
+      if(_mm_movemask_epi8(equal) != 0xFFFF)
+        return false;
+    }
+
+    return true;
+  }
+#else
+  (void)available;
+#endif
+
+  for(std::size_t i = 0; i < m_size; ++i)
+  {
+    if((data[i] & m_mask[i]) != m_bytes[i])
+      return false;
+  }
+
+  return true;
+}
+
+std::size_t Signature::search(std::uint8_t const* data, std::size_t size,
+  std::size_t start) const
+{
+  return m_plan->search(data, size, start);
+}
+
+void Signature::match(std::uint8_t const* data, std::size_t size,
+  std::uintptr_t address, std::vector<std::uintptr_t>& results,
+  std::size_t limit) const
+{
+  m_plan->match(data, size, address, results, limit);
+}
+
+bool Signature::resolve(std::uint8_t const* data, std::size_t available,
+  std::uintptr_t address, std::uintptr_t& target) const
+{
+  std::size_t const offset = m_referenceOffset;
+  switch(m_reference)
+  {
+  case SignatureReference::NONE:
+    target = address;
+    return true;
+
+  case SignatureReference::RELATIVE:
+    if(available < offset + 4)
+      return false;
+    target = address + m_instructionEnd + readDisplacement(data + offset);
+    return true;
+
+  case SignatureReference::BRANCH:
+    if(available < offset + 2)
+      return false;
+
+    // call rel32, jmp rel32
+    if(data[offset] == 0xE8 || data[offset] == 0xE9)
+    {
+      if(available < offset + 5)
+        return false;
+      target = address + offset + 5 + readDisplacement(data + offset + 1);
+      return true;
+    }
+
+    // jmp rel8, jcc rel8
+    if(data[offset] == 0xEB || (data[offset] & 0xF0) == 0x70)
+    {
+      target = address + offset + 2 +
+        static_cast<std::int8_t>(data[offset + 1]);
+      return true;
+    }
+
+    // jcc rel32
+    if(data[offset] == 0x0F && (data[offset + 1] & 0xF0) == 0x80)
+    {
+      if(available < offset + 6)
+        return false;
+      target = address + offset + 6 + readDisplacement(data + offset + 2);
+      return true;
+    }
+
+    // No supported branch instruction at the reference offset.
+    return false;
+  }
+
+  return false;
+}
@@ -0,0 +1,595 @@
+/*
+SignatureDatabase.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/types.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <mutex>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/Signature.hpp>
+#include <Ethon/SignatureDatabase.hpp>
+
+using Ethon::SignatureDatabase;
+using Ethon::SignatureModule;
+using Ethon::Signature;
+using Ethon::Scanner;
+using Ethon::MemoryEditor;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::ByteContainer;
+using Ethon::EthonError;
+using Ethon::ArgumentError;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  char const MAGIC[8] = {'E', 'T', 'H', 'S', 'I', 'G', 'D', 'B'};
+  std::uint32_t const VERSION = 2;
+  std::uint64_t const INITIAL_CAPACITY = 1024;
+
+  struct Header
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t capacity;   // Amount of slots, a power of two.
+    std::uint64_t count;      // Amount of used slots.
+    std::uint64_t table;      // File offset of the slots.
+  };
+
+  // A slot is empty if its module hash is zero.
+  struct Slot
+  {
+    std::uint64_t module;
+    std::uint64_t signature;
+    std::uint64_t offset;
+  };
+
+  Slot* getSlots(void* map)
+  {
+    return reinterpret_cast<Slot*>(static_cast<char*>(map) +
+      static_cast<Header const*>(map)->table);
+  }
+
+  // Inserts or updates an entry, returns true if a new slot was used.
+  bool insertSlot(Slot* slots, std::uint64_t capacity, Slot const& entry)
+  {
+    std::uint64_t const mask = capacity - 1;
+    for(std::uint64_t i = (entry.module ^ entry.signature) & mask; ;
+      i = (i + 1) & mask)
+    {
+      if(!slots[i].module)
+      {
+        slots[i].signature = entry.signature;
+        slots[i].offset = entry.offset;
+        slots[i].module = entry.module;
+        return true;
+      }
+
+      if(slots[i].module == entry.module &&
+        slots[i].signature == entry.signature)
+      {
+        slots[i].offset = entry.offset;
+        return false;
+      }
+    }
+  }
+
+  // FNV-1a, never zero.
+  std::uint64_t hash(std::string const& value)
+  {
+    std::uint64_t result = 14695981039346656037ULL;
+    BOOST_FOREACH(char cur, value)
+    {
+      result ^= static_cast<std::uint8_t>(cur);
+      result *= 1099511628211ULL;
+    }
+
+    return result | 1;
+  }
+
+  std::string signatureKey(Signature const& signature)
+  {
+    std::ostringstream key;
+    key << signature.toString() << ';' <<
+      static_cast<int>(signature.getReference()) << ';' <<
+      signature.getReferenceOffset() << ';' << signature.getInstructionEnd();
+    return key.str();
+  }
+
+  // Holds a flock for its lifetime.
+  class FileLock
+  {
+  private:
+    int m_file;
+
+  public:
+    FileLock(int file, int operation)
+      : m_file(file)
+    {
+      while(::flock(m_file, operation) == -1)
+      {
+        if(errno == EINTR)
+          continue;
+
+        std::error_code const error = Ethon::makeErrorCode();
+        BOOST_THROW_EXCEPTION(FilesystemError() <<
+          ErrorString("Can't lock signature database") <<
+          ErrorCode(error));
+      }
+    }
+
+    ~FileLock()
+    {
+      ::flock(m_file, LOCK_UN);
+    }
+  };
+
+  bool readExactly(MemoryEditor& editor, std::uintptr_t address, void* dest,
+    std::size_t amount)
+  {
+    try
+    {
+      return editor.read(address, dest, amount) == amount;
+    }
+    catch(EthonError const&)
+    {
+      return false;
+    }
+  }
+
+  // Reads the GNU build-id from the notes of a mapped ELF image of a class.
+  template<typename EHDR, typename PHDR>
+  std::string readBuildId(MemoryEditor& editor, std::uintptr_t base)
+  {
+    EHDR header;
+    if(!readExactly(editor, base, &header, sizeof(header)) ||
+      header.e_phentsize != sizeof(PHDR))
+    {
+      return std::string();
+    }
+
+    std::vector<PHDR> programHeaders(header.e_phnum);
+    if(programHeaders.empty() || !readExactly(editor, base + header.e_phoff,
+      &programHeaders[0], programHeaders.size() * sizeof(PHDR)))
+    {
+      return std::string();
+    }
+
+    // Position dependent executables are not relocated.
+    std::uintptr_t bias = base;
+    BOOST_FOREACH(PHDR const& cur, programHeaders)
+    {
+      if(cur.p_type == PT_LOAD)
+      {
+        bias = base - (cur.p_vaddr & ~static_cast<std::uintptr_t>(0xFFF));
+        break;
+      }
+    }
+
+    BOOST_FOREACH(PHDR const& cur, programHeaders)
+    {
+      if(cur.p_type != PT_NOTE || cur.p_memsz > 0x10000)
+        continue;
+
+      ByteContainer notes(cur.p_memsz);
+      if(notes.empty() ||
+        !readExactly(editor, bias + cur.p_vaddr, &notes[0], notes.size()))
+      {
+        continue;
+      }
+
+      for(std::size_t pos = 0; pos + sizeof(Elf64_Nhdr) <= notes.size(); )
+      {
+        Elf64_Nhdr note;
+        std::memcpy(&note, &notes[pos], sizeof(note));
+        std::size_t name = pos + sizeof(note);
+        std::size_t desc = name + ((note.n_namesz + 3) & ~3u);
+        std::size_t next = desc + ((note.n_descsz + 3) & ~3u);
+        if(next > notes.size())
+          break;
+
+        if(note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 &&
+          std::memcmp(&notes[name], "GNU", 4) == 0)
+        {
+          static char const digits[] = "0123456789abcdef";
+          std::string result;
+          for(std::size_t i = 0; i < note.n_descsz; ++i)
+          {
+            result += digits[notes[desc + i] >> 4];
+            result += digits[notes[desc + i] & 0x0F];
+          }
+          return result;
+        }
+
+        pos = next;
+      }
+    }
+
+    return std::string();
+  }
+
+  // Reads the GNU build-id from the notes of a mapped ELF image.
+  std::string readBuildId(MemoryEditor& editor, std::uintptr_t base)
+  {
+    unsigned char ident[EI_NIDENT];
+    if(!readExactly(editor, base, ident, sizeof(ident)) ||
+      std::memcmp(ident, ELFMAG, SELFMAG) != 0)
+    {
+      return std::string();
+    }
+
+    switch(ident[EI_CLASS])
+    {
+    case ELFCLASS32:
+      return readBuildId<Elf32_Ehdr, Elf32_Phdr>(editor, base);
+    case ELFCLASS64:
+      return readBuildId<Elf64_Ehdr, Elf64_Phdr>(editor, base);
+    default:
+      return std::string();
+    }
+  }
+}
+
+/* SignatureDatabase class */
+
+SignatureDatabase::SignatureDatabase(boost::filesystem::path const& path)
+  : m_file(-1), m_map(0), m_mapSize(0)
+{
+  m_file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if(m_file == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't open signature database") <<
+      ErrorCode(error));
+  }
+
+  try
+  {
+    FileLock lock(m_file, LOCK_EX);
+
+    struct stat info;
+    if(::fstat(m_file, &info) == -1)
+    {
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("Can't stat signature database") <<
+        ErrorCode(error));
+    }
+
+    if(info.st_size == 0)
+    {
+      Header header = Header();
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.capacity = INITIAL_CAPACITY;
+      header.count = 0;
+      header.table = sizeof(Header);
+
+      if(::ftruncate(m_file, sizeof(Header) +
+        INITIAL_CAPACITY * sizeof(Slot)) == -1 ||
+        ::pwrite(m_file, &header, sizeof(header), 0) != sizeof(header))
+      {
+        std::error_code const error = Ethon::makeErrorCode();
+        BOOST_THROW_EXCEPTION(FilesystemError() <<
+          ErrorString("Can't initialize signature database") <<
+          ErrorCode(error));
+      }
+    }
+
+    remap();
+  }
+  catch(...)
+  {
+    if(m_map)
+      ::munmap(m_map, m_mapSize);
+    ::close(m_file);
+    throw;
+  }
+}
+
+SignatureDatabase::~SignatureDatabase()
+{
+  if(m_map)
+    ::munmap(m_map, m_mapSize);
+  ::close(m_file);
+}
+
+void SignatureDatabase::remap()
+{
+  struct stat info;
+  if(::fstat(m_file, &info) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't stat signature database") <<
+      ErrorCode(error));
+  }
+
+  // Another process may have grown the table.
+  std::size_t size = static_cast<std::size_t>(info.st_size);
+  if(m_map && size == m_mapSize)
+    return;
+
+  if(m_map)
+    ::munmap(m_map, m_mapSize);
+  m_map = 0;
+  m_mapSize = 0;
+
+  if(size < sizeof(Header))
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Not a signature database"));
+  }
+
+  void* map = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+  if(map == MAP_FAILED)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't map signature database") <<
+      ErrorCode(error));
+  }
+
+  m_map = map;
+  m_mapSize = size;
+
+  // The file may be longer than the table while a grow is in progress or
+  // after one was interrupted.
+  Header const* header = static_cast<Header const*>(m_map);
+  if(std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+    header->version != VERSION || !header->capacity ||
+    (header->capacity & (header->capacity - 1)) ||
+    header->table < sizeof(Header) || header->table % sizeof(std::uint64_t) ||
+    header->table > size ||
+    header->capacity > (size - header->table) / sizeof(Slot))
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Not a signature database"));
+  }
+}
+
+void SignatureDatabase::grow()
+{
+  Header header = *static_cast<Header const*>(m_map);
+  std::uint64_t const capacity = header.capacity * 2;
+
+  // The new table is built behind the end of the file, the old one stays
+  // valid until the header is rewritten with a single write. The space of
+  // old tables is not reclaimed.
+  std::uint64_t const table = (m_mapSize + sizeof(std::uint64_t) - 1) /
+    sizeof(std::uint64_t) * sizeof(std::uint64_t);
+  if(::ftruncate(m_file, table + capacity * sizeof(Slot)) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't resize signature database") <<
+      ErrorCode(error));
+  }
+
+  remap();
+
+  Slot const* slots = getSlots(m_map);
+  Slot* newSlots = reinterpret_cast<Slot*>(static_cast<char*>(m_map) +
+    table);
+  std::memset(newSlots, 0, capacity * sizeof(Slot));
+  for(std::uint64_t i = 0; i < header.capacity; ++i)
+  {
+    if(slots[i].module)
+      insertSlot(newSlots, capacity, slots[i]);
+  }
+
+  header.capacity = capacity;
+  header.table = table;
+  if(::pwrite(m_file, &header, sizeof(header), 0) != sizeof(header))
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't write signature database header") <<
+      ErrorCode(error));
+  }
+}
+
+bool SignatureDatabase::lookup(std::uint64_t module, std::uint64_t signature,
+  std::uint64_t& offset)
+{
+  Header const* header = static_cast<Header const*>(m_map);
+  Slot const* slots = getSlots(m_map);
+  std::uint64_t const mask = header->capacity - 1;
+
+  for(std::uint64_t i = (module ^ signature) & mask; ; i = (i + 1) & mask)
+  {
+    if(!slots[i].module)
+      return false;
+
+    if(slots[i].module == module && slots[i].signature == signature)
+    {
+      offset = slots[i].offset;
+      return true;
+    }
+  }
+}
+
+void SignatureDatabase::store(std::uint64_t module, std::uint64_t signature,
+  std::uint64_t offset)
+{
+  Header* header = static_cast<Header*>(m_map);
+  Slot const entry = { module, signature, offset };
+  if(insertSlot(getSlots(m_map), header->capacity, entry))
+    ++header->count;
+}
+
+SignatureModule SignatureDatabase::loadModule(MemoryEditor const& editor,
+  std::string const& module)
+{
+  SignatureModule result;
+  result.base = 0;
+
+  MemoryRegionSequence seq = makeMemoryRegionSequence(editor.getProcess());
+  BOOST_FOREACH(MemoryRegion const& cur, seq)
+  {
+    std::string const& path = cur.getPath();
+    bool matches = path == module || (module.find('/') == std::string::npos &&
+      path.size() > module.size() && path[0] == '/' &&
+      path.compare(path.size() - module.size(), module.size(), module) == 0 &&
+      path[path.size() - module.size() - 1] == '/');
+
+    if(!matches || (!result.path.empty() && path != result.path))
+      continue;
+
+    if(result.regions.empty())
+    {
+      result.path = path;
+      result.base = cur.getStartAddress();
+    }
+    result.regions.push_back(cur);
+  }
+
+  if(result.regions.empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Module '" + module + "' is not mapped"));
+  }
+
+  MemoryEditor reader(editor);
+  std::string buildId = readBuildId(reader, result.base);
+  if(!buildId.empty())
+  {
+    result.identity = "build-id:" + buildId;
+    return result;
+  }
+
+  // Without a build-id the file's identity has to do.
+  std::ostringstream identity;
+  MemoryRegion const& first = result.regions.front();
+  identity << "file:" << first.getDeviceMajor() << ':' <<
+    first.getDeviceMinor() << ':' << first.getInode();
+
+  boost::filesystem::path file = editor.getProcess().getProcfsDirectory() /
+    "root" / result.path;
+  struct stat info;
+  if(::stat(file.c_str(), &info) == 0)
+    identity << ':' << info.st_size << ':' << info.st_mtime;
+
+  result.identity = identity.str();
+  return result;
+}
+
+std::uintptr_t SignatureDatabase::find(MemoryEditor const& editor,
+  SignatureModule const& module, Signature const& signature)
+{
+  std::uint64_t const moduleHash = hash(module.identity);
+  std::uint64_t const signatureHash = hash(signatureKey(signature));
+  std::size_t const span = signature.getSpan();
+  MemoryEditor reader(editor);
+  ByteContainer buffer(span);
+  std::uintptr_t target;
+
+  std::uint64_t offset;
+  bool cached;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    FileLock lock(m_file, LOCK_SH);
+    remap();
+    cached = lookup(moduleHash, signatureHash, offset);
+  }
+
+  // A cached match is validated by reading it again.
+  if(cached && readExactly(reader, module.base + offset, &buffer[0], span) &&
+    signature.matches(&buffer[0]) &&
+    signature.resolve(&buffer[0], span, module.base + offset, target))
+  {
+    return target;
+  }
+
+  Signature plain(signature);
+  plain.clearReference();
+  Scanner scanner(editor);
+  std::uintptr_t match = 0;
+  BOOST_FOREACH(MemoryRegion const& cur, module.regions)
+  {
+    if(cur.isReadable() && (match = scanner.findSignature(plain, &cur)))
+      break;
+  }
+
+  if(!match)
+    return 0;
+
+  if(!readExactly(reader, match, &buffer[0], span) ||
+    !signature.resolve(&buffer[0], span, match, target))
+  {
+    BOOST_THROW_EXCEPTION(EthonError() <<
+      ErrorString("Unable to read the reference of a match"));
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    FileLock lock(m_file, LOCK_EX);
+    remap();
+
+    Header const* header = static_cast<Header const*>(m_map);
+    if((header->count + 1) * 10 > header->capacity * 7)
+      grow();
+    store(moduleHash, signatureHash, match - module.base);
+  }
+
+  return target;
+}
+
+std::uintptr_t SignatureDatabase::find(MemoryEditor const& editor,
+  std::string const& module, Signature const& signature)
+{
+  return find(editor, loadModule(editor, module), signature);
+}
+
+std::size_t SignatureDatabase::getSize()
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  FileLock lock(m_file, LOCK_SH);
+  remap();
+  return static_cast<std::size_t>(
+    static_cast<Header const*>(m_map)->count);
+}
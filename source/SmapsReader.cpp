@@ -0,0 +1,299 @@
+/*
+SmapsReader.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <fcntl.h>
+#include <unistd.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/SmapsReader.hpp>
+
+using Ethon::SmapsReader;
+using Ethon::RegionUsage;
+using Ethon::MemoryRegion;
+using Ethon::Process;
+using Ethon::FilesystemError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  // Initial buffer size, smaps takes about 1KB per region.
+  std::size_t const SMAPS_BUFFER_SIZE = 256 * 1024;
+
+  struct Field
+  {
+    char const* name;
+    std::size_t length;
+    std::uint64_t RegionUsage::* member;
+  };
+
+  Field const FIELDS[] = {
+    { "Rss", 3, &RegionUsage::rss },
+    { "Pss", 3, &RegionUsage::pss },
+    { "Shared_Clean", 12, &RegionUsage::sharedClean },
+    { "Shared_Dirty", 12, &RegionUsage::sharedDirty },
+    { "Private_Clean", 13, &RegionUsage::privateClean },
+    { "Private_Dirty", 13, &RegionUsage::privateDirty },
+    { "Referenced", 10, &RegionUsage::referenced },
+    { "Anonymous", 9, &RegionUsage::anonymous },
+    { "AnonHugePages", 13, &RegionUsage::anonHugePages },
+    { "Swap", 4, &RegionUsage::swap },
+    { "SwapPss", 7, &RegionUsage::swapPss }
+  };
+
+  /**
+  * Reads a whole file.
+  * @param path Path of the file.
+  * @param buffer Buffer to read into, grown as needed.
+  * @param size Receives the amount of read bytes.
+  * @return False if the file couldn't be read, true otherwise.
+  */
+  bool readFile(std::string const& path, std::vector<char>& buffer,
+    std::size_t& size)
+  {
+    size = 0;
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(file == -1)
+      return false;
+
+    for(;;)
+    {
+      if(size == buffer.size())
+        buffer.resize(std::max<std::size_t>(buffer.size() * 2, 4096));
+
+      ssize_t const count = ::read(file, &buffer[size], buffer.size() - size);
+      if(count == 0)
+        break;
+
+      if(count == -1)
+      {
+        if(errno == EINTR)
+          continue;
+
+        ::close(file);
+        return false;
+      }
+
+      size += count;
+    }
+
+    ::close(file);
+    return true;
+  }
+
+  // Region headers start with their address, fields with a capital letter.
+  bool isHeader(char const* line, char const* end)
+  {
+    return line != end && ((*line >= '0' && *line <= '9') ||
+      (*line >= 'a' && *line <= 'f'));
+  }
+
+  /**
+  * Adds the fields in a range of lines to a usage.
+  * @param cur Start of the first line.
+  * @param end End of the last line.
+  * @param usage The usage.
+  */
+  void addFields(char const* cur, char const* end, RegionUsage& usage)
+  {
+    while(cur < end)
+    {
+      char const* eol = static_cast<char const*>(
+        std::memchr(cur, '\n', end - cur));
+      if(!eol)
+        eol = end;
+
+      char const* colon = static_cast<char const*>(
+        std::memchr(cur, ':', eol - cur));
+      if(colon)
+      {
+        std::size_t const length = colon - cur;
+        for(Field const& field : FIELDS)
+        {
+          if(field.length != length ||
+            std::memcmp(field.name, cur, length) != 0)
+            continue;
+
+          // Values are given in kB.
+          char const* digit = colon + 1;
+          while(digit != eol && *digit == ' ')
+            ++digit;
+
+          std::uint64_t value = 0;
+          for(; digit != eol && *digit >= '0' && *digit <= '9'; ++digit)
+            value = value * 10 + (*digit - '0');
+
+          usage.*field.member += value * 1024;
+          break;
+        }
+      }
+
+      cur = eol + 1;
+    }
+  }
+}
+
+/* SmapsReader class */
+
+SmapsReader::SmapsReader(Process const& process)
+  : m_process(process), m_loaded(false), m_available(false), m_buffer(),
+    m_size(0), m_entries(), m_usages(), m_parsed()
+{ }
+
+bool SmapsReader::load() const
+{
+  if(m_loaded)
+    return m_available;
+
+  m_loaded = true;
+  m_entries.clear();
+  if(m_buffer.empty())
+    m_buffer.resize(SMAPS_BUFFER_SIZE);
+  m_available = readFile((m_process.getProcfsDirectory() / "smaps").string(),
+    m_buffer, m_size);
+  if(!m_available)
+    return false;
+
+  // Only the headers are parsed here, the fields of a region once needed.
+  char const* const data = &m_buffer[0];
+  char const* const end = data + m_size;
+  char const* cur = data;
+  while(cur < end)
+  {
+    char const* eol = static_cast<char const*>(
+      std::memchr(cur, '\n', end - cur));
+    if(!eol)
+      eol = end;
+
+    if(isHeader(cur, eol))
+    {
+      if(!m_entries.empty())
+        m_entries.back().end = cur - data;
+
+      std::uintptr_t start = 0;
+      for(; cur != eol && *cur != '-'; ++cur)
+      {
+        char const c = *cur;
+        start = (start << 4) |
+          static_cast<std::uintptr_t>(c <= '9' ? c - '0' : c - 'a' + 10);
+      }
+
+      std::size_t const begin = std::min<std::size_t>(eol + 1 - data, m_size);
+      Entry entry = { start, begin, m_size };
+      m_entries.push_back(entry);
+    }
+
+    cur = eol + 1;
+  }
+
+  m_usages.assign(m_entries.size(), RegionUsage());
+  m_parsed.assign(m_entries.size(), false);
+  return true;
+}
+
+void SmapsReader::refresh()
+{
+  m_loaded = false;
+  m_available = false;
+}
+
+Process const& SmapsReader::getProcess() const
+{
+  return m_process;
+}
+
+bool SmapsReader::getUsage(std::uintptr_t start, RegionUsage& usage) const
+{
+  if(!load())
+    return false;
+
+  std::vector<Entry>::const_iterator it = std::lower_bound(
+    m_entries.begin(), m_entries.end(), start,
+    [](Entry const& entry, std::uintptr_t address)
+    {
+      return entry.start < address;
+    });
+  if(it == m_entries.end() || it->start != start)
+    return false;
+
+  std::size_t const index = it - m_entries.begin();
+  if(!m_parsed[index])
+  {
+    RegionUsage parsed = RegionUsage();
+    addFields(&m_buffer[0] + it->begin, &m_buffer[0] + it->end, parsed);
+    m_usages[index] = parsed;
+    m_parsed[index] = true;
+  }
+
+  usage = m_usages[index];
+  return true;
+}
+
+bool SmapsReader::getUsage(MemoryRegion const& region,
+  RegionUsage& usage) const
+{
+  return getUsage(region.getStartAddress(), usage);
+}
+
+bool SmapsReader::isPopulated(MemoryRegion const& region) const
+{
+  RegionUsage usage;
+  return !getUsage(region, usage) || usage.rss || usage.swap;
+}
+
+RegionUsage SmapsReader::getRollup(Process const& process)
+{
+  RegionUsage result = RegionUsage();
+  std::vector<char> buffer(4096);
+  std::size_t size;
+  if(readFile((process.getProcfsDirectory() / "smaps_rollup").string(),
+    buffer, size))
+  {
+    addFields(&buffer[0], &buffer[0] + size, result);
+    return result;
+  }
+
+  // Sum up all regions, the single header per region has no known fields.
+  buffer.resize(SMAPS_BUFFER_SIZE);
+  if(!readFile((process.getProcfsDirectory() / "smaps").string(), buffer,
+    size))
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't read smaps-file") <<
+      ErrorCode(error));
+  }
+
+  addFields(&buffer[0], &buffer[0] + size, result);
+  return result;
+}
@@ -0,0 +1,744 @@
+/*
+Snapshot.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+// C++ Standard Library:
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// Boost Library:
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+// zlib:
+#include <zlib.h>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ScanContext.hpp>
+#include <Ethon/Snapshot.hpp>
+
+using Ethon::PageStore;
+using Ethon::Snapshot;
+using Ethon::SnapshotStorage;
+using Ethon::UnknownValueScan;
+using Ethon::ChangeCompare;
+using Ethon::MemoryEditor;
+using Ethon::MemoryRegion;
+using Ethon::MemoryRegionSequence;
+using Ethon::ByteContainer;
+using Ethon::ScanContext;
+using Ethon::ValueType;
+using Ethon::EthonError;
+using Ethon::ArgumentError;
+using Ethon::UnexpectedError;
+using Ethon::FilesystemError;
+
+// Amount of pages read from the process at once.
+static std::size_t const PAGES_PER_READ = 256;
+
+// Reads a chunk of memory, treating I/O errors (device memory, regions
+// unmapped in the meantime) as an empty read.
+static std::size_t readChunk(MemoryEditor& editor, std::uintptr_t address,
+  std::uint8_t* dest, std::size_t amount)
+{
+  try
+  {
+    return editor.read(address, dest, amount);
+  }
+  catch(EthonError const& e)
+  {
+    std::error_code const* errorCode =
+      boost::get_error_info<Ethon::ErrorCode>(e);
+    if(errorCode && errorCode->value() == EIO)
+      return 0;
+
+    // Another error occurred, rethrow.
+    throw;
+  }
+}
+
+static bool isZeroPage(std::uint8_t const* data)
+{
+  std::uint64_t accumulated = 0;
+  for(std::size_t i = 0; i < Snapshot::PAGE_BYTES; i += sizeof(std::uint64_t))
+  {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    accumulated |= word;
+  }
+
+  return accumulated == 0;
+}
+
+/* PageStore class */
+
+PageStore::PageStore(SnapshotStorage storage, std::size_t memoryLimit,
+  boost::filesystem::path const& path)
+  : m_slots(), m_blobs(), m_free(), m_storage(storage),
+    m_memoryLimit(memoryLimit), m_memoryUsage(0), m_path(path), m_file(-1),
+    m_fileSize(0)
+{ }
+
+PageStore::~PageStore()
+{
+  if(m_file != -1)
+    ::close(m_file);
+}
+
+std::uint64_t PageStore::append(void const* data, std::size_t size)
+{
+  if(m_file == -1)
+  {
+    if(m_path.empty())
+    {
+      // Create an unlinked temporary file which vanishes once closed.
+      std::string tmpl = (boost::filesystem::temp_directory_path() /
+        "ethonmem-snapshot-XXXXXX").string();
+      m_file = ::mkstemp(&tmpl[0]);
+      if(m_file != -1)
+        ::unlink(tmpl.c_str());
+    }
+    else
+    {
+      m_file = ::open(m_path.string().c_str(), O_RDWR | O_CREAT | O_TRUNC,
+        0600);
+    }
+
+    if(m_file == -1)
+    {
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("Can't create snapshot file") <<
+        ErrorCode(error));
+    }
+  }
+
+  std::uint64_t const offset = m_fileSize;
+  char const* source = static_cast<char const*>(data);
+  for(std::size_t written = 0; written < size; )
+  {
+    ::ssize_t count = ::pwrite(m_file, source + written, size - written,
+      offset + written);
+    if(count == -1)
+    {
+      std::error_code const error = Ethon::makeErrorCode();
+      BOOST_THROW_EXCEPTION(FilesystemError() <<
+        ErrorString("pwrite failed writing snapshot page") <<
+        ErrorCode(error));
+    }
+
+    written += count;
+  }
+
+  m_fileSize += size;
+  return offset;
+}
+
+std::uint32_t PageStore::put(void const* data, std::size_t size)
+{
+  ByteContainer compressed(::compressBound(size));
+  ::uLongf compressedSize = compressed.size();
+  if(::compress2(&compressed[0], &compressedSize,
+    static_cast<Bytef const*>(data), size, Z_BEST_SPEED) != Z_OK)
+  {
+    BOOST_THROW_EXCEPTION(UnexpectedError() <<
+      ErrorString("compress2 failed compressing snapshot page"));
+  }
+
+  // Keep incompressible pages as they are.
+  Slot slot;
+  slot.raw = compressedSize >= size;
+  slot.size = slot.raw ? size : compressedSize;
+  slot.refs = 1;
+  slot.offset = 0;
+
+  void const* source = slot.raw ? data : &compressed[0];
+  slot.onDisk = m_storage == SnapshotStorage::DISK ||
+    m_memoryUsage + slot.size > m_memoryLimit;
+
+  std::uint32_t index;
+  if(!m_free.empty())
+  {
+    index = m_free.back();
+    m_free.pop_back();
+  }
+  else
+  {
+    index = m_slots.size();
+    m_slots.push_back(slot);
+    m_blobs.push_back(ByteContainer());
+  }
+
+  if(slot.onDisk)
+  {
+    slot.offset = append(source, slot.size);
+  }
+  else
+  {
+    std::uint8_t const* bytes = static_cast<std::uint8_t const*>(source);
+    m_blobs[index].assign(bytes, bytes + slot.size);
+    m_memoryUsage += slot.size;
+  }
+
+  m_slots[index] = slot;
+  return index;
+}
+
+void PageStore::get(std::uint32_t slot, void* dest, std::size_t size) const
+{
+  assert(slot < m_slots.size() && m_slots[slot].refs);
+  Slot const& cur = m_slots[slot];
+
+  ByteContainer buffer;
+  std::uint8_t const* source;
+  if(cur.onDisk)
+  {
+    buffer.resize(cur.size);
+    for(std::size_t done = 0; done < cur.size; )
+    {
+      ::ssize_t count = ::pread(m_file, &buffer[done], cur.size - done,
+        cur.offset + done);
+      if(count <= 0)
+      {
+        std::error_code const error = Ethon::makeErrorCode();
+        BOOST_THROW_EXCEPTION(FilesystemError() <<
+          ErrorString("pread failed reading snapshot page") <<
+          ErrorCode(error));
+      }
+
+      done += count;
+    }
+    source = &buffer[0];
+  }
+  else
+  {
+    source = &m_blobs[slot][0];
+  }
+
+  if(cur.raw)
+  {
+    std::memcpy(dest, source, std::min<std::size_t>(size, cur.size));
+    return;
+  }
+
+  ::uLongf destSize = size;
+  if(::uncompress(static_cast<Bytef*>(dest), &destSize, source, cur.size)
+    != Z_OK || destSize != size)
+  {
+    BOOST_THROW_EXCEPTION(UnexpectedError() <<
+      ErrorString("uncompress failed decompressing snapshot page"));
+  }
+}
+
+void PageStore::retain(std::uint32_t slot)
+{
+  assert(slot < m_slots.size() && m_slots[slot].refs);
+  ++m_slots[slot].refs;
+}
+
+bool PageStore::release(std::uint32_t slot)
+{
+  assert(slot < m_slots.size() && m_slots[slot].refs);
+  Slot& cur = m_slots[slot];
+  if(--cur.refs)
+    return false;
+
+  // Space inside the file is not reclaimed, only memory is.
+  if(!cur.onDisk)
+  {
+    m_memoryUsage -= cur.size;
+    ByteContainer().swap(m_blobs[slot]);
+  }
+
+  m_free.push_back(slot);
+  return true;
+}
+
+std::size_t PageStore::getMemoryUsage() const
+{
+  return m_memoryUsage;
+}
+
+std::uint64_t PageStore::getDiskUsage() const
+{
+  return m_fileSize;
+}
+
+/* Snapshot class */
+
+std::size_t const Snapshot::PAGE_BYTES;
+std::uint32_t const Snapshot::ZERO_SLOT;
+
+Snapshot::Snapshot(SnapshotStorage storage, std::size_t memoryLimit,
+  boost::filesystem::path const& path)
+  : m_store(storage, memoryLimit, path), m_pages(), m_regions(), m_dedup()
+{ }
+
+std::uint64_t Snapshot::hashPage(std::uint8_t const* data)
+{
+  // Four independent lanes keep the multiplications pipelined.
+  std::uint64_t const prime = 0x9E3779B97F4A7C15ULL;
+  std::uint64_t lanes[4] = { prime, prime << 1, prime << 2, prime << 3 };
+  for(std::size_t i = 0; i < PAGE_BYTES; i += 4 * sizeof(std::uint64_t))
+  {
+    for(std::size_t j = 0; j < 4; ++j)
+    {
+      std::uint64_t word;
+      std::memcpy(&word, data + i + j * sizeof(word), sizeof(word));
+      lanes[j] = (lanes[j] ^ word) * prime;
+      lanes[j] ^= lanes[j] >> 29;
+    }
+  }
+
+  std::uint64_t hash = lanes[0] ^ (lanes[1] * 31) ^ (lanes[2] * 131) ^
+    (lanes[3] * 8191);
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+std::uint32_t Snapshot::store(std::uint8_t const* data, std::uint64_t hash)
+{
+  if(isZeroPage(data))
+    return ZERO_SLOT;
+
+  auto itr = m_dedup.find(hash);
+  if(itr != m_dedup.end())
+  {
+    // Guard against hash collisions before sharing the slot.
+    std::vector<std::uint8_t> existing(PAGE_BYTES);
+    m_store.get(itr->second, &existing[0], PAGE_BYTES);
+    if(std::memcmp(&existing[0], data, PAGE_BYTES) == 0)
+    {
+      m_store.retain(itr->second);
+      return itr->second;
+    }
+
+    return m_store.put(data, PAGE_BYTES);
+  }
+
+  std::uint32_t slot = m_store.put(data, PAGE_BYTES);
+  m_dedup.insert(std::make_pair(hash, slot));
+  return slot;
+}
+
+void Snapshot::drop(Page const& page)
+{
+  if(page.slot == ZERO_SLOT)
+    return;
+
+  if(m_store.release(page.slot))
+  {
+    auto itr = m_dedup.find(page.hash);
+    if(itr != m_dedup.end() && itr->second == page.slot)
+      m_dedup.erase(itr);
+  }
+}
+
+std::size_t Snapshot::capture(MemoryEditor& editor,
+  ScanContext const& context)
+{
+  BOOST_FOREACH(Page const& cur, m_pages)
+    drop(cur);
+  m_pages.clear();
+  m_regions.clear();
+
+  std::uint64_t total = 0;
+  MemoryRegionSequence seq = makeMemoryRegionSequence(editor.getProcess());
+  BOOST_FOREACH(MemoryRegion const& region, seq)
+  {
+    if(region.isReadable() && region.isWriteable() && region.isPrivate())
+    {
+      m_regions.push_back(region);
+      total += region.getSize();
+    }
+  }
+
+  ScanContext::Scope scope(context, total);
+  std::vector<std::uint8_t> buffer(PAGES_PER_READ * PAGE_BYTES);
+  BOOST_FOREACH(MemoryRegion const& region, m_regions)
+  {
+    for(std::uintptr_t address = region.getStartAddress();
+      address < region.getEndAddress(); )
+    {
+      context.check();
+
+      std::size_t amount = std::min<std::size_t>(buffer.size(),
+        region.getEndAddress() - address);
+      std::size_t read = readChunk(editor, address, &buffer[0], amount);
+
+      for(std::size_t offset = 0; offset + PAGE_BYTES <= read;
+        offset += PAGE_BYTES)
+      {
+        Page page;
+        page.address = address + offset;
+        page.hash = hashPage(&buffer[offset]);
+        page.slot = store(&buffer[offset], page.hash);
+        m_pages.push_back(page);
+      }
+
+      // Skip the rest of the region if it could not be read entirely.
+      if(read != amount)
+      {
+        context.advance(region.getEndAddress() - address);
+        break;
+      }
+
+      context.advance(amount);
+      address += amount;
+    }
+  }
+
+  return m_pages.size();
+}
+
+std::vector<Snapshot::Page> const& Snapshot::getPages() const
+{
+  return m_pages;
+}
+
+std::vector<MemoryRegion> const& Snapshot::getRegions() const
+{
+  return m_regions;
+}
+
+void Snapshot::loadPage(std::size_t index, std::uint8_t* dest) const
+{
+  Page const& page = m_pages.at(index);
+  if(page.slot == ZERO_SLOT)
+    std::fill(dest, dest + PAGE_BYTES, 0);
+  else
+    m_store.get(page.slot, dest, PAGE_BYTES);
+}
+
+void Snapshot::updatePage(std::size_t index, std::uint8_t const* data,
+  std::uint64_t hash)
+{
+  Page& page = m_pages.at(index);
+  std::uint32_t slot = store(data, hash);
+  drop(page);
+
+  page.hash = hash;
+  page.slot = slot;
+}
+
+void Snapshot::discardPage(std::size_t index)
+{
+  Page& page = m_pages.at(index);
+  drop(page);
+
+  page.hash = 0;
+  page.slot = ZERO_SLOT;
+}
+
+PageStore const& Snapshot::getStore() const
+{
+  return m_store;
+}
+
+/* UnknownValueScan class */
+
+// Compares the candidates of a page whose content changed.
+template<typename T>
+static void comparePage(std::uint8_t const* before, std::uint8_t const* after,
+  ChangeCompare compare, std::size_t alignment,
+  std::vector<std::uint64_t>& bits, std::uint32_t& count)
+{
+  std::uint32_t remaining = 0;
+  for(std::size_t word = 0; word < bits.size(); ++word)
+  {
+    std::uint64_t current = bits[word];
+    while(current)
+    {
+      std::size_t bit = __builtin_ctzll(current);
+      current &= current - 1;
+
+      std::size_t offset = (word * 64 + bit) * alignment;
+      T previous, now;
+      std::memcpy(&previous, before + offset, sizeof(T));
+      std::memcpy(&now, after + offset, sizeof(T));
+
+      // Changed and unchanged compare representations, so NaNs which stayed
+      // the same count as unchanged.
+      bool keep = false;
+      switch(compare)
+      {
+      case ChangeCompare::CHANGED:
+        keep = std::memcmp(&previous, &now, sizeof(T)) != 0;
+        break;
+      case ChangeCompare::UNCHANGED:
+        keep = std::memcmp(&previous, &now, sizeof(T)) == 0;
+        break;
+      case ChangeCompare::INCREASED:
+        keep = now > previous;
+        break;
+      case ChangeCompare::DECREASED:
+        keep = now < previous;
+        break;
+      }
+
+      if(keep)
+        ++remaining;
+      else
+        bits[word] &= ~(std::uint64_t(1) << bit);
+    }
+  }
+
+  count = remaining;
+}
+
+static void comparePage(ValueType type, std::uint8_t const* before,
+  std::uint8_t const* after, ChangeCompare compare, std::size_t alignment,
+  std::vector<std::uint64_t>& bits, std::uint32_t& count)
+{
+  switch(type)
+  {
+  case ValueType::INT8:
+    comparePage<std::int8_t>(before, after, compare, alignment, bits, count);
+    break;
+  case ValueType::UINT8:
+    comparePage<std::uint8_t>(before, after, compare, alignment, bits, count);
+    break;
+  case ValueType::INT16:
+    comparePage<std::int16_t>(before, after, compare, alignment, bits, count);
+    break;
+  case ValueType::UINT16:
+    comparePage<std::uint16_t>(before, after, compare, alignment, bits,
+      count);
+    break;
+  case ValueType::INT32:
+    comparePage<std::int32_t>(before, after, compare, alignment, bits, count);
+    break;
+  case ValueType::UINT32:
+    comparePage<std::uint32_t>(before, after, compare, alignment, bits,
+      count);
+    break;
+  case ValueType::INT64:
+    comparePage<std::int64_t>(before, after, compare, alignment, bits, count);
+    break;
+  case ValueType::UINT64:
+    comparePage<std::uint64_t>(before, after, compare, alignment, bits,
+      count);
+    break;
+  case ValueType::FLOAT:
+    comparePage<float>(before, after, compare, alignment, bits, count);
+    break;
+  case ValueType::DOUBLE:
+    comparePage<double>(before, after, compare, alignment, bits, count);
+    break;
+  }
+}
+
+UnknownValueScan::UnknownValueScan(MemoryEditor const& editor,
+  ValueType type, std::size_t alignment, SnapshotStorage storage,
+  std::size_t memoryLimit, boost::filesystem::path const& path)
+  : m_editor(editor), m_type(type),
+    m_alignment(alignment ? alignment : Ethon::getValueTypeSize(type)),
+    m_slotsPerPage(0), m_snapshot(storage, memoryLimit, path),
+    m_candidates(), m_context()
+{
+  std::size_t const size = Ethon::getValueTypeSize(type);
+  if(m_alignment > Snapshot::PAGE_BYTES)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Alignment exceeds the page size"));
+  }
+
+  m_slotsPerPage = (Snapshot::PAGE_BYTES - size) / m_alignment + 1;
+}
+
+void UnknownValueScan::setContext(ScanContext const& context)
+{
+  m_context = context;
+}
+
+ScanContext const& UnknownValueScan::getContext() const
+{
+  return m_context;
+}
+
+std::uint64_t UnknownValueScan::start()
+{
+  std::size_t pages = m_snapshot.capture(m_editor, m_context);
+
+  Candidates all;
+  all.count = m_slotsPerPage;
+  m_candidates.assign(pages, all);
+
+  return getResultCount();
+}
+
+std::uint64_t UnknownValueScan::next(ChangeCompare compare)
+{
+  std::vector<Snapshot::Page> const& pages = m_snapshot.getPages();
+  std::vector<std::uint8_t> buffer(PAGES_PER_READ * Snapshot::PAGE_BYTES);
+  std::vector<std::uint8_t> before(Snapshot::PAGE_BYTES);
+  std::size_t const words = (m_slotsPerPage + 63) / 64;
+
+  std::uint64_t total = 0;
+  BOOST_FOREACH(Candidates const& cur, m_candidates)
+  {
+    if(cur.count)
+      total += Snapshot::PAGE_BYTES;
+  }
+
+  ScanContext::Scope scope(m_context, total);
+  for(std::size_t first = 0; first < pages.size(); )
+  {
+    if(!m_candidates[first].count)
+    {
+      ++first;
+      continue;
+    }
+
+    m_context.check();
+
+    // Read a run of consecutive candidate pages at once.
+    std::size_t last = first + 1;
+    while(last < pages.size() && last - first < PAGES_PER_READ &&
+      m_candidates[last].count && pages[last].address ==
+      pages[last - 1].address + Snapshot::PAGE_BYTES)
+    {
+      ++last;
+    }
+
+    std::size_t amount = (last - first) * Snapshot::PAGE_BYTES;
+    std::size_t read = readChunk(m_editor, pages[first].address, &buffer[0],
+      amount);
+
+    for(std::size_t i = first; i < last; ++i)
+    {
+      Candidates& candidates = m_candidates[i];
+      std::size_t offset = (i - first) * Snapshot::PAGE_BYTES;
+
+      // A failed read of a run says nothing about the pages behind the
+      // failing one, so these are read one by one.
+      bool present = offset + Snapshot::PAGE_BYTES <= read;
+      if(!present && last - first > 1)
+      {
+        present = readChunk(m_editor, pages[i].address, &buffer[offset],
+          Snapshot::PAGE_BYTES) == Snapshot::PAGE_BYTES;
+      }
+
+      // The page vanished, nothing can be compared.
+      if(!present)
+      {
+        candidates.count = 0;
+        std::vector<std::uint64_t>().swap(candidates.bits);
+        m_snapshot.discardPage(i);
+        continue;
+      }
+
+      std::uint8_t const* after = &buffer[offset];
+      std::uint64_t hash = Snapshot::hashPage(after);
+      if(hash == pages[i].hash)
+      {
+        // The page did not change, so every candidate is unchanged.
+        if(compare != ChangeCompare::UNCHANGED)
+        {
+          candidates.count = 0;
+          std::vector<std::uint64_t>().swap(candidates.bits);
+          m_snapshot.discardPage(i);
+        }
+        continue;
+      }
+
+      if(candidates.bits.empty())
+      {
+        candidates.bits.assign(words, ~std::uint64_t(0));
+        if(m_slotsPerPage % 64)
+          candidates.bits.back() = (std::uint64_t(1) << (m_slotsPerPage % 64))
+            - 1;
+      }
+
+      m_snapshot.loadPage(i, &before[0]);
+      comparePage(m_type, &before[0], after, compare, m_alignment,
+        candidates.bits, candidates.count);
+      // Pages without candidates are never compared again.
+      if(!candidates.count)
+      {
+        std::vector<std::uint64_t>().swap(candidates.bits);
+        m_snapshot.discardPage(i);
+      }
+      else
+        m_snapshot.updatePage(i, after, hash);
+    }
+
+    m_context.advance(amount);
+    first = last;
+  }
+
+  return getResultCount();
+}
+
+std::uint64_t UnknownValueScan::getResultCount() const
+{
+  std::uint64_t count = 0;
+  BOOST_FOREACH(Candidates const& cur, m_candidates)
+    count += cur.count;
+
+  return count;
+}
+
+std::vector<std::uintptr_t> UnknownValueScan::getResults(
+  std::size_t limit) const
+{
+  std::vector<Snapshot::Page> const& pages = m_snapshot.getPages();
+  std::vector<std::uintptr_t> results;
+
+  for(std::size_t i = 0; i < pages.size() && results.size() < limit; ++i)
+  {
+    Candidates const& candidates = m_candidates[i];
+    if(!candidates.count)
+      continue;
+
+    for(std::size_t slot = 0; slot < m_slotsPerPage &&
+      results.size() < limit; ++slot)
+    {
+      if(candidates.bits.empty() ||
+        (candidates.bits[slot / 64] >> (slot % 64)) & 1)
+      {
+        results.push_back(pages[i].address + slot * m_alignment);
+      }
+    }
+  }
+
+  return results;
+}
+
+Snapshot const& UnknownValueScan::getSnapshot() const
+{
+  return m_snapshot;
+}
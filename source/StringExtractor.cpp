@@ -0,0 +1,507 @@
+/*
+StringExtractor.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// SSE2:
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Memory.hpp>
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/StringExtractor.hpp>
+
+using Ethon::StringExtractor;
+using Ethon::ExtractedString;
+using Ethon::StringEncoding;
+using Ethon::MemoryEditor;
+using Ethon::MemorySource;
+using Ethon::ProcessMemorySource;
+using Ethon::MemoryRegion;
+using Ethon::Scanner;
+using Ethon::ScanContext;
+using Ethon::ArgumentError;
+using Ethon::ErrorString;
+
+namespace
+{
+  bool isPrintable(std::uint8_t byte)
+  {
+    return (byte >= 0x20 && byte <= 0x7E) || byte == '\t';
+  }
+
+  // Gathers the even bits of a mask into the low 32 bits.
+  std::uint64_t compressEven(std::uint64_t mask)
+  {
+    mask &= 0x5555555555555555ULL;
+    mask = (mask | (mask >> 1)) & 0x3333333333333333ULL;
+    mask = (mask | (mask >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+    mask = (mask | (mask >> 4)) & 0x00FF00FF00FF00FFULL;
+    mask = (mask | (mask >> 8)) & 0x0000FFFF0000FFFFULL;
+    mask = (mask | (mask >> 16)) & 0x00000000FFFFFFFFULL;
+    return mask;
+  }
+
+  // Per chunk state shared by all trackers of a region.
+  struct Chunk
+  {
+    std::uint8_t const* data;
+    std::uintptr_t address;
+    MemoryRegion const* region;
+  };
+
+  // Follows the runs of one encoding and alignment through a region.
+  // Units are the characters, width bytes apart, the printable byte of a
+  // unit lying at charOffset.
+  class Tracker
+  {
+  private:
+    StringEncoding m_encoding;
+    std::size_t m_width;
+    std::size_t m_charOffset;
+    std::size_t m_minLength;
+
+    bool m_active;
+    std::uintptr_t m_start;       // Address of the run's first unit.
+    std::size_t m_startOffset;    // Chunk offset of the first unit of the
+                                  // run inside the current chunk.
+    std::size_t m_length;         // Units in the run.
+    std::string m_pending;        // Characters from earlier chunks.
+
+  public:
+    Tracker(StringEncoding encoding, std::size_t width,
+      std::size_t charOffset, std::size_t minLength)
+      : m_encoding(encoding), m_width(width), m_charOffset(charOffset),
+        m_minLength(minLength), m_active(false), m_start(0),
+        m_startOffset(0), m_length(0)
+    { }
+
+    bool isActive() const
+    {
+      return m_active;
+    }
+
+    // The run continues in a new chunk, starting at unit offset.
+    void beginChunk(std::size_t offset)
+    {
+      m_startOffset = offset;
+    }
+
+    // Saves the characters of an unfinished run before the chunk is gone.
+    void endChunk(Chunk const& chunk)
+    {
+      if(!m_active)
+        return;
+
+      append(chunk, m_length - m_pending.size());
+    }
+
+    // Feeds a mask of printable units, unit 0 at chunk offset offset.
+    template<typename EMIT>
+    bool feed(Chunk const& chunk, std::uint64_t mask, std::size_t units,
+      std::size_t offset, EMIT const& emit)
+    {
+      if(units < 64)
+        mask &= (static_cast<std::uint64_t>(1) << units) - 1;
+      if(!m_active && !mask)
+        return true;
+
+      // Bit i of window is set if units i to i + minLength - 1 are
+      // printable, which marks the start of every long enough run lying
+      // inside the block. Short runs are skipped without looking at them.
+      std::uint64_t window = 0;
+      if(m_minLength <= units)
+      {
+        window = mask;
+        for(std::size_t span = 1; span < m_minLength; )
+        {
+          std::size_t shift = std::min(span, m_minLength - span);
+          window &= window >> shift;
+          span += shift;
+        }
+      }
+
+      if(!m_active && !window && !(mask >> (units - 1)))
+        return true;
+
+      std::size_t pos = 0;
+      while(pos < units)
+      {
+        if(m_active)
+        {
+          std::uint64_t rest = ~(mask >> pos);
+          std::size_t ones = rest ? __builtin_ctzll(rest) : 64 - pos;
+          ones = std::min(ones, units - pos);
+          m_length += ones;
+          pos += ones;
+          if(pos < units && !finish(chunk, emit))
+            return false;
+          continue;
+        }
+
+        std::uint64_t rest = window >> pos;
+        if(rest)
+          pos += __builtin_ctzll(rest);
+        else
+        {
+          // Only a run reaching the end of the block may continue in the
+          // next one and become long enough.
+          std::uint64_t top = ~mask & ((units < 64 ?
+            static_cast<std::uint64_t>(1) << units : 0) - 1);
+          std::size_t trailing = top ? units - 1 - (63 - __builtin_clzll(top)) :
+            units;
+          if(!trailing || units - trailing < pos)
+            break;
+          pos = units - trailing;
+        }
+
+        m_active = true;
+        m_start = chunk.address + offset + pos * m_width;
+        m_startOffset = offset + pos * m_width;
+        m_length = 0;
+        m_pending.clear();
+      }
+
+      return true;
+    }
+
+    // Ends the current run, reporting it if it is long enough.
+    template<typename EMIT>
+    bool finish(Chunk const& chunk, EMIT const& emit)
+    {
+      if(!m_active)
+        return true;
+
+      m_active = false;
+      if(m_length < m_minLength)
+        return true;
+
+      append(chunk, m_length - m_pending.size());
+      ExtractedString result = {m_start, m_encoding, std::string(),
+        chunk.region};
+      result.text.swap(m_pending);
+      return emit(result);
+    }
+
+  private:
+    void append(Chunk const& chunk, std::size_t count)
+    {
+      if(!count)
+        return;
+
+      std::uint8_t const* cur = chunk.data + m_startOffset + m_charOffset;
+      if(m_width == 1)
+        m_pending.append(reinterpret_cast<char const*>(cur), count);
+      else
+      {
+        for(std::size_t i = 0; i < count; ++i, cur += m_width)
+          m_pending += static_cast<char>(*cur);
+      }
+    }
+  };
+
+  // Classifies 64 bytes into a mask of printable and a mask of zero bytes.
+  void classify(std::uint8_t const* data, std::size_t size,
+    std::uint64_t& printable, std::uint64_t& zero)
+  {
+    printable = zero = 0;
+#ifdef __SSE2__
+    if(size >= 64)
+    {
+      __m128i const low = _mm_set1_epi8(0x1F);
+      __m128i const high = _mm_set1_epi8(0x7F);
+      __m128i const tab = _mm_set1_epi8('\t');
+      __m128i const null = _mm_setzero_si128();
+      for(std::size_t i = 0; i < 64; i += 16)
+      {
+        __m128i value = _mm_loadu_si128(
+          reinterpret_cast<__m128i const*>(data + i));
+        __m128i isPrintable = _mm_or_si128(
+          _mm_and_si128(_mm_cmpgt_epi8(value, low),
+            _mm_cmplt_epi8(value, high)),
+          _mm_cmpeq_epi8(value, tab));
+        printable |= static_cast<std::uint64_t>(static_cast<unsigned>(
+          _mm_movemask_epi8(isPrintable))) << i;
+        zero |= static_cast<std::uint64_t>(static_cast<unsigned>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(value, null)))) << i;
+      }
+      return;
+    }
+#endif
+
+    for(std::size_t i = 0; i < std::min<std::size_t>(size, 64); ++i)
+    {
+      printable |= static_cast<std::uint64_t>(isPrintable(data[i])) << i;
+      zero |= static_cast<std::uint64_t>(data[i] == 0) << i;
+    }
+  }
+
+  // Extracts the strings of one region.
+  class RegionExtraction
+  {
+  private:
+    std::vector<Tracker> m_trackers;
+    bool m_ascii, m_little, m_big;
+
+  public:
+    RegionExtraction(StringEncoding encodings, std::size_t minLength)
+      : m_ascii(hasEncoding(encodings, StringEncoding::UTF8)),
+        m_little(hasEncoding(encodings, StringEncoding::UTF16LE)),
+        m_big(hasEncoding(encodings, StringEncoding::UTF16BE))
+    {
+      // ASCII, then UTF-16LE and UTF-16BE for even and odd addresses.
+      m_trackers.push_back(Tracker(StringEncoding::UTF8, 1, 0, minLength));
+      for(int parity = 0; parity < 2; ++parity)
+      {
+        m_trackers.push_back(Tracker(StringEncoding::UTF16LE, 2, 0,
+          minLength));
+      }
+      for(int parity = 0; parity < 2; ++parity)
+      {
+        m_trackers.push_back(Tracker(StringEncoding::UTF16BE, 2, 1,
+          minLength));
+      }
+    }
+
+    // Processes units starting before owned, reading up to size bytes.
+    template<typename EMIT>
+    bool process(Chunk const& chunk, std::size_t size, std::size_t owned,
+      EMIT const& emit)
+    {
+      for(std::size_t i = 0; i < m_trackers.size(); ++i)
+        m_trackers[i].beginChunk(i ? (i - 1) % 2 : 0);
+
+      for(std::size_t offset = 0; offset < owned; offset += 64)
+      {
+        std::uint8_t const* data = chunk.data + offset;
+        std::uint64_t printable, zero;
+        classify(data, size - offset, printable, zero);
+
+        std::size_t asciiUnits = std::min<std::size_t>(64, owned - offset);
+        if(m_ascii && !m_trackers[0].feed(chunk, printable, asciiUnits,
+          offset, emit))
+        {
+          return false;
+        }
+
+        if(!m_little && !m_big)
+          continue;
+
+        // A UTF-16 unit at i also needs byte i + 1.
+        bool nextPrintable = false, nextZero = false;
+        if(offset + 64 < size)
+        {
+          nextPrintable = isPrintable(data[64]);
+          nextZero = data[64] == 0;
+        }
+
+        std::uint64_t little = printable & ((zero >> 1) |
+          (static_cast<std::uint64_t>(nextZero) << 63));
+        std::uint64_t big = zero & ((printable >> 1) |
+          (static_cast<std::uint64_t>(nextPrintable) << 63));
+
+        std::size_t limit = std::min(owned - offset, size - offset - 1);
+        if(m_little && !feedUtf16(chunk, little, limit, offset, 1, emit))
+          return false;
+        if(m_big && !feedUtf16(chunk, big, limit, offset, 3, emit))
+          return false;
+      }
+
+      BOOST_FOREACH(Tracker& cur, m_trackers)
+        cur.endChunk(chunk);
+      return true;
+    }
+
+    // Feeds the even and odd units of a UTF-16 mask to the trackers at
+    // first and first + 1.
+    template<typename EMIT>
+    bool feedUtf16(Chunk const& chunk, std::uint64_t mask, std::size_t limit,
+      std::size_t offset, std::size_t first, EMIT const& emit)
+    {
+      if(!mask && !m_trackers[first].isActive() &&
+        !m_trackers[first + 1].isActive())
+      {
+        return true;
+      }
+
+      for(std::size_t parity = 0; parity < 2; ++parity)
+      {
+        std::size_t units = limit > parity ?
+          std::min<std::size_t>(32, (limit - parity + 1) / 2) : 0;
+        if(!m_trackers[first + parity].feed(chunk,
+          compressEven(mask >> parity), units, offset + parity, emit))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    // Ends all runs at the end of the region or an unreadable part.
+    template<typename EMIT>
+    bool finish(Chunk const& chunk, EMIT const& emit)
+    {
+      BOOST_FOREACH(Tracker& cur, m_trackers)
+      {
+        if(!cur.finish(chunk, emit))
+          return false;
+      }
+
+      return true;
+    }
+  };
+}
+
+/* StringExtractor class */
+
+StringExtractor::StringExtractor(MemoryEditor const& editor,
+  std::size_t minLength, StringEncoding encodings, std::size_t threads)
+  : m_source(std::make_shared<ProcessMemorySource>(editor)),
+    m_minLength(std::max<std::size_t>(minLength, 1)),
+    m_encodings(encodings), m_threads(threads), m_context()
+{ }
+
+StringExtractor::StringExtractor(std::shared_ptr<MemorySource> const& source,
+  std::size_t minLength, StringEncoding encodings, std::size_t threads)
+  : m_source(source), m_minLength(std::max<std::size_t>(minLength, 1)),
+    m_encodings(encodings), m_threads(threads), m_context()
+{ }
+
+void StringExtractor::setContext(ScanContext const& context)
+{
+  m_context = context;
+}
+
+bool StringExtractor::extract(Callback const& callback,
+  MemoryRegion const* region)
+{
+  return extract(Scanner(m_source).selectRegions(region), callback);
+}
+
+bool StringExtractor::extract(Callback const& callback,
+  RegionFilter const& filter)
+{
+  return extract(Scanner(m_source).selectRegions(filter), callback);
+}
+
+bool StringExtractor::extract(std::vector<MemoryRegion> const& regions,
+  Callback const& callback)
+{
+  std::size_t threadCount = m_threads ? m_threads :
+    std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+  threadCount = std::min(threadCount,
+    std::max<std::size_t>(regions.size(), 1));
+
+  std::uint64_t total = 0;
+  BOOST_FOREACH(MemoryRegion const& cur, regions)
+  {
+    if(cur.isReadable())
+      total += cur.getSize();
+  }
+  ScanContext::Scope scope(m_context, total);
+
+  std::mutex mutex;
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stopped(false);
+  std::vector<std::exception_ptr> errors(threadCount);
+
+  auto emit = [&](ExtractedString const& string) -> bool
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(stopped)
+      return false;
+    if(!callback(string))
+      stopped = true;
+    return !stopped;
+  };
+
+  auto worker = [&](std::size_t index)
+  {
+    try
+    {
+      // The workers' scanners add to the extraction's progress.
+      Scanner scanner(m_source);
+      scanner.setContext(m_context);
+      for(std::size_t i = next++; i < regions.size() && !stopped; i = next++)
+      {
+        MemoryRegion const& cur = regions[i];
+        if(!cur.isReadable())
+          continue;
+
+        RegionExtraction extraction(m_encodings, m_minLength);
+        Chunk last = {0, 0, &cur};
+
+        // Chunks overlap by a byte, so units at their end are complete.
+        bool more = scanner.walkRegion(cur, 1, [&](std::uint8_t const* data,
+          std::size_t amount, std::uintptr_t address) -> bool
+        {
+          Chunk chunk = {data, address, &cur};
+          last = chunk;
+          return extraction.process(chunk, amount,
+            std::min(amount, Scanner::CHUNK_SIZE), emit);
+        });
+
+        // Unfinished runs keep their characters in memory, so no chunk
+        // data is needed for finishing them.
+        last.data = 0;
+        if(!more || !extraction.finish(last, emit))
+          break;
+      }
+    }
+    catch(...)
+    {
+      errors[index] = std::current_exception();
+      stopped = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < threadCount; ++i)
+    threads.push_back(std::thread(worker, i));
+  BOOST_FOREACH(std::thread& cur, threads)
+    cur.join();
+
+  BOOST_FOREACH(std::exception_ptr const& cur, errors)
+  {
+    if(cur)
+      std::rethrow_exception(cur);
+  }
+
+  return !stopped;
+}
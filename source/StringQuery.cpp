@@ -0,0 +1,335 @@
+/*
+StringQuery.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// SSE2:
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/StringQuery.hpp>
+
+using Ethon::StringQuery;
+using Ethon::StringEncoding;
+using Ethon::StringMatch;
+using Ethon::ArgumentError;
+using Ethon::ErrorString;
+
+namespace
+{
+  std::vector<char32_t> decodeUtf8(std::string const& text)
+  {
+    std::vector<char32_t> result;
+    for(std::size_t i = 0; i < text.size(); )
+    {
+      std::uint8_t lead = static_cast<std::uint8_t>(text[i]);
+      std::size_t length = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 :
+        (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 0;
+      if(!length || i + length > text.size())
+      {
+        BOOST_THROW_EXCEPTION(ArgumentError() <<
+          ErrorString("Invalid UTF-8 string"));
+      }
+
+      char32_t code = length == 1 ? lead : lead & (0x7F >> length);
+      for(std::size_t j = 1; j < length; ++j)
+      {
+        std::uint8_t cur = static_cast<std::uint8_t>(text[i + j]);
+        if((cur & 0xC0) != 0x80)
+        {
+          BOOST_THROW_EXCEPTION(ArgumentError() <<
+            ErrorString("Invalid UTF-8 string"));
+        }
+        code = (code << 6) | (cur & 0x3F);
+      }
+
+      static char32_t const minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+      if(code < minimum[length] || code > 0x10FFFF ||
+        (code >= 0xD800 && code <= 0xDFFF))
+      {
+        BOOST_THROW_EXCEPTION(ArgumentError() <<
+          ErrorString("Invalid UTF-8 string"));
+      }
+
+      result.push_back(code);
+      i += length;
+    }
+
+    return result;
+  }
+
+  bool isLetter(char32_t code)
+  {
+    return (code >= 'a' && code <= 'z') || (code >= 'A' && code <= 'Z');
+  }
+
+  // Appends a byte, folded if it is a letter and case is ignored.
+  void append(StringQuery::Needle& needle, std::uint8_t byte, bool fold)
+  {
+    needle.pattern.push_back(fold ? byte | 0x20 : byte);
+    needle.fold.push_back(fold ? 0x20 : 0x00);
+  }
+
+  void appendUtf16(StringQuery::Needle& needle, std::uint16_t unit,
+    bool fold, bool bigEndian)
+  {
+    std::uint8_t low = unit & 0xFF, high = unit >> 8;
+    append(needle, bigEndian ? high : low, fold && !bigEndian);
+    append(needle, bigEndian ? low : high, fold && bigEndian);
+  }
+
+  StringQuery::Needle makeNeedle(std::vector<char32_t> const& text,
+    StringEncoding encoding, bool ignoreCase)
+  {
+    StringQuery::Needle needle;
+    needle.encoding = encoding;
+
+    BOOST_FOREACH(char32_t code, text)
+    {
+      bool fold = ignoreCase && isLetter(code);
+      if(encoding == StringEncoding::UTF8)
+      {
+        if(code < 0x80)
+          append(needle, code, fold);
+        else if(code < 0x800)
+        {
+          append(needle, 0xC0 | (code >> 6), false);
+          append(needle, 0x80 | (code & 0x3F), false);
+        }
+        else if(code < 0x10000)
+        {
+          append(needle, 0xE0 | (code >> 12), false);
+          append(needle, 0x80 | ((code >> 6) & 0x3F), false);
+          append(needle, 0x80 | (code & 0x3F), false);
+        }
+        else
+        {
+          append(needle, 0xF0 | (code >> 18), false);
+          append(needle, 0x80 | ((code >> 12) & 0x3F), false);
+          append(needle, 0x80 | ((code >> 6) & 0x3F), false);
+          append(needle, 0x80 | (code & 0x3F), false);
+        }
+        continue;
+      }
+
+      bool bigEndian = encoding == StringEncoding::UTF16BE;
+      if(code < 0x10000)
+        appendUtf16(needle, code, fold, bigEndian);
+      else
+      {
+        code -= 0x10000;
+        appendUtf16(needle, 0xD800 | (code >> 10), false, bigEndian);
+        appendUtf16(needle, 0xDC00 | (code & 0x3FF), false, bigEndian);
+      }
+    }
+
+    needle.size = needle.pattern.size();
+
+    // Zero bytes, like the high halves of UTF-16 ASCII, are poor filters.
+    needle.first = 0;
+    while(needle.first + 1 < needle.size && !needle.pattern[needle.first])
+      ++needle.first;
+    needle.last = needle.size - 1;
+    while(needle.last > needle.first && !needle.pattern[needle.last])
+      --needle.last;
+
+    // Padding always matches, as (byte | 0xFF) == 0xFF.
+    std::size_t padded = (needle.size + 15) / 16 * 16;
+    needle.pattern.resize(padded, 0xFF);
+    needle.fold.resize(padded, 0xFF);
+    return needle;
+  }
+
+  bool verify(StringQuery::Needle const& needle, std::uint8_t const* data,
+    std::size_t available)
+  {
+#ifdef __SSE2__
+    if(available >= needle.pattern.size())
+    {
+      for(std::size_t i = 0; i < needle.pattern.size(); i += 16)
+      {
+        __m128i value = _mm_loadu_si128(
+          reinterpret_cast<__m128i const*>(data + i));
+        __m128i fold = _mm_loadu_si128(
+          reinterpret_cast<__m128i const*>(&needle.fold[i]));
+        __m128i pattern = _mm_loadu_si128(
+          reinterpret_cast<__m128i const*>(&needle.pattern[i]));
+        __m128i equal = _mm_cmpeq_epi8(_mm_or_si128(value, fold), pattern);
+        if(_mm_movemask_epi8(equal) != 0xFFFF)
+          return false;
+      }
+
+      return true;
+    }
+#endif
+
+    if(available < needle.size)
+      return false;
+
+    for(std::size_t i = 0; i < needle.size; ++i)
+    {
+      if((data[i] | needle.fold[i]) != needle.pattern[i])
+        return false;
+    }
+
+    return true;
+  }
+}
+
+/* StringQuery class */
+
+StringQuery::StringQuery(std::string const& text, StringEncoding encodings,
+  bool ignoreCase)
+{
+  std::vector<char32_t> decoded = decodeUtf8(text);
+  if(decoded.empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Empty string query"));
+  }
+
+  static StringEncoding const all[] = {
+    StringEncoding::UTF8, StringEncoding::UTF16LE, StringEncoding::UTF16BE
+  };
+
+  BOOST_FOREACH(StringEncoding cur, all)
+  {
+    if(hasEncoding(encodings, cur))
+      m_needles.push_back(makeNeedle(decoded, cur, ignoreCase));
+  }
+
+  if(m_needles.empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("No encoding selected"));
+  }
+
+  m_minSize = m_maxSize = m_needles.front().size;
+  BOOST_FOREACH(Needle const& cur, m_needles)
+  {
+    m_minSize = std::min(m_minSize, cur.size);
+    m_maxSize = std::max(m_maxSize, cur.size);
+  }
+}
+
+std::vector<StringQuery::Needle> const& StringQuery::getNeedles() const
+{
+  return m_needles;
+}
+
+std::size_t StringQuery::getMinSize() const
+{
+  return m_minSize;
+}
+
+std::size_t StringQuery::getMaxSize() const
+{
+  return m_maxSize;
+}
+
+std::size_t StringQuery::match(std::uint8_t const* data, std::size_t size,
+  std::size_t count, std::uintptr_t address,
+  std::vector<StringMatch>& results, std::size_t limit) const
+{
+  std::size_t const needles = m_needles.size();
+  std::size_t appended = 0;
+  std::size_t i = 0;
+  count = std::min(count, size);
+  if(!limit)
+    return 0;
+
+#ifdef __SSE2__
+  __m128i firstPattern[3], firstFold[3], lastPattern[3], lastFold[3];
+  for(std::size_t n = 0; n < needles; ++n)
+  {
+    Needle const& cur = m_needles[n];
+    firstPattern[n] = _mm_set1_epi8(static_cast<char>(cur.pattern[cur.first]));
+    firstFold[n] = _mm_set1_epi8(static_cast<char>(cur.fold[cur.first]));
+    lastPattern[n] = _mm_set1_epi8(static_cast<char>(cur.pattern[cur.last]));
+    lastFold[n] = _mm_set1_epi8(static_cast<char>(cur.fold[cur.last]));
+  }
+
+  // Filters 16 positions for all encodings at once, then verifies the
+  // candidates in address order.
+  for(; i + 16 <= count && i + 15 + m_maxSize <= size; i += 16)
+  {
+    unsigned bits[3] = {0, 0, 0};
+    unsigned any = 0;
+    for(std::size_t n = 0; n < needles; ++n)
+    {
+      Needle const& cur = m_needles[n];
+      __m128i first = _mm_or_si128(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(data + i + cur.first)), firstFold[n]);
+      __m128i last = _mm_or_si128(_mm_loadu_si128(
+        reinterpret_cast<__m128i const*>(data + i + cur.last)), lastFold[n]);
+      bits[n] = _mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(first, firstPattern[n]),
+        _mm_cmpeq_epi8(last, lastPattern[n])));
+      any |= bits[n];
+    }
+
+    while(any)
+    {
+      unsigned bit = __builtin_ctz(any);
+      std::size_t pos = i + bit;
+      for(std::size_t n = 0; n < needles; ++n)
+      {
+        if((bits[n] >> bit & 1) &&
+          verify(m_needles[n], data + pos, size - pos))
+        {
+          StringMatch match = {address + pos, m_needles[n].encoding};
+          results.push_back(match);
+          if(++appended == limit)
+            return appended;
+        }
+      }
+      any &= any - 1;
+    }
+  }
+#endif
+
+  for(; i < count; ++i)
+  {
+    for(std::size_t n = 0; n < needles; ++n)
+    {
+      if(verify(m_needles[n], data + i, size - i))
+      {
+        StringMatch match = {address + i, m_needles[n].encoding};
+        results.push_back(match);
+        if(++appended == limit)
+          return appended;
+      }
+    }
+  }
+
+  return appended;
+}
@@ -0,0 +1,271 @@
+/*
+StructQuery.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/ValueQuery.hpp>
+#include <Ethon/StructQuery.hpp>
+
+using Ethon::StructQuery;
+using Ethon::StructField;
+using Ethon::ValueQuery;
+using Ethon::ValueType;
+using Ethon::Comparison;
+using Ethon::ArgumentError;
+
+namespace
+{
+  // Memory is far from uniformly distributed: zeroes dominate, small
+  // integers are common and range queries tend to be wide.
+  double const ZERO_FREQUENCY = 0.25;
+  double const SMALL_FREQUENCY = 1.0 / 256;
+  double const RANGE_FREQUENCY = 1.0 / 4096;
+  double const FLOAT_RANGE_FREQUENCY = 1.0 / 64;
+  double const ORDER_FREQUENCY = 0.5;
+
+  template<typename T>
+  double estimateTyped(ValueQuery const& query)
+  {
+    T const first = query.getOperand<T>();
+    T const second = query.getOperand<T>(true);
+    bool const integral = std::is_integral<T>::value;
+    double const uniform = std::ldexp(1.0, -8 * static_cast<int>(sizeof(T)));
+
+    // Inclusive bounds of the matched values.
+    double low = static_cast<double>(first);
+    double high = low;
+    switch(query.getComparison())
+    {
+    case Comparison::EQUAL:
+      break;
+    case Comparison::RANGE:
+      high = static_cast<double>(second);
+      break;
+    case Comparison::EPSILON:
+      low -= static_cast<double>(second);
+      high += static_cast<double>(second);
+      break;
+    case Comparison::GREATER:
+    case Comparison::LESS:
+      return ORDER_FREQUENCY;
+    }
+
+    if(!(low <= high))
+      return 0.0;
+    if(low <= 0.0 && high >= 0.0)
+      return ZERO_FREQUENCY;
+
+    double frequency;
+    if(low == high)
+    {
+      frequency = uniform;
+      if(integral && std::fabs(low) < 256.0)
+        frequency = SMALL_FREQUENCY;
+    }
+    else if(integral)
+    {
+      frequency = std::max((high - low + 1.0) * uniform, RANGE_FREQUENCY);
+    }
+    else
+    {
+      frequency = FLOAT_RANGE_FREQUENCY;
+    }
+
+    return std::min(frequency, 1.0);
+  }
+}
+
+double Ethon::estimateSelectivity(ValueQuery const& query)
+{
+  switch(query.getType())
+  {
+  case ValueType::INT8: return estimateTyped<std::int8_t>(query);
+  case ValueType::UINT8: return estimateTyped<std::uint8_t>(query);
+  case ValueType::INT16: return estimateTyped<std::int16_t>(query);
+  case ValueType::UINT16: return estimateTyped<std::uint16_t>(query);
+  case ValueType::INT32: return estimateTyped<std::int32_t>(query);
+  case ValueType::UINT32: return estimateTyped<std::uint32_t>(query);
+  case ValueType::INT64: return estimateTyped<std::int64_t>(query);
+  case ValueType::UINT64: return estimateTyped<std::uint64_t>(query);
+  case ValueType::FLOAT: return estimateTyped<float>(query);
+  case ValueType::DOUBLE: return estimateTyped<double>(query);
+  }
+
+  return 1.0;
+}
+
+/* StructQuery class */
+
+std::size_t const StructQuery::npos;
+
+StructQuery::StructQuery(std::size_t alignment)
+  : m_fields(), m_order(), m_alignment(alignment), m_span(0),
+    m_prefilter(npos)
+{ }
+
+StructQuery& StructQuery::add(std::size_t offset, ValueQuery const& query)
+{
+  StructField field = { offset, query };
+  m_fields.push_back(field);
+  m_span = std::max(m_span, offset + query.getSize());
+  plan();
+  return *this;
+}
+
+StructQuery& StructQuery::setPrefilter(std::size_t index)
+{
+  if(index != npos && index >= m_fields.size())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Invalid prefilter field"));
+  }
+
+  m_prefilter = index;
+  plan();
+  return *this;
+}
+
+void StructQuery::plan()
+{
+  std::vector<double> selectivity;
+  for(std::size_t i = 0; i < m_fields.size(); ++i)
+    selectivity.push_back(Ethon::estimateSelectivity(m_fields[i].query));
+
+  // Cheap rejections first, ties go to wider fields.
+  m_order.clear();
+  for(std::size_t i = 0; i < m_fields.size(); ++i)
+    m_order.push_back(i);
+
+  std::stable_sort(m_order.begin(), m_order.end(),
+    [&](std::size_t lhs, std::size_t rhs)
+    {
+      if(selectivity[lhs] != selectivity[rhs])
+        return selectivity[lhs] < selectivity[rhs];
+      return m_fields[lhs].query.getSize() > m_fields[rhs].query.getSize();
+    });
+
+  if(m_prefilter != npos)
+  {
+    auto forced = std::find(m_order.begin(), m_order.end(), m_prefilter);
+    std::rotate(m_order.begin(), forced, forced + 1);
+  }
+}
+
+ValueQuery StructQuery::getPrefilterQuery() const
+{
+  StructField const& field = m_fields[m_order.front()];
+  std::size_t const alignment = getAlignment();
+
+  ValueQuery query = field.query;
+  query.setAlignment(alignment, field.offset % alignment);
+  return query;
+}
+
+std::vector<StructField> const& StructQuery::getFields() const
+{
+  return m_fields;
+}
+
+std::size_t StructQuery::getPrefilter() const
+{
+  return m_order.empty() ? npos : m_order.front();
+}
+
+std::size_t StructQuery::getAlignment() const
+{
+  if(m_alignment)
+    return m_alignment;
+
+  std::size_t alignment = 1;
+  BOOST_FOREACH(StructField const& field, m_fields)
+    alignment = std::max(alignment, field.query.getSize());
+  return alignment;
+}
+
+std::size_t StructQuery::getSpan() const
+{
+  return m_span;
+}
+
+std::size_t StructQuery::match(std::uint8_t const* data, std::size_t size,
+  std::size_t count, std::uintptr_t address,
+  std::vector<std::uintptr_t>& results, std::size_t limit) const
+{
+  if(m_fields.empty())
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Struct query without fields"));
+  }
+
+  if(size < m_span || !count || !limit)
+    return 0;
+
+  // Scan the prefilter field of every possible base, its matches are
+  // bounded by the buffer and verified in place.
+  std::size_t const bases = std::min(count, size - m_span + 1);
+  StructField const& prefilter = m_fields[m_order.front()];
+  std::uintptr_t const fieldAddress = address + prefilter.offset;
+
+  std::vector<std::uintptr_t> candidates;
+  getPrefilterQuery().match(data + prefilter.offset,
+    bases - 1 + prefilter.query.getSize(), fieldAddress, candidates);
+
+  std::size_t const before = results.size();
+  for(std::size_t i = 0; i < candidates.size() &&
+    results.size() - before < limit; ++i)
+  {
+    std::size_t base = candidates[i] - fieldAddress;
+
+    bool matches = true;
+    for(std::size_t j = 1; j < m_order.size() && matches; ++j)
+    {
+      StructField const& field = m_fields[m_order[j]];
+      matches = field.query.test(data + base + field.offset);
+    }
+
+    if(matches)
+      results.push_back(address + base);
+  }
+
+  return results.size() - before;
+}
+
+bool StructQuery::test(std::uint8_t const* data) const
+{
+  BOOST_FOREACH(std::size_t index, m_order)
+  {
+    StructField const& field = m_fields[index];
+    if(!field.query.test(data + field.offset))
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,469 @@
+/*
+SymbolResolver.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// POSIX:
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+
+// Boost Library:
+#include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/ModuleMap.hpp>
+#include <Ethon/SymbolResolver.hpp>
+
+using Ethon::ElfSymbols;
+using Ethon::ElfSymbol;
+using Ethon::SymbolResolver;
+using Ethon::Symbol;
+using Ethon::Module;
+using Ethon::ModuleMap;
+using Ethon::Process;
+using Ethon::EthonError;
+using Ethon::ArgumentError;
+using Ethon::FilesystemError;
+using Ethon::UnexpectedError;
+using Ethon::ErrorString;
+using Ethon::ErrorCode;
+
+namespace
+{
+  // Checks if a range lies inside a file of the given size.
+  bool isInside(std::uint64_t offset, std::uint64_t size,
+    std::uint64_t fileSize)
+  {
+    return offset <= fileSize && size <= fileSize - offset;
+  }
+
+  // Symbols with an address in the file.
+  bool isDefined(Elf64_Sym const& symbol)
+  {
+    return symbol.st_shndx != SHN_UNDEF && symbol.st_shndx != SHN_ABS &&
+      symbol.st_value != 0;
+  }
+
+  // Symbols an address can be attributed to.
+  bool isAddressable(Elf64_Sym const& symbol)
+  {
+    unsigned char const type = ELF64_ST_TYPE(symbol.st_info);
+    return isDefined(symbol) && (type == STT_FUNC || type == STT_OBJECT ||
+      type == STT_GNU_IFUNC);
+  }
+
+  std::uint32_t gnuHash(boost::string_ref name)
+  {
+    std::uint32_t hash = 5381;
+    BOOST_FOREACH(char cur, name)
+      hash = hash * 33 + static_cast<unsigned char>(cur);
+    return hash;
+  }
+}
+
+/* ElfSymbols class */
+
+std::size_t ElfSymbols::NameHash::operator()(boost::string_ref value) const
+{
+  return boost::hash_range(value.begin(), value.end());
+}
+
+ElfSymbols::ElfSymbols(boost::filesystem::path const& path)
+  : m_map(MAP_FAILED), m_size(0), m_loadAddress(0), m_dynsym(), m_symtab(),
+    m_gnuHash(0), m_gnuHashSize(0), m_indexed(false), m_names(), m_sorted()
+{
+  int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat info;
+  if(file == -1 || ::fstat(file, &info) == -1)
+  {
+    std::error_code const error = Ethon::makeErrorCode();
+    if(file != -1)
+      ::close(file);
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't open " + path.string()) <<
+      ErrorCode(error));
+  }
+
+  m_size = info.st_size;
+  if(m_size >= sizeof(Elf64_Ehdr))
+    m_map = ::mmap(0, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+  ::close(file);
+  if(m_map == MAP_FAILED)
+  {
+    BOOST_THROW_EXCEPTION(FilesystemError() <<
+      ErrorString("Can't map " + path.string()));
+  }
+
+  std::uint8_t const* data = static_cast<std::uint8_t const*>(m_map);
+  Elf64_Ehdr const& header = *reinterpret_cast<Elf64_Ehdr const*>(data);
+  if(std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+    header.e_ident[EI_CLASS] != ELFCLASS64 ||
+    header.e_shentsize != sizeof(Elf64_Shdr) ||
+    header.e_phentsize != sizeof(Elf64_Phdr) ||
+    !isInside(header.e_shoff, header.e_shnum * sizeof(Elf64_Shdr), m_size) ||
+    !isInside(header.e_phoff, header.e_phnum * sizeof(Elf64_Phdr), m_size))
+  {
+    ::munmap(m_map, m_size);
+    BOOST_THROW_EXCEPTION(UnexpectedError() <<
+      ErrorString(path.string() + " is not an ELF64 file"));
+  }
+
+  // Position dependent executables are mapped at their linked address.
+  Elf64_Phdr const* programHeaders =
+    reinterpret_cast<Elf64_Phdr const*>(data + header.e_phoff);
+  for(std::size_t i = 0; i < header.e_phnum; ++i)
+  {
+    if(programHeaders[i].p_type == PT_LOAD)
+    {
+      m_loadAddress = programHeaders[i].p_vaddr & ~0xFFFULL;
+      break;
+    }
+  }
+
+  // Only the symbol tables and the GNU hash table are needed.
+  Elf64_Shdr const* sections =
+    reinterpret_cast<Elf64_Shdr const*>(data + header.e_shoff);
+  for(std::size_t i = 0; i < header.e_shnum; ++i)
+  {
+    Elf64_Shdr const& cur = sections[i];
+    if(cur.sh_type == SHT_NOBITS || !isInside(cur.sh_offset, cur.sh_size,
+      m_size))
+      continue;
+
+    if(cur.sh_type == SHT_DYNSYM || cur.sh_type == SHT_SYMTAB)
+    {
+      if(cur.sh_link >= header.e_shnum ||
+        cur.sh_entsize != sizeof(Elf64_Sym))
+        continue;
+
+      Elf64_Shdr const& strings = sections[cur.sh_link];
+      if(!isInside(strings.sh_offset, strings.sh_size, m_size))
+        continue;
+
+      Table table = {
+        reinterpret_cast<Elf64_Sym const*>(data + cur.sh_offset),
+        cur.sh_size / sizeof(Elf64_Sym),
+        reinterpret_cast<char const*>(data + strings.sh_offset),
+        strings.sh_size
+      };
+      (cur.sh_type == SHT_DYNSYM ? m_dynsym : m_symtab) = table;
+    }
+    else if(cur.sh_type == SHT_GNU_HASH && cur.sh_size >= 16)
+    {
+      m_gnuHash = reinterpret_cast<std::uint32_t const*>(data +
+        cur.sh_offset);
+      m_gnuHashSize = cur.sh_size;
+    }
+  }
+}
+
+ElfSymbols::~ElfSymbols()
+{
+  ::munmap(m_map, m_size);
+}
+
+boost::string_ref ElfSymbols::getName(Table const& table,
+  Elf64_Sym const& symbol)
+{
+  if(symbol.st_name >= table.stringSize)
+    return boost::string_ref();
+
+  char const* name = table.strings + symbol.st_name;
+  char const* end = static_cast<char const*>(std::memchr(name, '\0',
+    table.stringSize - symbol.st_name));
+  return end ? boost::string_ref(name, end - name) : boost::string_ref();
+}
+
+std::uint64_t ElfSymbols::getLoadAddress() const
+{
+  return m_loadAddress;
+}
+
+bool ElfSymbols::lookupGnuHash(boost::string_ref name,
+  ElfSymbol& result) const
+{
+  // Layout: nbuckets, symoffset, bloomSize, bloomShift, bloom[bloomSize]
+  // as 64 bit words, buckets[nbuckets], chains[].
+  std::uint32_t const buckets = m_gnuHash[0];
+  std::uint32_t const offset = m_gnuHash[1];
+  std::uint32_t const bloomSize = m_gnuHash[2];
+  std::uint32_t const bloomShift = m_gnuHash[3];
+  std::size_t const chainStart = 16 + bloomSize * 8ULL + buckets * 4ULL;
+  if(!buckets || !bloomSize || chainStart > m_gnuHashSize)
+    return false;
+
+  std::uint32_t const hash = gnuHash(name);
+  std::uint64_t const* bloom =
+    reinterpret_cast<std::uint64_t const*>(m_gnuHash + 4);
+  std::uint64_t const word = bloom[(hash / 64) % bloomSize];
+  std::uint64_t const mask = (1ULL << (hash % 64)) |
+    (1ULL << ((hash >> bloomShift) % 64));
+  if((word & mask) != mask)
+    return false;
+
+  std::uint32_t const* bucket = m_gnuHash + 4 + bloomSize * 2;
+  std::uint32_t const* chains = bucket + buckets;
+  std::size_t const chainCount = (m_gnuHashSize - chainStart) / 4;
+  for(std::uint32_t i = bucket[hash % buckets];
+    i >= offset && i < m_dynsym.count && i - offset < chainCount; ++i)
+  {
+    std::uint32_t const chain = chains[i - offset];
+    Elf64_Sym const& symbol = m_dynsym.symbols[i];
+    if((chain | 1) == (hash | 1) && isDefined(symbol) &&
+      getName(m_dynsym, symbol) == name)
+    {
+      result.name = getName(m_dynsym, symbol);
+      result.value = symbol.st_value;
+      result.size = symbol.st_size;
+      return true;
+    }
+
+    // The last entry of a chain has the lowest bit set.
+    if(chain & 1)
+      break;
+  }
+
+  return false;
+}
+
+void ElfSymbols::index() const
+{
+  if(m_indexed)
+    return;
+  m_indexed = true;
+
+  // Exported names take precedence over local ones.
+  Table const* tables[] = { &m_dynsym, &m_symtab };
+  BOOST_FOREACH(Table const* table, tables)
+  {
+    for(std::size_t i = 0; i < table->count; ++i)
+    {
+      Elf64_Sym const& symbol = table->symbols[i];
+      if(!isDefined(symbol))
+        continue;
+
+      ElfSymbol const entry = { getName(*table, symbol), symbol.st_value,
+        symbol.st_size };
+      if(entry.name.empty())
+        continue;
+
+      m_names.insert(std::make_pair(entry.name, entry));
+      if(isAddressable(symbol))
+        m_sorted.push_back(entry);
+    }
+  }
+
+  // Of symbols sharing an address, the largest one is kept.
+  std::stable_sort(m_sorted.begin(), m_sorted.end(),
+    [](ElfSymbol const& lhs, ElfSymbol const& rhs)
+    {
+      return lhs.value < rhs.value ||
+        (lhs.value == rhs.value && lhs.size > rhs.size);
+    });
+  m_sorted.erase(std::unique(m_sorted.begin(), m_sorted.end(),
+    [](ElfSymbol const& lhs, ElfSymbol const& rhs)
+    {
+      return lhs.value == rhs.value;
+    }), m_sorted.end());
+  std::vector<ElfSymbol>(m_sorted).swap(m_sorted);
+}
+
+bool ElfSymbols::lookup(boost::string_ref name, ElfSymbol& result) const
+{
+  if(m_gnuHash && lookupGnuHash(name, result))
+    return true;
+
+  index();
+  auto it = m_names.find(name);
+  if(it == m_names.end())
+    return false;
+
+  result = it->second;
+  return true;
+}
+
+bool ElfSymbols::lookup(std::uint64_t value, ElfSymbol& result) const
+{
+  index();
+  std::vector<ElfSymbol>::const_iterator it = std::upper_bound(
+    m_sorted.begin(), m_sorted.end(), value,
+    [](std::uint64_t lhs, ElfSymbol const& rhs)
+    {
+      return lhs < rhs.value;
+    });
+  if(it == m_sorted.begin())
+    return false;
+
+  result = *(it - 1);
+  return true;
+}
+
+/* SymbolResolver class */
+
+SymbolResolver::SymbolResolver(Process const& process)
+  : m_modules(process), m_files(), m_symbols(), m_loaded()
+{
+  refresh();
+}
+
+void SymbolResolver::refresh()
+{
+  m_modules.refresh();
+  m_symbols.assign(m_modules.getModules().size(), 0);
+  m_loaded.assign(m_modules.getModules().size(), false);
+}
+
+ModuleMap const& SymbolResolver::getModuleMap() const
+{
+  return m_modules;
+}
+
+ElfSymbols const* SymbolResolver::getSymbols(Module const& module) const
+{
+  std::size_t const index = &module - &m_modules.getModules()[0];
+  if(m_loaded[index])
+    return m_symbols[index];
+  m_loaded[index] = true;
+
+  // Files that can't be read are remembered as well.
+  FileKey const key(module.devMajor, module.devMinor, module.inode);
+  std::map<FileKey, std::shared_ptr<ElfSymbols>>::const_iterator it =
+    m_files.find(key);
+  if(it == m_files.end())
+  {
+    std::shared_ptr<ElfSymbols> symbols;
+    if(module.inode)
+    {
+      // Go through the process' root in case it lives in a container,
+      // map_files also covers deleted files but needs CAP_SYS_ADMIN.
+      boost::filesystem::path const procfs =
+        m_modules.getProcess().getProcfsDirectory();
+      std::ostringstream range;
+      range << std::hex << module.segments.front().start << '-' <<
+        module.segments.front().end;
+      boost::filesystem::path const paths[] = {
+        procfs / "root" / *module.path, procfs / "map_files" / range.str()
+      };
+
+      BOOST_FOREACH(boost::filesystem::path const& cur, paths)
+      {
+        try
+        {
+          symbols = std::make_shared<ElfSymbols>(cur);
+          break;
+        }
+        catch(EthonError const&)
+        { }
+      }
+    }
+
+    it = m_files.insert(std::make_pair(key, symbols)).first;
+  }
+
+  m_symbols[index] = it->second.get();
+  return m_symbols[index];
+}
+
+bool SymbolResolver::lookup(Module const& module, boost::string_ref name,
+  Symbol& result) const
+{
+  ElfSymbols const* symbols = getSymbols(module);
+  ElfSymbol symbol;
+  if(!symbols || !symbols->lookup(name, symbol))
+    return false;
+
+  result.name = symbol.name;
+  result.address = module.base - symbols->getLoadAddress() + symbol.value;
+  result.size = symbol.size;
+  result.module = &module;
+  return true;
+}
+
+bool SymbolResolver::find(boost::string_ref module, boost::string_ref name,
+  Symbol& result) const
+{
+  Module const* found = m_modules.find(module);
+  return found && lookup(*found, name, result);
+}
+
+bool SymbolResolver::find(boost::string_ref name, Symbol& result) const
+{
+  BOOST_FOREACH(Module const& cur, m_modules.getModules())
+  {
+    if(lookup(cur, name, result))
+      return true;
+  }
+
+  return false;
+}
+
+std::uintptr_t SymbolResolver::resolve(boost::string_ref module,
+  boost::string_ref name) const
+{
+  Symbol result;
+  if(!find(module, name, result))
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Symbol '" + name.to_string() + "' not found in '" +
+        module.to_string() + "'"));
+  }
+
+  return result.address;
+}
+
+bool SymbolResolver::symbolize(std::uintptr_t address, Symbol& result) const
+{
+  Module const* module = m_modules.find(address);
+  if(!module)
+    return false;
+
+  ElfSymbols const* symbols = getSymbols(*module);
+  if(!symbols)
+    return false;
+
+  std::uintptr_t const bias = module->base - symbols->getLoadAddress();
+  ElfSymbol symbol;
+  if(!symbols->lookup(static_cast<std::uint64_t>(address - bias), symbol))
+    return false;
+
+  result.name = symbol.name;
+  result.address = bias + symbol.value;
+  result.size = symbol.size;
+  result.module = module;
+  return true;
+}
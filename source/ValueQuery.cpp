@@ -0,0 +1,532 @@
+/*
+ValueQuery.cpp
+This File is a part of Ethonmem, a memory hacking library for linux
+Copyright (C) < 2012, Ethon >
+              < ethon@ethon.cc - http://ethon.cc >
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// C++ Standard Library:
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+// SSE2:
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Ethon:
+#include <Ethon/Error.hpp>
+#include <Ethon/Scanner.hpp>
+#include <Ethon/ValueQuery.hpp>
+
+using Ethon::ValueQuery;
+using Ethon::ValueType;
+using Ethon::Comparison;
+using Ethon::ArgumentError;
+
+namespace
+{
+  // Operands of a comparison, converted to the compared type.
+  template<typename T>
+  struct Operands
+  {
+    Comparison comparison;
+    T first;
+    T second;
+  };
+
+  template<typename T>
+  bool testScalar(T value, Operands<T> const& op)
+  {
+    switch(op.comparison)
+    {
+    case Comparison::EQUAL:
+      return value == op.first;
+    case Comparison::RANGE:
+      return op.first <= value && value <= op.second;
+    case Comparison::EPSILON:
+      return std::fabs(value - op.first) <= op.second;
+    case Comparison::GREATER:
+      return value > op.first;
+    case Comparison::LESS:
+      return value < op.first;
+    }
+
+    return false;
+  }
+
+  // Integer epsilon comparisons are ranges, clamped to the type's limits.
+  template<typename T>
+  Operands<T> normalize(Operands<T> op, std::true_type /*integral*/)
+  {
+    if(op.comparison != Comparison::EPSILON)
+      return op;
+
+    T const epsilon = op.second < 0 ? T(0) - op.second : op.second;
+    T const min = std::numeric_limits<T>::min();
+    T const max = std::numeric_limits<T>::max();
+
+    op.comparison = Comparison::RANGE;
+    op.second = op.first > max - epsilon ? max : T(op.first + epsilon);
+    op.first = op.first < min + epsilon ? min : T(op.first - epsilon);
+    return op;
+  }
+
+  template<typename T>
+  Operands<T> normalize(Operands<T> op, std::false_type /*integral*/)
+  {
+    return op;
+  }
+
+#ifdef __SSE2__
+  // Integer operations of a given lane width on biased values. Unsigned
+  // values are biased by their sign bit, so signed compares order them.
+  template<std::size_t N>
+  struct IntOps;
+
+  template<>
+  struct IntOps<1>
+  {
+    static __m128i splat(std::uint64_t v)
+    { return _mm_set1_epi8(static_cast<char>(v)); }
+    static __m128i signBit()
+    { return _mm_set1_epi8(static_cast<char>(0x80)); }
+    static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+    static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi8(a, b); }
+    static unsigned bits(__m128i m) { return _mm_movemask_epi8(m); }
+  };
+
+  template<>
+  struct IntOps<2>
+  {
+    static __m128i splat(std::uint64_t v)
+    { return _mm_set1_epi16(static_cast<short>(v)); }
+    static __m128i signBit()
+    { return _mm_set1_epi16(static_cast<short>(0x8000)); }
+    static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+    static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi16(a, b); }
+    static unsigned bits(__m128i m)
+    { return _mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128())); }
+  };
+
+  template<>
+  struct IntOps<4>
+  {
+    static __m128i splat(std::uint64_t v)
+    { return _mm_set1_epi32(static_cast<int>(v)); }
+    static __m128i signBit()
+    { return _mm_set1_epi32(static_cast<int>(0x80000000u)); }
+    static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+    static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi32(a, b); }
+    static unsigned bits(__m128i m)
+    { return _mm_movemask_ps(_mm_castsi128_ps(m)); }
+  };
+
+  template<>
+  struct IntOps<8>
+  {
+    static __m128i splat(std::uint64_t v)
+    { return _mm_set1_epi64x(static_cast<long long>(v)); }
+    static __m128i signBit()
+    { return _mm_set1_epi64x(static_cast<long long>(0x8000000000000000ull)); }
+    static __m128i eq(__m128i a, __m128i b)
+    {
+      __m128i r = _mm_cmpeq_epi32(a, b);
+      return _mm_and_si128(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+    static __m128i gt(__m128i a, __m128i b)
+    {
+      // SSE2 lacks pcmpgtq: where the high halves are equal, the borrow of
+      // b - a decides, otherwise the signed compare of the high halves.
+      __m128i r = _mm_and_si128(_mm_cmpeq_epi32(a, b), _mm_sub_epi64(b, a));
+      r = _mm_or_si128(r, _mm_cmpgt_epi32(a, b));
+      return _mm_shuffle_epi32(r, _MM_SHUFFLE(3, 3, 1, 1));
+    }
+    static unsigned bits(__m128i m)
+    { return _mm_movemask_pd(_mm_castsi128_pd(m)); }
+  };
+
+  template<typename T>
+  struct IntLanes
+  {
+    typedef IntOps<sizeof(T)> Ops;
+    typedef __m128i Vec;
+    static std::size_t const COUNT = 16 / sizeof(T);
+
+    static Vec bias()
+    {
+      return std::is_signed<T>::value ? _mm_setzero_si128() : Ops::signBit();
+    }
+
+    static Vec load(std::uint8_t const* p)
+    {
+      return _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(p)), bias());
+    }
+
+    static Vec splat(T v)
+    {
+      return _mm_xor_si128(Ops::splat(static_cast<std::uint64_t>(v)), bias());
+    }
+
+    static Vec equal(Vec v, Vec a, Vec) { return Ops::eq(v, a); }
+    static Vec greater(Vec v, Vec a, Vec) { return Ops::gt(v, a); }
+    static Vec less(Vec v, Vec a, Vec) { return Ops::gt(a, v); }
+    static Vec range(Vec v, Vec a, Vec b)
+    {
+      Vec outside = _mm_or_si128(Ops::gt(a, v), Ops::gt(v, b));
+      return _mm_andnot_si128(outside, _mm_set1_epi32(-1));
+    }
+    static Vec epsilon(Vec v, Vec a, Vec b) { return range(v, a, b); }
+    static unsigned bits(Vec m) { return Ops::bits(m); }
+  };
+
+  struct FloatLanes
+  {
+    typedef __m128 Vec;
+    static std::size_t const COUNT = 4;
+
+    static Vec load(std::uint8_t const* p)
+    { return _mm_loadu_ps(reinterpret_cast<float const*>(p)); }
+    static Vec splat(float v) { return _mm_set1_ps(v); }
+    static Vec equal(Vec v, Vec a, Vec) { return _mm_cmpeq_ps(v, a); }
+    static Vec greater(Vec v, Vec a, Vec) { return _mm_cmpgt_ps(v, a); }
+    static Vec less(Vec v, Vec a, Vec) { return _mm_cmplt_ps(v, a); }
+    static Vec range(Vec v, Vec a, Vec b)
+    { return _mm_and_ps(_mm_cmpge_ps(v, a), _mm_cmple_ps(v, b)); }
+    static Vec epsilon(Vec v, Vec a, Vec b)
+    {
+      Vec distance = _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(v, a));
+      return _mm_cmple_ps(distance, b);
+    }
+    static unsigned bits(Vec m) { return _mm_movemask_ps(m); }
+  };
+
+  struct DoubleLanes
+  {
+    typedef __m128d Vec;
+    static std::size_t const COUNT = 2;
+
+    static Vec load(std::uint8_t const* p)
+    { return _mm_loadu_pd(reinterpret_cast<double const*>(p)); }
+    static Vec splat(double v) { return _mm_set1_pd(v); }
+    static Vec equal(Vec v, Vec a, Vec) { return _mm_cmpeq_pd(v, a); }
+    static Vec greater(Vec v, Vec a, Vec) { return _mm_cmpgt_pd(v, a); }
+    static Vec less(Vec v, Vec a, Vec) { return _mm_cmplt_pd(v, a); }
+    static Vec range(Vec v, Vec a, Vec b)
+    { return _mm_and_pd(_mm_cmpge_pd(v, a), _mm_cmple_pd(v, b)); }
+    static Vec epsilon(Vec v, Vec a, Vec b)
+    {
+      Vec distance = _mm_andnot_pd(_mm_set1_pd(-0.0), _mm_sub_pd(v, a));
+      return _mm_cmple_pd(distance, b);
+    }
+    static unsigned bits(Vec m) { return _mm_movemask_pd(m); }
+  };
+
+  template<typename T>
+  struct LanesOf
+  {
+    typedef IntLanes<T> type;
+  };
+
+  template<>
+  struct LanesOf<float>
+  {
+    typedef FloatLanes type;
+  };
+
+  template<>
+  struct LanesOf<double>
+  {
+    typedef DoubleLanes type;
+  };
+
+  // Tests consecutive elements, emitting the indices of matches. The
+  // comparison is a template argument so the loop contains no branches on
+  // it.
+  template<typename T, typename L, typename L::Vec (*TEST)(
+    typename L::Vec, typename L::Vec, typename L::Vec)>
+  std::size_t scanLanes(std::uint8_t const* data, std::size_t count,
+    Operands<T> const& op, std::vector<std::size_t>& indices,
+    std::size_t limit)
+  {
+    typename L::Vec const first = L::splat(op.first);
+    typename L::Vec const second = L::splat(op.second);
+
+    std::size_t i = 0;
+    for(; i + L::COUNT <= count && indices.size() < limit; i += L::COUNT)
+    {
+      unsigned bits = L::bits(TEST(L::load(data + i * sizeof(T)), first,
+        second));
+      while(bits)
+      {
+        indices.push_back(i + __builtin_ctz(bits));
+        bits &= bits - 1;
+      }
+    }
+
+    return i;
+  }
+#endif
+
+  // Tests consecutive elements, appending the indices of matches.
+  template<typename T>
+  void scanContiguous(std::uint8_t const* data, std::size_t count,
+    Operands<T> const& op, std::vector<std::size_t>& indices,
+    std::size_t limit)
+  {
+    std::size_t i = 0;
+
+#ifdef __SSE2__
+    typedef typename LanesOf<T>::type L;
+    switch(op.comparison)
+    {
+    case Comparison::EQUAL:
+      i = scanLanes<T, L, &L::equal>(data, count, op, indices, limit);
+      break;
+    case Comparison::RANGE:
+      i = scanLanes<T, L, &L::range>(data, count, op, indices, limit);
+      break;
+    case Comparison::EPSILON:
+      i = scanLanes<T, L, &L::epsilon>(data, count, op, indices, limit);
+      break;
+    case Comparison::GREATER:
+      i = scanLanes<T, L, &L::greater>(data, count, op, indices, limit);
+      break;
+    case Comparison::LESS:
+      i = scanLanes<T, L, &L::less>(data, count, op, indices, limit);
+      break;
+    }
+#endif
+
+    for(; i < count && indices.size() < limit; ++i)
+    {
+      T value;
+      std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+      if(testScalar(value, op))
+        indices.push_back(i);
+    }
+
+    if(indices.size() > limit)
+      indices.resize(limit);
+  }
+
+  template<typename T>
+  std::size_t matchTyped(Operands<T> op, std::uint8_t const* data,
+    std::size_t size, std::uintptr_t address, std::size_t alignment,
+    std::size_t offset, std::vector<std::uintptr_t>& results,
+    std::size_t limit)
+  {
+    op = normalize(op, std::is_integral<T>());
+
+    std::size_t const width = sizeof(T);
+    if(size < width || !limit)
+      return 0;
+
+    // First candidate offset inside the buffer with the given residue.
+    auto firstCandidate = [&](std::size_t modulus, std::size_t residue)
+      -> std::size_t
+    {
+      std::size_t misalignment = (address % modulus + modulus - residue) %
+        modulus;
+      return misalignment ? modulus - misalignment : 0;
+    };
+
+    std::size_t const before = results.size();
+    std::vector<std::size_t> indices;
+
+    if(alignment <= width && width % alignment == 0)
+    {
+      // Every residue modulo the element size is a contiguous array of
+      // elements, scan them one after another and merge.
+      for(std::size_t residue = offset % alignment; residue < width;
+        residue += alignment)
+      {
+        std::size_t start = firstCandidate(width, residue);
+        if(start + width > size)
+          continue;
+
+        indices.clear();
+        std::size_t count = (size - start) / width;
+        scanContiguous(data + start, count, op, indices,
+          std::numeric_limits<std::size_t>::max());
+
+        for(std::size_t j = 0; j < indices.size(); ++j)
+          results.push_back(address + start + indices[j] * width);
+      }
+
+      if(width / alignment > 1)
+        std::sort(results.begin() + before, results.end());
+      if(results.size() - before > limit)
+        results.resize(before + limit);
+    }
+    else if(alignment % width == 0 && alignment < 4 * width)
+    {
+      // Slightly sparser than the element size, scan contiguously and
+      // filter.
+      std::size_t start = firstCandidate(width, offset % width);
+      if(start + width <= size)
+      {
+        std::size_t count = (size - start) / width;
+        scanContiguous(data + start, count, op, indices,
+          std::numeric_limits<std::size_t>::max());
+
+        for(std::size_t j = 0; j < indices.size() &&
+          results.size() - before < limit; ++j)
+        {
+          std::uintptr_t cur = address + start + indices[j] * width;
+          if(cur % alignment == offset)
+            results.push_back(cur);
+        }
+      }
+    }
+    else
+    {
+      // Sparse candidates, test them one by one.
+      for(std::size_t i = firstCandidate(alignment, offset);
+        i + width <= size && results.size() - before < limit; i += alignment)
+      {
+        T value;
+        std::memcpy(&value, data + i, width);
+        if(testScalar(value, op))
+          results.push_back(address + i);
+      }
+    }
+
+    return results.size() - before;
+  }
+
+  template<typename T>
+  Operands<T> makeOperands(Comparison comparison, std::uint64_t first,
+    std::uint64_t second)
+  {
+    Operands<T> op;
+    op.comparison = comparison;
+    std::memcpy(&op.first, &first, sizeof(T));
+    std::memcpy(&op.second, &second, sizeof(T));
+    return op;
+  }
+}
+
+/* ValueQuery class */
+
+ValueQuery::ValueQuery(ValueType type, Comparison comparison,
+  void const* first, void const* second)
+  : m_type(type), m_comparison(comparison), m_first(0), m_second(0),
+    m_alignment(Ethon::getValueTypeSize(type)), m_offset(0)
+{
+  std::memcpy(&m_first, first, getSize());
+  if(comparison == Comparison::RANGE || comparison == Comparison::EPSILON)
+    std::memcpy(&m_second, second, getSize());
+}
+
+ValueQuery& ValueQuery::setAlignment(std::size_t alignment,
+  std::size_t offset)
+{
+  if(!alignment || offset >= alignment)
+  {
+    BOOST_THROW_EXCEPTION(ArgumentError() <<
+      ErrorString("Invalid alignment or offset"));
+  }
+
+  m_alignment = alignment;
+  m_offset = offset;
+  return *this;
+}
+
+ValueType ValueQuery::getType() const
+{
+  return m_type;
+}
+
+Comparison ValueQuery::getComparison() const
+{
+  return m_comparison;
+}
+
+std::size_t ValueQuery::getAlignment() const
+{
+  return m_alignment;
+}
+
+std::size_t ValueQuery::getOffset() const
+{
+  return m_offset;
+}
+
+std::size_t ValueQuery::getSize() const
+{
+  return Ethon::getValueTypeSize(m_type);
+}
+
+#define ETHON_DISPATCH_VALUETYPE(FUNCTION, ...) \
+  switch(m_type) \
+  { \
+  case ValueType::INT8: return FUNCTION<std::int8_t>(__VA_ARGS__); \
+  case ValueType::UINT8: return FUNCTION<std::uint8_t>(__VA_ARGS__); \
+  case ValueType::INT16: return FUNCTION<std::int16_t>(__VA_ARGS__); \
+  case ValueType::UINT16: return FUNCTION<std::uint16_t>(__VA_ARGS__); \
+  case ValueType::INT32: return FUNCTION<std::int32_t>(__VA_ARGS__); \
+  case ValueType::UINT32: return FUNCTION<std::uint32_t>(__VA_ARGS__); \
+  case ValueType::INT64: return FUNCTION<std::int64_t>(__VA_ARGS__); \
+  case ValueType::UINT64: return FUNCTION<std::uint64_t>(__VA_ARGS__); \
+  case ValueType::FLOAT: return FUNCTION<float>(__VA_ARGS__); \
+  case ValueType::DOUBLE: return FUNCTION<double>(__VA_ARGS__); \
+  }
+
+template<typename T>
+static std::size_t dispatchMatch(ValueQuery const& query,
+  std::uint8_t const* data, std::size_t size, std::uintptr_t address,
+  std::vector<std::uintptr_t>& results, std::size_t limit)
+{
+  return matchTyped(makeOperands<T>(query.getComparison(),
+    query.getOperand<std::uint64_t>(), query.getOperand<std::uint64_t>(true)),
+    data, size, address, query.getAlignment(), query.getOffset(), results,
+    limit);
+}
+
+template<typename T>
+static bool dispatchTest(ValueQuery const& query, std::uint8_t const* data)
+{
+  Operands<T> op = normalize(makeOperands<T>(query.getComparison(),
+    query.getOperand<std::uint64_t>(), query.getOperand<std::uint64_t>(true)),
+    std::is_integral<T>());
+
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return testScalar(value, op);
+}
+
+std::size_t ValueQuery::match(std::uint8_t const* data, std::size_t size,
+  std::uintptr_t address, std::vector<std::uintptr_t>& results,
+  std::size_t limit) const
+{
+  ETHON_DISPATCH_VALUETYPE(dispatchMatch, *this, data, size, address,
+    results, limit)
+  return 0;
+}
+
+bool ValueQuery::test(std::uint8_t const* data) const
+{
+  ETHON_DISPATCH_VALUETYPE(dispatchTest, *this, data)
+  return false;
+}
@@ -0,0 +1,203 @@
+// C++ Header Files:
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+// POSIX Header Files:
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Ethon Header Files:
+#include <Ethon/MemoryRegions.hpp>
+#include <Ethon/Processes.hpp>
+#include <Ethon/Error.hpp>
+
+// Maps many small regions into this process and enumerates them with the
+// old fgets/sscanf parser, the MemoryRegionIterator and the raw MapsReader.
+
+namespace
+{
+  std::size_t const DEFAULT_MAPPINGS = 50000;
+  char const* const SPACED_PATH = "/tmp/ethonmem maps bench file";
+
+  struct Parsed
+  {
+    std::uintptr_t start;
+    std::uintptr_t end;
+    std::string path;
+  };
+
+  // The parser MemoryRegionIterator used before MapsReader.
+  void parseLegacy(std::vector<Parsed>& results)
+  {
+    results.clear();
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if(!maps)
+      return;
+
+    std::array<char, 1152> lineBuffer;
+    while(fgets(&lineBuffer[0], 1152, maps))
+    {
+      std::array<char, 1024> pathBuffer;
+      std::array<char, 5> perms;
+      unsigned int offset, inode;
+      unsigned short devMajor, devMinor;
+      Parsed entry;
+      pathBuffer[0] = '\0';
+      sscanf(&lineBuffer[0], "%lx-%lx %4s %x %hx:%hx %u %1024s",
+        &entry.start, &entry.end, &perms[0], &offset, &devMajor, &devMinor,
+        &inode, &pathBuffer[0]);
+      entry.path.assign(&pathBuffer[0]);
+      results.push_back(entry);
+    }
+    fclose(maps);
+  }
+
+  void parseIterator(std::vector<Parsed>& results)
+  {
+    results.clear();
+    Ethon::MemoryRegionSequence seq =
+      Ethon::makeMemoryRegionSequence(Ethon::getCurrentProcess());
+    for(auto it = seq.first; it != seq.second; ++it)
+    {
+      Parsed entry = {it->getStartAddress(), it->getEndAddress(),
+        it->getPath()};
+      results.push_back(entry);
+    }
+  }
+
+  void parseReader(Ethon::MapsReader& reader, std::vector<Parsed>& results)
+  {
+    results.clear();
+    reader.read();
+    Ethon::MapsEntry entry;
+    while(reader.next(entry))
+    {
+      Parsed parsed = {entry.start, entry.end, std::string()};
+      results.push_back(parsed);
+    }
+  }
+
+  // Returns the best time out of five in milliseconds.
+  template<typename Function>
+  double measure(Function function)
+  {
+    double best = 0.0;
+    for(int run = 0; run < 5; ++run)
+    {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+      if(!run || elapsed.count() < best)
+        best = elapsed.count();
+    }
+    return best;
+  }
+
+  bool hasPath(std::vector<Parsed> const& results, std::string const& path)
+  {
+    for(Parsed const& entry : results)
+    {
+      if(entry.path == path)
+        return true;
+    }
+    return false;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    std::size_t const mappings = argc > 1 ?
+      std::strtoul(argv[1], nullptr, 10) : DEFAULT_MAPPINGS;
+
+    // Alternating protections keep the kernel from merging the regions.
+    long const pageSize = sysconf(_SC_PAGESIZE);
+    char* base = static_cast<char*>(mmap(nullptr, mappings * pageSize,
+      PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if(base == MAP_FAILED)
+    {
+      std::cerr << "Can't map " << mappings << " pages" << std::endl;
+      return 1;
+    }
+    for(std::size_t i = 0; i < mappings; i += 2)
+      mprotect(base + i * pageSize, pageSize, PROT_READ | PROT_WRITE);
+
+    int file = open(SPACED_PATH, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(file == -1 || ftruncate(file, pageSize) == -1 ||
+       mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, file, 0) == MAP_FAILED)
+    {
+      std::cerr << "Can't map " << SPACED_PATH << std::endl;
+      return 1;
+    }
+    close(file);
+    unlink(SPACED_PATH);
+    std::string const spacedPath = std::string(SPACED_PATH) + " (deleted)";
+
+    // Reserved up front so that growing them doesn't add mappings.
+    std::vector<Parsed> legacy, iterated, read;
+    legacy.reserve(mappings + 1024);
+    iterated.reserve(mappings + 1024);
+    read.reserve(mappings + 1024);
+    Ethon::MapsReader reader(Ethon::getCurrentProcess());
+
+    // The readers' buffers are mapped on first use and may merge with other
+    // regions, so every parser runs once before the compared passes.
+    parseLegacy(legacy);
+    parseIterator(iterated);
+    parseReader(reader, read);
+
+    double legacyTime = measure([&]{ parseLegacy(legacy); });
+    double iteratorTime = measure([&]{ parseIterator(iterated); });
+    double readerTime = measure([&]{ parseReader(reader, read); });
+
+    int errors = 0;
+    if(legacy.size() != iterated.size() || read.size() != iterated.size())
+      ++errors;
+    for(std::size_t i = 0; !errors && i < legacy.size(); ++i)
+    {
+      if(legacy[i].start != iterated[i].start ||
+         legacy[i].end != iterated[i].end ||
+         read[i].start != iterated[i].start || read[i].end != iterated[i].end)
+        ++errors;
+    }
+    if(!hasPath(iterated, spacedPath))
+      ++errors;
+
+    std::cout << legacy.size() << " regions\n\n" << std::left <<
+      std::setw(22) << "parser" << std::right << std::setw(12) << "ms" <<
+      std::setw(14) << "ns/line" << std::endl << std::fixed;
+    std::pair<char const*, double> const rows[] = {
+      {"fgets/sscanf", legacyTime},
+      {"MemoryRegionIterator", iteratorTime},
+      {"MapsReader", readerTime}
+    };
+    for(auto const& row : rows)
+    {
+      std::cout << std::left << std::setw(22) << row.first << std::right <<
+        std::setprecision(2) << std::setw(12) << row.second <<
+        std::setprecision(0) << std::setw(14) <<
+        row.second * 1e6 / legacy.size() << std::endl;
+    }
+
+    std::cout << "\nspaced path " << (hasPath(legacy, spacedPath) ?
+      "kept" : "truncated") << " by fgets/sscanf, " <<
+      (hasPath(iterated, spacedPath) ? "kept" : "truncated") <<
+      " by MapsReader\n" << errors << " result mismatches" << std::endl;
+    return errors ? 1 : 0;
+  }
+  catch(Ethon::EthonError const& e)
+  {
+    Ethon::printError(e, std::cerr);
+    return 1;
+  }
+}
@@ -0,0 +1,199 @@
+// C++ Header Files:
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+// Ethon Header Files:
+#include <Ethon/Signature.hpp>
+#include <Ethon/ScanPlanner.hpp>
+#include <Ethon/Error.hpp>
+
+// Runs every applicable kernel on every combination of buffer and signature
+// and checks that the planner's choice is close to the fastest one.
+
+namespace
+{
+  std::size_t const BUFFER_SIZE = 16 * 1024 * 1024;
+  double const TOLERANCE = 1.25;
+
+  char const* const ALGORITHM_NAMES[] = {
+    "memchr", "simd-pair", "horspool", "bitap"
+  };
+
+  Ethon::SearchAlgorithm const ALGORITHMS[] = {
+    Ethon::SearchAlgorithm::MEMCHR, Ethon::SearchAlgorithm::SIMD_PAIR,
+    Ethon::SearchAlgorithm::HORSPOOL, Ethon::SearchAlgorithm::BITAP
+  };
+
+  struct Buffer
+  {
+    std::string name;
+    std::vector<std::uint8_t> data;
+  };
+
+  struct Pattern
+  {
+    std::string name;
+    std::string signature;
+  };
+
+  Buffer makeUniform(std::mt19937& rng)
+  {
+    Buffer result = {"uniform", std::vector<std::uint8_t>(BUFFER_SIZE)};
+    for(std::size_t i = 0; i < BUFFER_SIZE; ++i)
+      result.data[i] = static_cast<std::uint8_t>(rng());
+    return result;
+  }
+
+  // Bytes distributed like the planner's prior, resembling code and data.
+  Buffer makeTypical(std::mt19937& rng)
+  {
+    Ethon::ByteStatistics prior;
+    std::vector<double> weights;
+    for(std::size_t i = 0; i < 256; ++i)
+      weights.push_back(prior.getFrequency(static_cast<std::uint8_t>(i)));
+    std::discrete_distribution<int> distribution(weights.begin(),
+      weights.end());
+
+    Buffer result = {"typical", std::vector<std::uint8_t>(BUFFER_SIZE)};
+    for(std::size_t i = 0; i < BUFFER_SIZE; ++i)
+      result.data[i] = static_cast<std::uint8_t>(distribution(rng));
+    return result;
+  }
+
+  Buffer makeSparse(std::mt19937& rng)
+  {
+    Buffer result = {"sparse", std::vector<std::uint8_t>(BUFFER_SIZE)};
+    for(std::size_t i = 0; i < BUFFER_SIZE; i += 1 + rng() % 64)
+      result.data[i] = static_cast<std::uint8_t>(rng());
+    return result;
+  }
+
+  std::string randomSignature(std::mt19937& rng, std::size_t length)
+  {
+    static char const digits[] = "0123456789ABCDEF";
+
+    std::string result;
+    for(std::size_t i = 0; i < length; ++i)
+    {
+      std::uint8_t byte = static_cast<std::uint8_t>(rng());
+      result += digits[byte >> 4];
+      result += digits[byte & 0x0F];
+      result += ' ';
+    }
+    return result;
+  }
+
+  // Runs a kernel over a buffer, returning the best time out of three.
+  double measure(Ethon::ScanPlan const& plan, Buffer const& buffer,
+    std::vector<std::uintptr_t>& results)
+  {
+    double best = 0.0;
+    for(int run = 0; run < 3; ++run)
+    {
+      results.clear();
+      auto start = std::chrono::steady_clock::now();
+      plan.match(&buffer.data[0], buffer.data.size(), 0, results);
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      if(!run || elapsed.count() < best)
+        best = elapsed.count();
+    }
+    return best;
+  }
+}
+
+int main()
+{
+  try
+  {
+    std::mt19937 rng(42);
+
+    std::vector<Buffer> buffers;
+    buffers.push_back(makeUniform(rng));
+    buffers.push_back(makeTypical(rng));
+    buffers.push_back(makeSparse(rng));
+
+    std::vector<Pattern> patterns;
+    patterns.push_back(Pattern{"short-rare", "D7 3E 91"});
+    patterns.push_back(Pattern{"short-common", "48 8B 05"});
+    patterns.push_back(Pattern{"long-fixed", randomSignature(rng, 32)});
+    patterns.push_back(Pattern{"wildcards",
+      "48 ?? ?? ?? ?? 8B ?? ?? 05 ?? ?? 85"});
+    patterns.push_back(Pattern{"zeros", "00 00 ?? 00 00 00 ?? 01"});
+    patterns.push_back(Pattern{"very-long", randomSignature(rng, 96)});
+
+    std::cout << std::left << std::setw(10) << "buffer" <<
+      std::setw(14) << "signature";
+    for(char const* name : ALGORITHM_NAMES)
+      std::cout << std::right << std::setw(11) << name;
+    std::cout << "   planned" << std::endl;
+
+    int misses = 0, errors = 0;
+    for(Buffer& buffer : buffers)
+    {
+      for(Pattern const& pattern : patterns)
+      {
+        Ethon::Signature signature(pattern.signature);
+
+        // Every combination has at least one match at the end.
+        std::vector<std::uint8_t> const& bytes = signature.getBytes();
+        std::copy(bytes.begin(), bytes.begin() + signature.getSize(),
+          buffer.data.end() - signature.getSize());
+
+        Ethon::ByteStatistics statistics;
+        statistics.sample(&buffer.data[0], 1024 * 1024);
+        Ethon::ScanPlan planned = Ethon::planSearch(signature, statistics);
+
+        std::cout << std::left << std::setw(10) << buffer.name <<
+          std::setw(14) << pattern.name << std::right << std::fixed <<
+          std::setprecision(0);
+
+        std::vector<std::uintptr_t> expected, results;
+        double times[4] = {0.0, 0.0, 0.0, 0.0};
+        double best = 0.0;
+        for(std::size_t i = 0; i < 4; ++i)
+        {
+          if(!Ethon::ScanPlan::isApplicable(signature, ALGORITHMS[i]))
+          {
+            std::cout << std::setw(11) << "-";
+            continue;
+          }
+
+          Ethon::ScanPlan plan(signature, ALGORITHMS[i], statistics);
+          times[i] = measure(plan, buffer, i ? results : expected);
+          if(i && results != expected)
+            ++errors;
+          if(!best || times[i] < best)
+            best = times[i];
+
+          std::cout << std::setw(8) << buffer.data.size() / times[i] / 1e6 <<
+            "MB/s";
+        }
+
+        double chosen = times[static_cast<int>(planned.getAlgorithm())];
+        bool hit = chosen <= best * TOLERANCE;
+        misses += !hit;
+        std::cout << "   " <<
+          ALGORITHM_NAMES[static_cast<int>(planned.getAlgorithm())] <<
+          (hit ? "" : " (miss)") << std::endl;
+
+        std::fill(buffer.data.end() - signature.getSize(), buffer.data.end(),
+          0);
+      }
+    }
+
+    std::cout << "\n" << misses << " planning misses, " << errors <<
+      " result mismatches" << std::endl;
+    return errors ? 1 : 0;
+  }
+  catch(Ethon::EthonError const& e)
+  {
+    Ethon::printError(e, std::cerr);
+    return 1;
+  }
+}
@@ -0,0 +1,155 @@
+// C++ Header Files:
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <memory>
+
+// Ethon Header Files:
+#include <Ethon/Scanner.hpp>
+#include <Ethon/MemorySource.hpp>
+#include <Ethon/Error.hpp>
+
+// Evaluates predicate expressions on a buffer, then scans a buffer for
+// records only a predicate reading a neighbouring field can tell apart.
+
+using namespace Ethon::Predicates;
+
+namespace
+{
+  std::uint64_t const MAGIC = 0x5C4E9D1C7A3B2F01ULL;
+
+  struct Record
+  {
+    std::uint64_t id;
+    std::int32_t health;
+    float speed;
+  };
+
+  // Memory consisting of a single buffer, mapped at the buffer's address.
+  class BufferMemorySource
+    : public Ethon::MemorySource
+  {
+  private:
+    std::uint8_t const* m_data;
+    std::size_t m_size;
+
+  public:
+    BufferMemorySource(void const* data, std::size_t size)
+      : m_data(static_cast<std::uint8_t const*>(data)), m_size(size)
+    { }
+
+    std::vector<Ethon::MemoryRegion> getRegions() const
+    {
+      std::uintptr_t const start = reinterpret_cast<std::uintptr_t>(m_data);
+      std::array<char, 4> const perms = { { 'r', 'w', '-', 'p' } };
+      return std::vector<Ethon::MemoryRegion>(1,
+        Ethon::MemoryRegion(start, start + m_size, perms));
+    }
+
+    std::size_t read(std::uintptr_t address, std::uint8_t* dest,
+      std::size_t amount)
+    {
+      std::size_t const offset = address -
+        reinterpret_cast<std::uintptr_t>(m_data);
+      if(offset >= m_size)
+        return 0;
+
+      amount = std::min(amount, m_size - offset);
+      std::memcpy(dest, m_data + offset, amount);
+      return amount;
+    }
+  };
+
+  int g_errors = 0;
+
+  void check(bool condition, std::string const& what)
+  {
+    std::cout << (condition ? "passed: " : "FAILED: ") << what << std::endl;
+    if(!condition)
+      ++g_errors;
+  }
+
+  void testEvaluation()
+  {
+    Record record = { MAGIC, 150, 0.5f };
+    std::uint8_t data[sizeof(Record)];
+    std::memcpy(data, &record, sizeof(record));
+
+    check(value<std::uint64_t>()(data) == MAGIC,
+      "value<T>() reads the candidate");
+    check(field<std::int32_t>(8)(data) == 150, "field<T>() reads at an offset");
+    check((field<std::int32_t>(8) > 100)(data), "comparison with a constant");
+    check(!(field<std::int32_t>(8) % 4 == 0)(data), "arithmetic operators");
+    check((field<std::int32_t>(8) * 2 + 1)(data) == 301,
+      "nested arithmetic keeps its result type");
+    check((field<std::int32_t>(8) > 100 && field<float>(12) < 1.0f)(data),
+      "logical and");
+    check((field<std::int32_t>(8) < 0 || field<float>(12) == 0.5f)(data),
+      "logical or");
+    check(!(!(value<std::uint64_t>() == MAGIC))(data), "logical not");
+
+    // The candidate lies at the end of the buffer, the field before it.
+    check((field<std::int32_t>(-8) == 150)(data + 16),
+      "negative offsets");
+
+    auto const expression = value<std::uint64_t>() == MAGIC &&
+      field<float>(12) < 1.0f;
+    check(expression.getLow() == 0 && expression.getHigh() == 16,
+      "read range covers all fields");
+    check(field<std::int32_t>(-8).getLow() == -8 &&
+      field<std::int32_t>(-8).getHigh() == -4, "read range of a field");
+  }
+
+  void testScan()
+  {
+    // Only every third record is fast enough to match.
+    std::vector<Record> records(1000);
+    for(std::size_t i = 0; i < records.size(); ++i)
+    {
+      records[i].id = MAGIC;
+      records[i].health = static_cast<std::int32_t>(i);
+      records[i].speed = i % 3 ? 2.0f : 0.5f;
+    }
+
+    std::size_t const size = records.size() * sizeof(Record);
+    Ethon::Scanner scanner(
+      std::make_shared<BufferMemorySource>(&records[0], size));
+    std::vector<std::uintptr_t> results = scanner.findAllIf(
+      value<std::uint64_t>() == MAGIC && field<std::int32_t>(8) >= 0 &&
+      field<float>(12) < 1.0f, sizeof(std::uint64_t));
+
+    std::uintptr_t const begin = reinterpret_cast<std::uintptr_t>(&records[0]);
+    bool exact = results.size() == (records.size() + 2) / 3;
+    for(std::size_t i = 0; i < results.size(); ++i)
+    {
+      std::size_t const index = (results[i] - begin) / sizeof(Record);
+      exact = exact && (results[i] - begin) % sizeof(Record) == 0 &&
+        index % 3 == 0;
+    }
+
+    check(std::is_sorted(results.begin(), results.end()),
+      "findAllIf() orders results ascending");
+    check(exact, "findAllIf() finds exactly the matching records");
+  }
+}
+
+int main()
+{
+  try
+  {
+    testEvaluation();
+    testScan();
+
+    std::cout << "\n" << g_errors << " failed checks" << std::endl;
+    return g_errors ? 1 : 0;
+  }
+  catch(Ethon::EthonError const& e)
+  {
+    Ethon::printError(e, std::cerr);
+    return 1;
+  }
+}